@@ -71,6 +71,14 @@ function(caffe_generate_export_configs)
     list(APPEND Caffe_DEFINITIONS -DUSE_LEVELDB)
   endif()
 
+  if(USE_LIBJPEG)
+    list(APPEND Caffe_DEFINITIONS -DUSE_LIBJPEG)
+  endif()
+
+  if(USE_LIBURING)
+    list(APPEND Caffe_DEFINITIONS -DUSE_LIBURING)
+  endif()
+
   if(NOT HAVE_CUDNN)
     set(HAVE_CUDNN FALSE)
   else()
@@ -54,6 +54,22 @@ if(USE_LEVELDB)
   list(APPEND Caffe_LINKER_LIBS ${Snappy_LIBRARIES})
 endif()
 
+# ---[ libjpeg
+if(USE_LIBJPEG)
+  find_package(JPEG REQUIRED)
+  include_directories(SYSTEM ${JPEG_INCLUDE_DIR})
+  list(APPEND Caffe_LINKER_LIBS ${JPEG_LIBRARIES})
+  add_definitions(-DUSE_LIBJPEG)
+endif()
+
+# ---[ liburing
+if(USE_LIBURING)
+  find_package(Liburing REQUIRED)
+  include_directories(SYSTEM ${LIBURING_INCLUDE_DIR})
+  list(APPEND Caffe_LINKER_LIBS ${LIBURING_LIBRARIES})
+  add_definitions(-DUSE_LIBURING)
+endif()
+
 # ---[ CUDA
 include(cmake/Cuda.cmake)
 if(NOT HAVE_CUDA)
@@ -0,0 +1,15 @@
+# Try to find the liburing library and headers
+#  LIBURING_FOUND - system has liburing
+#  LIBURING_INCLUDE_DIR - the liburing include directory
+#  LIBURING_LIBRARIES - Libraries needed to use liburing
+
+find_path(LIBURING_INCLUDE_DIR NAMES liburing.h PATHS "$ENV{LIBURING_DIR}/include")
+find_library(LIBURING_LIBRARIES NAMES uring PATHS "$ENV{LIBURING_DIR}/lib")
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(Liburing DEFAULT_MSG LIBURING_INCLUDE_DIR LIBURING_LIBRARIES)
+
+if(LIBURING_FOUND)
+  message(STATUS "Found liburing (include: ${LIBURING_INCLUDE_DIR}, library: ${LIBURING_LIBRARIES})")
+  mark_as_advanced(LIBURING_INCLUDE_DIR LIBURING_LIBRARIES)
+endif()
@@ -117,6 +117,8 @@ function(caffe_print_configuration_summary)
   caffe_status("  USE_OPENCV        :   ${USE_OPENCV}")
   caffe_status("  USE_LEVELDB       :   ${USE_LEVELDB}")
   caffe_status("  USE_LMDB          :   ${USE_LMDB}")
+  caffe_status("  USE_LIBJPEG       :   ${USE_LIBJPEG}")
+  caffe_status("  USE_LIBURING      :   ${USE_LIBURING}")
   caffe_status("  USE_NCCL          :   ${USE_NCCL}")
   caffe_status("  ALLOW_LMDB_NOLOCK :   ${ALLOW_LMDB_NOLOCK}")
   caffe_status("")
@@ -136,6 +138,12 @@ function(caffe_print_configuration_summary)
   if(USE_OPENCV)
     caffe_status("  OpenCV            :   Yes (ver. ${OpenCV_VERSION})")
   endif()
+  if(USE_LIBJPEG)
+    caffe_status("  libjpeg           : " JPEG_FOUND THEN "Yes" ELSE "No")
+  endif()
+  if(USE_LIBURING)
+    caffe_status("  liburing          : " LIBURING_FOUND THEN "Yes" ELSE "No")
+  endif()
   caffe_status("  CUDA              : " HAVE_CUDA THEN "Yes (ver. ${CUDA_VERSION})" ELSE "No" )
   caffe_status("")
   if(HAVE_CUDA)
@@ -0,0 +1,645 @@
+//
+// Ahead-of-time compiler of a deploy prototxt. For a given net and input size it generates a standalone C++
+// translation unit, in which all shapes, strides, paddings and dilations are compile-time constants (see
+// caffe/util/compiled_net.hpp) and all blobs are statically planned in one memory arena. The generated code
+// loads the weights from a caffemodel file and produces the same outputs as Net::Forward().
+//
+// Supported layers: Input, Convolution (group 1), ReLU, Pooling (MAX), Split, Dropout, BBTXTBB, BB3TXTBB
+//
+// The generated file contains a main() function, which compares the compiled net with Net::Forward() on
+// random data and measures the time of both. Define COMPILED_NET_NO_MAIN to use it as a library.
+//
+
+#include <caffe/caffe.hpp>
+#include "caffe/util/upgrade_proto.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+
+namespace {
+
+    // Each blob in the arena is aligned to 16 floats (one 64 byte cache line)
+    const int ALIGNMENT = 16;
+
+
+    int alignCount (int count)
+    {
+        return (count + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+
+    /**
+     * @brief Converts a layer or net name into a valid C++ identifier
+     */
+    std::string identifier (const std::string &name)
+    {
+        std::string out = name;
+        for (char &c: out)
+        {
+            if (!std::isalnum(c)) c = '_';
+        }
+        if (out.empty() || std::isdigit(out[0])) out = "_" + out;
+        return out;
+    }
+
+
+    /**
+     * @brief Float literal, which represents exactly the given float value
+     */
+    std::string floatLiteral (float value)
+    {
+        std::ostringstream ss;
+        ss << std::setprecision(9) << value;
+        std::string out = ss.str();
+        if (out.find_first_of(".e") == std::string::npos) out += ".0";
+        return out + "f";
+    }
+
+
+    std::string shapeString (const std::vector<int> &shape)
+    {
+        std::ostringstream ss;
+        for (int i = 0; i < shape.size(); ++i) ss << (i > 0 ? "x" : "") << shape[i];
+        return ss.str();
+    }
+
+
+    /**
+     * @brief Value of a repeated parameter field (kernel_size, pad, ...) for the given spatial axis
+     */
+    template <typename RepeatedField>
+    int spatialValue (const RepeatedField &field, int axis, int default_value)
+    {
+        if (field.size() == 0) return default_value;
+        return field.Get(field.size() == 1 ? 0 : axis);
+    }
+
+
+    /**
+     * @brief Kernel, padding, stride and dilation of a convolution or pooling
+     */
+    struct Window
+    {
+        int kh, kw, ph, pw, sh, sw, dh, dw;
+
+        std::string templateArguments (bool dilation) const
+        {
+            std::ostringstream ss;
+            ss << kh << ", " << kw << ", " << ph << ", " << pw << ", " << sh << ", " << sw;
+            if (dilation) ss << ", " << dh << ", " << dw;
+            return ss.str();
+        }
+    };
+
+
+    Window convolutionWindow (const caffe::ConvolutionParameter &p)
+    {
+        Window w;
+        w.kh = p.has_kernel_h() ? p.kernel_h() : spatialValue(p.kernel_size(), 0, 0);
+        w.kw = p.has_kernel_w() ? p.kernel_w() : spatialValue(p.kernel_size(), 1, 0);
+        w.ph = (p.has_pad_h() || p.has_pad_w()) ? p.pad_h() : spatialValue(p.pad(), 0, 0);
+        w.pw = (p.has_pad_h() || p.has_pad_w()) ? p.pad_w() : spatialValue(p.pad(), 1, 0);
+        w.sh = (p.has_stride_h() || p.has_stride_w()) ? p.stride_h() : spatialValue(p.stride(), 0, 1);
+        w.sw = (p.has_stride_h() || p.has_stride_w()) ? p.stride_w() : spatialValue(p.stride(), 1, 1);
+        w.dh = spatialValue(p.dilation(), 0, 1);
+        w.dw = spatialValue(p.dilation(), 1, 1);
+        return w;
+    }
+
+
+    Window poolingWindow (const caffe::PoolingParameter &p)
+    {
+        Window w;
+        w.kh = p.has_kernel_size() ? p.kernel_size() : p.kernel_h();
+        w.kw = p.has_kernel_size() ? p.kernel_size() : p.kernel_w();
+        w.ph = p.has_pad() ? p.pad() : p.pad_h();
+        w.pw = p.has_pad() ? p.pad() : p.pad_w();
+        w.sh = (p.has_stride_h() || p.has_stride_w()) ? p.stride_h() : p.stride();
+        w.sw = (p.has_stride_h() || p.has_stride_w()) ? p.stride_w() : p.stride();
+        w.dh = w.dw = 1;
+        return w;
+    }
+
+
+    /**
+     * @brief First-fit allocator of blobs in the static memory arena
+     */
+    class ArenaPlanner
+    {
+    public:
+
+        ArenaPlanner ()
+            : _size(0)
+        {
+        }
+
+
+        int allocate (int count)
+        {
+            count = alignCount(count);
+
+            for (auto it = this->_free.begin(); it != this->_free.end(); ++it)
+            {
+                if (it->second >= count)
+                {
+                    const int offset = it->first;
+                    const int remaining = it->second - count;
+                    this->_free.erase(it);
+                    if (remaining > 0) this->_free[offset+count] = remaining;
+                    return offset;
+                }
+            }
+
+            // No free interval is large enough - extend the arena
+            const int offset = this->_size;
+            this->_size += count;
+            return offset;
+        }
+
+
+        void release (int offset, int count)
+        {
+            count = alignCount(count);
+            auto it = this->_free.emplace(offset, count).first;
+
+            // Merge with the following interval
+            auto next = std::next(it);
+            if (next != this->_free.end() && it->first + it->second == next->first)
+            {
+                it->second += next->second;
+                this->_free.erase(next);
+            }
+            // Merge with the preceding interval
+            if (it != this->_free.begin())
+            {
+                auto prev = std::prev(it);
+                if (prev->first + prev->second == it->first)
+                {
+                    prev->second += it->second;
+                    this->_free.erase(it);
+                }
+            }
+        }
+
+
+        int size () const
+        {
+            return std::max(this->_size, ALIGNMENT);
+        }
+
+
+    private:
+
+        // Free intervals of the arena: offset -> count
+        std::map<int, int> _free;
+        int _size;
+    };
+
+
+    /**
+     * @brief Liveness and placement of one blob of the net
+     */
+    struct BlobPlan
+    {
+        int root;       // Id of the blob, which owns the memory (Split and Dropout only alias their bottom)
+        int first_def;  // Index of the layer, which produces the blob
+        int last_use;   // Index of the last layer, which reads the blob
+        int offset;     // Offset in the arena
+    };
+
+}
+
+
+
+// -----------------------------------------------  COMPILE  ---------------------------------------------- //
+
+struct ProgramArguments
+{
+    std::string path_prototxt;
+    std::string input_shape;
+    std::string name_space;
+    std::string path_out;
+};
+
+
+/**
+ * @brief Creates the net with the given input shape in order to infer the shapes of all blobs
+ */
+std::shared_ptr<caffe::Net<float>> createNet (const ProgramArguments &pa)
+{
+    caffe::NetParameter net_param;
+    caffe::ReadNetParamsFromTextFileOrDie(pa.path_prototxt, &net_param);
+    net_param.mutable_state()->set_phase(caffe::TEST);
+
+    if (!pa.input_shape.empty())
+    {
+        std::vector<std::string> dims;
+        boost::split(dims, pa.input_shape, boost::is_any_of(",x"));
+        CHECK_EQ(dims.size(), 4) << "Input shape must be given as N,C,H,W!";
+
+        int num_input_layers = 0;
+        for (int i = 0; i < net_param.layer_size(); ++i)
+        {
+            if (net_param.layer(i).type() != "Input") continue;
+
+            caffe::BlobShape *shape = net_param.mutable_layer(i)->mutable_input_param()->mutable_shape(0);
+            shape->clear_dim();
+            for (const std::string &d: dims) shape->add_dim(std::stoi(d));
+            num_input_layers++;
+        }
+        CHECK_EQ(num_input_layers, 1) << "The net must have exactly one Input layer!";
+    }
+
+    return std::make_shared<caffe::Net<float>>(net_param);
+}
+
+
+void compileNet (const ProgramArguments &pa)
+{
+    caffe::Caffe::set_mode(caffe::Caffe::CPU);
+
+    auto net = createNet(pa);
+
+    const auto &layers = net->layers();
+    const auto &blobs  = net->blobs();
+    const int num_layers = layers.size();
+
+    CHECK_EQ(net->input_blob_indices().size(), 1) << "The net must have exactly one input!";
+    CHECK_EQ(blobs[net->input_blob_indices()[0]]->num_axes(), 4) << "The input must have 4 axes!";
+    const int N = blobs[net->input_blob_indices()[0]]->shape(0);
+
+    const std::string ns = pa.name_space.empty() ? identifier(net->name()) : pa.name_space;
+
+
+    // -- LIVENESS OF THE BLOBS -- //
+    std::vector<BlobPlan> plan(blobs.size());
+    for (int i = 0; i < blobs.size(); ++i)
+    {
+        plan[i].root      = i;
+        plan[i].first_def = -1;
+        plan[i].last_use  = -1;
+        plan[i].offset    = -1;
+    }
+
+    for (int l = 0; l < num_layers; ++l)
+    {
+        const std::string &type = layers[l]->layer_param().type();
+
+        for (int b: net->bottom_ids(l))
+        {
+            plan[plan[b].root].last_use = l;
+        }
+        for (int t: net->top_ids(l))
+        {
+            if (type == "Split" || type == "Dropout")
+            {
+                // These layers do not change the data in the TEST phase
+                plan[t].root = plan[net->bottom_ids(l)[0]].root;
+            }
+            else if (plan[t].first_def < 0)
+            {
+                plan[t].first_def = l;
+            }
+        }
+    }
+    // The input is filled by the caller before each forward pass and the outputs must stay valid after it,
+    // these are never reused
+    plan[plan[net->input_blob_indices()[0]].root].last_use = num_layers;
+    for (int o: net->output_blob_indices())
+    {
+        plan[plan[o].root].last_use = num_layers;
+    }
+
+
+    // -- STATIC PLACEMENT OF THE BLOBS -- //
+    ArenaPlanner arena;
+    for (int l = 0; l < num_layers; ++l)
+    {
+        for (int t: net->top_ids(l))
+        {
+            if (plan[t].root == t && plan[t].first_def == l && plan[t].offset < 0)
+            {
+                plan[t].offset = arena.allocate(blobs[t]->count());
+            }
+        }
+
+        // Release the blobs, which are not needed anymore
+        for (int i = 0; i < blobs.size(); ++i)
+        {
+            if (plan[i].root == i && plan[i].last_use == l && plan[i].offset >= 0)
+            {
+                arena.release(plan[i].offset, blobs[i]->count());
+            }
+        }
+    }
+
+    auto blobPtr = [&] (int blob_id) {
+        std::ostringstream ss;
+        ss << "(arena + " << plan[plan[blob_id].root].offset << ")";
+        return ss.str();
+    };
+
+
+    // -- GENERATE THE CODE -- //
+    std::ostringstream weights;     // Static weight buffers
+    std::ostringstream params;      // Entries of the weight table
+    std::ostringstream forward;     // Body of the forward function
+    int num_params       = 0;
+    int col_buffer_size  = 1;
+    int bias_multiplier  = 1;
+
+    for (int l = 0; l < num_layers; ++l)
+    {
+        const caffe::LayerParameter &lp = layers[l]->layer_param();
+        const std::string &type = lp.type();
+        const std::string name  = identifier(lp.name());
+
+        if (type == "Input" || type == "Split" || type == "Dropout") continue;
+
+        CHECK_EQ(net->bottom_ids(l).size(), 1) << "Layer '" << lp.name() << "' must have exactly one bottom!";
+        CHECK_EQ(net->top_ids(l).size(), 1) << "Layer '" << lp.name() << "' must have exactly one top!";
+
+        const caffe::Blob<float> &bottom = *blobs[net->bottom_ids(l)[0]];
+        const caffe::Blob<float> &top    = *blobs[net->top_ids(l)[0]];
+        const std::string in  = blobPtr(net->bottom_ids(l)[0]);
+        const std::string out = blobPtr(net->top_ids(l)[0]);
+
+        forward << "    // " << lp.name() << " (" << type << "): " << shapeString(bottom.shape()) << " -> "
+                << shapeString(top.shape()) << "\n";
+
+        // Per image kernels are called for each image in the batch
+        const std::string loop = (N > 1) ? "    for (int n = 0; n < " + std::to_string(N) + "; ++n)\n    " : "";
+        const std::string in_n  = (N > 1) ? in + " + n*" + std::to_string(bottom.count(1)) : in;
+        const std::string out_n = (N > 1) ? out + " + n*" + std::to_string(top.count(1)) : out;
+
+        if (type == "Convolution")
+        {
+            const caffe::ConvolutionParameter &cp = lp.convolution_param();
+            CHECK_EQ(cp.group(), 1) << "Grouped convolution is not supported ('" << lp.name() << "')!";
+            CHECK_EQ(bottom.num_axes(), 4) << "Only 2D convolution is supported ('" << lp.name() << "')!";
+            CHECK_EQ(layers[l]->blobs().size(), cp.bias_term() ? 2 : 1);
+
+            const Window w   = convolutionWindow(cp);
+            const bool bias  = cp.bias_term();
+            const int c_in   = bottom.shape(1);
+            const int c_out  = top.shape(1);
+            const std::string geometry = std::to_string(c_in) + ", " + std::to_string(bottom.shape(2)) + ", "
+                    + std::to_string(bottom.shape(3)) + ", " + w.templateArguments(true);
+
+            weights << "    float w_" << name << "[" << layers[l]->blobs()[0]->count() << "];\n";
+            if (bias) weights << "    float b_" << name << "[" << c_out << "];\n";
+            params << "        { \"" << lp.name() << "\", w_" << name << ", " << layers[l]->blobs()[0]->count()
+                   << ", " << (bias ? "b_" + name : "NULL") << ", " << (bias ? c_out : 0) << " },\n";
+            num_params++;
+
+            forward << "    static_assert(ConvGeometry<" << geometry << ">::OUT_H == " << top.shape(2)
+                    << " && ConvGeometry<" << geometry << ">::OUT_W == " << top.shape(3)
+                    << ", \"Shape mismatch in " << lp.name() << "\");\n";
+            forward << loop << "    convolution<" << c_in << ", " << bottom.shape(2) << ", " << bottom.shape(3)
+                    << ", " << c_out << ", " << w.templateArguments(true) << ", " << (bias ? "true" : "false")
+                    << ">(" << in_n << ", w_" << name << ", " << (bias ? "b_" + name : "NULL")
+                    << ", bias_multiplier, col_buffer, " << out_n << ");\n";
+
+            const bool is_1x1 = w.kh == 1 && w.kw == 1 && w.sh == 1 && w.sw == 1 && w.ph == 0 && w.pw == 0;
+            if (!is_1x1) col_buffer_size = std::max(col_buffer_size, c_in*w.kh*w.kw*top.count(2));
+            bias_multiplier = std::max(bias_multiplier, top.count(2));
+        }
+        else if (type == "ReLU")
+        {
+            forward << "    relu<" << top.count() << ">(" << in << ", " << out << ", "
+                    << floatLiteral(lp.relu_param().negative_slope()) << ");\n";
+        }
+        else if (type == "Pooling")
+        {
+            const caffe::PoolingParameter &pp = lp.pooling_param();
+            CHECK_EQ(pp.pool(), caffe::PoolingParameter_PoolMethod_MAX) << "Only MAX pooling is supported ('"
+                                                                          << lp.name() << "')!";
+            CHECK(!pp.global_pooling()) << "Global pooling is not supported ('" << lp.name() << "')!";
+
+            const Window w = poolingWindow(pp);
+            const std::string geometry = std::to_string(bottom.shape(2)) + ", " + std::to_string(bottom.shape(3))
+                    + ", " + w.templateArguments(false);
+
+            forward << "    static_assert(PoolGeometry<" << geometry << ">::OUT_H == " << top.shape(2)
+                    << " && PoolGeometry<" << geometry << ">::OUT_W == " << top.shape(3)
+                    << ", \"Shape mismatch in " << lp.name() << "\");\n";
+            forward << loop << "    maxPooling<" << bottom.shape(1) << ", " << geometry << ">(" << in_n << ", "
+                    << out_n << ");\n";
+        }
+        else if (type == "BBTXTBB" || type == "BB3TXTBB")
+        {
+            CHECK_EQ(bottom.shape(1), type == "BBTXTBB" ? 5 : 8) << "Wrong number of channels of the input of '"
+                                                                 << lp.name() << "'!";
+
+            forward << loop << "    bbtxtBB<" << bottom.shape(1) << ", " << bottom.shape(2) << ", "
+                    << bottom.shape(3) << ">(" << in_n << ", " << out_n << ", "
+                    << floatLiteral(lp.bbtxt_bb_param().ideal_size()) << ", "
+                    << floatLiteral(lp.bbtxt_bb_param().downsampling()) << ");\n";
+        }
+        else
+        {
+            LOG(FATAL) << "Layer type '" << type << "' is not supported by the compiler!";
+        }
+    }
+
+
+    // -- WRITE THE TRANSLATION UNIT -- //
+    const int input_id = net->input_blob_indices()[0];
+    const std::vector<int> &outputs = net->output_blob_indices();
+
+    std::ofstream fout(pa.path_out);
+    CHECK(fout) << "Output file '" << pa.path_out << "' could not have been created!";
+
+    fout << "//\n"
+         << "// Generated by compile_net from " << boost::filesystem::path(pa.path_prototxt).filename().string()
+         << " for input " << shapeString(blobs[input_id]->shape()) << ". Do not edit!\n"
+         << "//\n\n"
+         << "#include <caffe/caffe.hpp>\n"
+         << "#include \"caffe/util/benchmark.hpp\"\n"
+         << "#include \"caffe/util/compiled_net.hpp\"\n\n\n"
+         << "namespace " << ns << " {\n\n"
+         << "using namespace caffe::compiled;\n\n"
+         << "const int INPUT_SHAPE[4] = { " << blobs[input_id]->shape(0) << ", " << blobs[input_id]->shape(1)
+         << ", " << blobs[input_id]->shape(2) << ", " << blobs[input_id]->shape(3) << " };\n"
+         << "const int INPUT_COUNT    = " << blobs[input_id]->count() << ";\n"
+         << "const int NUM_OUTPUTS    = " << outputs.size() << ";\n"
+         << "const char* const OUTPUT_NAMES[NUM_OUTPUTS] = {";
+    for (int o: outputs) fout << " \"" << net->blob_names()[o] << "\",";
+    fout << " };\n"
+         << "const int OUTPUT_COUNTS[NUM_OUTPUTS] = {";
+    for (int o: outputs) fout << " " << blobs[o]->count() << ",";
+    fout << " };\n\n\n"
+         << "namespace {\n\n"
+         << "    // All blobs of the net, statically planned (" << arena.size()*sizeof(float)/1024 << " kB)\n"
+         << "    alignas(64) float arena[" << arena.size() << "];\n"
+         << "    alignas(64) float col_buffer[" << col_buffer_size << "];\n"
+         << "    float bias_multiplier[" << bias_multiplier << "];\n\n"
+         << weights.str() << "\n"
+         << "    const ParamEntry PARAMS[" << std::max(num_params, 1) << "] = {\n"
+         << params.str()
+         << "    };\n\n"
+         << "}\n\n\n"
+         << "/**\n"
+         << " * @brief Loads the weights of the net from a caffemodel file, must be called before forward()\n"
+         << " */\n"
+         << "void loadWeights (const std::string &path_caffemodel)\n"
+         << "{\n"
+         << "    loadParams(path_caffemodel, PARAMS, " << num_params << ");\n"
+         << "    std::fill(bias_multiplier, bias_multiplier + " << bias_multiplier << ", 1.0f);\n"
+         << "}\n\n\n"
+         << "float* input ()\n"
+         << "{\n"
+         << "    return " << blobPtr(input_id) << ";\n"
+         << "}\n\n\n"
+         << "const float* output (int i)\n"
+         << "{\n"
+         << "    static float* const OUTPUTS[NUM_OUTPUTS] = {";
+    for (int o: outputs) fout << " " << blobPtr(o) << ",";
+    fout << " };\n"
+         << "    return OUTPUTS[i];\n"
+         << "}\n\n\n"
+         << "void forward ()\n"
+         << "{\n"
+         << forward.str()
+         << "}\n\n\n"
+         << "}  // namespace " << ns << "\n\n\n";
+
+    // Verification and benchmark against Net::Forward()
+    fout << "#ifndef COMPILED_NET_NO_MAIN\n"
+         << "int main (int argc, char** argv)\n"
+         << "{\n"
+         << "    FLAGS_logtostderr = 1;\n"
+         << "    ::google::InitGoogleLogging(argv[0]);\n\n"
+         << "    if (argc < 3)\n"
+         << "    {\n"
+         << "        std::cerr << \"Usage: \" << argv[0] << \" path/f.prototxt path/f.caffemodel [iterations]\" << std::endl;\n"
+         << "        return EXIT_FAILURE;\n"
+         << "    }\n"
+         << "    const int iterations = (argc > 3) ? std::stoi(argv[3]) : 10;\n\n"
+         << "    caffe::Caffe::set_mode(caffe::Caffe::CPU);\n"
+         << "    " << ns << "::loadWeights(argv[2]);\n\n"
+         << "    caffe::Net<float> net(argv[1], caffe::TEST);\n"
+         << "    net.CopyTrainedLayersFrom(argv[2]);\n"
+         << "    net.input_blobs()[0]->Reshape(" << blobs[input_id]->shape(0) << ", " << blobs[input_id]->shape(1)
+         << ", " << blobs[input_id]->shape(2) << ", " << blobs[input_id]->shape(3) << ");\n"
+         << "    net.Reshape();\n\n"
+         << "    float *data = net.input_blobs()[0]->mutable_cpu_data();\n"
+         << "    caffe::caffe_rng_uniform(" << ns << "::INPUT_COUNT, -1.0f, 1.0f, data);\n"
+         << "    caffe::caffe_copy(" << ns << "::INPUT_COUNT, data, " << ns << "::input());\n\n"
+         << "    caffe::CPUTimer timer;\n"
+         << "    timer.Start();\n"
+         << "    for (int i = 0; i < iterations; ++i) net.Forward();\n"
+         << "    timer.Stop();\n"
+         << "    std::cout << \"Net::Forward():  \" << timer.MilliSeconds()/iterations << \" ms\" << std::endl;\n\n"
+         << "    timer.Start();\n"
+         << "    for (int i = 0; i < iterations; ++i) " << ns << "::forward();\n"
+         << "    timer.Stop();\n"
+         << "    std::cout << \"Compiled net:    \" << timer.MilliSeconds()/iterations << \" ms\" << std::endl;\n\n"
+         << "    bool match = true;\n"
+         << "    for (int o = 0; o < " << ns << "::NUM_OUTPUTS; ++o)\n"
+         << "    {\n"
+         << "        const float *expected = net.output_blobs()[o]->cpu_data();\n"
+         << "        const float *actual   = " << ns << "::output(o);\n"
+         << "        float max_diff = 0.0f;\n"
+         << "        for (int i = 0; i < " << ns << "::OUTPUT_COUNTS[o]; ++i)\n"
+         << "        {\n"
+         << "            max_diff = std::max(max_diff, std::abs(expected[i] - actual[i]));\n"
+         << "        }\n"
+         << "        std::cout << " << ns << "::OUTPUT_NAMES[o] << \": max abs difference \" << max_diff << std::endl;\n"
+         << "        if (max_diff != 0.0f) match = false;\n"
+         << "    }\n\n"
+         << "    return match ? EXIT_SUCCESS : EXIT_FAILURE;\n"
+         << "}\n"
+         << "#endif  // COMPILED_NET_NO_MAIN\n";
+
+    fout.close();
+
+    LOG(INFO) << "Compiled " << num_layers << " layers, arena " << arena.size() << " floats, col buffer "
+              << col_buffer_size << " floats -> " << pa.path_out;
+}
+
+
+
+// -----------------------------------------------  MAIN  ------------------------------------------------ //
+
+/**
+ * @brief Parses arguments of the program
+ */
+void parseArguments (int argc, char** argv, ProgramArguments &pa)
+{
+    try {
+        po::options_description desc("Arguments");
+        desc.add_options()
+            ("help", "Print help")
+            ("prototxt", po::value<std::string>(&pa.path_prototxt)->required(),
+             "Deploy model file of the network (*.prototxt)")
+            ("path_out", po::value<std::string>(&pa.path_out)->required(),
+             "Path to the generated C++ file")
+            ("input_shape", po::value<std::string>(&pa.input_shape)->default_value(""),
+             "Shape of the input N,C,H,W (the shape from the prototxt is used if not given)")
+            ("namespace", po::value<std::string>(&pa.name_space)->default_value(""),
+             "Namespace of the generated code (derived from the net name if not given)")
+        ;
+
+        po::positional_options_description positional;
+        positional.add("prototxt", 1);
+        positional.add("path_out", 1);
+
+
+        // Parse the input arguments
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+
+        if (vm.count("help")) {
+            std::cout << "Usage: ./compile_net path/f.prototxt path/out.cpp --input_shape 1,3,128,256\n";
+            std::cout << desc;
+            exit(EXIT_SUCCESS);
+        }
+
+        po::notify(vm);
+
+        if (!boost::filesystem::exists(pa.path_prototxt))
+        {
+            std::cerr << "ERROR: File '" << pa.path_prototxt << "' does not exist!" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        if (boost::filesystem::exists(pa.path_out))
+        {
+            std::cerr << "ERROR: File '" << pa.path_out << "' already exists!" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    catch(std::exception& e)
+    {
+        std::cerr << e.what() << "\n";
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+int main (int argc, char** argv)
+{
+    FLAGS_logtostderr = 1;
+    FLAGS_minloglevel = ::google::INFO;
+    ::google::InitGoogleLogging(argv[0]);
+
+    ProgramArguments pa;
+    parseArguments(argc, argv, pa);
+
+
+    compileNet(pa);
+
+
+    return EXIT_SUCCESS;
+}
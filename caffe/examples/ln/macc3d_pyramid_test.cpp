@@ -4,12 +4,19 @@
 //
 // Tests object detection of 3D bounding boxes of a single scale detector on an image pyramid
 //
-// Optionaly it can apply non-maxima suppression (merging) on bounding boxes.
+// Optionaly it can apply non-maxima suppression (merging) on bounding boxes - either in the image (2D) or in
+// the bird's eye view on the ground plane rectangles of the 3D boxes. The raw detections (before the 3D
+// reconstruction, filtering and NMS) can be cached on the disk, so repeated runs skip the forward pass. With
+// --sparse_head the coordinates of the accumulators are computed only in the extracted local maxima.
 //
 
 #include <caffe/caffe.hpp>
 #include "caffe/util/benchmark.hpp"
+#include "caffe/util/detection.hpp"
+#include "caffe/util/detection_cache.hpp"
+#include "caffe/util/io.hpp"
 #include "caffe/util/pgp.hpp"
+#include "caffe/util/upgrade_proto.hpp"
 
 // This code only works with OpenCV!
 #ifdef USE_OPENCV
@@ -19,6 +26,7 @@
 #include <opencv2/imgproc/imgproc.hpp>
 #include <algorithm>
 #include <iosfwd>
+#include <map>
 #include <memory>
 #include <string>
 #include <utility>
@@ -30,62 +38,10 @@ namespace po = boost::program_options;
 
 // Maximum 2D intersection over union of two boxes that will be both kept after NMS
 #define IOU_2D_THRESHOLD 0.5
-
-
-namespace {
-
-    /**
-     * @brief Checks if the Z coordinate of all points in X_3x8 is in front of C_3x1
-     * @param X_3x8
-     * @param C_3x1
-     * @return True if z of all points in larger than z of C
-     */
-    bool checkZ (const cv::Mat &X_3x8, const cv::Mat &C_3x1)
-    {
-        for (int p = 0; p < 8; ++p)
-        {
-            if (X_3x8.at<double>(2, p) < C_3x1.at<double>(2,0))
-            {
-                return false;
-            }
-        }
-
-        return true;
-    }
-
-
-    /**
-     * @brief Check if the bottom trapezoid has some reasonable size (area)
-     * @param X_3x8 Coordinates of 3D bounding box corners ordered FBL FBR RBR RBL FTL FTR RTR RTL
-     * @return True if it has good size
-     */
-    bool checkBBSize (const cv::Mat &X_3x8)
-    {
-        // We will compute the area of the bottom trapezoid of the bounding box - we need to find the
-        // "height" h of the trapezoid in order to use the A = (a+b)*h / 2 equation for computing its area
-
-        // Get the plane defined by the RBL-FBL normal vector and FBL and intersect it with the RBR-FBR line
-        // The coordinates are ordered FBL FBR RBR RBL FTL FTR RTR RTL
-        cv::Mat n_3x1 = X_3x8(cv::Rect(0, 0, 1, 3)) - X_3x8(cv::Rect(3, 0, 1, 3));  // RBL - FBL
-        double d = -n_3x1.dot(X_3x8(cv::Rect(3, 0, 1, 3)));  // d from ax+by+cz+d=0
-
-        // Intersect the plane with RBR-FBR line (it has the same direction as RBL-FBL)
-        double lambda = -(n_3x1.dot(X_3x8(cv::Rect(1, 0, 1, 3))) + d) / n_3x1.dot(n_3x1);
-        cv::Mat ip_3x1 = X_3x8(cv::Rect(1, 0, 1, 3)) + lambda*n_3x1;  // Intersection point
-
-        // Now compute the distance of the intersected point and FBL to get the h
-        cv::Mat temp = X_3x8(cv::Rect(3, 0, 1, 3)) - ip_3x1;
-        double h = std::sqrt(temp.dot(temp));
-        // Distance of FBL and RBL - another side of the trapezoid
-        double a = std::sqrt(n_3x1.dot(n_3x1));
-
-        // Check the area - if it is too small or too big throw it away
-        double area = (a*a*h) / 2.0;
-        if (area < 1.5 || area > 7500) return false;
-        return true;
-    }
-
-}
+// Maximum intersection over union of the ground plane rectangles of two boxes that will be both kept after NMS
+#define IOU_BEV_THRESHOLD 0.3
+// Minimum confidence of an extracted bounding box
+#define MIN_CONF 0.1
 
 
 /**
@@ -111,107 +67,57 @@ void wrapInputLayer (caffe::Blob<float>* input_layer, std::vector<cv::Mat> &out_
 }
 
 
+/**
+ * @brief Extracts the raw detections (local maxima of the confidence) from the network output
+ */
 std::vector<BB3D> extract3DBoundingBoxes (caffe::Blob<float> *output, const std::string &path_image,
-                                          double scale, const PGP *pgp_p, bool size_filter)
+                                          double scale)
 {
     std::vector<BB3D> bounding_boxes;
 
-    float *data_output = output->mutable_cpu_data();
-
-    // 3D bounding box
-    cv::Mat acc_prob(output->shape(2), output->shape(3), CV_32FC1, data_output+output->offset(0, 0));
-    cv::Mat acc_fblx(output->shape(2), output->shape(3), CV_32FC1, data_output+output->offset(0, 1));
-    cv::Mat acc_fbly(output->shape(2), output->shape(3), CV_32FC1, data_output+output->offset(0, 2));
-    cv::Mat acc_fbrx(output->shape(2), output->shape(3), CV_32FC1, data_output+output->offset(0, 3));
-    cv::Mat acc_fbry(output->shape(2), output->shape(3), CV_32FC1, data_output+output->offset(0, 4));
-    cv::Mat acc_rblx(output->shape(2), output->shape(3), CV_32FC1, data_output+output->offset(0, 5));
-    cv::Mat acc_rbly(output->shape(2), output->shape(3), CV_32FC1, data_output+output->offset(0, 6));
-    cv::Mat acc_ftly(output->shape(2), output->shape(3), CV_32FC1, data_output+output->offset(0, 7));
-
-    // Extract detected 3D boxes - only extract local maxima from 3x3 neighborhood
-    for (int i = 0; i < acc_prob.rows; ++i)
+    // Extract detected 3D boxes - only local maxima from 3x3 neighborhood, the same as in the library detectors
+    for (const caffe::Detection3D &d: caffe::extractBB3TXTDetections(*output, 0, scale, MIN_CONF))
     {
-        for (int j = 0; j < acc_prob.cols; ++j)
-        {
-            float conf = acc_prob.at<float>(i, j);
-            if (conf >= 0.1)
-            {
-                // Check if it is a local maximum
-                if (i > 0)
-                {
-                    if (j > 0 && acc_prob.at<float>(i-1, j-1) > conf) continue;
-                    if (acc_prob.at<float>(i-1, j) > conf) continue;
-                    if (j < acc_prob.cols-1 && acc_prob.at<float>(i-1, j+1) > conf) continue;
-                }
-                if (j > 0 && acc_prob.at<float>(i, j-1) > conf) continue;
-                if (j < acc_prob.cols-1 && acc_prob.at<float>(i, j+1) > conf) continue;
-                if (i < acc_prob.rows-1)
-                {
-                    if (j > 0 && acc_prob.at<float>(i+1, j-1) > conf) continue;
-                    if (acc_prob.at<float>(i+1, j) > conf) continue;
-                    if (j < acc_prob.cols-1 && acc_prob.at<float>(i+1, j+1) > conf) continue;
-                }
+        bounding_boxes.emplace_back(path_image, d.label, d.conf, d.fblx, d.fbly, d.fbrx, d.fbry, d.rblx, d.rbly,
+                                    d.ftly);
+    }
 
-                // Ok, this is a local maximum
-                double fblx = acc_fblx.at<float>(i, j) / scale;
-                double fbly = acc_fbly.at<float>(i, j) / scale;
-                double fbrx = acc_fbrx.at<float>(i, j) / scale;
-                double fbry = acc_fbry.at<float>(i, j) / scale;
-                double rblx = acc_rblx.at<float>(i, j) / scale;
-                double rbly = acc_rbly.at<float>(i, j) / scale;
-                double ftly = acc_ftly.at<float>(i, j) / scale;
+    return bounding_boxes;
+}
 
 
-                if (pgp_p == NULL)
-                {
-                    // We do not have image projection matrices and ground planes - just output the detection
-                    bounding_boxes.emplace_back(path_image, 1, conf, fblx, fbly, fbrx, fbry, rblx, rbly, ftly);
-                }
-                else
-                {
-                    // There are image projection matrices and ground planes - reconstruct the 3D bounding box
-                    BB3D bb3d(path_image, 1, conf, fblx, fbly, fbrx, fbry, rblx, rbly, ftly);
-                    cv::Mat X_3x8 = pgp_p->reconstructAndFixBB3D(bb3d);
-
-                    // Now since the Z axis points forward, we can check if the reconstructed points are in
-                    // front of the camera, if not then we can throw away this bounding box
-                    if (!checkZ(X_3x8, pgp_p->C_3x1)) continue;
-
-                    // Check if the bounding box is large enough - its bottom trapezoid should be of
-                    // reasonable size
-                    if (size_filter && !checkBBSize(X_3x8)) continue;
-
-                    // Extract the 2D bounding box - project back the 3D one and find extremes
-                    cv::Mat x_2x8 = pgp_p->projectXtox(X_3x8);
-                    double xmin = DBL_MAX; double ymin = DBL_MAX; double xmax = DBL_MIN; double ymax = DBL_MIN;
-                    for (int p = 0; p < 8; ++p)
-                    {
-                        const double u = x_2x8.at<double>(0, p);
-                        const double v = x_2x8.at<double>(1, p);
-                        if (u < xmin) xmin = u;
-                        if (u > xmax) xmax = u;
-                        if (v < ymin) ymin = v;
-                        if (v > ymax) ymax = v;
-                    }
-                    // Set the 2D bounding box
-                    bb3d.xmin = xmin;
-                    bb3d.ymin = ymin;
-                    bb3d.xmax = xmax;
-                    bb3d.ymax = ymax;
-
-                    bounding_boxes.push_back(bb3d);
-                }
-            }
-        }
+/**
+ * @brief Converts raw detections into cache records: conf fblx fbly fbrx fbry rblx rbly ftly
+ */
+std::vector<float> toCacheRecords (const std::vector<BB3D> &bbs)
+{
+    std::vector<float> records;
+    records.reserve(8*bbs.size());
+    for (const BB3D &bb: bbs)
+    {
+        records.insert(records.end(), { float(bb.conf), float(bb.fblx), float(bb.fbly), float(bb.fbrx),
+                                        float(bb.fbry), float(bb.rblx), float(bb.rbly), float(bb.ftly) });
     }
+    return records;
+}
 
-    return bounding_boxes;
+
+std::vector<BB3D> fromCacheRecords (const std::vector<float> &records, const std::string &path_image)
+{
+    std::vector<BB3D> bbs;
+    for (int i = 0; i+8 <= records.size(); i += 8)
+    {
+        bbs.emplace_back(path_image, 1, records[i], records[i+1], records[i+2], records[i+3], records[i+4],
+                         records[i+5], records[i+6], records[i+7]);
+    }
+    return bbs;
 }
 
 
 std::vector<BB3D> detectObjects (const std::string &path_image, const std::vector<double> &scales,
                                  const std::shared_ptr<caffe::Net<float>> &net,
-                                 const std::map<std::string, PGP> &pgps, bool size_filter)
+                                 const std::map<std::string, PGP> &pgps, bool size_filter,
+                                 const caffe::DetectionCache *cache)
 {
 #ifdef MEASURE_TIME
     caffe::CPUTimer timer;
@@ -222,18 +128,10 @@ std::vector<BB3D> detectObjects (const std::string &path_image, const std::vecto
 
     std::vector<cv::Mat> input_channels;
 
-#ifdef MEASURE_TIME
-    timer.Start();
-#endif
-    // Load the image
-    cv::Mat image = cv::imread(path_image, CV_LOAD_IMAGE_COLOR);
-    // Convert to zero mean and unit variance
-    cv::Mat imagef; image.convertTo(imagef, CV_32FC3);
-    imagef -= cv::Scalar(128.0f, 128.0f, 128.0f);
-    imagef *= 1.0f/128.0f;
-#ifdef MEASURE_TIME
-    timer.Stop(); std::cout << "Time to to read image: " << timer.MilliSeconds() << " ms" << std::endl;
-#endif
+    // The image is only loaded if some scale is not cached
+    std::map<int, cv::Mat> decoded;
+    cv::Size original_size;
+    const uint64_t image_hash = (cache != NULL) ? caffe::DetectionCache::hashFile(path_image) : 0;
 
     // Get the image projection matrix and ground plane if we have them
     const PGP* pgp_p = NULL;
@@ -257,8 +155,21 @@ std::vector<BB3D> detectObjects (const std::string &path_image, const std::vecto
     // Build the image pyramid and run detection on each scale of the pyramid
     for (double s: scales)
     {
-        cv::Mat imagef_scaled;
-        cv::resize(imagef, imagef_scaled, cv::Size(), s, s);
+        std::string key;
+        if (cache != NULL)
+        {
+            key = cache->key(image_hash, s);
+            std::vector<float> records;
+            if (cache->load(key, 8, records))
+            {
+                std::vector<BB3D> new_bbs = reconstructDetections(fromCacheRecords(records, path_image),
+                                                                       pgp_p, size_filter);
+                bounding_boxes.insert(bounding_boxes.end(), new_bbs.begin(), new_bbs.end());
+                continue;
+            }
+        }
+
+        cv::Mat imagef_scaled = caffe::pyramidLevel(path_image, s, decoded, original_size);
 
         // Reshape the network
         input_layer->Reshape(1, input_layer->shape(1), imagef_scaled.rows, imagef_scaled.cols);
@@ -271,11 +182,17 @@ std::vector<BB3D> detectObjects (const std::string &path_image, const std::vecto
 
         net->Forward();
 
+        std::vector<BB3D> candidates;
         for (caffe::Blob<float>* output: net->output_blobs())
         {
-            std::vector<BB3D> new_bbs = extract3DBoundingBoxes(output, path_image, s, pgp_p, size_filter);
-            bounding_boxes.insert(bounding_boxes.end(), new_bbs.begin(), new_bbs.end());
+            std::vector<BB3D> new_bbs = extract3DBoundingBoxes(output, path_image, s);
+            candidates.insert(candidates.end(), new_bbs.begin(), new_bbs.end());
         }
+
+        if (cache != NULL) cache->store(key, 8, toCacheRecords(candidates));
+
+        std::vector<BB3D> new_bbs = reconstructDetections(candidates, pgp_p, size_filter);
+        bounding_boxes.insert(bounding_boxes.end(), new_bbs.begin(), new_bbs.end());
     }
 
 #ifdef MEASURE_TIME
@@ -321,6 +238,32 @@ std::vector<BB3D> nonMaximaSuppression (std::vector<BB3D> &bbs)
 }
 
 
+std::vector<BB3D> nonMaximaSuppressionBEV (const std::vector<BB3D> &bbs, const PGP &pgp)
+{
+    // Non-maxima suppression in the bird's eye view - the boxes are compared by the intersection over union
+    // of their rectangles on the ground plane. Objects, which occlude each other in the image, but are at
+    // different distances from the camera, are thus not merged
+    std::vector<GroundRect> rects;
+    std::vector<double> conf;
+    rects.reserve(bbs.size());
+    conf.reserve(bbs.size());
+
+    for (BB3D bb: bbs)
+    {
+        // The boxes have already been fixed by PGP::reconstructDetection() in reconstructDetections(),
+        // so the reconstruction keeps them
+        cv::Mat X_3x8 = pgp.reconstructAndFixBB3D(bb);
+        rects.push_back(pgp.groundRect(X_3x8));
+        conf.push_back(bb.conf);
+    }
+
+    std::vector<BB3D> bbs_out;
+    for (int i: nonMaximaSuppressionBEV(rects, conf, IOU_BEV_THRESHOLD)) bbs_out.push_back(bbs[i]);
+
+    return bbs_out;
+}
+
+
 void writeBoundingBoxes (const std::vector<BB3D> &bbs, std::ofstream &fout)
 {
     for (const BB3D &bb: bbs)
@@ -337,7 +280,8 @@ void writeBoundingBoxes (const std::vector<BB3D> &bbs, std::ofstream &fout)
 
 void runPyramidDetection (const std::string &path_prototxt, const std::string &path_caffemodel,
                           const std::string &path_image_list, const std::string &path_out,
-                          const std::string &path_pgp, bool size_filter)
+                          const std::string &path_pgp, bool size_filter, bool nms_bev,
+                          const std::string &path_cache, bool sparse_head)
 {
 #ifdef CPU_ONLY
     caffe::Caffe::set_mode(caffe::Caffe::CPU);
@@ -354,7 +298,16 @@ void runPyramidDetection (const std::string &path_prototxt, const std::string &p
     const std::vector<double> scales = { 1.0 };
 
     // Create network and load trained weights from caffemodel file
-    auto net = std::make_shared<caffe::Net<float>>(path_prototxt, caffe::TEST);
+    caffe::NetParameter net_param;
+    caffe::ReadNetParamsFromTextFileOrDie(path_prototxt, &net_param);
+    net_param.mutable_state()->set_phase(caffe::TEST);
+    if (sparse_head)
+    {
+        const int replaced = caffe::enableSparseAccumulators(net_param, MIN_CONF);
+        LOG(INFO) << "Sparse evaluation of " << replaced << " accumulators";
+    }
+
+    auto net = std::make_shared<caffe::Net<float>>(net_param);
     net->CopyTrainedLayersFrom(path_caffemodel);
 
     caffe::Blob<float>* input_layer  = net->input_blobs()[0];
@@ -381,6 +334,9 @@ void runPyramidDetection (const std::string &path_prototxt, const std::string &p
     std::ofstream fout_nms;
     if (pgps.size() > 0) fout_nms.open(path_out.substr(0, path_out.size()-7) + "_nms.bb3txt");
 
+    std::unique_ptr<caffe::DetectionCache> cache;
+    if (path_cache != "") cache.reset(new caffe::DetectionCache(path_cache, path_prototxt, path_caffemodel));
+
     // -- RUN THE DETECTOR ON EACH IMAGE -- //
     while (std::getline(infile, line))
     {
@@ -388,7 +344,7 @@ void runPyramidDetection (const std::string &path_prototxt, const std::string &p
         CHECK(boost::filesystem::exists(line)) << "Image '" << line << "' not found!";
 
         // Detect bbs on the image
-        std::vector<BB3D> bbs = detectObjects(line, scales, net, pgps, size_filter);
+        std::vector<BB3D> bbs = detectObjects(line, scales, net, pgps, size_filter, cache.get());
 
         // Save the bounding boxes before NMS to a BBTXT file
         writeBoundingBoxes(bbs, fout);
@@ -400,7 +356,15 @@ void runPyramidDetection (const std::string &path_prototxt, const std::string &p
             timer.Start();
 #endif
             // Non-maxima suppression
-            bbs = nonMaximaSuppression(bbs);
+            auto pgpi = pgps.find(line);
+            if (nms_bev && pgpi != pgps.end())
+            {
+                bbs = nonMaximaSuppressionBEV(bbs, pgpi->second);
+            }
+            else
+            {
+                bbs = nonMaximaSuppression(bbs);
+            }
 #ifdef MEASURE_TIME
             timer.Stop(); std::cout << "Time to perform NMS: " << timer.MilliSeconds() << " ms" << std::endl;
 #endif
@@ -425,6 +389,9 @@ struct ProgramArguments
     std::string path_out;
     std::string path_pgp;
     bool size_filter;
+    bool nms_bev;
+    std::string path_cache;
+    bool sparse_head;
 };
 
 
@@ -449,6 +416,12 @@ void parseArguments (int argc, char** argv, ProgramArguments &pa)
              "Path to a PGP file with calibration matrices and ground planes")
             ("size_filter", po::bool_switch(&pa.size_filter)->default_value(false),
              "Turns on filtering of all bounding boxes, which are too small")
+            ("nms_bev", po::bool_switch(&pa.nms_bev)->default_value(false),
+             "Non-maxima suppression on the ground plane (bird's eye view) instead of in the image")
+            ("cache", po::value<std::string>(&pa.path_cache)->default_value(""),
+             "Directory with cached raw detections, reused if the images and the model are the same")
+            ("sparse_head", po::bool_switch(&pa.sparse_head)->default_value(false),
+             "Compute the bounding box coordinates only in the local maxima of the accumulators")
         ;
 
         po::positional_options_description positional;
@@ -515,7 +488,8 @@ int main (int argc, char** argv)
     parseArguments(argc, argv, pa);
 
 std::cout << pa.size_filter << std::endl;
-    runPyramidDetection(pa.path_prototxt, pa.path_caffemodel, pa.path_image_list, pa.path_out, pa.path_pgp, pa.size_filter);
+    runPyramidDetection(pa.path_prototxt, pa.path_caffemodel, pa.path_image_list, pa.path_out, pa.path_pgp, pa.size_filter,
+                        pa.nms_bev, pa.path_cache, pa.sparse_head);
 
 
     return EXIT_SUCCESS;
@@ -0,0 +1,417 @@
+//
+// Tests object detection of 2D and 3D bounding boxes with a joint network (one backbone with both 2D and 3D
+// accumulators, see macc_net_generator.py joint) on an image pyramid
+//
+// Each pyramid level is passed through the network only once, the 2D bounding boxes are extracted from the
+// 5 channel accumulators and the 3D ones from the 8 channel accumulators of the same forward pass. This
+// replaces running macc_pyramid_test and macc3d_pyramid_test with two separate networks. The 2D boxes are
+// written to a BBTXT file, the 3D ones to a BB3TXT file, both before and after non-maxima suppression (the 3D
+// boxes only with a PGP file).
+//
+
+#include <caffe/caffe.hpp>
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/detection.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/nms_bev.hpp"
+#include "caffe/util/pgp.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+// This code only works with OpenCV!
+#ifdef USE_OPENCV
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+
+// Maximum 2D intersection over union of two boxes that will be both kept after NMS
+#define IOU_2D_THRESHOLD 0.5
+// Maximum intersection over union of the ground plane rectangles of two boxes that will be both kept after NMS
+#define IOU_BEV_THRESHOLD 0.3
+// Minimum confidence of an extracted bounding box
+#define MIN_CONF 0.1
+
+
+/**
+ * @brief Bounding boxes of both kinds detected in one image
+ */
+struct JointDetections
+{
+    std::vector<caffe::Detection2D> bbs2d;
+    std::vector<BB3D> bbs3d;
+};
+
+
+/**
+ * @brief Wraps the input layer into a vector of cv::Mat so we could assign data to it more easily
+ * @param input_layer Pointer to the net input layer blob
+ * @param input_channels Vector of cv::Mat, which will be assigned
+ */
+void wrapInputLayer (caffe::Blob<float>* input_layer, std::vector<cv::Mat> &out_input_channels)
+{
+    out_input_channels.clear();
+
+    int height = input_layer->shape(2);
+    int width  = input_layer->shape(3);
+
+    float* input_data = input_layer->mutable_cpu_data();
+
+    for (int i = 0; i < input_layer->shape(1); ++i)
+    {
+        cv::Mat channel(height, width, CV_32FC1, input_data);
+        out_input_channels.push_back(channel);
+        input_data += width * height;
+    }
+}
+
+
+/**
+ * @brief Runs the network once on each pyramid level and extracts both 2D and 3D bounding boxes
+ */
+JointDetections detectObjects (const std::string &path_image, const std::vector<double> &scales,
+                               const std::shared_ptr<caffe::Net<float>> &net, const PGP *pgp_p,
+                               bool size_filter)
+{
+#ifdef MEASURE_TIME
+    caffe::CPUTimer timer;
+    timer.Start();
+#endif
+    JointDetections detections;
+
+    caffe::Blob<float>* input_layer = net->input_blobs()[0];
+    std::vector<cv::Mat> input_channels;
+
+    std::map<int, cv::Mat> decoded;
+    cv::Size original_size;
+
+    // Build the image pyramid and run detection on each scale of the pyramid
+    for (double s: scales)
+    {
+        cv::Mat imagef_scaled = caffe::pyramidLevel(path_image, s, decoded, original_size);
+
+        // Reshape the network
+        input_layer->Reshape(1, input_layer->shape(1), imagef_scaled.rows, imagef_scaled.cols);
+        net->Reshape();
+
+        // Copy the image to the input layer of the network
+        wrapInputLayer(input_layer, input_channels);
+        cv::split(imagef_scaled, input_channels);
+
+        net->Forward();
+
+        // The kind of the accumulator is given by its number of channels
+        std::vector<BB3D> candidates;
+        for (caffe::Blob<float>* output: net->output_blobs())
+        {
+            if (output->shape(1) == 5)
+            {
+                std::vector<caffe::Detection2D> new_bbs = caffe::extractBBTXTDetections(*output, 0, s, MIN_CONF);
+                detections.bbs2d.insert(detections.bbs2d.end(), new_bbs.begin(), new_bbs.end());
+            }
+            else if (output->shape(1) == 8)
+            {
+                for (const caffe::Detection3D &d: caffe::extractBB3TXTDetections(*output, 0, s, MIN_CONF))
+                {
+                    candidates.emplace_back(path_image, d.label, d.conf, d.fblx, d.fbly, d.fbrx, d.fbry, d.rblx,
+                                            d.rbly, d.ftly);
+                }
+            }
+        }
+
+        std::vector<BB3D> new_bbs = reconstructDetections(candidates, pgp_p, size_filter);
+        detections.bbs3d.insert(detections.bbs3d.end(), new_bbs.begin(), new_bbs.end());
+    }
+
+#ifdef MEASURE_TIME
+    timer.Stop(); std::cout << "Time net + bb extraction: " << timer.MilliSeconds() << " ms" << std::endl;
+#endif
+
+    return detections;
+}
+
+
+std::vector<BB3D> nonMaximaSuppression (std::vector<BB3D> &bbs)
+{
+    // Standard non-maxima suppression in the image, the boxes are compared by their 2D bounding boxes
+    return caffe::greedyNonMaximaSuppression(bbs, IOU_2D_THRESHOLD, iou2d<BB3D>);
+}
+
+
+std::vector<BB3D> nonMaximaSuppressionBEV (const std::vector<BB3D> &bbs, const PGP &pgp)
+{
+    // Non-maxima suppression in the bird's eye view on the ground plane rectangles of the boxes
+    std::vector<GroundRect> rects;
+    std::vector<double> conf;
+    for (BB3D bb: bbs)
+    {
+        rects.push_back(pgp.groundRect(pgp.reconstructAndFixBB3D(bb)));
+        conf.push_back(bb.conf);
+    }
+
+    std::vector<BB3D> bbs_out;
+    for (int i: nonMaximaSuppressionBEV(rects, conf, IOU_BEV_THRESHOLD)) bbs_out.push_back(bbs[i]);
+
+    return bbs_out;
+}
+
+
+void writeBoundingBoxes (const std::string &path_image, const std::vector<caffe::Detection2D> &bbs,
+                         std::ofstream &fout)
+{
+    for (const caffe::Detection2D &bb: bbs)
+    {
+        // The line of a BBTXT file is: filename label confidence xmin ymin xmax ymax
+        fout << path_image << " " << bb.label << " " << bb.conf << " " << bb.xmin << " " << bb.ymin << " "
+             << bb.xmax << " " << bb.ymax << std::endl;
+    }
+}
+
+
+void writeBoundingBoxes (const std::vector<BB3D> &bbs, std::ofstream &fout)
+{
+    for (const BB3D &bb: bbs)
+    {
+        // The line of a BB3TXT file is:
+        // filename label confidence xmin ymin xmax ymax fblx fbly fbrx fbry rblx rbly ftly
+        fout << bb.path_image << " 1 " << bb.conf << " " << bb.xmin << " " << bb.ymin << " " << bb.xmax
+             << " " << bb.ymax << " " << bb.fblx << " " << bb.fbly << " " << bb.fbrx << " " << bb.fbry
+             << " " << bb.rblx << " " << bb.rbly << " " << bb.ftly << std::endl;
+    }
+}
+
+
+void runJointPyramidDetection (const std::string &path_prototxt, const std::string &path_caffemodel,
+                               const std::string &path_image_list, const std::string &path_out_2d,
+                               const std::string &path_out_3d, const std::string &path_pgp, bool size_filter,
+                               bool nms_bev, bool sparse_head)
+{
+#ifdef CPU_ONLY
+    caffe::Caffe::set_mode(caffe::Caffe::CPU);
+#else
+    caffe::Caffe::set_mode(caffe::Caffe::GPU);
+#endif
+
+    // Scaling factor is 1.5
+//    const std::vector<double> scales = { 1.0, 0.66, 0.44, 0.29, 0.19 };
+    const std::vector<double> scales = { 1.0 };
+
+    // Create network and load trained weights from caffemodel file
+    caffe::NetParameter net_param;
+    caffe::ReadNetParamsFromTextFileOrDie(path_prototxt, &net_param);
+    net_param.mutable_state()->set_phase(caffe::TEST);
+    if (sparse_head)
+    {
+        const int replaced = caffe::enableSparseAccumulators(net_param, MIN_CONF);
+        LOG(INFO) << "Sparse evaluation of " << replaced << " accumulators";
+    }
+
+    auto net = std::make_shared<caffe::Net<float>>(net_param);
+    net->CopyTrainedLayersFrom(path_caffemodel);
+
+    CHECK_EQ(net->num_inputs(), 1) << "Network should have exactly one input.";
+    CHECK_EQ(net->input_blobs()[0]->shape(1), 3) << "Input layer must have 3 channels.";
+
+    int num_2d = 0, num_3d = 0;
+    for (caffe::Blob<float>* output: net->output_blobs())
+    {
+        if (output->shape(1) == 5) num_2d++;
+        else if (output->shape(1) == 8) num_3d++;
+        else LOG(FATAL) << "Unsupported network, only 5 and 8 channel outputs!";
+    }
+    CHECK_GT(num_2d, 0) << "The network has no 2D accumulators (5 channels), it is not a joint network!";
+    CHECK_GT(num_3d, 0) << "The network has no 3D accumulators (8 channels), it is not a joint network!";
+
+    std::ifstream infile(path_image_list.c_str());
+    CHECK(infile) << "Unable to open image list TXT file '" << path_image_list << "'!";
+    std::string line;
+
+    // Load the P matrices and ground planes
+    std::map<std::string, PGP> pgps;
+    if (path_pgp != "") pgps = PGP::readPGPFile(path_pgp);
+
+    std::ofstream fout_2d; fout_2d.open(path_out_2d);
+    CHECK(fout_2d) << "Output file '" << path_out_2d << "' could not have been created!";
+    std::ofstream fout_2d_nms; fout_2d_nms.open(path_out_2d.substr(0, path_out_2d.size()-6) + "_nms.bbtxt");
+
+    std::ofstream fout_3d; fout_3d.open(path_out_3d);
+    CHECK(fout_3d) << "Output file '" << path_out_3d << "' could not have been created!";
+    std::ofstream fout_3d_nms;
+    if (pgps.size() > 0) fout_3d_nms.open(path_out_3d.substr(0, path_out_3d.size()-7) + "_nms.bb3txt");
+
+    // -- RUN THE DETECTOR ON EACH IMAGE -- //
+    while (std::getline(infile, line))
+    {
+        LOG(INFO) << line;
+        CHECK(boost::filesystem::exists(line)) << "Image '" << line << "' not found!";
+
+        // Get the image projection matrix and ground plane if we have them
+        const PGP* pgp_p = NULL;
+        auto pgpi = pgps.find(line);
+        if (pgpi != pgps.end())
+        {
+            pgp_p = &pgpi->second;
+        }
+        else if (pgps.size() > 0)
+        {
+            std::cerr << "WARNING: PGP entry not found for image '" << line << "'" << std::endl;
+        }
+
+        // Detect both kinds of bbs in one pass through the network
+        JointDetections detections = detectObjects(line, scales, net, pgp_p, size_filter);
+
+        // Save the bounding boxes before NMS
+        writeBoundingBoxes(line, detections.bbs2d, fout_2d);
+        writeBoundingBoxes(detections.bbs3d, fout_3d);
+
+        writeBoundingBoxes(line, caffe::nonMaximaSuppression(detections.bbs2d, IOU_2D_THRESHOLD), fout_2d_nms);
+
+        // Only do NMS of the 3D boxes if we can reconstruct them
+        if (pgps.size() > 0)
+        {
+            if (nms_bev && pgp_p != NULL)
+            {
+                writeBoundingBoxes(nonMaximaSuppressionBEV(detections.bbs3d, *pgp_p), fout_3d_nms);
+            }
+            else
+            {
+                writeBoundingBoxes(nonMaximaSuppression(detections.bbs3d), fout_3d_nms);
+            }
+        }
+    }
+
+    fout_2d.close();
+    fout_2d_nms.close();
+    fout_3d.close();
+    if (pgps.size() > 0) fout_3d_nms.close();
+}
+
+
+// -----------------------------------------------  MAIN  ------------------------------------------------ //
+
+struct ProgramArguments
+{
+    std::string path_prototxt;
+    std::string path_caffemodel;
+    std::string path_image_list;
+    std::string path_out_2d;
+    std::string path_out_3d;
+    std::string path_pgp;
+    bool size_filter;
+    bool nms_bev;
+    bool sparse_head;
+};
+
+
+/**
+ * @brief Parses arguments of the program
+ */
+void parseArguments (int argc, char** argv, ProgramArguments &pa)
+{
+    try {
+        po::options_description desc("Arguments");
+        desc.add_options()
+            ("help", "Print help")
+            ("prototxt", po::value<std::string>(&pa.path_prototxt)->required(),
+             "Model file of the joint network (*.prototxt)")
+            ("caffemodel", po::value<std::string>(&pa.path_caffemodel)->required(),
+             "Weight file of the joint network (*.caffemodel)")
+            ("image_list", po::value<std::string>(&pa.path_image_list)->required(),
+             "Path to a TXT file with paths to the images to be tested")
+            ("path_out_2d", po::value<std::string>(&pa.path_out_2d)->required(),
+             "Path to the output BBTXT file with 2D bounding boxes")
+            ("path_out_3d", po::value<std::string>(&pa.path_out_3d)->required(),
+             "Path to the output BB3TXT file with 3D bounding boxes")
+            ("pgp", po::value<std::string>(&pa.path_pgp)->default_value(""),
+             "Path to a PGP file with calibration matrices and ground planes")
+            ("size_filter", po::bool_switch(&pa.size_filter)->default_value(false),
+             "Turns on filtering of all 3D bounding boxes, which are too small")
+            ("nms_bev", po::bool_switch(&pa.nms_bev)->default_value(false),
+             "Non-maxima suppression of the 3D boxes on the ground plane (bird's eye view)")
+            ("sparse_head", po::bool_switch(&pa.sparse_head)->default_value(false),
+             "Compute the bounding box coordinates only in the local maxima of the accumulators")
+        ;
+
+        po::positional_options_description positional;
+        positional.add("prototxt", 1);
+        positional.add("caffemodel", 1);
+        positional.add("image_list", 1);
+        positional.add("path_out_2d", 1);
+        positional.add("path_out_3d", 1);
+        positional.add("pgp", 1);
+
+
+        // Parse the input arguments
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+
+        if (vm.count("help")) {
+            std::cout << "Usage: ./macc_joint_pyramid_test path/f.prototxt path/f.caffemodel path/image_list.txt path/out.bbtxt path/out.bb3txt (path/calib.pgp)\n";
+            std::cout << desc;
+            exit(EXIT_SUCCESS);
+        }
+
+        po::notify(vm);
+
+        for (const std::string &path: { pa.path_prototxt, pa.path_caffemodel, pa.path_image_list })
+        {
+            if (!boost::filesystem::exists(path))
+            {
+                std::cerr << "ERROR: File '" << path << "' does not exist!" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        for (const std::string &path: { pa.path_out_2d, pa.path_out_3d })
+        {
+            if (boost::filesystem::exists(path))
+            {
+                std::cerr << "ERROR: File '" << path << "' already exists!" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (pa.path_pgp != "" && !boost::filesystem::exists(pa.path_pgp))
+        {
+            std::cerr << "ERROR: File '" << pa.path_pgp << "' does not exist!" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    catch(std::exception& e)
+    {
+        std::cerr << e.what() << "\n";
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+int main (int argc, char** argv)
+{
+    FLAGS_logtostderr = 1;
+    FLAGS_minloglevel = ::google::INFO;
+    ::google::InitGoogleLogging(argv[0]);
+
+    ProgramArguments pa;
+    parseArguments(argc, argv, pa);
+
+    runJointPyramidDetection(pa.path_prototxt, pa.path_caffemodel, pa.path_image_list, pa.path_out_2d,
+                             pa.path_out_3d, pa.path_pgp, pa.size_filter, pa.nms_bev, pa.sparse_head);
+
+
+    return EXIT_SUCCESS;
+}
+
+
+#else
+int main(int argc, char** argv) {
+    LOG(FATAL) << "This example requires OpenCV; compile with USE_OPENCV.";
+}
+#endif  // USE_OPENCV
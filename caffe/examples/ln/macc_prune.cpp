@@ -0,0 +1,554 @@
+//
+// Structured channel pruning of a trained deploy network. The filters of the convolutional layers are
+// ranked by the L1 norm of their weights and by the mean activation collected on a set of images, the
+// weakest filters are removed together with the corresponding input channels of the downstream
+// convolutions. It outputs a new deploy prototxt and caffemodel.
+//
+
+#include <caffe/caffe.hpp>
+#include "caffe/util/bbtxt.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+// This code only works with OpenCV!
+#ifdef USE_OPENCV
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+
+namespace {
+
+    // Layers, which do not change the meaning of the channels of their input
+    const std::set<std::string> CHANNEL_PRESERVING_LAYERS = { "ReLU", "Pooling", "Split", "Dropout" };
+
+
+    /**
+     * @brief Pruning candidate - convolutional layer and the layers, which consume its output channels
+     */
+    struct PrunableLayer
+    {
+        int layer_id;
+        std::vector<int> consumer_ids;                  // Convolutional layers reading the output channels
+        std::vector<double> weight_norm;                // L1 norm of each filter
+        std::vector<double> activation;                 // Sum of mean activations of each channel
+        std::vector<int> keep;                          // Indices of the filters, which are kept
+    };
+
+}
+
+
+/**
+ * @brief Wraps the input layer into a vector of cv::Mat so we could assign data to it more easily
+ * @param input_layer Pointer to the net input layer blob
+ * @param input_channels Vector of cv::Mat, which will be assigned
+ */
+void wrapInputLayer (caffe::Blob<float>* input_layer, std::vector<cv::Mat> &out_input_channels)
+{
+    out_input_channels.clear();
+
+    int height = input_layer->shape(2);
+    int width  = input_layer->shape(3);
+
+    float* input_data = input_layer->mutable_cpu_data();
+
+    for (int i = 0; i < input_layer->shape(1); ++i)
+    {
+        cv::Mat channel(height, width, CV_32FC1, input_data);
+        out_input_channels.push_back(channel);
+        input_data += width * height;
+    }
+}
+
+
+/**
+ * @brief Reads paths to the images either from a BBTXT file or from a plain list of images
+ */
+std::vector<std::string> readImageList (const std::string &path_image_list)
+{
+    std::vector<std::string> paths;
+
+    if (boost::algorithm::ends_with(path_image_list, ".bbtxt"))
+    {
+        for (auto &entry: readBBTXTFile(path_image_list)) paths.push_back(entry.first);
+    }
+    else
+    {
+        std::ifstream infile(path_image_list.c_str());
+        CHECK(infile) << "Unable to open image list TXT file '" << path_image_list << "'!";
+        std::string line;
+        while (std::getline(infile, line))
+        {
+            if (!line.empty()) paths.push_back(line);
+        }
+    }
+
+    return paths;
+}
+
+
+/**
+ * @brief Finds the convolutional layers, which consume the channels of the given blob. Follows the blob through
+ * the channel preserving layers (ReLU, Pooling, ...)
+ * @param net
+ * @param blob_id Id of the blob to be followed
+ * @param from_layer Only layers after this one are considered
+ * @param consumer_ids Output list of the consuming convolutional layers
+ * @return false if the channels are consumed by some other layer or are an output of the net
+ */
+bool findConsumers (const std::shared_ptr<caffe::Net<float>> &net, int blob_id, int from_layer,
+                    std::vector<int> &consumer_ids)
+{
+    const std::vector<int> &outputs = net->output_blob_indices();
+    if (std::find(outputs.begin(), outputs.end(), blob_id) != outputs.end()) return false;
+
+    for (int l = from_layer+1; l < net->layers().size(); ++l)
+    {
+        const std::vector<int> &bottoms = net->bottom_ids(l);
+        if (std::find(bottoms.begin(), bottoms.end(), blob_id) == bottoms.end()) continue;
+
+        const caffe::LayerParameter &lp = net->layers()[l]->layer_param();
+
+        if (lp.type() == "Convolution")
+        {
+            if (bottoms.size() != 1 || lp.convolution_param().group() != 1) return false;
+            consumer_ids.push_back(l);
+        }
+        else if (CHANNEL_PRESERVING_LAYERS.count(lp.type()) > 0)
+        {
+            for (int t: net->top_ids(l))
+            {
+                // In-place layers keep the same blob, which we already follow
+                if (t != blob_id && !findConsumers(net, t, l, consumer_ids)) return false;
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Finds the convolutional layers, which can be pruned
+ * @param net
+ * @param min_channels Only layers with at least this number of filters are pruned
+ * @param layer_names If not empty, only these layers are pruned
+ */
+std::vector<PrunableLayer> findPrunableLayers (const std::shared_ptr<caffe::Net<float>> &net, int min_channels,
+                                               const std::vector<std::string> &layer_names)
+{
+    std::vector<PrunableLayer> prunable;
+
+    for (int l = 0; l < net->layers().size(); ++l)
+    {
+        const caffe::LayerParameter &lp = net->layers()[l]->layer_param();
+        if (lp.type() != "Convolution") continue;
+
+        const int num_output = lp.convolution_param().num_output();
+        if (layer_names.empty() && num_output < min_channels) continue;
+        if (!layer_names.empty() && std::find(layer_names.begin(), layer_names.end(), lp.name()) == layer_names.end())
+            continue;
+
+        PrunableLayer pl;
+        pl.layer_id = l;
+        if (net->top_ids(l).size() != 1 || !findConsumers(net, net->top_ids(l)[0], l, pl.consumer_ids)
+                || pl.consumer_ids.empty())
+        {
+            LOG(WARNING) << "Layer '" << lp.name() << "' cannot be pruned - its output is not consumed only by "
+                         << "convolutional layers";
+            continue;
+        }
+
+        // L1 norms of the filters
+        const caffe::Blob<float> &weights = *net->layers()[l]->blobs()[0];
+        const int filter_size = weights.count(1);
+        for (int f = 0; f < num_output; ++f)
+        {
+            pl.weight_norm.push_back(caffe::caffe_cpu_asum(filter_size, weights.cpu_data() + f*filter_size));
+        }
+        pl.activation.resize(num_output, 0.0);
+
+        prunable.push_back(pl);
+    }
+
+    return prunable;
+}
+
+
+/**
+ * @brief Runs the images through the net and accumulates the mean activation of each channel of the prunable layers
+ */
+void collectActivations (const std::shared_ptr<caffe::Net<float>> &net, const std::vector<std::string> &paths,
+                         std::vector<PrunableLayer> &prunable)
+{
+    caffe::Blob<float>* input_layer = net->input_blobs()[0];
+    std::vector<cv::Mat> input_channels;
+
+    for (int i = 0; i < paths.size(); ++i)
+    {
+        LOG(INFO) << "[" << i+1 << "/" << paths.size() << "] " << paths[i];
+
+        cv::Mat image = cv::imread(paths[i], CV_LOAD_IMAGE_COLOR);
+        CHECK(image.data) << "Image '" << paths[i] << "' could not be read!";
+
+        // Convert to zero mean and unit variance
+        cv::Mat imagef; image.convertTo(imagef, CV_32FC3);
+        imagef -= cv::Scalar(128.0f, 128.0f, 128.0f);
+        imagef *= 1.0f/128.0f;
+
+        input_layer->Reshape(1, input_layer->shape(1), imagef.rows, imagef.cols);
+        net->Reshape();
+
+        wrapInputLayer(input_layer, input_channels);
+        cv::split(imagef, input_channels);
+
+        net->Forward();
+
+        // The top blobs contain the activations after the in-place ReLUs
+        for (PrunableLayer &pl: prunable)
+        {
+            const caffe::Blob<float> &top = *net->blobs()[net->top_ids(pl.layer_id)[0]];
+            const int spatial = top.count(2);
+            for (int c = 0; c < top.shape(1); ++c)
+            {
+                pl.activation[c] += caffe::caffe_cpu_asum(spatial, top.cpu_data() + top.offset(0, c)) / spatial;
+            }
+        }
+    }
+}
+
+
+/**
+ * @brief Selects the filters to be kept - the ones with the highest product of normalized weight norm and
+ * normalized mean activation
+ */
+void rankFilters (double prune_ratio, std::vector<PrunableLayer> &prunable)
+{
+    for (PrunableLayer &pl: prunable)
+    {
+        const int num_output = pl.weight_norm.size();
+
+        const double mean_norm = std::accumulate(pl.weight_norm.begin(), pl.weight_norm.end(), 0.0) / num_output;
+        const double mean_act  = std::accumulate(pl.activation.begin(), pl.activation.end(), 0.0) / num_output;
+
+        std::vector<double> score(num_output);
+        for (int f = 0; f < num_output; ++f)
+        {
+            score[f] = (pl.weight_norm[f] / (mean_norm + 1e-12)) * (pl.activation[f] / (mean_act + 1e-12));
+        }
+
+        std::vector<int> order(num_output);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&score](int a, int b) { return score[a] > score[b]; });
+
+        const int num_keep = std::max(1, num_output - int(prune_ratio * num_output));
+        pl.keep.assign(order.begin(), order.begin() + num_keep);
+        // Keep the original order of the filters
+        std::sort(pl.keep.begin(), pl.keep.end());
+    }
+}
+
+
+/**
+ * @brief Copies the selected output and input channels of a convolution weight blob
+ * @param weights Original weights of shape OUT x IN x KH x KW
+ * @param keep_out Kept filters (empty for all)
+ * @param keep_in Kept input channels (empty for all)
+ * @param blob_out Pruned weights
+ */
+void pruneWeights (const caffe::Blob<float> &weights, const std::vector<int> &keep_out,
+                   const std::vector<int> &keep_in, caffe::BlobProto *blob_out)
+{
+    std::vector<int> out(weights.shape(0)), in(weights.shape(1));
+    std::iota(out.begin(), out.end(), 0);
+    std::iota(in.begin(), in.end(), 0);
+    if (!keep_out.empty()) out = keep_out;
+    if (!keep_in.empty()) in = keep_in;
+
+    std::vector<int> shape = weights.shape();
+    shape[0] = out.size();
+    shape[1] = in.size();
+    caffe::Blob<float> pruned(shape);
+
+    const int kernel_size = weights.count(2);
+    float *data = pruned.mutable_cpu_data();
+    for (int o: out)
+    {
+        for (int i: in)
+        {
+            caffe::caffe_copy(kernel_size, weights.cpu_data() + weights.offset(o, i), data);
+            data += kernel_size;
+        }
+    }
+
+    pruned.ToProto(blob_out);
+}
+
+
+void pruneBias (const caffe::Blob<float> &bias, const std::vector<int> &keep_out, caffe::BlobProto *blob_out)
+{
+    caffe::Blob<float> pruned(std::vector<int>(1, keep_out.size()));
+    for (int i = 0; i < keep_out.size(); ++i) pruned.mutable_cpu_data()[i] = bias.cpu_data()[keep_out[i]];
+    pruned.ToProto(blob_out);
+}
+
+
+/**
+ * @brief Number of multiply-accumulate operations of all convolutions of the net for the current input
+ */
+double convolutionMACs (const std::shared_ptr<caffe::Net<float>> &net, const std::vector<PrunableLayer> &prunable,
+                        bool pruned)
+{
+    std::map<int, int> out_channels, in_channels;
+    if (pruned)
+    {
+        for (const PrunableLayer &pl: prunable)
+        {
+            out_channels[pl.layer_id] = pl.keep.size();
+            for (int c: pl.consumer_ids) in_channels[c] = pl.keep.size();
+        }
+    }
+
+    double macs = 0.0;
+    for (int l = 0; l < net->layers().size(); ++l)
+    {
+        if (net->layers()[l]->layer_param().type() != "Convolution") continue;
+
+        const caffe::Blob<float> &weights = *net->layers()[l]->blobs()[0];
+        const caffe::Blob<float> &top     = *net->blobs()[net->top_ids(l)[0]];
+        const int c_out = out_channels.count(l) ? out_channels[l] : weights.shape(0);
+        const int c_in  = in_channels.count(l) ? in_channels[l] : weights.shape(1);
+        macs += double(c_out) * c_in * weights.count(2) * top.count(2);
+    }
+
+    return macs;
+}
+
+
+/**
+ * @brief Removes the filters, which are not kept, and the corresponding input channels of the consumers. Writes
+ * path_out.prototxt and path_out.caffemodel
+ */
+void writePrunedNet (const std::shared_ptr<caffe::Net<float>> &net, const std::vector<PrunableLayer> &prunable,
+                     const std::string &path_prototxt, const std::string &path_out)
+{
+    // -- PRUNE THE WEIGHTS -- //
+    // Kept output and input channels of each affected layer
+    std::map<int, std::vector<int>> keep_out, keep_in;
+    for (const PrunableLayer &pl: prunable)
+    {
+        keep_out[pl.layer_id] = pl.keep;
+        for (int c: pl.consumer_ids) keep_in[c] = pl.keep;
+    }
+
+    caffe::NetParameter weights_param;
+    net->ToProto(&weights_param, false);
+    CHECK_EQ(weights_param.layer_size(), net->layers().size());
+
+    for (int l = 0; l < net->layers().size(); ++l)
+    {
+        if (keep_out.count(l) == 0 && keep_in.count(l) == 0) continue;
+
+        const auto &blobs = net->layers()[l]->blobs();
+        caffe::LayerParameter *lp = weights_param.mutable_layer(l);
+
+        const bool prune_out = keep_out.count(l) > 0;
+        pruneWeights(*blobs[0], keep_out[l], keep_in[l], lp->mutable_blobs(0));
+        if (blobs.size() > 1 && prune_out) pruneBias(*blobs[1], keep_out[l], lp->mutable_blobs(1));
+    }
+
+
+    // -- PRUNE THE PROTOTXT -- //
+    caffe::NetParameter deploy_param;
+    caffe::ReadNetParamsFromTextFileOrDie(path_prototxt, &deploy_param);
+
+    for (const PrunableLayer &pl: prunable)
+    {
+        const std::string &name = net->layer_names()[pl.layer_id];
+        for (int i = 0; i < deploy_param.layer_size(); ++i)
+        {
+            if (deploy_param.layer(i).name() != name) continue;
+            deploy_param.mutable_layer(i)->mutable_convolution_param()->set_num_output(pl.keep.size());
+        }
+
+        LOG(INFO) << name << ": " << pl.weight_norm.size() << " -> " << pl.keep.size() << " filters";
+    }
+
+    LOG(INFO) << "Convolution MACs (last image): " << convolutionMACs(net, prunable, false) / 1e9 << " G -> "
+              << convolutionMACs(net, prunable, true) / 1e9 << " G";
+
+    caffe::WriteProtoToTextFile(deploy_param, path_out + ".prototxt");
+    caffe::WriteProtoToBinaryFile(weights_param, path_out + ".caffemodel");
+
+    LOG(INFO) << "Pruned net written to '" << path_out << ".prototxt' and '" << path_out << ".caffemodel'";
+}
+
+
+void pruneNet (const std::string &path_prototxt, const std::string &path_caffemodel,
+               const std::string &path_image_list, const std::string &path_out, double prune_ratio,
+               int min_channels, int max_images, const std::vector<std::string> &layer_names)
+{
+    caffe::Caffe::set_mode(caffe::Caffe::CPU);
+
+    // Create network and load trained weights from caffemodel file
+    auto net = std::make_shared<caffe::Net<float>>(path_prototxt, caffe::TEST);
+    net->CopyTrainedLayersFrom(path_caffemodel);
+
+    CHECK_EQ(net->num_inputs(), 1) << "Network should have exactly one input.";
+    CHECK_EQ(net->input_blobs()[0]->shape(1), 3) << "Input layer must have 3 channels.";
+
+
+    // -- RANK THE FILTERS -- //
+    std::vector<PrunableLayer> prunable = findPrunableLayers(net, min_channels, layer_names);
+    CHECK(!prunable.empty()) << "There are no layers to be pruned!";
+
+    std::vector<std::string> paths = readImageList(path_image_list);
+    CHECK(!paths.empty()) << "No images in '" << path_image_list << "'!";
+    if (max_images > 0 && paths.size() > max_images) paths.resize(max_images);
+
+    collectActivations(net, paths, prunable);
+    rankFilters(prune_ratio, prunable);
+
+
+    writePrunedNet(net, prunable, path_prototxt, path_out);
+}
+
+
+
+// -----------------------------------------------  MAIN  ------------------------------------------------ //
+
+struct ProgramArguments
+{
+    std::string path_prototxt;
+    std::string path_caffemodel;
+    std::string path_image_list;
+    std::string path_out;
+    double prune_ratio;
+    int min_channels;
+    int max_images;
+    std::string layers;
+};
+
+
+/**
+ * @brief Parses arguments of the program
+ */
+void parseArguments (int argc, char** argv, ProgramArguments &pa)
+{
+    try {
+        po::options_description desc("Arguments");
+        desc.add_options()
+            ("help", "Print help")
+            ("prototxt", po::value<std::string>(&pa.path_prototxt)->required(),
+             "Deploy model file of the network (*.prototxt)")
+            ("caffemodel", po::value<std::string>(&pa.path_caffemodel)->required(),
+             "Weight file of the network (*.caffemodel)")
+            ("image_list", po::value<std::string>(&pa.path_image_list)->required(),
+             "BBTXT file or TXT file with paths to the images used for collecting activation statistics")
+            ("path_out", po::value<std::string>(&pa.path_out)->required(),
+             "Path prefix of the output - path_out.prototxt and path_out.caffemodel will be created")
+            ("prune_ratio", po::value<double>(&pa.prune_ratio)->default_value(0.25),
+             "Fraction of the filters removed from each pruned layer")
+            ("min_channels", po::value<int>(&pa.min_channels)->default_value(256),
+             "Only layers with at least this number of filters are pruned")
+            ("max_images", po::value<int>(&pa.max_images)->default_value(200),
+             "Maximum number of images used for activation statistics (0 for all)")
+            ("layers", po::value<std::string>(&pa.layers)->default_value(""),
+             "Comma separated names of the layers to be pruned (overrides min_channels)")
+        ;
+
+        po::positional_options_description positional;
+        positional.add("prototxt", 1);
+        positional.add("caffemodel", 1);
+        positional.add("image_list", 1);
+        positional.add("path_out", 1);
+
+
+        // Parse the input arguments
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+
+        if (vm.count("help")) {
+            std::cout << "Usage: ./macc_prune path/f.prototxt path/f.caffemodel path/images.bbtxt path/out\n";
+            std::cout << desc;
+            exit(EXIT_SUCCESS);
+        }
+
+        po::notify(vm);
+
+        if (!boost::filesystem::exists(pa.path_prototxt))
+        {
+            std::cerr << "ERROR: File '" << pa.path_prototxt << "' does not exist!" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        if (!boost::filesystem::exists(pa.path_caffemodel))
+        {
+            std::cerr << "ERROR: File '" << pa.path_caffemodel << "' does not exist!" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        if (!boost::filesystem::exists(pa.path_image_list))
+        {
+            std::cerr << "ERROR: File '" << pa.path_image_list << "' does not exist!" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        if (boost::filesystem::exists(pa.path_out + ".prototxt") || boost::filesystem::exists(pa.path_out + ".caffemodel"))
+        {
+            std::cerr << "ERROR: Output '" << pa.path_out << ".prototxt/.caffemodel' already exists!" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        if (pa.prune_ratio < 0.0 || pa.prune_ratio >= 1.0)
+        {
+            std::cerr << "ERROR: Prune ratio must be in [0, 1)!" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    catch(std::exception& e)
+    {
+        std::cerr << e.what() << "\n";
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+int main (int argc, char** argv)
+{
+    FLAGS_logtostderr = 1;
+    FLAGS_minloglevel = ::google::INFO;
+    ::google::InitGoogleLogging(argv[0]);
+
+    ProgramArguments pa;
+    parseArguments(argc, argv, pa);
+
+    std::vector<std::string> layer_names;
+    if (!pa.layers.empty()) boost::split(layer_names, pa.layers, boost::is_any_of(","));
+
+
+    pruneNet(pa.path_prototxt, pa.path_caffemodel, pa.path_image_list, pa.path_out, pa.prune_ratio,
+             pa.min_channels, pa.max_images, layer_names);
+
+
+    return EXIT_SUCCESS;
+}
+
+
+#else
+int main(int argc, char** argv) {
+    LOG(FATAL) << "This example requires OpenCV; compile with USE_OPENCV.";
+}
+#endif  // USE_OPENCV
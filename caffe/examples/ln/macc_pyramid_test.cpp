@@ -4,10 +4,24 @@
 //
 // Tests object detection of 2D bounding boxes a single scale detector on an image pyramid. It outputs BBTXT.
 //
+// Optionally the raw detections (before NMS) can be cached on the disk, so repeated runs on the same images with
+// the same model skip the forward pass. Large image lists can be processed by several worker processes in a
+// resumable way (--workers). With --sparse_head the coordinates of the accumulators are computed only in the
+// local maxima of the probability, which are extracted as bounding boxes.
+//
+// With --cascade_scale the detection runs in two passes: the network first runs on a downscaled image and only
+// padded tiles around the candidates (detections with a low confidence) from this coarse pass are then
+// processed in the full resolution. The speedup is reported at the end of the run, the recall can be compared
+// with a run without the cascade by scripts/compute_pr_curve.py.
 //
 
 #include <caffe/caffe.hpp>
 #include "caffe/util/benchmark.hpp"
+#include "caffe/util/detection.hpp"
+#include "caffe/util/detection_cache.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/sharded_run.hpp"
+#include "caffe/util/upgrade_proto.hpp"
 #include "caffe/util/utils_bb.hpp"
 
 // This code only works with OpenCV!
@@ -16,8 +30,12 @@
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <algorithm>
+#include <cmath>
 #include <iosfwd>
+#include <map>
 #include <memory>
 #include <string>
 #include <utility>
@@ -37,6 +55,9 @@ namespace po = boost::program_options;
     #define SIMILARITY_THRESHOLD 0.65
 #endif
 
+// Minimum confidence of an extracted bounding box
+#define MIN_CONF 0.1
+
 
 namespace {
 
@@ -103,118 +124,319 @@ void wrapInputLayer (caffe::Blob<float>* input_layer, std::vector<cv::Mat> &out_
 
 
 std::vector<BB2D> extract2DBoundingBoxes (caffe::Blob<float> *output, const std::string &path_image,
-                                          double scale)
+                                          double scale, double min_conf)
 {
     std::vector<BB2D> bounding_boxes;
 
-    float *data_output = output->mutable_cpu_data();
+    // Extract detected boxes - only local maxima from 3x3 neighborhood, the same as in the library detectors
+    for (const caffe::Detection2D &d: caffe::extractBBTXTDetections(*output, 0, scale, min_conf))
+    {
+        bounding_boxes.emplace_back(path_image, d.label, d.conf, d.xmin, d.ymin, d.xmax, d.ymax);
+    }
 
-    // 2D bounding box
-    cv::Mat acc_prob(output->shape(2), output->shape(3), CV_32FC1, data_output+output->offset(0, 0));
-    cv::Mat acc_xmin(output->shape(2), output->shape(3), CV_32FC1, data_output+output->offset(0, 1));
-    cv::Mat acc_ymin(output->shape(2), output->shape(3), CV_32FC1, data_output+output->offset(0, 2));
-    cv::Mat acc_xmax(output->shape(2), output->shape(3), CV_32FC1, data_output+output->offset(0, 3));
-    cv::Mat acc_ymax(output->shape(2), output->shape(3), CV_32FC1, data_output+output->offset(0, 4));
+    return bounding_boxes;
+}
 
-    // Extract detected boxes - only extract local maxima from 3x3 neighborhood
-    for (int i = 0; i < acc_prob.rows; ++i)
-    {
-        for (int j = 0; j < acc_prob.cols; ++j)
-        {
-            float conf = acc_prob.at<float>(i, j);
-            if (conf >= 0.1)
-            {
-                // Check if it is a local maximum
-                if (i > 0)
-                {
-                    if (j > 0 && acc_prob.at<float>(i-1, j-1) > conf) continue;
-                    if (acc_prob.at<float>(i-1, j) > conf) continue;
-                    if (j < acc_prob.cols-1 && acc_prob.at<float>(i-1, j+1) > conf) continue;
-                }
-                if (j > 0 && acc_prob.at<float>(i, j-1) > conf) continue;
-                if (j < acc_prob.cols-1 && acc_prob.at<float>(i, j+1) > conf) continue;
-                if (i < acc_prob.rows-1)
-                {
-                    if (j > 0 && acc_prob.at<float>(i+1, j-1) > conf) continue;
-                    if (acc_prob.at<float>(i+1, j) > conf) continue;
-                    if (j < acc_prob.cols-1 && acc_prob.at<float>(i+1, j+1) > conf) continue;
-                }
 
-                // Ok, this is a local maximum
-                double xmin = acc_xmin.at<float>(i, j) / scale;
-                double ymin = acc_ymin.at<float>(i, j) / scale;
-                double xmax = acc_xmax.at<float>(i, j) / scale;
-                double ymax = acc_ymax.at<float>(i, j) / scale;
+/**
+ * @brief Runs the network on the image and extracts the bounding boxes from all its accumulators
+ * @param imagef Image converted to zero mean and unit variance
+ * @param scale Scale of the image with respect to the original image (coordinates are divided by it)
+ * @param min_conf Minimum confidence of an extracted bounding box
+ */
+std::vector<BB2D> runNetwork (const cv::Mat &imagef, const std::string &path_image, double scale,
+                              double min_conf, const std::shared_ptr<caffe::Net<float>> &net)
+{
+    caffe::Blob<float>* input_layer = net->input_blobs()[0];
+
+    // Reshape the network
+    input_layer->Reshape(1, input_layer->shape(1), imagef.rows, imagef.cols);
+    net->Reshape();
 
-                bounding_boxes.emplace_back(path_image, 1, conf, xmin, ymin, xmax, ymax);
-            }
-        }
+    // Prepare the cv::Mats for input
+    std::vector<cv::Mat> input_channels;
+    wrapInputLayer(input_layer, input_channels);
+    // Copy the image to the input layer of the network
+    cv::split(imagef, input_channels);
+
+    net->Forward();
+
+    std::vector<BB2D> bounding_boxes;
+    for (caffe::Blob<float>* output: net->output_blobs())
+    {
+        std::vector<BB2D> new_bbs = extract2DBoundingBoxes(output, path_image, scale, min_conf);
+        bounding_boxes.insert(bounding_boxes.end(), new_bbs.begin(), new_bbs.end());
     }
 
     return bounding_boxes;
 }
 
 
+/**
+ * @brief Converts detections into cache records: conf xmin ymin xmax ymax
+ */
+std::vector<float> toCacheRecords (const std::vector<BB2D> &bbs)
+{
+    std::vector<float> records;
+    records.reserve(5*bbs.size());
+    for (const BB2D &bb: bbs)
+    {
+        records.insert(records.end(), { float(bb.conf), float(bb.xmin), float(bb.ymin), float(bb.xmax),
+                                        float(bb.ymax) });
+    }
+    return records;
+}
+
+
+std::vector<BB2D> fromCacheRecords (const std::vector<float> &records, const std::string &path_image)
+{
+    std::vector<BB2D> bbs;
+    for (int i = 0; i+5 <= records.size(); i += 5)
+    {
+        bbs.emplace_back(path_image, 1, records[i], records[i+1], records[i+2], records[i+3], records[i+4]);
+    }
+    return bbs;
+}
+
+
 std::vector<BB2D> detectObjects (const std::string &path_image, const std::vector<double> &scales,
-                                 const std::shared_ptr<caffe::Net<float>> &net)
+                                 const std::shared_ptr<caffe::Net<float>> &net,
+                                 const caffe::DetectionCache *cache)
 {
 #ifdef MEASURE_TIME
     caffe::CPUTimer timer;
 #endif
     std::vector<BB2D> bounding_boxes;
 
-    caffe::Blob<float>* input_layer  = net->input_blobs()[0];
-
-    std::vector<cv::Mat> input_channels;
+    // The image is only read if some scale is not cached
+    std::map<int, cv::Mat> decoded;
+    cv::Size original_size;
+    const uint64_t image_hash = (cache != NULL) ? caffe::DetectionCache::hashFile(path_image) : 0;
 
 #ifdef MEASURE_TIME
     timer.Start();
 #endif
-    // Read the image
-    cv::Mat image = cv::imread(path_image, CV_LOAD_IMAGE_COLOR);
-    // Convert to zero mean and unit variance
-    cv::Mat imagef; image.convertTo(imagef, CV_32FC3);
-    imagef -= cv::Scalar(128.0f, 128.0f, 128.0f);
-    imagef *= 1.0f/128.0f;
-#ifdef MEASURE_TIME
-    timer.Stop(); std::cout << "Time to to read image: " << timer.MilliSeconds() << " ms" << std::endl;
-#endif
+    // Build the image pyramid and run detection on each scale of the pyramid
+    for (double s: scales)
+    {
+        std::string key;
+        if (cache != NULL)
+        {
+            key = cache->key(image_hash, s);
+            std::vector<float> records;
+            if (cache->load(key, 5, records))
+            {
+                std::vector<BB2D> new_bbs = fromCacheRecords(records, path_image);
+                bounding_boxes.insert(bounding_boxes.end(), new_bbs.begin(), new_bbs.end());
+                continue;
+            }
+        }
+
+        cv::Mat imagef_scaled = caffe::pyramidLevel(path_image, s, decoded, original_size);
+        std::vector<BB2D> scale_bbs = runNetwork(imagef_scaled, path_image, s, MIN_CONF, net);
+
+        if (cache != NULL) cache->store(key, 5, toCacheRecords(scale_bbs));
+        bounding_boxes.insert(bounding_boxes.end(), scale_bbs.begin(), scale_bbs.end());
+    }
 
 #ifdef MEASURE_TIME
-    timer.Start();
+    timer.Stop(); std::cout << "Time net + bb extraction: " << timer.MilliSeconds() << " ms" << std::endl;
 #endif
-    // Build the image pyramid and run detection on each scale of the pyramid
-    for (double s: scales)
+
+    return bounding_boxes;
+}
+
+
+/**
+ * @brief Settings of the coarse-to-fine detection cascade
+ */
+struct CascadeSettings
+{
+    // Scale of the coarse pass with respect to the pyramid level, 0 turns the cascade off
+    double coarse_scale;
+    // Minimum confidence of a candidate from the coarse pass
+    double candidate_conf;
+    // Context around the candidates in pixels of the pyramid level (about half of the receptive field)
+    int padding;
+    // Tiles start at multiples of the largest downsampling of the accumulators, so that their accumulator
+    // grids are aligned with the grids of the whole image
+    int alignment;
+
+
+    bool enabled () const
+    {
+        return this->coarse_scale > 0.0;
+    }
+};
+
+
+/**
+ * @brief Number of tiles and pixels processed in the full resolution with the cascade and pixels of the whole
+ * images
+ */
+struct CascadeStats
+{
+    CascadeStats ()
+        : tiles(0),
+          pixels(0),
+          full_pixels(0)
     {
-        cv::Mat imagef_scaled;
-        cv::resize(imagef, imagef_scaled, cv::Size(), s, s);
+    }
 
-        // Reshape the network
-        input_layer->Reshape(1, input_layer->shape(1), imagef_scaled.rows, imagef_scaled.cols);
-        net->Reshape();
 
-        // Prepare the cv::Mats for input
-        wrapInputLayer(input_layer, input_channels);
-        // Copy the image to the input layer of the network
-        cv::split(imagef_scaled, input_channels);
+    int tiles;
+    long long pixels;
+    long long full_pixels;
+};
 
-        net->Forward();
 
-        for (caffe::Blob<float>* output: net->output_blobs())
+/**
+ * @brief Largest downsampling of the accumulators of the network
+ */
+int accumulatorAlignment (const caffe::Net<float> &net)
+{
+    int alignment = 1;
+    for (const auto &layer: net.layers())
+    {
+        if (layer->layer_param().has_bbtxt_bb_param())
         {
-            std::vector<BB2D> new_bbs = extract2DBoundingBoxes(output, path_image, s);
-            bounding_boxes.insert(bounding_boxes.end(), new_bbs.begin(), new_bbs.end());
+            alignment = std::max(alignment, int(layer->layer_param().bbtxt_bb_param().downsampling()));
         }
     }
+    return alignment;
+}
 
-#ifdef MEASURE_TIME
-    timer.Stop(); std::cout << "Time net + bb extraction: " << timer.MilliSeconds() << " ms" << std::endl;
-#endif
+
+/**
+ * @brief Tile of the pyramid level, which is processed for the given candidate region
+ */
+cv::Rect paddedTile (const cv::Rect &region, const CascadeSettings &cascade, const cv::Size &size)
+{
+    const int x1 = std::max(0, region.x - cascade.padding) / cascade.alignment * cascade.alignment;
+    const int y1 = std::max(0, region.y - cascade.padding) / cascade.alignment * cascade.alignment;
+    const int x2 = std::min(size.width, region.br().x + cascade.padding);
+    const int y2 = std::min(size.height, region.br().y + cascade.padding);
+
+    return cv::Rect(x1, y1, x2-x1, y2-y1);
+}
+
+
+/**
+ * @brief Regions of the pyramid level with candidates, regions with overlapping tiles are merged
+ * @param candidates Candidates from the coarse pass (in the original image coordinates)
+ * @param scale Scale of the pyramid level
+ */
+std::vector<cv::Rect> candidateRegions (const std::vector<BB2D> &candidates, double scale,
+                                        const CascadeSettings &cascade, const cv::Size &size)
+{
+    std::vector<cv::Rect> regions;
+    for (const BB2D &bb: candidates)
+    {
+        const int x1 = int(std::floor(bb.xmin*scale));
+        const int y1 = int(std::floor(bb.ymin*scale));
+        const int x2 = int(std::ceil(bb.xmax*scale));
+        const int y2 = int(std::ceil(bb.ymax*scale));
+        const cv::Rect region = cv::Rect(x1, y1, x2-x1, y2-y1) & cv::Rect(0, 0, size.width, size.height);
+        if (region.area() > 0) regions.push_back(region);
+    }
+
+    // Merge the regions until no two tiles overlap
+    bool merged = true;
+    while (merged)
+    {
+        merged = false;
+        for (int i = 0; i < regions.size() && !merged; ++i)
+        {
+            const cv::Rect tile_i = paddedTile(regions[i], cascade, size);
+            for (int j = i+1; j < regions.size(); ++j)
+            {
+                if ((tile_i & paddedTile(regions[j], cascade, size)).area() > 0)
+                {
+                    regions[i] |= regions[j];
+                    regions.erase(regions.begin() + j);
+                    merged = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    return regions;
+}
+
+
+/**
+ * @brief Detects objects with the coarse-to-fine cascade
+ *
+ * On each pyramid level the network first runs on the level downscaled by coarse_scale. Detections with
+ * confidence at least candidate_conf are the candidates, the network then runs in the full resolution of the
+ * level only on the padded tiles around them. Only the detections with enough context (centers at most half
+ * of the padding from the candidate region) are kept from each tile.
+ */
+std::vector<BB2D> detectObjectsCascade (const std::string &path_image, const std::vector<double> &scales,
+                                        const std::shared_ptr<caffe::Net<float>> &net,
+                                        const CascadeSettings &cascade, CascadeStats &stats)
+{
+    std::vector<BB2D> bounding_boxes;
+
+    std::map<int, cv::Mat> decoded;
+    cv::Size original_size;
+
+    for (double s: scales)
+    {
+        // Coarse pass
+        cv::Mat imagef_coarse = caffe::pyramidLevel(path_image, s*cascade.coarse_scale, decoded, original_size);
+        std::vector<BB2D> candidates = runNetwork(imagef_coarse, path_image, s*cascade.coarse_scale,
+                                                  cascade.candidate_conf, net);
+
+        // Fine pass on the tiles around the candidates
+        cv::Mat imagef_scaled = caffe::pyramidLevel(path_image, s, decoded, original_size);
+        stats.full_pixels += imagef_scaled.total();
+
+        for (const cv::Rect &region: candidateRegions(candidates, s, cascade, imagef_scaled.size()))
+        {
+            const cv::Rect tile = paddedTile(region, cascade, imagef_scaled.size());
+            stats.tiles++;
+            stats.pixels += tile.area();
+
+            const int margin = cascade.padding / 2;
+            const cv::Rect keep(region.x-margin, region.y-margin, region.width+2*margin, region.height+2*margin);
+
+            for (BB2D &bb: runNetwork(imagef_scaled(tile), path_image, 1.0, MIN_CONF, net))
+            {
+                const double cx = tile.x + (bb.xmin+bb.xmax) / 2.0;
+                const double cy = tile.y + (bb.ymin+bb.ymax) / 2.0;
+                if (cx < keep.x || cx >= keep.br().x || cy < keep.y || cy >= keep.br().y) continue;
+
+                // Tile coordinates to the original image coordinates
+                bb.xmin = (tile.x + bb.xmin) / s;
+                bb.ymin = (tile.y + bb.ymin) / s;
+                bb.xmax = (tile.x + bb.xmax) / s;
+                bb.ymax = (tile.y + bb.ymax) / s;
+                bounding_boxes.push_back(bb);
+            }
+        }
+    }
 
     return bounding_boxes;
 }
 
 
+/**
+ * @brief Logs the detection speed and the fraction of the full resolution pixels processed by the cascade
+ */
+void reportSpeed (int num_images, float seconds, const CascadeSettings &cascade, const CascadeStats &stats)
+{
+    LOG(INFO) << "Processed " << num_images << " images in " << seconds << " s ("
+              << 1000.0f * seconds / std::max(1, num_images) << " ms per image)";
+    if (cascade.enabled())
+    {
+        LOG(INFO) << "Cascade: " << stats.tiles << " tiles, "
+                  << 100.0 * stats.pixels / std::max(1LL, stats.full_pixels) << "% of the full resolution pixels processed";
+    }
+}
+
+
 std::vector<BB2D> nonMaximaSuppression (std::vector<BB2D> &bbs)
 {
 #ifdef BASIC_NON_MAXIMA_SUPPRESSION
@@ -309,8 +531,19 @@ void writeBoundingBoxes (const std::vector<BB2D> &bbs, std::ofstream &fout)
 }
 
 
-void runPyramidDetection (const std::string &path_prototxt, const std::string &path_caffemodel,
-                          const std::string &path_image_list, const std::string &path_out)
+// Scaling factor is 1.5
+// around that size
+//const std::vector<double> SCALES = { 1.0, 0.66, 0.44, 0.29, 0.19 };
+const std::vector<double> SCALES = { 1.0 };
+
+
+/**
+ * @brief Creates the network and loads the trained weights from the caffemodel file
+ * @param sparse_head Compute the coordinates of the accumulators only in the extracted local maxima
+ * @param min_conf Lowest confidence of a bounding box extracted from the accumulators
+ */
+std::shared_ptr<caffe::Net<float>> createNet (const std::string &path_prototxt, const std::string &path_caffemodel,
+                                              bool sparse_head, double min_conf)
 {
 #ifdef CPU_ONLY
     caffe::Caffe::set_mode(caffe::Caffe::CPU);
@@ -318,17 +551,16 @@ void runPyramidDetection (const std::string &path_prototxt, const std::string &p
     caffe::Caffe::set_mode(caffe::Caffe::GPU);
 #endif
 
-#ifdef MEASURE_TIME
-    caffe::CPUTimer timer;
-#endif
-
-    // Scaling factor is 1.5
-    // around that size
-//    const std::vector<double> scales = { 1.0, 0.66, 0.44, 0.29, 0.19 };
-    const std::vector<double> scales = { 1.0 };
+    caffe::NetParameter net_param;
+    caffe::ReadNetParamsFromTextFileOrDie(path_prototxt, &net_param);
+    net_param.mutable_state()->set_phase(caffe::TEST);
+    if (sparse_head)
+    {
+        const int replaced = caffe::enableSparseAccumulators(net_param, min_conf);
+        LOG(INFO) << "Sparse evaluation of " << replaced << " accumulators";
+    }
 
-    // Create network and load trained weights from caffemodel file
-    auto net = std::make_shared<caffe::Net<float>>(path_prototxt, caffe::TEST);
+    auto net = std::make_shared<caffe::Net<float>>(net_param);
     net->CopyTrainedLayersFrom(path_caffemodel);
 
     caffe::Blob<float>* input_layer  = net->input_blobs()[0];
@@ -338,6 +570,53 @@ void runPyramidDetection (const std::string &path_prototxt, const std::string &p
     CHECK_EQ(input_layer->shape(1), 3) << "Input layer must have 3 channels.";
     CHECK_EQ(output_layer->shape(1), 5) << "Unsupported network, only 5 channels!";
 
+    return net;
+}
+
+
+/**
+ * @brief Runs the detector on one image and writes the bounding boxes before and after NMS
+ */
+void processImage (const std::string &path_image, const std::shared_ptr<caffe::Net<float>> &net,
+                   const caffe::DetectionCache *cache, const CascadeSettings &cascade, CascadeStats &stats,
+                   std::ofstream &fout, std::ofstream &fout_nms)
+{
+#ifdef MEASURE_TIME
+    caffe::CPUTimer timer;
+#endif
+
+    LOG(INFO) << path_image;
+    CHECK(boost::filesystem::exists(path_image)) << "Image '" << path_image << "' not found!";
+
+    // Detect bbs on the image
+    std::vector<BB2D> bbs = cascade.enabled() ? detectObjectsCascade(path_image, SCALES, net, cascade, stats)
+                                              : detectObjects(path_image, SCALES, net, cache);
+
+    // Save the bounding boxes before NMS to a BBTXT file
+    writeBoundingBoxes(bbs, fout);
+
+    // Non-maxima suppression
+#ifdef MEASURE_TIME
+    timer.Start();
+#endif
+    bbs = nonMaximaSuppression(bbs);
+#ifdef MEASURE_TIME
+    timer.Stop(); std::cout << "Time to perform NMS: " << timer.MilliSeconds() << " ms" << std::endl;
+#endif
+
+    // Save the bounding boxes after NMS to a BBTXT file
+    writeBoundingBoxes(bbs, fout_nms);
+}
+
+
+void runPyramidDetection (const std::string &path_prototxt, const std::string &path_caffemodel,
+                          const std::string &path_image_list, const std::string &path_out,
+                          const std::string &path_cache, bool sparse_head, CascadeSettings cascade)
+{
+    auto net = createNet(path_prototxt, path_caffemodel, sparse_head,
+                         cascade.enabled() ? std::min(MIN_CONF, cascade.candidate_conf) : MIN_CONF);
+    cascade.alignment = accumulatorAlignment(*net);
+
     std::ifstream infile(path_image_list.c_str());
     CHECK(infile) << "Unable to open image list TXT file '" << path_image_list << "'!";
     std::string line;
@@ -346,34 +625,113 @@ void runPyramidDetection (const std::string &path_prototxt, const std::string &p
     CHECK(fout) << "Output file '" << path_out << "' could not have been created!";
     std::ofstream fout_nms; fout_nms.open(path_out.substr(0, path_out.size()-6) + "_nms.bbtxt");
 
+    std::unique_ptr<caffe::DetectionCache> cache;
+    if (path_cache != "") cache.reset(new caffe::DetectionCache(path_cache, path_prototxt, path_caffemodel));
+
 
     // -- RUN THE DETECTOR ON EACH IMAGE -- //
+    CascadeStats stats;
+    caffe::CPUTimer timer;
+    timer.Start();
+    int num_images = 0;
     while (std::getline(infile, line))
     {
-        LOG(INFO) << line;
-        CHECK(boost::filesystem::exists(line)) << "Image '" << line << "' not found!";
+        processImage(line, net, cache.get(), cascade, stats, fout, fout_nms);
+        num_images++;
+    }
+    reportSpeed(num_images, timer.Seconds(), cascade, stats);
 
-        // Detect bbs on the image
-        std::vector<BB2D> bbs = detectObjects(line, scales, net);
+    fout.close();
+    fout_nms.close();
+}
 
-        // Save the bounding boxes before NMS to a BBTXT file
-        writeBoundingBoxes(bbs, fout);
 
-        // Non-maxima suppression
-#ifdef MEASURE_TIME
-        timer.Start();
-#endif
-        bbs = nonMaximaSuppression(bbs);
-#ifdef MEASURE_TIME
-        timer.Stop(); std::cout << "Time to perform NMS: " << timer.MilliSeconds() << " ms" << std::endl;
-#endif
+/**
+ * @brief Runs the detection in num_workers processes, which claim chunks of the image list
+ *
+ * The chunk outputs and checkpoints are stored in the path_out.shards directory. If the run crashes, running
+ * the same command again only processes the unfinished images. When all chunks are finished, the outputs are
+ * merged into path_out and the NMS output in the order of the image list.
+ */
+void runShardedPyramidDetection (const std::string &path_prototxt, const std::string &path_caffemodel,
+                                 const std::string &path_image_list, const std::string &path_out,
+                                 const std::string &path_cache, int num_workers, int chunk_size,
+                                 bool sparse_head, CascadeSettings cascade)
+{
+    std::vector<std::string> images;
+    {
+        std::ifstream infile(path_image_list.c_str());
+        CHECK(infile) << "Unable to open image list TXT file '" << path_image_list << "'!";
+        std::string line;
+        while (std::getline(infile, line)) images.push_back(line);
+    }
+
+    const caffe::ShardedRun run(path_out + ".shards", images, chunk_size, 2);
+    run.resetQueue();
+
+    // The workers must be forked before the network (and possibly CUDA) is initialized
+    std::vector<pid_t> workers;
+    for (int w = 0; w < num_workers; ++w)
+    {
+        pid_t pid = fork();
+        CHECK_GE(pid, 0) << "Unable to start a worker process";
+
+        if (pid == 0)
+        {
+            auto net = createNet(path_prototxt, path_caffemodel, sparse_head,
+                                 cascade.enabled() ? std::min(MIN_CONF, cascade.candidate_conf) : MIN_CONF);
+            cascade.alignment = accumulatorAlignment(*net);
+
+            std::unique_ptr<caffe::DetectionCache> cache;
+            if (path_cache != "") cache.reset(new caffe::DetectionCache(path_cache, path_prototxt,
+                                                                        path_caffemodel));
+
+            CascadeStats stats;
+            caffe::CPUTimer timer;
+            timer.Start();
+            int num_images = 0;
+            int chunk;
+            while (run.claim(chunk))
+            {
+                caffe::ChunkWriter writer(run, chunk);
+                for (int i = writer.nextItem(); i < run.chunkEnd(chunk); ++i)
+                {
+                    processImage(images[i], net, cache.get(), cascade, stats, writer.output(0),
+                                 writer.output(1));
+                    writer.checkpoint();
+                    num_images++;
+                }
+                writer.finish();
+            }
+            reportSpeed(num_images, timer.Seconds(), cascade, stats);
 
-        // Save the bounding boxes after NMS to a BBTXT file
-        writeBoundingBoxes(bbs, fout_nms);
+            // The outputs were flushed and closed by ChunkWriter::finish(). The atexit handlers and static
+            // destructors belong to the parent (glog, protobuf, CUDA), they must not run in the worker
+            google::FlushLogFiles(google::INFO);
+            _exit(EXIT_SUCCESS);
+        }
+
+        workers.push_back(pid);
     }
 
-    fout.close();
-    fout_nms.close();
+    for (pid_t pid: workers)
+    {
+        int status;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+        {
+            LOG(ERROR) << "Worker " << pid << " failed";
+        }
+    }
+
+    // -- MERGE THE CHUNK OUTPUTS -- //
+    if (!run.merge({ path_out, path_out.substr(0, path_out.size()-6) + "_nms.bbtxt" }))
+    {
+        LOG(ERROR) << "Some chunks are not finished, run the same command again to resume the detection";
+        exit(EXIT_FAILURE);
+    }
+
+    boost::filesystem::remove_all(path_out + ".shards");
 }
 
 
@@ -386,6 +744,11 @@ struct ProgramArguments
     std::string path_caffemodel;
     std::string path_image_list;
     std::string path_out;
+    std::string path_cache;
+    int workers;
+    int chunk_size;
+    bool sparse_head;
+    CascadeSettings cascade;
 };
 
 
@@ -406,6 +769,20 @@ void parseArguments (int argc, char** argv, ProgramArguments &pa)
              "Path to a TXT file with paths to the images to be tested")
             ("path_out", po::value<std::string>(&pa.path_out)->required(),
              "Path to the output BBTXT file")
+            ("cache", po::value<std::string>(&pa.path_cache)->default_value(""),
+             "Directory with cached detections (before NMS), reused if the images and the model are the same")
+            ("workers", po::value<int>(&pa.workers)->default_value(0),
+             "Number of worker processes for resumable sharded detection (0 runs in this process)")
+            ("chunk_size", po::value<int>(&pa.chunk_size)->default_value(100),
+             "Number of images claimed at once by a worker")
+            ("sparse_head", po::bool_switch(&pa.sparse_head)->default_value(false),
+             "Compute the bounding box coordinates only in the local maxima of the accumulators")
+            ("cascade_scale", po::value<double>(&pa.cascade.coarse_scale)->default_value(0.0),
+             "Scale of the coarse pass of the coarse-to-fine cascade (0 turns the cascade off)")
+            ("cascade_conf", po::value<double>(&pa.cascade.candidate_conf)->default_value(0.05),
+             "Minimum confidence of a candidate from the coarse pass")
+            ("cascade_padding", po::value<int>(&pa.cascade.padding)->default_value(236),
+             "Context around the candidates processed in the full resolution (in pixels)")
         ;
 
         po::positional_options_description positional;
@@ -447,6 +824,16 @@ void parseArguments (int argc, char** argv, ProgramArguments &pa)
             std::cerr << "ERROR: File '" << pa.path_out << "' already exists!" << std::endl;
             exit(EXIT_FAILURE);
         }
+        if (pa.cascade.enabled() && pa.path_cache != "")
+        {
+            std::cerr << "ERROR: The cascade cannot be combined with the detection cache!" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        if (pa.cascade.coarse_scale >= 1.0 || pa.cascade.padding < 0)
+        {
+            std::cerr << "ERROR: The cascade scale must be below 1 and the padding non-negative!" << std::endl;
+            exit(EXIT_FAILURE);
+        }
         if (pa.path_out.substr(pa.path_out.size()-6, 6) != ".bbtxt")
         {
             std::cerr << "ERROR: BBTXT file is produced on the output. The given output filename does not "
@@ -469,10 +856,20 @@ int main (int argc, char** argv)
     ::google::InitGoogleLogging(argv[0]);
 
     ProgramArguments pa;
+    pa.cascade.alignment = 1;
     parseArguments(argc, argv, pa);
 
 
-    runPyramidDetection(pa.path_prototxt, pa.path_caffemodel, pa.path_image_list, pa.path_out);
+    if (pa.workers > 0)
+    {
+        runShardedPyramidDetection(pa.path_prototxt, pa.path_caffemodel, pa.path_image_list, pa.path_out,
+                                   pa.path_cache, pa.workers, pa.chunk_size, pa.sparse_head, pa.cascade);
+    }
+    else
+    {
+        runPyramidDetection(pa.path_prototxt, pa.path_caffemodel, pa.path_image_list, pa.path_out,
+                            pa.path_cache, pa.sparse_head, pa.cascade);
+    }
 
 
     return EXIT_SUCCESS;
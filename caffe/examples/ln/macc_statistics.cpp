@@ -16,9 +16,14 @@
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <algorithm>
+#include <fstream>
+#include <functional>
 #include <iosfwd>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -36,7 +41,8 @@ namespace {
             : xmin(xmin), xmax(xmax), ymin(ymin), ymax(ymax),
               xspread(xmax-xmin), yspread(ymax-ymin),
               hist(num_bins, num_bins, CV_64FC1, cv::Scalar(0)),
-              counts(num_bins, num_bins, CV_64FC1, cv::Scalar(0))
+              counts(num_bins, num_bins, CV_64FC1, cv::Scalar(0)),
+              out_of_bounds(0)
         {
         }
 
@@ -47,15 +53,27 @@ namespace {
 
             if (col >= 0 && row >= 0 && col < hist.cols && row < hist.rows)
             {
-                hist.at<double>(row, col) += weight;
-                counts.at<double>(row, col) += 1.0;
+                this->hist.ptr<double>(row)[col] += weight;
+                this->counts.ptr<double>(row)[col] += 1.0;
             }
             else
             {
-                std::cout << "Out of bounds: " << x << ", " << y << " => " << col << ", " << row << std::endl;
+                this->out_of_bounds++;
             }
         }
 
+        /**
+         * @brief Adds the entries of another histogram with the same bins to this one
+         * The weights are integers, therefore the sums do not depend on the order of merging
+         */
+        void merge (const Hist2D &other)
+        {
+            CHECK(this->hist.size() == other.hist.size()) << "Histograms have different number of bins";
+            this->hist   += other.hist;
+            this->counts += other.counts;
+            this->out_of_bounds += other.out_of_bounds;
+        }
+
         cv::Mat normalized ()
         {
             cv::Mat hist_norm; this->hist.copyTo(hist_norm);
@@ -92,7 +110,8 @@ namespace {
         double xspread, yspread;
         cv::Mat hist;
         cv::Mat counts;
-        int total;
+        // Number of entries, which did not fall into any bin
+        long out_of_bounds;
     };
 
 
@@ -103,15 +122,64 @@ namespace {
     }
 
 
-    std::vector<Hist2D> hist_wh_neg;
-    std::vector<Hist2D> hist_tl_neg;
-    std::vector<Hist2D> hist_br_neg;
-    std::vector<Hist2D> hist_wh_pos;
-    std::vector<Hist2D> hist_tl_pos;
-    std::vector<Hist2D> hist_br_pos;
+    /**
+     * @brief All histograms collected on one accumulator
+     */
+    struct AccumulatorHistograms
+    {
+        AccumulatorHistograms ()
+            : wh_neg(0, 2, 0, 2, 200),
+              tl_neg(-1, 1, -1, 1, 200),
+              br_neg(0, 2, 0, 2, 200),
+              wh_pos(0, 2, 0, 2, 200),
+              tl_pos(-1, 1, -1, 1, 200),
+              br_pos(0, 2, 0, 2, 200),
+              wh_car_g_bb(0, 2, 0, 2, 200),
+              wh_notcar_g_bb(0, 2, 0, 2, 200)
+        {
+        }
+
+        void merge (const AccumulatorHistograms &other)
+        {
+            this->wh_neg.merge(other.wh_neg);
+            this->tl_neg.merge(other.tl_neg);
+            this->br_neg.merge(other.br_neg);
+            this->wh_pos.merge(other.wh_pos);
+            this->tl_pos.merge(other.tl_pos);
+            this->br_pos.merge(other.br_pos);
+            this->wh_car_g_bb.merge(other.wh_car_g_bb);
+            this->wh_notcar_g_bb.merge(other.wh_notcar_g_bb);
+        }
+
+        long outOfBounds () const
+        {
+            return wh_neg.out_of_bounds + tl_neg.out_of_bounds + br_neg.out_of_bounds + wh_pos.out_of_bounds
+                    + tl_pos.out_of_bounds + br_pos.out_of_bounds;
+        }
+
 
-    std::vector<Hist2D> hist_wh_car_g_bb;
-    std::vector<Hist2D> hist_wh_notcar_g_bb;
+        Hist2D wh_neg;
+        Hist2D tl_neg;
+        Hist2D br_neg;
+        Hist2D wh_pos;
+        Hist2D tl_pos;
+        Hist2D br_pos;
+
+        Hist2D wh_car_g_bb;
+        Hist2D wh_notcar_g_bb;
+    };
+
+
+    // WARNING! These are size bounds for "macc_0.3_r2_x2_to_x16"!!
+    const std::map<std::string, std::pair<double, double>> SIZE_BOUNDS = {
+        { "acc_x2",  std::make_pair(22.25, 55.5) },
+        { "acc_x4",  std::make_pair(44.5, 111.0) },
+        { "acc_x8",  std::make_pair(89.0, 222.0) },
+        { "acc_x16", std::make_pair(178.0, 444.0) }
+    };
+    const std::map<std::string, double> SCALES = {
+        { "acc_x2", 2.0 }, { "acc_x4", 4.0 }, { "acc_x8", 8.0 }, { "acc_x16", 16.0 }
+    };
 
 }
 
@@ -139,77 +207,68 @@ void wrapInputLayer (caffe::Blob<float>* input_layer, std::vector<cv::Mat> &out_
 }
 
 
-void histogramOfCoords (caffe::Blob<float> *output, int a, const std::string &name, const std::vector<BB2D> &gt_bbs)
+/**
+ * @brief Adds the pixels of one accumulator into its histograms (a shard of the running thread)
+ */
+void histogramOfCoords (caffe::Blob<float> *output, const std::string &name, const std::vector<BB2D> &gt_bbs,
+                        AccumulatorHistograms &hists)
 {
     // Build probabilistic target (ground truth) accumulator - we need it to determine positive and negative
     // pixels
-    static std::map<std::string, std::pair<double, double>> size_bounds;
-    static std::map<std::string, double> scales;
-    if (size_bounds.size() == 0)
-    {
-        // WARNING! These are size bounds for "macc_0.3_r2_x2_to_x16"!!
-        size_bounds.insert(std::make_pair("acc_x2", std::make_pair(22.25, 55.5)));
-        size_bounds.insert(std::make_pair("acc_x4", std::make_pair(44.5, 111.0)));
-        size_bounds.insert(std::make_pair("acc_x8", std::make_pair(89.0, 222.0)));
-        size_bounds.insert(std::make_pair("acc_x16", std::make_pair(178.0, 444.0)));
-        scales.insert(std::make_pair("acc_x2", 2.0));
-        scales.insert(std::make_pair("acc_x4", 4.0));
-        scales.insert(std::make_pair("acc_x8", 8.0));
-        scales.insert(std::make_pair("acc_x16", 16.0));
-    }
     cv::Mat acc_gt_prob(output->shape(2), output->shape(3), CV_32FC1, cv::Scalar(0.0f));
-    for (const BB2D &gt_bb: gt_bbs)
+    auto boundsi = SIZE_BOUNDS.find(name);
+    if (boundsi != SIZE_BOUNDS.end())
     {
-        double size = std::max(gt_bb.width(), gt_bb.height());
-        if (size > size_bounds[name].first && size < size_bounds[name].second)
+        const double scale = SCALES.at(name);
+        for (const BB2D &gt_bb: gt_bbs)
         {
-            // This ground truth should be detected by this accumulator
-            cv::Point2d co = gt_bb.center();
-            cv::circle(acc_gt_prob, cv::Point(co.x/scales[name], co.y/scales[name]), 3, cv::Scalar(1.0f), -1);
+            double size = std::max(gt_bb.width(), gt_bb.height());
+            if (size > boundsi->second.first && size < boundsi->second.second)
+            {
+                // This ground truth should be detected by this accumulator
+                cv::Point2d co = gt_bb.center();
+                cv::circle(acc_gt_prob, cv::Point(co.x/scale, co.y/scale), 3, cv::Scalar(1.0f), -1);
+            }
         }
     }
 
-//    cv::imshow("gt acc " + std::to_string(a), acc_gt_prob);
 
-
-    float *data_output = output->mutable_cpu_data();
+    const float *data_output = output->cpu_data();
 
     // 2D bounding box
-    cv::Mat acc_prob(output->shape(2), output->shape(3), CV_32FC1, data_output+output->offset(0, 0));
-    cv::Mat acc_xmin(output->shape(2), output->shape(3), CV_32FC1, data_output+output->offset(0, 1));
-    cv::Mat acc_ymin(output->shape(2), output->shape(3), CV_32FC1, data_output+output->offset(0, 2));
-    cv::Mat acc_xmax(output->shape(2), output->shape(3), CV_32FC1, data_output+output->offset(0, 3));
-    cv::Mat acc_ymax(output->shape(2), output->shape(3), CV_32FC1, data_output+output->offset(0, 4));
-
-//    cv::imshow("detected acc " + std::to_string(a), acc_prob);
+    const float *acc_xmin = data_output + output->offset(0, 1);
+    const float *acc_ymin = data_output + output->offset(0, 2);
+    const float *acc_xmax = data_output + output->offset(0, 3);
+    const float *acc_ymax = data_output + output->offset(0, 4);
 
-    // Extract detected boxes - only extract local maxima from 3x3 neighborhood
-    for (int i = 0; i < acc_prob.rows; ++i)
+    for (int i = 0; i < acc_gt_prob.rows; ++i)
     {
-        for (int j = 0; j < acc_prob.cols; ++j)
+        const float *label_row = acc_gt_prob.ptr<float>(i);
+
+        for (int j = 0; j < acc_gt_prob.cols; ++j)
         {
-            float label = acc_gt_prob.at<float>(i, j);
+            const int k = i*acc_gt_prob.cols + j;
 
-            double w = acc_xmax.at<float>(i, j) - acc_xmin.at<float>(i, j);
-            double h = acc_ymax.at<float>(i, j) - acc_ymin.at<float>(i, j);
+            double w = acc_xmax[k] - acc_xmin[k];
+            double h = acc_ymax[k] - acc_ymin[k];
 
-            if (label > 0.0f)
+            if (label_row[j] > 0.0f)
             {
                 // This is a positive pixel
-                hist_wh_pos[a].addEntry(w, h);
-                hist_tl_pos[a].addEntry(acc_xmin.at<float>(i, j), acc_ymin.at<float>(i, j));
-                hist_br_pos[a].addEntry(acc_xmax.at<float>(i, j), acc_ymax.at<float>(i, j));
-                hist_wh_car_g_bb[a].addEntry(w, h, 1.0);
-                hist_wh_notcar_g_bb[a].addEntry(w, h, 0.0);
+                hists.wh_pos.addEntry(w, h);
+                hists.tl_pos.addEntry(acc_xmin[k], acc_ymin[k]);
+                hists.br_pos.addEntry(acc_xmax[k], acc_ymax[k]);
+                hists.wh_car_g_bb.addEntry(w, h, 1.0);
+                hists.wh_notcar_g_bb.addEntry(w, h, 0.0);
             }
             else
             {
                 // This is a background pixel
-                hist_wh_neg[a].addEntry(w, h);
-                hist_tl_neg[a].addEntry(acc_xmin.at<float>(i, j), acc_ymin.at<float>(i, j));
-                hist_br_neg[a].addEntry(acc_xmax.at<float>(i, j), acc_ymax.at<float>(i, j));
-                hist_wh_car_g_bb[a].addEntry(w, h, 0.0);
-                hist_wh_notcar_g_bb[a].addEntry(w, h, 1.0);
+                hists.wh_neg.addEntry(w, h);
+                hists.tl_neg.addEntry(acc_xmin[k], acc_ymin[k]);
+                hists.br_neg.addEntry(acc_xmax[k], acc_ymax[k]);
+                hists.wh_car_g_bb.addEntry(w, h, 0.0);
+                hists.wh_notcar_g_bb.addEntry(w, h, 1.0);
             }
         }
     }
@@ -217,7 +276,8 @@ void histogramOfCoords (caffe::Blob<float> *output, int a, const std::string &na
 
 
 void computeStatistics (const std::string &path_image, const std::shared_ptr<caffe::Net<float>> &net,
-                        const std::map<std::string, std::vector<BB2D>> &gt_bbs_list)
+                        const std::map<std::string, std::vector<BB2D>> &gt_bbs_list,
+                        std::vector<AccumulatorHistograms> &shard)
 {
     caffe::Blob<float>* input_layer  = net->input_blobs()[0];
 
@@ -231,16 +291,13 @@ void computeStatistics (const std::string &path_image, const std::shared_ptr<caf
     imagef *= 1.0f/128.0f;
 
     // Ground truth bounding boxes
-    std::vector<BB2D> gt_bbs;
+    static const std::vector<BB2D> no_gt_bbs;
     auto gt_bbsi = gt_bbs_list.find(path_image);
     if (gt_bbsi == gt_bbs_list.end())
     {
         LOG(WARNING) << "No ground truth for image '" << path_image << "'";
     }
-    else
-    {
-        gt_bbs = (*gt_bbsi).second;
-    }
+    const std::vector<BB2D> &gt_bbs = (gt_bbsi == gt_bbs_list.end()) ? no_gt_bbs : gt_bbsi->second;
 
 
     // Reshape the network
@@ -257,23 +314,58 @@ void computeStatistics (const std::string &path_image, const std::shared_ptr<caf
     // For each accumulator
     for (int a = 0; a < net->output_blobs().size(); ++a)
     {
-        histogramOfCoords(net->output_blobs()[a], a, net->blob_names()[net->output_blob_indices()[a]], gt_bbs);
+        histogramOfCoords(net->output_blobs()[a], net->blob_names()[net->output_blob_indices()[a]], gt_bbs,
+                          shard[a]);
     }
-
-//    cv::imshow("image", image);
-//    cv::waitKey(0);
 }
 
 
-void runStatisticsComputation (const std::string &path_prototxt, const std::string &path_caffemodel,
-                               const std::string &path_image_list, const std::string &path_gt_bbtxt,
-                               const std::string &path_out)
+void setCaffeMode ()
 {
 #ifdef CPU_ONLY
     caffe::Caffe::set_mode(caffe::Caffe::CPU);
 #else
     caffe::Caffe::set_mode(caffe::Caffe::GPU);
 #endif
+}
+
+
+/**
+ * @brief Takes images from the shared image list and collects their statistics into its own shard
+ * Each thread has its own instance of the network, which shares the weights with the loaded one
+ */
+void runStatisticsWorker (const std::string &path_prototxt, const caffe::Net<float> *net_weights,
+                          std::istream &image_list, std::mutex &image_list_mutex, int &num_images,
+                          const std::map<std::string, std::vector<BB2D>> &gt_bbs_list,
+                          std::vector<AccumulatorHistograms> &shard)
+{
+    // The Caffe mode is thread local
+    setCaffeMode();
+
+    auto net = std::make_shared<caffe::Net<float>>(path_prototxt, caffe::TEST);
+    net->ShareTrainedLayersWith(net_weights);
+
+    std::string path_image;
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(image_list_mutex);
+            if (!std::getline(image_list, path_image)) break;
+            if (num_images++ % 100 == 0) LOG(INFO) << num_images << ": " << path_image;
+        }
+
+        CHECK(boost::filesystem::exists(path_image)) << "Image '" << path_image << "' not found!";
+
+        computeStatistics(path_image, net, gt_bbs_list, shard);
+    }
+}
+
+
+void runStatisticsComputation (const std::string &path_prototxt, const std::string &path_caffemodel,
+                               const std::string &path_image_list, const std::string &path_gt_bbtxt,
+                               const std::string &path_out, int num_threads)
+{
+    setCaffeMode();
 
     // Create network and load trained weights from caffemodel file
     auto net = std::make_shared<caffe::Net<float>>(path_prototxt, caffe::TEST);
@@ -288,33 +380,43 @@ void runStatisticsComputation (const std::string &path_prototxt, const std::stri
 
     std::ifstream infile(path_image_list.c_str());
     CHECK(infile) << "Unable to open image list TXT file '" << path_image_list << "'!";
-    std::string line;
 
     // Load ground truth
-    std::map<std::string, std::vector<BB2D>> gt_bbs_list = readBBTXTFile(path_gt_bbtxt);
+    const std::map<std::string, std::vector<BB2D>> gt_bbs_list = readBBTXTFile(path_gt_bbtxt);
 
 
-    for (int i = 0; i < net->output_blobs().size(); ++i)
+    // -- RUN THE DETECTOR ON EACH IMAGE -- //
+    // Each thread collects its own shard of histograms, which are merged in the end. The images are streamed
+    // from the image list
+    std::vector<std::vector<AccumulatorHistograms>> shards(num_threads);
+    for (auto &shard: shards) shard.resize(net->output_blobs().size());
+
+    std::mutex image_list_mutex;
+    int num_images = 0;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t)
     {
-        hist_wh_neg.emplace_back(0, 2, 0, 2, 200);
-        hist_tl_neg.emplace_back(-1, 1, -1, 1, 200);
-        hist_br_neg.emplace_back(0, 2, 0, 2, 200);
-        hist_wh_pos.emplace_back(0, 2, 0, 2, 200);
-        hist_tl_pos.emplace_back(-1, 1, -1, 1, 200);
-        hist_br_pos.emplace_back(0, 2, 0, 2, 200);
-        hist_wh_car_g_bb.emplace_back(0, 2, 0, 2, 200);
-        hist_wh_notcar_g_bb.emplace_back(0, 2, 0, 2, 200);
+        threads.emplace_back(runStatisticsWorker, std::cref(path_prototxt), net.get(), std::ref(infile),
+                             std::ref(image_list_mutex), std::ref(num_images), std::cref(gt_bbs_list),
+                             std::ref(shards[t]));
     }
+    for (std::thread &t: threads) t.join();
 
+    LOG(INFO) << "Processed " << num_images << " images in " << num_threads << " threads";
 
-    // -- RUN THE DETECTOR ON EACH IMAGE -- //
-    while (std::getline(infile, line))
+    std::vector<AccumulatorHistograms> &hists = shards[0];
+    for (int t = 1; t < num_threads; ++t)
     {
-        LOG(INFO) << line;
-        CHECK(boost::filesystem::exists(line)) << "Image '" << line << "' not found!";
-
-        // Detect bbs on the image
-        computeStatistics(line, net, gt_bbs_list);
+        for (int i = 0; i < hists.size(); ++i) hists[i].merge(shards[t][i]);
+    }
+    for (int i = 0; i < hists.size(); ++i)
+    {
+        if (hists[i].outOfBounds() > 0)
+        {
+            LOG(INFO) << hists[i].outOfBounds() << " entries out of the histogram bounds in accumulator '"
+                      << net->blob_names()[net->output_blob_indices()[i]] << "'";
+        }
     }
 
 
@@ -322,9 +424,9 @@ void runStatisticsComputation (const std::string &path_prototxt, const std::stri
     {
 //        {
 //            std::vector<cv::Mat> chs_tl;
-//            chs_tl.push_back(cv::Mat::zeros(hist_tl_pos[i].hist.size(), CV_64FC1));
-//            chs_tl.push_back(hist_tl_pos[i].normalized());
-//            chs_tl.push_back(hist_tl_neg[i].normalized());
+//            chs_tl.push_back(cv::Mat::zeros(hists[i].tl_pos.hist.size(), CV_64FC1));
+//            chs_tl.push_back(hists[i].tl_pos.normalized());
+//            chs_tl.push_back(hists[i].tl_neg.normalized());
 //            cv::line(chs_tl[0], cv::Point(chs_tl[0].cols/2,0), cv::Point(chs_tl[0].cols/2, chs_tl[0].rows), cv::Scalar(0.5), 2);
 //            cv::line(chs_tl[0], cv::Point(0,chs_tl[0].rows/2), cv::Point(chs_tl[0].cols, chs_tl[0].rows/2), cv::Scalar(0.5), 2);
 //            cv::Mat comb_tl; cv::merge(chs_tl, comb_tl);
@@ -334,9 +436,9 @@ void runStatisticsComputation (const std::string &path_prototxt, const std::stri
 
 //        {
 //            std::vector<cv::Mat> chs_br;
-//            chs_br.push_back(cv::Mat::zeros(hist_br_pos[i].hist.size(), CV_64FC1));
-//            chs_br.push_back(hist_br_pos[i].normalized());
-//            chs_br.push_back(hist_br_neg[i].normalized());
+//            chs_br.push_back(cv::Mat::zeros(hists[i].br_pos.hist.size(), CV_64FC1));
+//            chs_br.push_back(hists[i].br_pos.normalized());
+//            chs_br.push_back(hists[i].br_neg.normalized());
 //            cv::line(chs_br[0], cv::Point(chs_br[0].cols/2,0), cv::Point(chs_br[0].cols/2, chs_br[0].rows), cv::Scalar(0.5));
 //            cv::line(chs_br[0], cv::Point(0,chs_br[0].rows/2), cv::Point(chs_br[0].cols, chs_br[0].rows/2), cv::Scalar(0.5));
 //            cv::Mat comb_br; cv::merge(chs_br, comb_br);
@@ -347,9 +449,9 @@ void runStatisticsComputation (const std::string &path_prototxt, const std::stri
         {
             // P(BB|CAR_GT) WxH
             std::vector<cv::Mat> chs;
-            chs.push_back(cv::Mat::zeros(hist_wh_pos[i].hist.size(), CV_64FC1));
-            chs.push_back(hist_wh_pos[i].normalized());
-            chs.push_back(hist_wh_neg[i].normalized());
+            chs.push_back(cv::Mat::zeros(hists[i].wh_pos.hist.size(), CV_64FC1));
+            chs.push_back(hists[i].wh_pos.normalized());
+            chs.push_back(hists[i].wh_neg.normalized());
             cv::line(chs[0], cv::Point(chs[0].cols/2,0), cv::Point(chs[0].cols/2, chs[0].rows), cv::Scalar(0.5));
             cv::line(chs[0], cv::Point(0,chs[0].rows/2), cv::Point(chs[0].cols, chs[0].rows/2), cv::Scalar(0.5));
             cv::line(chs[0], cv::Point(0,0), cv::Point(chs[0].cols, chs[0].rows), cv::Scalar(0.5));
@@ -361,9 +463,9 @@ void runStatisticsComputation (const std::string &path_prototxt, const std::stri
         {
             // P(CAR_GT|BB) WxH
             std::vector<cv::Mat> chs;
-            chs.push_back(cv::Mat::zeros(hist_wh_car_g_bb[i].hist.size(), CV_64FC1));
-            chs.push_back(hist_wh_car_g_bb[i].countNormalized());
-            chs.push_back(cv::Mat::zeros(hist_wh_car_g_bb[i].hist.size(), CV_64FC1));
+            chs.push_back(cv::Mat::zeros(hists[i].wh_car_g_bb.hist.size(), CV_64FC1));
+            chs.push_back(hists[i].wh_car_g_bb.countNormalized());
+            chs.push_back(cv::Mat::zeros(hists[i].wh_car_g_bb.hist.size(), CV_64FC1));
             cv::line(chs[0], cv::Point(chs[0].cols/2,0), cv::Point(chs[0].cols/2, chs[0].rows), cv::Scalar(0.5));
             cv::line(chs[0], cv::Point(0,chs[0].rows/2), cv::Point(chs[0].cols, chs[0].rows/2), cv::Scalar(0.5));
             cv::line(chs[0], cv::Point(0,0), cv::Point(chs[0].cols, chs[0].rows), cv::Scalar(0.5));
@@ -375,9 +477,9 @@ void runStatisticsComputation (const std::string &path_prototxt, const std::stri
         {
             // P(NOT_CAR_GT|BB) WxH
             std::vector<cv::Mat> chs;
-            chs.push_back(cv::Mat::zeros(hist_wh_car_g_bb[i].hist.size(), CV_64FC1));
-            chs.push_back(cv::Mat::zeros(hist_wh_car_g_bb[i].hist.size(), CV_64FC1));
-            chs.push_back(hist_wh_notcar_g_bb[i].countNormalized());
+            chs.push_back(cv::Mat::zeros(hists[i].wh_car_g_bb.hist.size(), CV_64FC1));
+            chs.push_back(cv::Mat::zeros(hists[i].wh_car_g_bb.hist.size(), CV_64FC1));
+            chs.push_back(hists[i].wh_notcar_g_bb.countNormalized());
             cv::line(chs[0], cv::Point(chs[0].cols/2,0), cv::Point(chs[0].cols/2, chs[0].rows), cv::Scalar(0.5));
             cv::line(chs[0], cv::Point(0,chs[0].rows/2), cv::Point(chs[0].cols, chs[0].rows/2), cv::Scalar(0.5));
             cv::line(chs[0], cv::Point(0,0), cv::Point(chs[0].cols, chs[0].rows), cv::Scalar(0.5));
@@ -402,6 +504,7 @@ struct ProgramArguments
     std::string path_image_list;
     std::string path_gt_bbtxt;
     std::string path_out;
+    int threads;
 };
 
 
@@ -424,6 +527,8 @@ void parseArguments (int argc, char** argv, ProgramArguments &pa)
              "Path to a BBTXT file with ground truth annotation for the images in image list")
             ("path_out", po::value<std::string>(&pa.path_out)->required(),
              "Path to the output folder")
+            ("threads", po::value<int>(&pa.threads)->default_value(0),
+             "Number of threads with own network instances (0 for the number of cores on CPU, 1 on GPU)")
         ;
 
         po::positional_options_description positional;
@@ -490,7 +595,18 @@ int main (int argc, char** argv)
     parseArguments(argc, argv, pa);
 
 
-    runStatisticsComputation(pa.path_prototxt, pa.path_caffemodel, pa.path_image_list, pa.path_gt_bbtxt, pa.path_out);
+    int num_threads = pa.threads;
+    if (num_threads <= 0)
+    {
+#ifdef CPU_ONLY
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+#else
+        num_threads = 1;
+#endif
+    }
+
+    runStatisticsComputation(pa.path_prototxt, pa.path_caffemodel, pa.path_image_list, pa.path_gt_bbtxt, pa.path_out,
+                             num_threads);
 
 
     return EXIT_SUCCESS;
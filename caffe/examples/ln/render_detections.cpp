@@ -0,0 +1,453 @@
+//
+// Renders detections from a BBTXT or BB3TXT file into the frames of an image sequence and writes them into
+// a video or into image files. With a PGP file whole 3D bounding boxes are drawn and optionally also their
+// bird's eye view. The frames are rendered in parallel and encoded in the order of the image list. Does not
+// open any windows, so it can run headless.
+//
+
+#include <caffe/caffe.hpp>
+#include "caffe/util/bbtxt.hpp"
+#include "caffe/util/pgp.hpp"
+
+// This code only works with OpenCV!
+#ifdef USE_OPENCV
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+
+namespace {
+
+    // Colors of the bounding boxes of the labels (BGR)
+    const std::vector<cv::Scalar> COLORS = { cv::Scalar(255, 153, 51), cv::Scalar(204, 51, 255),
+                                             cv::Scalar(51, 204, 255), cv::Scalar(102, 255, 102) };
+
+    // Extent of the bird's eye view in meters - x in [-BEV_X, BEV_X], z in [0, BEV_Z]
+    const double BEV_X = 40.0;
+    const double BEV_Z = 120.0;
+
+
+    cv::Scalar labelColor (int label)
+    {
+        return COLORS[std::abs(label) % COLORS.size()];
+    }
+
+
+    cv::Point toPoint (const cv::Mat &x_2xn, int i)
+    {
+        return cv::Point(cvRound(x_2xn.at<double>(0, i)), cvRound(x_2xn.at<double>(1, i)));
+    }
+
+}
+
+
+struct RenderSettings
+{
+    // Detections indexed by image paths, only one of the maps is filled
+    std::map<std::string, std::vector<BB2D>> bbs_2d;
+    std::map<std::string, std::vector<BB3D>> bbs_3d;
+    std::map<std::string, PGP> pgps;
+    double confidence;
+    std::string path_datasets;
+    bool bev;
+};
+
+
+/**
+ * @brief If path_datasets is not empty it replaces the path up to the "datasets" folder with it
+ */
+std::string pathToImage (const std::string &path_image, const std::string &path_datasets)
+{
+    if (path_datasets == "") return path_image;
+
+    size_t pos = path_image.find("/datasets/");
+    if (pos == std::string::npos) return path_image;
+
+    return (boost::filesystem::path(path_datasets) / path_image.substr(pos+1)).string();
+}
+
+
+/**
+ * @brief Draws a 3D bounding box given by its corners FBL FBR RBR RBL FTL FTR RTR RTL projected to the image
+ */
+void draw3DBoundingBox (cv::Mat &image, const cv::Mat &x_2x8, const cv::Scalar &color)
+{
+    // Front side
+    cv::line(image, toPoint(x_2x8, 4), toPoint(x_2x8, 5), cv::Scalar(0, 255, 0), 2);
+    cv::line(image, toPoint(x_2x8, 5), toPoint(x_2x8, 1), cv::Scalar(0, 255, 0), 2);
+    cv::line(image, toPoint(x_2x8, 0), toPoint(x_2x8, 1), cv::Scalar(0, 255, 0), 2);
+    cv::line(image, toPoint(x_2x8, 0), toPoint(x_2x8, 4), cv::Scalar(0, 255, 0), 2);
+    // Rear side
+    cv::line(image, toPoint(x_2x8, 2), toPoint(x_2x8, 3), cv::Scalar(0, 0, 255), 2);
+    cv::line(image, toPoint(x_2x8, 7), toPoint(x_2x8, 3), cv::Scalar(0, 0, 255), 2);
+    cv::line(image, toPoint(x_2x8, 7), toPoint(x_2x8, 6), cv::Scalar(0, 0, 255), 2);
+    cv::line(image, toPoint(x_2x8, 6), toPoint(x_2x8, 2), cv::Scalar(0, 0, 255), 2);
+    // Connections
+    cv::line(image, toPoint(x_2x8, 4), toPoint(x_2x8, 7), color, 2);
+    cv::line(image, toPoint(x_2x8, 5), toPoint(x_2x8, 6), color, 2);
+    cv::line(image, toPoint(x_2x8, 1), toPoint(x_2x8, 2), color, 2);
+    cv::line(image, toPoint(x_2x8, 0), toPoint(x_2x8, 3), color, 2);
+}
+
+
+/**
+ * @brief Draws the bottom rectangle of a 3D bounding box into the bird's eye view (XZ plane) canvas
+ */
+void drawBEVBoundingBox (cv::Mat &canvas, const cv::Mat &X_3x8, const cv::Scalar &color)
+{
+    const double scale = canvas.rows / BEV_Z;
+
+    cv::Mat x_2x4(2, 4, CV_64FC1);
+    for (int i = 0; i < 4; ++i)
+    {
+        x_2x4.at<double>(0, i) = canvas.cols/2.0 + scale*X_3x8.at<double>(0, i);
+        x_2x4.at<double>(1, i) = canvas.rows - scale*X_3x8.at<double>(2, i);
+    }
+
+    cv::line(canvas, toPoint(x_2x4, 0), toPoint(x_2x4, 1), cv::Scalar(0, 255, 0), 2);
+    cv::line(canvas, toPoint(x_2x4, 1), toPoint(x_2x4, 2), color, 2);
+    cv::line(canvas, toPoint(x_2x4, 2), toPoint(x_2x4, 3), cv::Scalar(0, 0, 255), 2);
+    cv::line(canvas, toPoint(x_2x4, 3), toPoint(x_2x4, 0), color, 2);
+}
+
+
+/**
+ * @brief Loads the image and draws the detections into it
+ */
+cv::Mat renderFrame (const std::string &path_image, const RenderSettings &rs)
+{
+    cv::Mat image = cv::imread(pathToImage(path_image, rs.path_datasets), CV_LOAD_IMAGE_COLOR);
+    if (image.empty())
+    {
+        LOG(WARNING) << "Image '" << path_image << "' could not be read!";
+        return image;
+    }
+
+    cv::Mat canvas;
+    if (rs.bev)
+    {
+        // Bird's eye view with the same height as the image and the camera in the bottom center
+        canvas = cv::Mat(image.rows, cvRound(image.rows * 2*BEV_X / BEV_Z), CV_8UC3, cv::Scalar(255, 255, 255));
+        cv::line(canvas, cv::Point(canvas.cols/2, 0), cv::Point(canvas.cols/2, canvas.rows),
+                 cv::Scalar(200, 200, 200), 2);
+    }
+
+    auto it2d = rs.bbs_2d.find(path_image);
+    if (it2d != rs.bbs_2d.end())
+    {
+        for (const BB2D &bb: it2d->second)
+        {
+            if (bb.conf < rs.confidence) continue;
+            cv::rectangle(image, cv::Point(cvRound(bb.xmin), cvRound(bb.ymin)),
+                          cv::Point(cvRound(bb.xmax), cvRound(bb.ymax)), labelColor(bb.label), 2);
+        }
+    }
+
+    auto it3d = rs.bbs_3d.find(path_image);
+    if (it3d != rs.bbs_3d.end())
+    {
+        auto pgpi = rs.pgps.find(path_image);
+        if (rs.pgps.size() > 0 && pgpi == rs.pgps.end())
+        {
+            LOG(WARNING) << "PGP entry not found for image '" << path_image << "'";
+        }
+
+        for (BB3D bb: it3d->second)
+        {
+            if (bb.conf < rs.confidence) continue;
+
+            if (pgpi == rs.pgps.end())
+            {
+                // Without the PGP we can only show the 2D bounding box
+                cv::rectangle(image, cv::Point(cvRound(bb.xmin), cvRound(bb.ymin)),
+                              cv::Point(cvRound(bb.xmax), cvRound(bb.ymax)), labelColor(bb.label), 2);
+                continue;
+            }
+
+            // Reconstruct all 8 corners of the bounding box in 3D and project them back to the image
+            cv::Mat X_3x8 = pgpi->second.reconstructAndFixBB3D(bb);
+            draw3DBoundingBox(image, pgpi->second.projectXtox(X_3x8), labelColor(bb.label));
+
+            if (rs.bev) drawBEVBoundingBox(canvas, X_3x8, labelColor(bb.label));
+        }
+    }
+
+    if (rs.bev)
+    {
+        cv::Mat frame;
+        cv::hconcat(image, canvas, frame);
+        return frame;
+    }
+
+    return image;
+}
+
+
+/**
+ * @brief Renders the frames in num_threads threads and writes them in their order
+ *
+ * At most 4*num_threads frames are kept in memory at a time - a thread waits with rendering a frame until
+ * the frames, which are that much before it, are written.
+ */
+void renderSequence (const std::vector<std::string> &frames, const RenderSettings &rs, int num_threads,
+                     const std::string &path_out, double fps)
+{
+    const std::string extension = boost::filesystem::path(path_out).extension().string();
+    const bool to_video = (extension == ".avi" || extension == ".mp4" || extension == ".mkv");
+    cv::VideoWriter video;
+    cv::Size video_size;
+    cv::Mat last_frame;
+    int missing_frames = 0;
+    if (!to_video) boost::filesystem::create_directories(path_out);
+
+    const int window = 4 * num_threads;
+    std::vector<cv::Mat> slots(window);
+    std::vector<bool> ready(window, false);
+    std::mutex mutex;
+    std::condition_variable frame_ready, slot_free;
+    std::atomic<int> next_frame(0);
+    int written = 0;
+
+    auto worker = [&] ()
+    {
+        while (true)
+        {
+            const int i = next_frame++;
+            if (i >= int(frames.size())) break;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                slot_free.wait(lock, [&] () { return i < written + window; });
+            }
+
+            cv::Mat frame = renderFrame(frames[i], rs);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                slots[i % window] = frame;
+                ready[i % window] = true;
+            }
+            frame_ready.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) threads.emplace_back(worker);
+
+    // -- WRITE THE FRAMES IN THEIR ORDER -- //
+    for (int i = 0; i < frames.size(); ++i)
+    {
+        cv::Mat frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            frame_ready.wait(lock, [&] () { return bool(ready[i % window]); });
+            std::swap(frame, slots[i % window]);
+            ready[i % window] = false;
+            ++written;
+        }
+        slot_free.notify_all();
+
+        if (i % 100 == 0) LOG(INFO) << "Frame " << i << "/" << frames.size();
+
+        if (to_video)
+        {
+            // A frame, which could not be read, is replaced by the previous one (or a black one at the start)
+            // in order to keep the timing of the video
+            if (frame.empty())
+            {
+                if (video.isOpened()) video.write(last_frame);
+                else ++missing_frames;
+                continue;
+            }
+
+            if (!video.isOpened())
+            {
+                // The size of the video is given by the first frame
+                video_size = frame.size();
+                const int fourcc = (extension == ".avi") ? CV_FOURCC('M','J','P','G') : CV_FOURCC('m','p','4','v');
+                video.open(path_out, fourcc, fps, video_size);
+                CHECK(video.isOpened()) << "Video '" << path_out << "' could not have been created!";
+
+                cv::Mat black(video_size, CV_8UC3, cv::Scalar(0, 0, 0));
+                for (int j = 0; j < missing_frames; ++j) video.write(black);
+            }
+            if (frame.size() != video_size) cv::resize(frame, frame, video_size);
+            video.write(frame);
+            last_frame = frame;
+        }
+        else if (!frame.empty())
+        {
+            const std::string filename = boost::filesystem::path(frames[i]).filename().string();
+            cv::imwrite((boost::filesystem::path(path_out) / filename).string(), frame);
+        }
+    }
+
+    for (std::thread &t: threads) t.join();
+    if (video.isOpened()) video.release();
+}
+
+
+
+// -----------------------------------------------  MAIN  ------------------------------------------------ //
+
+struct ProgramArguments
+{
+    std::string path_detections;
+    std::string path_image_list;
+    std::string path_out;
+    std::string path_pgp;
+    std::string path_datasets;
+    double confidence;
+    double fps;
+    int offset;
+    int length;
+    int threads;
+    bool bev;
+};
+
+
+/**
+ * @brief Parses arguments of the program
+ */
+void parseArguments (int argc, char** argv, ProgramArguments &pa)
+{
+    try {
+        po::options_description desc("Arguments");
+        desc.add_options()
+            ("help", "Print help")
+            ("detections", po::value<std::string>(&pa.path_detections)->required(),
+             "Path to the BBTXT or BB3TXT file with detections")
+            ("image_list", po::value<std::string>(&pa.path_image_list)->required(),
+             "Path to a TXT file with paths to the frames of the sequence")
+            ("path_out", po::value<std::string>(&pa.path_out)->required(),
+             "Output video (*.avi, *.mp4, *.mkv) or a folder for the rendered images")
+            ("pgp", po::value<std::string>(&pa.path_pgp)->default_value(""),
+             "Path to a PGP file with calibration matrices and ground planes (draws 3D boxes from BB3TXT)")
+            ("path_datasets", po::value<std::string>(&pa.path_datasets)->default_value(""),
+             "Path to the 'datasets' folder on this machine, replaces the one in the image paths")
+            ("confidence", po::value<double>(&pa.confidence)->default_value(0.5),
+             "Minimum confidence of the shown bounding boxes")
+            ("fps", po::value<double>(&pa.fps)->default_value(24),
+             "Frame rate of the video")
+            ("offset", po::value<int>(&pa.offset)->default_value(0),
+             "Index of the first rendered frame of the image list")
+            ("length", po::value<int>(&pa.length)->default_value(999999999),
+             "Maximum number of rendered frames")
+            ("threads", po::value<int>(&pa.threads)->default_value(0),
+             "Number of rendering threads (0 for the number of cores)")
+            ("bev", po::bool_switch(&pa.bev)->default_value(false),
+             "Shows also the bird's eye view of the 3D bounding boxes (requires PGP)")
+        ;
+
+        po::positional_options_description positional;
+        positional.add("detections", 1);
+        positional.add("image_list", 1);
+        positional.add("path_out", 1);
+
+
+        // Parse the input arguments
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+
+        if (vm.count("help")) {
+            std::cout << "Usage: ./render_detections path/detections.bb3txt path/image_list.txt path/out.mp4 "
+                      << "(--pgp path/calib.pgp --bev)\n";
+            std::cout << desc;
+            exit(EXIT_SUCCESS);
+        }
+
+        po::notify(vm);
+
+        if (!boost::filesystem::exists(pa.path_detections))
+        {
+            std::cerr << "ERROR: File '" << pa.path_detections << "' does not exist!" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        if (!boost::filesystem::exists(pa.path_image_list))
+        {
+            std::cerr << "ERROR: File '" << pa.path_image_list << "' does not exist!" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        if (pa.path_pgp != "" && !boost::filesystem::exists(pa.path_pgp))
+        {
+            std::cerr << "ERROR: File '" << pa.path_pgp << "' does not exist!" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        if (pa.bev && pa.path_pgp == "")
+        {
+            std::cerr << "ERROR: The bird's eye view requires a PGP file!" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    catch(std::exception& e)
+    {
+        std::cerr << e.what() << "\n";
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+int main (int argc, char** argv)
+{
+    FLAGS_logtostderr = 1;
+    FLAGS_minloglevel = ::google::INFO;
+    ::google::InitGoogleLogging(argv[0]);
+
+    ProgramArguments pa;
+    parseArguments(argc, argv, pa);
+
+    RenderSettings rs;
+    rs.confidence    = pa.confidence;
+    rs.path_datasets = pa.path_datasets;
+    rs.bev           = pa.bev;
+
+    const std::string extension = boost::filesystem::path(pa.path_detections).extension().string();
+    if (extension == ".bb3txt")
+    {
+        rs.bbs_3d = readBB3TXTFile(pa.path_detections);
+        if (pa.path_pgp != "") rs.pgps = PGP::readPGPFile(pa.path_pgp);
+    }
+    else
+    {
+        rs.bbs_2d = readBBTXTFile(pa.path_detections);
+    }
+
+    std::vector<std::string> frames;
+    {
+        std::ifstream infile(pa.path_image_list.c_str());
+        std::string line;
+        for (int i = 0; std::getline(infile, line); ++i)
+        {
+            if (i >= pa.offset && frames.size() < pa.length) frames.push_back(line);
+        }
+    }
+
+    const int num_threads = (pa.threads > 0) ? pa.threads : std::max(1u, std::thread::hardware_concurrency());
+    LOG(INFO) << "Rendering " << frames.size() << " frames in " << num_threads << " threads";
+
+    renderSequence(frames, rs, num_threads, pa.path_out, pa.fps);
+
+
+    return EXIT_SUCCESS;
+}
+
+
+#else
+int main(int argc, char** argv) {
+    LOG(FATAL) << "This example requires OpenCV; compile with USE_OPENCV.";
+}
+#endif  // USE_OPENCV
@@ -0,0 +1,276 @@
+//
+// Embeddable detectors of 2D and 3D bounding boxes with MACC networks. A detector loads the network once and
+// processes frames submitted from any thread asynchronously in a pool of workers, frames of the same size
+// submitted concurrently are processed in one batch.
+//
+// Usage:
+//     caffe::Detector2D detector("macc_deploy.prototxt", "macc.caffemodel");
+//     std::future<std::vector<BB2D>> result = detector.detect(image);
+//     ...
+//     for (const BB2D &bb: result.get()) ...
+//
+
+#ifndef CAFFE_DETECTION_DETECTOR_HPP_
+#define CAFFE_DETECTION_DETECTOR_HPP_
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "caffe/net.hpp"
+#include "caffe/util/pgp.hpp"
+#include "caffe/util/utils_bb.hpp"
+
+
+namespace caffe {
+
+
+/**
+ * @brief Settings of the detectors
+ */
+struct DetectorSettings
+{
+    DetectorSettings ()
+        : scales({ 1.0 }),
+          min_conf(0.1),
+          nms_iou(0.5),
+          num_workers(1),
+          max_batch_size(4),
+          sparse_head(false),
+          gpu(-1),
+          size_filter(false),
+          nms_bev(false),
+          nms_bev_iou(0.3)
+    {
+    }
+
+
+    // Scales of the image pyramid
+    std::vector<double> scales;
+    // Minimum confidence of a detection
+    double min_conf;
+    // Maximum intersection over union of two boxes kept by the NMS (0 turns the NMS off)
+    double nms_iou;
+    // Number of worker threads, each runs its own copy of the network (the weights are shared)
+    int num_workers;
+    // Maximum number of frames of the same size processed in one forward pass
+    int max_batch_size;
+    // Compute the coordinates of the accumulators only in the extracted local maxima
+    bool sparse_head;
+    // Id of the GPU to run the network on, -1 runs it on the CPU
+    int gpu;
+
+    // 3D only: Throw away boxes with an unreasonable size of the bottom rectangle (needs PGP)
+    bool size_filter;
+    // 3D only: Non-maxima suppression on the ground plane instead of in the image (needs PGP)
+    bool nms_bev;
+    double nms_bev_iou;
+};
+
+
+/**
+ * @brief Common machinery of the asynchronous detectors
+ *
+ * The frames are converted into the pyramid levels in the submitting thread, the workers then take the
+ * queued frames in batches of frames of the same size, run the network on them and fulfill the promises of
+ * the frames with the extracted bounding boxes. Derived classes implement the extraction of the bounding
+ * boxes from the network output and their post-processing, they must call _stopWorkers() in their destructor.
+ *
+ * Only the outputs with the number of channels of the detector are used, so a joint network with both 2D and
+ * 3D accumulators can be loaded by either detector.
+ */
+template <typename BB>
+class AsyncDetector
+{
+public:
+
+    AsyncDetector (const std::string &path_prototxt, const std::string &path_caffemodel,
+                   const DetectorSettings &settings, int num_channels);
+    virtual ~AsyncDetector ();
+
+    AsyncDetector (const AsyncDetector&) = delete;
+    AsyncDetector& operator= (const AsyncDetector&) = delete;
+
+
+    const DetectorSettings& settings () const { return this->_settings; }
+
+
+protected:
+
+    /**
+     * @brief One submitted frame
+     */
+    struct Request
+    {
+        // Size of the original frame
+        cv::Size size;
+        // Pyramid levels of the frame (zero mean, unit variance), one for each scale
+        std::vector<cv::Mat> levels;
+        // Identifier of the frame (path_image of the bounding boxes)
+        std::string id;
+        // Image projection matrix and ground plane of the frame (3D only, can be null)
+        std::shared_ptr<const PGP> pgp;
+        std::promise<std::vector<BB>> promise;
+    };
+
+
+    /**
+     * @brief Queues the frame for detection
+     * @param image BGR image (CV_8UC3)
+     * @param id Identifier of the frame
+     * @param pgp Image projection matrix and ground plane of the frame (can be null)
+     */
+    std::future<std::vector<BB>> _submit (const cv::Mat &image, const std::string &id,
+                                          const std::shared_ptr<const PGP> &pgp);
+
+    /**
+     * @brief Extracts the bounding boxes from one image of an accumulator output
+     * @param output Output blob of the network (N x C x H x W)
+     * @param b Index of the image in the batch
+     * @param scale Scale of the pyramid level (coordinates are divided by it)
+     * @param id Identifier of the frame
+     */
+    virtual std::vector<BB> _extract (const Blob<float> &output, int b, double scale,
+                                      const std::string &id) const = 0;
+
+    /**
+     * @brief Post-processing (e.g. reconstruction and NMS) of all bounding boxes extracted from the frame
+     */
+    virtual std::vector<BB> _finish (std::vector<BB> &bbs, const PGP *pgp) const = 0;
+
+    /**
+     * @brief Stops and joins the workers, the unprocessed frames are failed
+     */
+    void _stopWorkers ();
+
+
+    // ---------------------------------------  PROTECTED MEMBERS  --------------------------------------- //
+    DetectorSettings _settings;
+    // Number of channels of the accumulators the detector extracts the bounding boxes from
+    int _num_channels;
+
+
+private:
+
+    void _workerEntry (int w);
+
+    /**
+     * @brief Takes the next batch of requests of the same size from the queue, blocks until there is one
+     * @return False if the detector is being stopped
+     */
+    bool _takeBatch (std::vector<std::unique_ptr<Request>> &batch);
+
+    void _processBatch (Net<float> &net, std::vector<std::unique_ptr<Request>> &batch);
+
+
+    // ----------------------------------------  PRIVATE MEMBERS  ---------------------------------------- //
+    // One network for each worker, the first one owns the weights
+    std::vector<std::shared_ptr<Net<float>>> _nets;
+    std::vector<std::thread> _workers;
+
+    std::deque<std::unique_ptr<Request>> _queue;
+    std::mutex _mtx;
+    std::condition_variable _cv;
+    bool _stop;
+
+};
+
+
+/**
+ * @brief Detector of 2D bounding boxes (networks with 5 channel accumulators)
+ */
+class Detector2D : public AsyncDetector<BB2D>
+{
+public:
+
+    Detector2D (const std::string &path_prototxt, const std::string &path_caffemodel,
+                const DetectorSettings &settings=DetectorSettings());
+    virtual ~Detector2D ();
+
+
+    /**
+     * @brief Queues the frame for detection
+     * @param image BGR image (CV_8UC3), it is not referenced after the call returns
+     * @param id Identifier of the frame (path_image of the returned bounding boxes)
+     * @return Bounding boxes after NMS in the coordinates of the image
+     */
+    std::future<std::vector<BB2D>> detect (const cv::Mat &image, const std::string &id="");
+
+    /**
+     * @brief Queues the frame given by a raw buffer of interleaved BGR pixels for detection
+     * @param data Pixels of the frame, row by row
+     * @param step Number of bytes of one row (at least 3*width)
+     */
+    std::future<std::vector<BB2D>> detect (const unsigned char *data, int width, int height, int step,
+                                           const std::string &id="");
+
+
+protected:
+
+    virtual std::vector<BB2D> _extract (const Blob<float> &output, int b, double scale,
+                                        const std::string &id) const override;
+
+    virtual std::vector<BB2D> _finish (std::vector<BB2D> &bbs, const PGP *pgp) const override;
+
+};
+
+
+/**
+ * @brief Detector of 3D bounding boxes (networks with 8 channel accumulators)
+ *
+ * With the PGP of the frame the detections are reconstructed in 3D, invalid ones are thrown away and their 2D
+ * bounding boxes are computed. Without it the raw detections (only the 7 coordinates) are returned without
+ * NMS.
+ */
+class Detector3D : public AsyncDetector<BB3D>
+{
+public:
+
+    Detector3D (const std::string &path_prototxt, const std::string &path_caffemodel,
+                const DetectorSettings &settings=DetectorSettings());
+    virtual ~Detector3D ();
+
+
+    /**
+     * @brief Queues the frame for detection
+     * @param image BGR image (CV_8UC3), it is not referenced after the call returns
+     * @param pgp Image projection matrix and ground plane of the frame
+     * @param id Identifier of the frame (path_image of the returned bounding boxes)
+     */
+    std::future<std::vector<BB3D>> detect (const cv::Mat &image, const PGP &pgp, const std::string &id="");
+
+    /**
+     * @brief Queues the frame without calibration for detection, returns the raw detections
+     */
+    std::future<std::vector<BB3D>> detect (const cv::Mat &image, const std::string &id="");
+
+    /**
+     * @brief Queues the frame given by a raw buffer of interleaved BGR pixels for detection
+     * @param data Pixels of the frame, row by row
+     * @param step Number of bytes of one row (at least 3*width)
+     * @param pgp Image projection matrix and ground plane of the frame (can be null)
+     */
+    std::future<std::vector<BB3D>> detect (const unsigned char *data, int width, int height, int step,
+                                           const PGP *pgp, const std::string &id="");
+
+
+protected:
+
+    virtual std::vector<BB3D> _extract (const Blob<float> &output, int b, double scale,
+                                        const std::string &id) const override;
+
+    virtual std::vector<BB3D> _finish (std::vector<BB3D> &bbs, const PGP *pgp) const override;
+
+};
+
+
+}  // namespace caffe
+
+#endif  // CAFFE_DETECTION_DETECTOR_HPP_
@@ -7,6 +7,7 @@
 #define CAFFE_INTERNAL_THREADPOOL_HPP_
 
 #include "caffe/common.hpp"
+#include "caffe/util/cpu_resources.hpp"
 
 
 /**
@@ -27,7 +28,11 @@ namespace caffe {
 class InternalThreadpool {
 public:
 
-    InternalThreadpool (int num_threads);
+    /**
+     * @param num_threads Number of threads of the pool
+     * @param role Cores the threads are pinned to (if CPUResources pins the threads)
+     */
+    InternalThreadpool (int num_threads, CPUResources::Role role);
     virtual ~InternalThreadpool ();
 
 
@@ -72,6 +77,7 @@ private:
     // ----------------------------------------  PRIVATE MEMBERS  ---------------------------------------- //
     // List of running threads
     std::vector<shared_ptr<boost::thread>> _threads;
+    CPUResources::Role _role;
 
 };
 
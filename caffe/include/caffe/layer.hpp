@@ -38,7 +38,7 @@ class Layer {
    * layer.
    */
   explicit Layer(const LayerParameter& param)
-    : layer_param_(param) {
+    : layer_param_(param), lazy_reshape_(false) {
       // Set phase and copy blobs (if there are any).
       phase_ = param.phase();
       if (layer_param_.blobs_size() > 0) {
@@ -291,6 +291,16 @@ class Layer {
     param_propagate_down_[param_id] = value;
   }
 
+  /**
+   * @brief Sets whether Forward() calls Reshape() only when the shapes of the
+   *        bottom blobs changed since the previous call (used by inference
+   *        only nets). Requires Reshape() to depend on the bottom shapes only.
+   */
+  inline void set_lazy_reshape(const bool value) {
+    lazy_reshape_ = value;
+    bottom_shapes_.clear();
+  }
+
 
  protected:
   /** The protobuf that stores the layer parameters */
@@ -306,6 +316,11 @@ class Layer {
    *  the objective function. */
   vector<Dtype> loss_;
 
+  /** Whether to skip Reshape() in Forward() if the bottom shapes are the same
+   *  as in the previous call, and the shapes of that call. */
+  bool lazy_reshape_;
+  vector<vector<int> > bottom_shapes_;
+
   /** @brief Using the CPU device, compute the layer output. */
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) = 0;
@@ -402,6 +417,22 @@ class Layer {
     }
   }
 
+  /**
+   * Called by Forward if lazy_reshape_ is set. Compares the shapes of the
+   * bottom blobs with the ones of the previous call and stores the new ones.
+   */
+  inline bool BottomShapesChanged(const vector<Blob<Dtype>*>& bottom) {
+    bool changed = bottom_shapes_.size() != bottom.size();
+    bottom_shapes_.resize(bottom.size());
+    for (int bottom_id = 0; bottom_id < bottom.size(); ++bottom_id) {
+      if (bottom_shapes_[bottom_id] != bottom[bottom_id]->shape()) {
+        bottom_shapes_[bottom_id] = bottom[bottom_id]->shape();
+        changed = true;
+      }
+    }
+    return changed;
+  }
+
  private:
   DISABLE_COPY_AND_ASSIGN(Layer);
 };  // class Layer
@@ -413,7 +444,9 @@ template <typename Dtype>
 inline Dtype Layer<Dtype>::Forward(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   Dtype loss = 0;
-  Reshape(bottom, top);
+  if (!lazy_reshape_ || BottomShapesChanged(bottom)) {
+    Reshape(bottom, top);
+  }
   switch (Caffe::mode()) {
   case Caffe::CPU:
     Forward_cpu(bottom, top);
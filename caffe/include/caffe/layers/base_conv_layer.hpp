@@ -40,6 +40,18 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype*
       weights);
   void backward_cpu_bias(Dtype* bias, const Dtype* input);
+  // Batched variants of the helpers above, they process num consecutive
+  // images with one GEMM per group. The images are laid out side by side in
+  // the shared workspace, the output (top diff) matrix of the last
+  // weight_cpu_gemm_batched call can be reused with skip_gather.
+  void forward_cpu_gemm_batched(const Dtype* input, const Dtype* weights,
+      Dtype* output, int num);
+  void backward_cpu_gemm_batched(const Dtype* output, const Dtype* weights,
+      Dtype* input, int num, bool skip_gather = false);
+  void weight_cpu_gemm_batched(const Dtype* input, const Dtype* output,
+      Dtype* weights, int num);
+  /// @brief Number of images per batched GEMM, 1 if the mode is disabled.
+  inline int batched_gemm_images() const { return batched_gemm_images_; }
 
 #ifndef CPU_ONLY
   void forward_gpu_gemm(const Dtype* col_input, const Dtype* weights,
@@ -92,6 +104,7 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   bool bias_term_;
   bool is_1x1_;
   bool force_nd_im2col_;
+  int batched_gemm_images_;
 
  private:
   // wrap im2col/col2im so we don't have to remember the (long) argument lists
@@ -123,6 +136,12 @@ class BaseConvolutionLayer : public Layer<Dtype> {
           pad_.cpu_data(), stride_.cpu_data(), dilation_.cpu_data(), data);
     }
   }
+  // Column and output matrices of num images side by side in the shared
+  // workspace, each group occupies a contiguous block of rows.
+  Dtype* batched_col_buffer(int num);
+  Dtype* batched_output_buffer(int num);
+  void batched_im2col_cpu(const Dtype* data, int num, Dtype* col_batch);
+
 #ifndef CPU_ONLY
   inline void conv_im2col_gpu(const Dtype* data, Dtype* col_buff) {
     if (!force_nd_im2col_ && num_spatial_axes_ == 2) {
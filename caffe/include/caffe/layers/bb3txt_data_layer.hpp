@@ -15,8 +15,12 @@ namespace caffe {
 /**
  * @brief The BB3TXTDataLayer class
  *
- * The BB3TXTDataLayer loads a BBTXT file with 2D bounding boxes and runs learning on the images specified in
+ * The BB3TXTDataLayer loads a BB3TXT file with 3D bounding boxes and runs learning on the images specified in
  * the paths in the given file.
+ *
+ * The labels are [label, xmin, ymin, xmax, ymax, fblx, fbly, fbrx, fbry, rblx, rbly, ftly] - they start with the
+ * 2D bounding box of the object, so they can be fed to a BBTXTLoss layer as well as to a BB3TXTLoss layer and one
+ * network can be trained with both 2D and 3D accumulators.
  */
 template <typename Dtype>
 class BB3TXTDataLayer : public BasePrefetchingDataLayer<Dtype>, public InternalThreadpool
@@ -100,6 +104,12 @@ protected:
      */
     virtual SelectedBB<Dtype> _getImageAndBB ();
 
+    /**
+     * @brief Starts the reads of the image files of the next read_ahead bounding boxes in the current epoch
+     * Must be called with _i_global_mtx locked
+     */
+    virtual void _prefetchAhead ();
+
 
     // ---------------------------------------  PROTECTED MEMBERS  --------------------------------------- //
     // List of image paths and 2D bounding box annotations in the form of a blob
@@ -112,11 +122,21 @@ protected:
     shared_ptr<Caffe::RNG> _rng;
 
     // Queue of indices of images to be processed
-    BlockingQueue<int> _b_queue;
-    BlockingCounter _num_processed;
+    LockFreeQueue<int> _b_queue;
+    LockFreeCounter _num_processed;
     // Mutex for access to _i_global and _bb_id_global
     mutable std::mutex _i_global_mtx;
 
+    // Cache of the deterministic TEST phase crops (indexed by the position in _indices)
+    std::unique_ptr<SampleCache<Dtype>> _test_cache;
+
+    // Asynchronous reads of the upcoming image files, null if the read-ahead is off
+    std::unique_ptr<FilePrefetcher> _prefetcher;
+    // Position in _indices of the next bounding box, whose image will be prefetched
+    int _i_prefetch;
+    // Sequence number of the first bounding box of the current epoch
+    long _seq_epoch;
+
 };
 
 
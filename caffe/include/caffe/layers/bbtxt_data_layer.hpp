@@ -17,8 +17,9 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
-#include "caffe/util/blocking_queue.hpp"
-#include "caffe/util/blocking_counter.hpp"
+#include "caffe/util/file_prefetcher.hpp"
+#include "caffe/util/lockfree_queue.hpp"
+#include "caffe/util/sample_cache.hpp"
 
 
 namespace caffe {
@@ -33,6 +34,10 @@ struct SelectedBB
     std::string filename;
     std::shared_ptr<Blob<Dtype>> label;
     int bb_id;
+    // Position in the list of all bounding boxes of the dataset
+    int index;
+    // Sequence number of the selection over all epochs (key of the prefetched image file)
+    long seq;
 };
 
 
@@ -94,6 +99,10 @@ protected:
 
     /**
      * @brief Crops a window from the given image around the given bb and resamples it to the network input blob
+     *
+     * Cropping, scaling, mirroring and rotation are composed into one affine transformation, which is applied
+     * to the image in a single warpAffine pass and to the annotations of the image.
+     *
      * @param cv_img Image to be cropped from
      * @param b Id of image in the batch (for output blobs)
      * @param bb_id Id of selected bounding box in the image label
@@ -101,27 +110,47 @@ protected:
     virtual void _cropAndTransform (const cv::Mat &cv_img, int b, int bb_id);
 
     /**
-     * @brief Subroutine of the previous method. Performs only the cropping part with label adjustment
-     * @param cv_img Image to be cropped from
-     * @param cv_img_cropped_out Output cropped image
+     * @brief Transformation (3x3, CV_64F) of the crop around the given bb to the network input
      * @param b Id of image in the batch (for output blobs)
      * @param bb_id Id of selected bounding box in the image label
      */
-    virtual void _cropBBFromImage (const cv::Mat &cv_img, cv::Mat &cv_img_cropped_out, int b, int bb_id);
+    virtual cv::Mat _cropTransform (int b, int bb_id);
 
     /**
-     * @brief Converts values to 0 mean, unit variance and adds some hue, exposure,... adjustments
-     * @param cv_img_cropped Already cropped image
+     * @brief Random horizontal mirroring of the network input during training (3x3, CV_64F)
+     */
+    virtual cv::Mat _flipTransform ();
+
+    /**
+     * @brief Random rotation by at most rotation_max degrees around the center of the network input during
+     * training (3x3, CV_64F)
+     */
+    virtual cv::Mat _rotationTransform ();
+
+    /**
+     * @brief Mirroring along the vertical axis of the network input (3x3, CV_64F)
+     */
+    cv::Mat _flipMatrix () const;
+
+    /**
+     * @brief Rotation by the given angle (degrees) around the center of the network input (3x3, CV_64F), same
+     * as cv::getRotationMatrix2D
+     */
+    cv::Mat _rotationMatrix (double angle) const;
+
+    /**
+     * @brief Transforms all annotations of the image, the new bounding boxes enclose the transformed ones
+     * @param T Transformation from the image to the network input (3x3, CV_64F)
      * @param b Id of image in the batch (for output blobs)
      */
-    virtual void _applyPixelTransformationsAndCopyOut (const cv::Mat &cv_img_cropped, int b);
+    virtual void _transformLabels (const cv::Mat &T, int b);
 
     /**
-     * @brief Randomly flips the image during training
-     * @param cv_img_cropped Already cropped and rescaled image
+     * @brief Converts values to 0 mean, unit variance and adds some hue, exposure,... adjustments
+     * @param cv_img_cropped Already cropped image
      * @param b Id of image in the batch (for output blobs)
      */
-    virtual void _flipImage(cv::Mat &cv_img_cropped, int b);
+    virtual void _applyPixelTransformationsAndCopyOut (const cv::Mat &cv_img_cropped, int b);
 
     /**
      * @brief Thread safe selecting of image filename and id of bounding box in that image
@@ -131,6 +160,12 @@ protected:
      */
     virtual SelectedBB<Dtype> _getImageAndBB ();
 
+    /**
+     * @brief Starts the reads of the image files of the next read_ahead bounding boxes in the current epoch
+     * Must be called with _i_global_mtx locked
+     */
+    virtual void _prefetchAhead ();
+
 
     // ---------------------------------------  PROTECTED MEMBERS  --------------------------------------- //
     // List of image paths and 2D bounding box annotations in the form of a blob
@@ -143,11 +178,21 @@ protected:
     shared_ptr<Caffe::RNG> _rng;
 
     // Queue of indices of images to be processed
-    BlockingQueue<int> _b_queue;
-    BlockingCounter _num_processed;
+    LockFreeQueue<int> _b_queue;
+    LockFreeCounter _num_processed;
     // Mutex for access to _i_global and _bb_id_global
     mutable std::mutex _i_global_mtx;
 
+    // Cache of the deterministic TEST phase crops (indexed by the position in _indices)
+    std::unique_ptr<SampleCache<Dtype>> _test_cache;
+
+    // Asynchronous reads of the upcoming image files, null if the read-ahead is off
+    std::unique_ptr<FilePrefetcher> _prefetcher;
+    // Position in _indices of the next bounding box, whose image will be prefetched
+    int _i_prefetch;
+    // Sequence number of the first bounding box of the current epoch
+    long _seq_epoch;
+
 };
 
 
@@ -15,8 +15,7 @@
 
 #include "caffe/layers/loss_layer.hpp"
 #include "caffe/internal_threadpool.hpp"
-#include "caffe/util/blocking_queue.hpp"
-#include "caffe/util/blocking_counter.hpp"
+#include "caffe/util/lockfree_queue.hpp"
 
 
 namespace caffe {
@@ -28,6 +27,14 @@ namespace caffe {
  * The loss is composed of two different losses - Accumulator loss and regression loss from bounding box
  * coordinates. This loss supports only one accumulator! I we want multiple accumulators in the network, each
  * accumulator has to have its own bbtxt loss layer
+ *
+ * Knowledge distillation: with the accumulator of a teacher network as the third bottom the target accumulator
+ * is blended with the teacher output (AccumulatorLossParameter distill_weight). The teacher sub-net shares the
+ * data blob and should be frozen (lr_mult: 0) and computed in the TEST phase (phase: TEST).
+ *
+ * Only the first 5 values of each label [label, xmin, ymin, xmax, ymax] are used, so the layer can also be
+ * trained from the labels of a BB3TXTData layer - a joint network then has a BBTXTLoss and a BB3TXTLoss on the
+ * same label blob, each with its own accumulators on the shared features.
  */
 template <typename Dtype>
 class BBTXTLossLayer : public LossLayer<Dtype>, public InternalThreadpool
@@ -49,6 +56,29 @@ public:
         return "BBTXTLoss";
     }
 
+    virtual inline int ExactNumBottomBlobs () const override
+    {
+        return -1;
+    }
+
+    virtual inline int MinBottomBlobs () const override
+    {
+        // Labels and the accumulator
+        return 2;
+    }
+
+    virtual inline int MaxBottomBlobs () const override
+    {
+        // Optional accumulator of the teacher network
+        return 3;
+    }
+
+    virtual inline bool AllowForceBackward (const int bottom_index) const override
+    {
+        // The teacher is never trained
+        return bottom_index < 2 && LossLayer<Dtype>::AllowForceBackward(bottom_index);
+    }
+
 
 protected:
 
@@ -80,6 +110,12 @@ protected:
      */
     virtual int _removeNegativeCoordinateDiff (int b);
 
+    /**
+     * @brief Shifts the diffs of the image towards the teacher accumulator (knowledge distillation)
+     * @param b Id of image in the batch
+     */
+    virtual void _blendTeacher (int b);
+
     /**
      * @brief Computes the squared error of the probability channel
      * @param b Id of image in the batch
@@ -117,12 +153,15 @@ protected:
     // Blob with the labels of shape batch x num_bbs x 5
     const Blob<Dtype>* _labels;
     const Blob<Dtype>* _bottom;
+    // Accumulator of the teacher network (null without distillation) and the blending weight of each channel
+    const Blob<Dtype>* _teacher;
+    std::vector<Dtype> _distill_weights;
 
     std::shared_ptr<Blob<Dtype>> _diff;
 
     // Queue of indices of images to be processed
-    BlockingQueue<int> _b_queue;
-    BlockingCounter _num_processed;
+    LockFreeQueue<int> _b_queue;
+    LockFreeCounter _num_processed;
 
     std::atomic<Dtype> _loss_prob;
     std::atomic<Dtype> _loss_prob_pos;
@@ -0,0 +1,74 @@
+//
+// Sparse evaluation of the last layer of an accumulator for deployment - the coordinate channels are only
+// computed in the peaks of the probability channel, from which the bounding boxes are extracted.
+//
+
+#ifndef CAFFE_SPARSE_ACCUMULATOR_LAYER_HPP_
+#define CAFFE_SPARSE_ACCUMULATOR_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+
+namespace caffe {
+
+
+/**
+ * @brief SparseAccumulatorLayer
+ * Drop-in replacement of the last 1x1 convolution of an accumulator for DEPLOYMENT. It has the same
+ * parameters (convolution_param) and weight blobs as the convolution, therefore it loads the weights of the
+ * trained network. Only the probability channel (channel 0) is computed densely, the coordinate channels
+ * are computed only in the local maxima of the probability (3x3 neighborhood) with probability at least
+ * min_conf, which are the only pixels from which the bounding boxes are extracted. All other coordinate
+ * values are 0.
+ *
+ * This removes (C-1)/C of the multiply-adds of the layer, i.e. 80% for the 5 channel 2D and 87.5% for the 8
+ * channel 3D accumulators.
+ */
+template <typename Dtype>
+class SparseAccumulatorLayer : public Layer<Dtype>
+{
+public:
+
+    explicit SparseAccumulatorLayer (const LayerParameter &param);
+
+    virtual void LayerSetUp (const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top) override;
+
+    virtual void Reshape (const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top) override;
+
+
+    // -----------------------------------------  INLINE METHODS  ---------------------------------------- //
+
+    virtual inline const char* type () const override
+    {
+        return "SparseAccumulator";
+    }
+
+    virtual inline int ExactNumBottomBlobs () const override { return 1; }
+    virtual inline int ExactNumTopBlobs () const override { return 1; }
+
+
+protected:
+
+    virtual void Forward_cpu (const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top) override;
+
+    virtual void Backward_cpu (const vector<Blob<Dtype>*> &top, const vector<bool> &propagate_down,
+                               const vector<Blob<Dtype>*> &bottom) override;
+
+
+    // ---------------------------------------  PROTECTED MEMBERS  --------------------------------------- //
+    // Number of output channels (probability + coordinates)
+    int _num_output;
+    // Number of input channels
+    int _channels;
+    bool _bias_term;
+
+};
+
+
+}  // namespace caffe
+
+#endif  // CAFFE_SPARSE_ACCUMULATOR_LAYER_HPP_
@@ -104,6 +104,13 @@ class Net {
    *        additional memory) the pre-trained layers from another Net.
    */
   void ShareTrainedLayersWith(const Net* other);
+  /**
+   * @brief For an already initialized net, copies the trained layers from
+   *        another Net into this net's own blobs. Unlike
+   *        ShareTrainedLayersWith() the weights of the two nets stay
+   *        independent afterwards, e.g. for testing while training goes on.
+   */
+  void CopyTrainedLayersFrom(const Net* other);
   // For an already initialized net, CopyTrainedLayersFrom() copies the already
   // trained layers from another net parameter instance.
   /**
@@ -135,6 +142,8 @@ class Net {
   }
   /// @brief returns the phase: TRAIN or TEST
   inline Phase phase() const { return phase_; }
+  /// @brief returns whether the net was built for inference only
+  inline bool inference_only() const { return inference_only_; }
   /**
    * @brief returns the bottom vecs for each layer -- usually you won't
    *        need this unless you do per-layer checks such as gradients.
@@ -330,6 +339,8 @@ class Net {
   size_t memory_used_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
+  /// Whether the net was built for inference only (no losses, no backward)
+  bool inference_only_;
   // Callbacks
   vector<Callback*> before_forward_;
   vector<Callback*> after_forward_;
@@ -143,6 +143,48 @@ class AdamSolver : public SGDSolver<Dtype> {
   DISABLE_COPY_AND_ASSIGN(AdamSolver);
 };
 
+/**
+ * @brief Asynchronous lock-free ("Hogwild") multi-threaded SGD on the CPU.
+ *
+ * Step runs hogwild_threads threads. This solver's thread trains its own net,
+ * every other thread trains a replica of the train net with its own data
+ * layers, which shares the parameter data with this solver's net. The threads
+ * have the solver ranks 0..hogwild_threads-1, this solver's thread has rank 0
+ * (its net is set up with the Hogwild solver count already). Data and
+ * HDF5Data layers read disjoint shares of the training data by the rank. The
+ * other data layers (e.g. ImageData, BBTXTData and BB3TXTData) are not
+ * sharded - every thread reads the whole training set, BBTXTData and
+ * BB3TXTData in their own shuffled order. Each thread computes gradients on
+ * its own minibatches and applies plain SGD updates (with its own momentum
+ * history) directly to the shared parameters without any locking. The
+ * staleness of the updates is bounded - a thread waits before an iteration if
+ * it is more than hogwild_max_lag iterations ahead of the slowest thread.
+ * Every thread runs the requested number of iterations, testing and snapshots
+ * are done only by this solver's thread.
+ */
+template <typename Dtype>
+class HogwildSGDSolver : public SGDSolver<Dtype> {
+ public:
+  explicit HogwildSGDSolver(const SolverParameter& param)
+      : SGDSolver<Dtype>(ShareRootData(param)) { HogwildPreSolve(); }
+  explicit HogwildSGDSolver(const string& param_file)
+      : SGDSolver<Dtype>(ShareRootData(param_file)) { HogwildPreSolve(); }
+  virtual inline const char* type() const { return "HogwildSGD"; }
+
+  virtual void Step(int iters);
+
+ protected:
+  // Sets the solver count of the calling thread to the number of the Hogwild
+  // threads for the setup of the root net, HogwildPreSolve restores it
+  static const SolverParameter& ShareRootData(const SolverParameter& param);
+  static SolverParameter ShareRootData(const string& param_file);
+  void HogwildPreSolve();
+
+  int num_threads_;
+
+  DISABLE_COPY_AND_ASSIGN(HogwildSGDSolver);
+};
+
 }  // namespace caffe
 
 #endif  // CAFFE_SGD_SOLVERS_HPP_
@@ -8,6 +8,12 @@
 #include "caffe/solver_factory.hpp"
 #include "caffe/util/benchmark.hpp"
 
+/**
+ Forward declare boost::thread instead of including boost/thread.hpp
+ to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+ */
+namespace boost { class thread; }
+
 namespace caffe {
 
 /**
@@ -56,7 +62,7 @@ class Solver {
   // in a non-zero iter number to resume training for a pre-trained net.
   virtual void Solve(const char* resume_file = NULL);
   inline void Solve(const string resume_file) { Solve(resume_file.c_str()); }
-  void Step(int iters);
+  virtual void Step(int iters);
   // The Restore method simply dispatches to one of the
   // RestoreSolverStateFrom___ protected methods. You should implement these
   // methods to restore the state from the appropriate snapshot type.
@@ -66,7 +72,7 @@ class Solver {
   // function that produces a SolverState protocol buffer that needs to be
   // written to disk together with the learned net.
   void Snapshot();
-  virtual ~Solver() {}
+  virtual ~Solver();
   inline const SolverParameter& param() const { return param_; }
   inline shared_ptr<Net<Dtype> > net() { return net_; }
   inline const vector<shared_ptr<Net<Dtype> > >& test_nets() {
@@ -103,6 +109,17 @@ class Solver {
   // The test routine
   void TestAll();
   void Test(const int test_net_id = 0);
+  // Runs the test iterations of a test net and logs the results against the
+  // given training iteration. Solver actions (snapshot, stop) are only
+  // handled when testing synchronously.
+  void TestNet(const int test_net_id, const int iter, const bool async);
+  // Asynchronous testing (test_async) - copies the current weights into the
+  // test nets and evaluates them on a separate thread
+  void TestAllAsync();
+  void TestAllAsyncEntry(int iter, int device, Caffe::Brew mode,
+      int rand_seed);
+  // Blocks until the asynchronous test finishes, optionally interrupting it
+  void WaitForAsyncTest(bool interrupt = false);
   virtual void SnapshotSolverState(const string& model_filename) = 0;
   virtual void RestoreSolverStateFromHDF5(const string& state_file) = 0;
   virtual void RestoreSolverStateFromBinaryProto(const string& state_file) = 0;
@@ -129,6 +146,9 @@ class Solver {
   Timer iteration_timer_;
   float iterations_last_;
 
+  // Thread running the asynchronous test
+  shared_ptr<boost::thread> test_thread_;
+
   DISABLE_COPY_AND_ASSIGN(Solver);
 };
 
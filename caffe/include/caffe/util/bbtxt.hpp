@@ -2,7 +2,7 @@
 // Libor Novak
 // 04/20/2017
 //
-// Functions for processing the BBTXT file format
+// Functions for processing the BBTXT and BB3TXT file formats
 //
 
 #ifndef BBTXT_H
@@ -21,5 +21,13 @@
 std::map<std::string, std::vector<BB2D>> readBBTXTFile (const std::string &path_bbtxt);
 
 
+/**
+ * @brief Reads a BB3TXT file into a map with 3D bounding box lists indexed by filenames
+ * @param path_bb3txt Path to the BB3TXT file
+ * @return
+ */
+std::map<std::string, std::vector<BB3D>> readBB3TXTFile (const std::string &path_bb3txt);
+
+
 #endif // BBTXT_H
 
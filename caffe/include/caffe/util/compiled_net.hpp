@@ -0,0 +1,238 @@
+//
+// Kernels used by the nets generated with examples/ln/compile_net. All shapes, strides, paddings and
+// dilations are template parameters, which makes all loop bounds compile-time constants. The kernels
+// follow the exact order of operations of the corresponding Caffe layers so the compiled net produces
+// the same outputs as Net::Forward().
+//
+
+#ifndef CAFFE_UTIL_COMPILED_NET_HPP_
+#define CAFFE_UTIL_COMPILED_NET_HPP_
+
+#include <algorithm>
+#include <cfloat>
+#include <string>
+
+#include "caffe/util/math_functions.hpp"
+
+
+namespace caffe {
+namespace compiled {
+
+
+/**
+ * @brief Weights of one layer of the compiled net, which are loaded from a caffemodel file
+ */
+struct ParamEntry
+{
+    const char *layer_name;
+    float *weights;
+    int weights_count;
+    float *bias;
+    int bias_count;
+};
+
+
+/**
+ * @brief Loads the weights of the listed layers from a caffemodel file
+ * @param path_caffemodel Path to the caffemodel file with trained weights
+ * @param params List of layers, whose weights are to be loaded
+ * @param num_params Length of the params list
+ */
+void loadParams (const std::string &path_caffemodel, const ParamEntry *params, int num_params);
+
+
+// ---------------------------------------------  GEOMETRY  ---------------------------------------------- //
+
+/**
+ * @brief Output shape of a convolution, computed the same way as in BaseConvolutionLayer
+ */
+template <int C, int H, int W, int KH, int KW, int PH, int PW, int SH, int SW, int DH, int DW>
+struct ConvGeometry
+{
+    static constexpr int OUT_H       = (H + 2*PH - (DH*(KH-1) + 1)) / SH + 1;
+    static constexpr int OUT_W       = (W + 2*PW - (DW*(KW-1) + 1)) / SW + 1;
+    static constexpr int OUT_SPATIAL = OUT_H * OUT_W;
+    static constexpr int KERNEL_DIM  = C * KH * KW;
+    // Caffe skips im2col for 1x1 convolutions with unit stride and no padding
+    static constexpr bool IS_1X1     = KH == 1 && KW == 1 && SH == 1 && SW == 1 && PH == 0 && PW == 0;
+    static constexpr int COL_SIZE    = IS_1X1 ? 0 : KERNEL_DIM * OUT_SPATIAL;
+};
+
+
+/**
+ * @brief Output shape of a pooling, computed the same way as in PoolingLayer (rounds up)
+ */
+template <int H, int W, int KH, int KW, int PH, int PW, int SH, int SW>
+struct PoolGeometry
+{
+    static constexpr int OUT_H_CEIL = (H + 2*PH - KH + SH - 1) / SH + 1;
+    static constexpr int OUT_W_CEIL = (W + 2*PW - KW + SW - 1) / SW + 1;
+    // The last pooling has to start strictly inside the image
+    static constexpr int OUT_H      = (PH > 0 && (OUT_H_CEIL-1)*SH >= H + PH) ? OUT_H_CEIL - 1 : OUT_H_CEIL;
+    static constexpr int OUT_W      = (PW > 0 && (OUT_W_CEIL-1)*SW >= W + PW) ? OUT_W_CEIL - 1 : OUT_W_CEIL;
+};
+
+
+// ----------------------------------------------  KERNELS  ---------------------------------------------- //
+
+/**
+ * @brief Specialized version of im2col_cpu()
+ * @param data_im Input image of shape C x H x W
+ * @param data_col Output column buffer of size ConvGeometry::COL_SIZE
+ */
+template <int C, int H, int W, int KH, int KW, int PH, int PW, int SH, int SW, int DH, int DW>
+inline void im2col (const float *data_im, float *data_col)
+{
+    typedef ConvGeometry<C, H, W, KH, KW, PH, PW, SH, SW, DH, DW> G;
+
+    for (int c = 0; c < C; ++c, data_im += H*W)
+    {
+        for (int kr = 0; kr < KH; ++kr)
+        {
+            for (int kc = 0; kc < KW; ++kc)
+            {
+                int input_row = -PH + kr*DH;
+                for (int r = 0; r < G::OUT_H; ++r, input_row += SH)
+                {
+                    if (static_cast<unsigned>(input_row) >= static_cast<unsigned>(H))
+                    {
+                        for (int col = 0; col < G::OUT_W; ++col) *(data_col++) = 0;
+                    }
+                    else
+                    {
+                        int input_col = -PW + kc*DW;
+                        for (int col = 0; col < G::OUT_W; ++col, input_col += SW)
+                        {
+                            *(data_col++) = (static_cast<unsigned>(input_col) < static_cast<unsigned>(W))
+                                    ? data_im[input_row*W + input_col] : 0;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+/**
+ * @brief Convolution of one image (group 1), the equivalent of ConvolutionLayer::Forward_cpu()
+ * @param input Input image of shape C_IN x H x W
+ * @param weights Filters C_OUT x C_IN x KH x KW
+ * @param bias Bias of size C_OUT (ignored if BIAS is false)
+ * @param bias_multiplier Vector of ones of size at least ConvGeometry::OUT_SPATIAL
+ * @param col_buffer Buffer of size at least ConvGeometry::COL_SIZE
+ * @param output Output of shape C_OUT x OUT_H x OUT_W
+ */
+template <int C_IN, int H, int W, int C_OUT, int KH, int KW, int PH, int PW, int SH, int SW, int DH, int DW,
+          bool BIAS>
+inline void convolution (const float *input, const float *weights, const float *bias,
+                         const float *bias_multiplier, float *col_buffer, float *output)
+{
+    typedef ConvGeometry<C_IN, H, W, KH, KW, PH, PW, SH, SW, DH, DW> G;
+
+    const float *col = input;
+    if (!G::IS_1X1)
+    {
+        im2col<C_IN, H, W, KH, KW, PH, PW, SH, SW, DH, DW>(input, col_buffer);
+        col = col_buffer;
+    }
+
+    caffe_cpu_gemm<float>(CblasNoTrans, CblasNoTrans, C_OUT, G::OUT_SPATIAL, G::KERNEL_DIM, 1.0f, weights, col,
+                          0.0f, output);
+    if (BIAS)
+    {
+        caffe_cpu_gemm<float>(CblasNoTrans, CblasNoTrans, C_OUT, G::OUT_SPATIAL, 1, 1.0f, bias, bias_multiplier,
+                              1.0f, output);
+    }
+}
+
+
+/**
+ * @brief ReLU, the equivalent of ReLULayer::Forward_cpu(), can be computed in place
+ */
+template <int COUNT>
+inline void relu (const float *input, float *output, const float negative_slope)
+{
+    for (int i = 0; i < COUNT; ++i)
+    {
+        output[i] = std::max(input[i], 0.0f) + negative_slope * std::min(input[i], 0.0f);
+    }
+}
+
+
+/**
+ * @brief Max pooling of one image, the equivalent of PoolingLayer::Forward_cpu() with MAX pooling
+ * @param input Input image of shape C x H x W
+ * @param output Output of shape C x PoolGeometry::OUT_H x PoolGeometry::OUT_W
+ */
+template <int C, int H, int W, int KH, int KW, int PH, int PW, int SH, int SW>
+inline void maxPooling (const float *input, float *output)
+{
+    typedef PoolGeometry<H, W, KH, KW, PH, PW, SH, SW> G;
+
+    for (int c = 0; c < C; ++c, input += H*W, output += G::OUT_H*G::OUT_W)
+    {
+        for (int ph = 0; ph < G::OUT_H; ++ph)
+        {
+            for (int pw = 0; pw < G::OUT_W; ++pw)
+            {
+                int hstart = ph*SH - PH;
+                int wstart = pw*SW - PW;
+                const int hend = std::min(hstart + KH, H);
+                const int wend = std::min(wstart + KW, W);
+                hstart = std::max(hstart, 0);
+                wstart = std::max(wstart, 0);
+
+                float mx = -FLT_MAX;
+                for (int h = hstart; h < hend; ++h)
+                {
+                    for (int w = wstart; w < wend; ++w)
+                    {
+                        if (input[h*W + w] > mx) mx = input[h*W + w];
+                    }
+                }
+                output[ph*G::OUT_W + pw] = mx;
+            }
+        }
+    }
+}
+
+
+/**
+ * @brief Conversion of normalized accumulator coordinates to pixel coordinates, the equivalent of
+ * BBTXTBBLayer::Forward_cpu() (C = 5) and BB3TXTBBLayer::Forward_cpu() (C = 8)
+ * @param input Accumulator of shape C x H x W
+ * @param output Output of shape C x H x W, can be the same as input
+ */
+template <int C, int H, int W>
+inline void bbtxtBB (const float *input, float *output, const float ideal_size, const float downsampling)
+{
+    static_assert(C == 5 || C == 8, "Only 2D (5 channels) and 3D (8 channels) accumulators are supported");
+
+    // The probability channel is passed through
+    if (input != output) caffe_copy(H*W, input, output);
+
+    for (int c = 1; c < C; ++c)
+    {
+        // Channels 1, 3, 5 are x coordinates (xmin, xmax or fblx, fbrx, rblx), the rest are y coordinates
+        const bool x_channel = (c == 1 || c == 3 || c == 5);
+
+        const float *in = input + c*H*W;
+        float *out      = output + c*H*W;
+
+        for (int i = 0; i < H; ++i)
+        {
+            for (int j = 0; j < W; ++j, ++in, ++out)
+            {
+                const int position = x_channel ? int(downsampling*(j+0.5f)) : int(downsampling*(i+0.5f));
+                *out = position + ideal_size * (*in - 0.5f);
+            }
+        }
+    }
+}
+
+
+}  // namespace compiled
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_COMPILED_NET_HPP_
@@ -0,0 +1,153 @@
+//
+// Process wide manager of the CPU cores. It finds out how many cores the process may actually use (affinity
+// mask and cgroup CPU quota) and splits them between the compute threads (BLAS, solver threads), the data
+// layer workers and the loss layer workers, which size and optionally pin their threads accordingly.
+//
+// The split is configured by the environment variables (or CPUResources::configure()):
+//     CAFFE_CPU_SHARES=2:2:1      Shares of the compute, data and loss threads
+//     CAFFE_CPU_PINNING=none      Pinning of the threads: none, core or numa
+//
+// The number of BLAS threads is only limited to the compute cores when the shares were configured explicitly,
+// with the default shares BLAS keeps its own thread count (tools without data and loss pools, e.g. caffe test
+// or the detectors, would otherwise use only a part of the cores).
+//
+
+#ifndef CAFFE_UTIL_CPU_RESOURCES_HPP_
+#define CAFFE_UTIL_CPU_RESOURCES_HPP_
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+
+namespace caffe {
+
+
+class CPUResources
+{
+public:
+
+    enum Role
+    {
+        // Main computation - BLAS, solver threads
+        COMPUTE = 0,
+        // Workers of the data layers
+        DATA    = 1,
+        // Workers of the loss layers
+        LOSS    = 2
+    };
+
+    enum Pinning
+    {
+        // Threads are only sized, the scheduler places them
+        PIN_NONE = 0,
+        // Each thread is pinned to one core of its role
+        PIN_CORE = 1,
+        // Each thread is pinned to the cores of its role on one NUMA node
+        PIN_NUMA = 2
+    };
+
+
+    /**
+     * @brief The process wide instance, the layout is detected and reported on the first call
+     */
+    static CPUResources& Get ();
+
+
+    /**
+     * @brief Changes the split of the cores, the BLAS thread count follows the compute cores
+     * @param shares Shares of the compute, data and loss cores "compute:data:loss" (empty - keep current)
+     * @param pinning One of "none", "core", "numa" (empty - keep current)
+     */
+    void configure (const std::string &shares, const std::string &pinning);
+
+    /**
+     * @brief Returns to the default shares (2:2:1, BLAS keeps its own thread count) without pinning
+     */
+    void reset ();
+
+    /**
+     * @brief Number of cores the process may use (affinity mask limited by the cgroup CPU quota)
+     */
+    int numCores () const;
+
+    /**
+     * @brief Number of threads for a pool of the given role
+     * @param max_threads Upper bound on the number of threads (<= 0 - no bound)
+     */
+    int numThreads (Role role, int max_threads=0) const;
+
+    /**
+     * @brief Pins the calling thread according to the pinning setting (does nothing with PIN_NONE)
+     * @param t Index of the thread in its pool, the threads are spread over the cores of the role. With -1
+     *          the thread is pinned to all cores of the role (threads it creates inherit this, e.g. BLAS)
+     */
+    void pinThread (Role role, int t=-1) const;
+
+    /**
+     * @brief Pins the calling thread to the last num_cores cores of the role regardless of the pinning setting
+     *
+     * Used to keep a helper thread (e.g. the asynchronous test of the solver) off the other threads of the
+     * role, which are spread from the first core.
+     * @param num_cores Number of cores (<= 0 - does nothing), at most all cores of the role are used
+     */
+    void pinThreadToTail (Role role, int num_cores) const;
+
+    /**
+     * @brief Human readable description of the cores and their split
+     */
+    std::string layout () const;
+
+
+private:
+
+    CPUResources ();
+
+    /**
+     * @brief Splits _cpus between the roles according to _shares and sets the number of BLAS threads (the
+     * compute cores with explicit shares, the own count of BLAS with the defaults)
+     */
+    void _split ();
+
+    /**
+     * @brief Parses the "compute:data:loss" shares
+     */
+    static std::vector<double> _parseShares (const std::string &shares);
+
+    static Pinning _parsePinning (const std::string &pinning);
+
+    std::string _describe () const;
+
+
+    // ---------------------------------------  PRIVATE MEMBERS  --------------------------------------- //
+    // CPUs the process may run on (affinity mask), grouped by NUMA nodes
+    std::vector<int> _cpus;
+    // NUMA node of each of the _cpus
+    std::vector<int> _nodes;
+    // Number of CPUs given by the cgroup quota, <= 0 if there is no quota
+    double _quota;
+    // Number of usable cores - the first _num_cores of _cpus are used
+    int _num_cores;
+
+    std::vector<double> _shares;
+    // The shares were given by CAFFE_CPU_SHARES or configure(), not the defaults
+    bool _explicit_shares;
+    // Own thread count of BLAS (<= 0 if unknown), used with the default shares
+    int _blas_threads;
+    Pinning _pinning;
+    // Indices to _cpus of the cores of each role
+    std::vector<std::vector<int>> _role_cpus;
+
+    mutable std::mutex _mtx;
+
+
+    DISABLE_COPY_AND_ASSIGN(CPUResources);
+};
+
+
+}  // namespace caffe
+
+
+#endif  // CAFFE_UTIL_CPU_RESOURCES_HPP_
@@ -0,0 +1,238 @@
+//
+// Extraction of bounding boxes from the output of BBTXT and BB3TXT networks and their non-maxima suppression.
+// Does not depend on OpenCV so it can be used in pycaffe and in deployment code, only the loading of the image
+// pyramid levels is built with USE_OPENCV
+//
+
+#ifndef CAFFE_UTIL_DETECTION_HPP_
+#define CAFFE_UTIL_DETECTION_HPP_
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#endif
+
+#include "caffe/blob.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+
+namespace caffe {
+
+
+/**
+ * @brief 2D bounding box detected by a BBTXT network (one line of a BBTXT file without the image path)
+ */
+struct Detection2D
+{
+    Detection2D () {}
+    Detection2D (int label, float conf, float xmin, float ymin, float xmax, float ymax)
+        : label(label),
+          conf(conf),
+          xmin(xmin),
+          ymin(ymin),
+          xmax(xmax),
+          ymax(ymax)
+    {
+    }
+
+
+    float area () const
+    {
+        return (this->xmax - this->xmin) * (this->ymax - this->ymin);
+    }
+
+
+    int label;
+    float conf;
+    float xmin;
+    float ymin;
+    float xmax;
+    float ymax;
+};
+
+
+/**
+ * @brief Raw 3D bounding box detected by a BB3TXT network - the image coordinates of the 3 bottom corners and
+ * the y coordinate of the front top left corner, from which the box is reconstructed in 3D
+ */
+struct Detection3D
+{
+    Detection3D () {}
+    Detection3D (int label, float conf, float fblx, float fbly, float fbrx, float fbry, float rblx, float rbly,
+                 float ftly)
+        : label(label),
+          conf(conf),
+          fblx(fblx),
+          fbly(fbly),
+          fbrx(fbrx),
+          fbry(fbry),
+          rblx(rblx),
+          rbly(rbly),
+          ftly(ftly)
+    {
+    }
+
+
+    int label;
+    float conf;
+    float fblx;
+    float fbly;
+    float fbrx;
+    float fbry;
+    float rblx;
+    float rbly;
+    float ftly;
+};
+
+
+/**
+ * @brief Intersection over union of two bounding boxes
+ */
+float iou2d (const Detection2D &a, const Detection2D &b);
+
+
+/**
+ * @brief Checks whether the pixel (i, j) of the probability channel is a local maximum in its 3x3 neighborhood
+ * @param acc_prob Probability channel of the accumulator (height x width)
+ */
+template <typename Dtype>
+inline bool isLocalMaximum (const Dtype *acc_prob, int height, int width, int i, int j)
+{
+    const Dtype conf = acc_prob[i*width + j];
+    for (int k = std::max(0, i-1); k <= std::min(height-1, i+1); ++k)
+    {
+        for (int l = std::max(0, j-1); l <= std::min(width-1, j+1); ++l)
+        {
+            if (acc_prob[k*width + l] > conf) return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * @brief Extracts bounding boxes from the accumulator output of a BBTXT network
+ *
+ * Only local maxima of the probability channel (3x3 neighborhood) with confidence at least min_conf are
+ * extracted. The channels of the output are: prob, xmin, ymin, xmax, ymax (other channels are ignored).
+ *
+ * @param output Output blob of the network (N x C x H x W), C >= 5
+ * @param b Index of the image in the batch
+ * @param scale Scale of the image in the pyramid (coordinates are divided by it)
+ * @param min_conf Minimum confidence of an extracted bounding box
+ * @param label Label assigned to the extracted bounding boxes
+ * @return Extracted bounding boxes
+ */
+template <typename Dtype>
+std::vector<Detection2D> extractBBTXTDetections (const Blob<Dtype> &output, int b, double scale,
+                                                 double min_conf, int label=1);
+
+
+/**
+ * @brief Extracts raw 3D bounding boxes from the accumulator output of a BB3TXT network
+ *
+ * Same as extractBBTXTDetections(), the channels of the output are: prob, fblx, fbly, fbrx, fbry, rblx,
+ * rbly, ftly.
+ *
+ * @param output Output blob of the network (N x C x H x W), C >= 8
+ */
+template <typename Dtype>
+std::vector<Detection3D> extractBB3TXTDetections (const Blob<Dtype> &output, int b, double scale,
+                                                  double min_conf, int label=1);
+
+
+/**
+ * @brief Greedy non-maxima suppression of bounding boxes of any type
+ *
+ * Bounding boxes are processed from the highest confidence, a box is thrown away if it has intersection over
+ * union higher than iou_threshold with an already kept box of the same label.
+ *
+ * @param bbs Bounding boxes with conf and label members (will be sorted by confidence)
+ * @param iou_threshold Maximum intersection over union of two kept boxes
+ * @param iou Intersection over union of two boxes, e.g. iou2d()
+ * @return Kept bounding boxes sorted by confidence
+ */
+template <typename BB, typename IoU>
+std::vector<BB> greedyNonMaximaSuppression (std::vector<BB> &bbs, double iou_threshold, IoU iou)
+{
+    // Sort by confidence in the descending order
+    std::stable_sort(bbs.begin(), bbs.end(), [] (const BB &a, const BB &b) { return a.conf > b.conf; });
+
+    std::vector<BB> bbs_out;
+    std::vector<bool> active(bbs.size(), true);
+
+    for (int i = 0; i < bbs.size(); ++i)
+    {
+        if (!active[i]) continue;
+
+        bbs_out.push_back(bbs[i]);
+
+        // Suppress all remaining bounding boxes of the same category overlapping with this one
+        for (int j = i+1; j < bbs.size(); ++j)
+        {
+            if (active[j] && bbs[j].label == bbs[i].label && iou(bbs[i], bbs[j]) > iou_threshold)
+            {
+                active[j] = false;
+            }
+        }
+    }
+
+    return bbs_out;
+}
+
+
+/**
+ * @brief Standard greedy non-maxima suppression
+ *
+ * Bounding boxes are processed from the highest confidence, a box is thrown away if it has intersection over
+ * union higher than iou_threshold with an already kept box of the same label.
+ *
+ * @param detections Bounding boxes (will be sorted by confidence)
+ * @param iou_threshold Maximum intersection over union of two kept boxes
+ * @return Kept bounding boxes sorted by confidence
+ */
+std::vector<Detection2D> nonMaximaSuppression (std::vector<Detection2D> &detections, double iou_threshold);
+
+
+/**
+ * @brief Checks whether the convolution is a 1x1 convolution with stride 1 and no padding or groups
+ */
+bool isPointwiseConvolution (const ConvolutionParameter &param);
+
+
+/**
+ * @brief Switches the network to the sparse evaluation of the accumulators
+ *
+ * The 1x1 convolutions, whose output is fed into a BBTXTBB or BB3TXTBB layer, are replaced by
+ * SparseAccumulator layers, which compute the coordinates only in the local maxima of the probability. The
+ * layer names and weight shapes stay the same, the trained weights can be loaded as usual.
+ *
+ * @param param Network definition (modified in place)
+ * @param min_conf Minimum probability of a local maximum, must not be higher than the extraction threshold
+ * @return Number of replaced layers
+ */
+int enableSparseAccumulators (NetParameter &param, float min_conf);
+
+
+#ifdef USE_OPENCV
+/**
+ * @brief Returns the image at the given scale of the pyramid, converted to zero mean and unit variance
+ *
+ * The image is decoded at the lowest reduced resolution (1/1, 1/2, 1/4 or 1/8), which is not below the scale,
+ * and then resized to the scale. JPEGs are decoded directly at the reduced resolution if Caffe is built with
+ * USE_LIBJPEG. Decoded images are kept in decoded (indexed by the reduction factor) for the other scales.
+ *
+ * @param original_size Output, size of the full resolution image (set when the image is decoded)
+ */
+cv::Mat pyramidLevel (const std::string &path_image, double scale, std::map<int, cv::Mat> &decoded,
+                      cv::Size &original_size);
+#endif
+
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_DETECTION_HPP_
@@ -0,0 +1,87 @@
+//
+// Persistent cache of raw detection candidates (local maxima of the network output before NMS and filtering)
+// for repeated evaluation runs of the pyramid test tools
+//
+
+#ifndef CAFFE_UTIL_DETECTION_CACHE_HPP_
+#define CAFFE_UTIL_DETECTION_CACHE_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+
+namespace caffe {
+
+
+/**
+ * @brief Content addressed store of detection candidates on the disk
+ *
+ * Each entry is identified by the hash of the image file content, the hash of the network (prototxt and
+ * caffemodel content) and the scale of the pyramid, i.e. by everything, which determines the output of the
+ * forward pass. An entry is a list of candidates, each consisting of record_size floats (e.g. confidence and
+ * coordinates). A run with changed post-processing parameters (NMS, filtering) then only repeats the cheap
+ * stages, while a changed model or image automatically misses the cache.
+ *
+ * Entries are written atomically (into a temporary file, which is then renamed), so multiple processes can
+ * share the cache directory.
+ */
+class DetectionCache
+{
+public:
+
+    /**
+     * @param path_dir Directory with the cache entries, created if it does not exist
+     * @param path_prototxt Model file of the network
+     * @param path_caffemodel Weight file of the network
+     */
+    DetectionCache (const std::string &path_dir, const std::string &path_prototxt,
+                    const std::string &path_caffemodel);
+
+
+    /**
+     * @brief 64-bit FNV-1a hash of the content of a file
+     */
+    static uint64_t hashFile (const std::string &path);
+
+    /**
+     * @brief Key of the entry of the given image (see hashFile()) and pyramid scale
+     */
+    std::string key (uint64_t image_hash, double scale) const;
+
+    /**
+     * @brief Loads the candidates stored under the given key
+     * @param key Entry key (see key())
+     * @param record_size Number of floats of one candidate
+     * @param candidates Output, record_size floats per candidate
+     * @return false if the entry is not in the cache
+     */
+    bool load (const std::string &key, int record_size, std::vector<float> &candidates) const;
+
+    /**
+     * @brief Stores the candidates under the given key
+     */
+    void store (const std::string &key, int record_size, const std::vector<float> &candidates) const;
+
+
+private:
+
+    std::string _path (const std::string &key) const;
+
+
+    // ---------------------------------------  PRIVATE MEMBERS  --------------------------------------- //
+    std::string _path_dir;
+    // Hash of the prototxt and caffemodel files
+    uint64_t _net_hash;
+
+
+    DISABLE_COPY_AND_ASSIGN(DetectionCache);
+};
+
+
+}  // namespace caffe
+
+
+#endif  // CAFFE_UTIL_DETECTION_CACHE_HPP_
@@ -0,0 +1,151 @@
+//
+// Asynchronous read-ahead of whole files into memory, used by the data layers to read the images, which will
+// be needed next, while the current ones are being decoded and transformed
+//
+
+#ifndef CAFFE_UTIL_FILE_PREFETCHER_HPP_
+#define CAFFE_UTIL_FILE_PREFETCHER_HPP_
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+
+namespace caffe {
+
+
+/**
+ * @brief Reads files asynchronously into memory buffers, the reads are identified by user given keys
+ *
+ * The reads are submitted through io_uring (build with USE_LIBURING) - the open, size query and read of each
+ * file are all asynchronous, so any number of reads can be in flight at once. Without io_uring support (or if
+ * the kernel refuses to create the ring) the files are read with blocking calls by a pool of threads.
+ *
+ * Each prefetched file must be either taken or discarded, all methods may be called concurrently from
+ * multiple threads.
+ */
+class FilePrefetcher
+{
+public:
+
+    /**
+     * @brief Counters of the prefetched reads
+     */
+    struct Stats
+    {
+        Stats () : hits(0), waits(0), misses(0) {}
+
+        // Reads, which were finished when they were taken
+        long hits;
+        // Reads, which were still in flight when they were taken
+        long waits;
+        // Takes of files, which were not prefetched or whose read failed
+        long misses;
+
+        /**
+         * @brief Fraction of takes served from the prefetched buffers without waiting
+         */
+        double coverage () const
+        {
+            const long total = this->hits + this->waits + this->misses;
+            return (total > 0) ? double(this->hits) / total : 0.0;
+        }
+    };
+
+
+    /**
+     * @param num_threads Number of threads of the blocking reader (only used when io_uring is not available)
+     * @param queue_depth Maximum number of io_uring requests in flight
+     * @param use_io_uring Whether to try io_uring at all
+     */
+    FilePrefetcher (int num_threads, int queue_depth, bool use_io_uring=true);
+    ~FilePrefetcher ();
+
+
+    /**
+     * @brief Starts reading the file, the read is identified by the key (keys must be unique among the reads,
+     * which were not taken or discarded yet)
+     */
+    void prefetch (long key, const std::string &filename);
+
+    /**
+     * @brief Moves the content of the prefetched file into the buffer, blocks until the read finishes
+     * @return false if the file was not prefetched or its read failed - the caller has to read it itself
+     */
+    bool take (long key, std::vector<unsigned char> &buffer);
+
+    /**
+     * @brief Throws away the prefetched file (unknown keys are ignored)
+     */
+    void discard (long key);
+
+    /**
+     * @brief Whether the reads are submitted through io_uring
+     */
+    bool usesIOUring () const;
+
+    Stats stats () const;
+
+
+private:
+
+    struct Read;
+
+    void _threadEntry ();
+
+    /**
+     * @brief Submits the queued reads to the ring and advances the finished requests (io_uring only)
+     */
+    void _ringEntry ();
+
+    /**
+     * @brief Marks the read as finished and wakes the waiting take()
+     */
+    void _finish (const std::shared_ptr<Read> &read, bool ok);
+
+    /**
+     * @brief Reads the whole file with blocking calls
+     */
+    static bool _readFile (const std::string &filename, std::vector<unsigned char> &buffer);
+
+
+    // ---------------------------------------  PRIVATE MEMBERS  --------------------------------------- //
+    // Reads, which were not taken yet
+    std::unordered_map<long, std::shared_ptr<Read>> _reads;
+    // Reads, which were not started yet
+    std::deque<std::shared_ptr<Read>> _queue;
+    mutable std::mutex _mtx;
+    // Signals new reads in the queue
+    std::condition_variable _cv_queue;
+    // Signals finished reads
+    std::condition_variable _cv_done;
+    bool _stop;
+
+    std::vector<std::thread> _threads;
+    int _queue_depth;
+    // Opaque io_uring ring, null if the blocking reader is used
+    struct Ring;
+    std::unique_ptr<Ring> _ring;
+
+    Stats _stats;
+
+
+    DISABLE_COPY_AND_ASSIGN(FilePrefetcher);
+};
+
+
+std::ostream& operator<< (std::ostream &os, const FilePrefetcher::Stats &stats);
+
+
+}  // namespace caffe
+
+
+#endif  // CAFFE_UTIL_FILE_PREFETCHER_HPP_
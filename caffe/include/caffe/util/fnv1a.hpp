@@ -0,0 +1,38 @@
+//
+// 64-bit FNV-1a hash. It is not cryptographic, but it is fast and stable across platforms and runs, so it is
+// used to identify files and lists in the caches and manifests written to disk.
+//
+
+#ifndef CAFFE_UTIL_FNV1A_HPP_
+#define CAFFE_UTIL_FNV1A_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace caffe {
+
+
+const uint64_t FNV1A_OFFSET = 14695981039346656037ULL;
+const uint64_t FNV1A_PRIME  = 1099511628211ULL;
+
+
+/**
+ * @brief Continues the hash with the given bytes
+ * @param hash Hash of the previous data, FNV1A_OFFSET at the start
+ * @return Hash of the previous data followed by the given bytes
+ */
+inline uint64_t fnv1a (uint64_t hash, const char *data, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= uint8_t(data[i]);
+        hash *= FNV1A_PRIME;
+    }
+    return hash;
+}
+
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_FNV1A_HPP_
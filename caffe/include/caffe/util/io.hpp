@@ -141,6 +141,21 @@ cv::Mat ReadImageToCVMat(const string& filename,
 
 cv::Mat ReadImageToCVMat(const string& filename);
 
+// Largest factor n from {1, 2, 4, 8}, such that 1/n >= scale, i.e. the lowest
+// reduced decode resolution from which an image at the given scale can be
+// resized without upsampling.
+int ReducedDecodeFactor(const double scale);
+
+// Reads an image decoded at 1/factor of its resolution (factor 1, 2, 4 or 8).
+// When built with USE_LIBJPEG, JPEG files are decoded directly at the reduced
+// resolution with the libjpeg DCT scaling, which is much faster than decoding
+// the full image. Other files are decoded at the full resolution and reduced
+// by cv::resize. The size of the reduced image is ceil(original size/factor),
+// original_height and original_width (if not NULL) are set to the size of the
+// full image.
+cv::Mat ReadImageToCVMatReduced(const string& filename, const int factor,
+    const bool is_color, int* original_height, int* original_width);
+
 cv::Mat DecodeDatumToCVMatNative(const Datum& datum);
 cv::Mat DecodeDatumToCVMat(const Datum& datum, bool is_color);
 
@@ -0,0 +1,123 @@
+//
+// Lock-free replacements of BlockingQueue and BlockingCounter for the hot paths of the data and loss layers,
+// where the worker threads hand over work items and report finished ones for every image of a batch. Waiting
+// threads spin shortly before they park, so the threads of a busy pool rarely sleep.
+//
+
+#ifndef CAFFE_UTIL_LOCKFREE_QUEUE_HPP_
+#define CAFFE_UTIL_LOCKFREE_QUEUE_HPP_
+
+#include <string>
+
+#include "caffe/common.hpp"
+
+
+namespace caffe {
+
+
+/**
+ * @brief Bounded multi-producer multi-consumer queue with the same interface as BlockingQueue
+ *
+ * The queue is a lock-free ring buffer (each cell carries a sequence number, producers and consumers only
+ * claim positions with a CAS). A thread, which has to wait (empty queue on pop, full queue on push), first
+ * spins for a short while and only then parks on a condition variable. Parking is an interruption point,
+ * i.e. a thread waiting in pop() or push() can be stopped with boost::thread::interrupt() the same way as
+ * with BlockingQueue.
+ */
+template <typename T>
+class LockFreeQueue {
+public:
+
+    /**
+     * @param capacity Maximum number of elements in the queue (rounded up to a power of 2)
+     */
+    explicit LockFreeQueue (size_t capacity = 1024);
+
+
+    /**
+     * @brief Inserts an element, waits if the queue is full
+     */
+    void push (const T &t);
+
+    /**
+     * @brief Inserts an element if the queue is not full
+     * @return true if the element was inserted
+     */
+    bool try_push (const T &t);
+
+    /**
+     * @brief Removes an element if the queue is not empty
+     * @return true if an element was removed
+     */
+    bool try_pop (T *t);
+
+    /**
+     * @brief Removes an element, waits if the queue is empty
+     * @param log_on_wait Message logged if the thread needs to be parked (e.g. data feeding is too slow)
+     */
+    T pop (const std::string &log_on_wait = "");
+
+    /**
+     * @brief Approximate number of elements in the queue
+     */
+    size_t size () const;
+
+    size_t capacity () const;
+
+
+protected:
+
+    /**
+     Move the ring buffer and synchronization fields out instead of including boost/thread.hpp and <atomic>
+     to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+     */
+    class state;
+
+    std::shared_ptr<state> _state;
+
+
+    DISABLE_COPY_AND_ASSIGN(LockFreeQueue);
+};
+
+
+/**
+ * @brief Atomic counter with the same interface as BlockingCounter. Works as a countdown latch - worker threads
+ * increase the counter and the owner waits until it reaches the number of submitted jobs.
+ *
+ * Increasing the counter is a single atomic instruction, the condition variable is only touched if some thread
+ * is parked in waitToCount(). Waiting spins first and then parks (interruption point).
+ */
+class LockFreeCounter {
+public:
+
+    explicit LockFreeCounter ();
+
+
+    void reset ();
+
+    void increase ();
+    void decrease ();
+
+    int getCount ();
+
+    /**
+     * @brief Blocks execution of the thread that called it until the counter counts to the given number
+     * @param count
+     */
+    void waitToCount (int count);
+
+
+protected:
+
+    class state;
+
+    std::shared_ptr<state> _state;
+
+
+    DISABLE_COPY_AND_ASSIGN(LockFreeCounter);
+};
+
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_LOCKFREE_QUEUE_HPP_
@@ -9,6 +9,7 @@
 #include "caffe/common.hpp"
 #include "caffe/util/device_alternate.hpp"
 #include "caffe/util/mkl_alternate.hpp"
+#include "caffe/util/philox.hpp"
 
 namespace caffe {
 
@@ -85,6 +86,27 @@ void caffe_rng_bernoulli(const int n, const Dtype p, int* r);
 template <typename Dtype>
 void caffe_rng_bernoulli(const int n, const Dtype p, unsigned int* r);
 
+// The caffe_rng_* functions above draw a fresh Philox4x32 stream from the
+// thread's caffe_rng(), so they stay reproducible under
+// Caffe::set_random_seed. The overloads below fill r from an explicit stream
+// without touching caffe_rng(), the same (seed, stream) always gives the same
+// numbers, e.g. Philox4x32(seed, Philox4x32::StreamId(layer, iteration)).
+template <typename Dtype>
+void caffe_rng_uniform(const int n, const Dtype a, const Dtype b, Dtype* r,
+                       const Philox4x32& stream);
+
+template <typename Dtype>
+void caffe_rng_gaussian(const int n, const Dtype mu, const Dtype sigma,
+                        Dtype* r, const Philox4x32& stream);
+
+template <typename Dtype>
+void caffe_rng_bernoulli(const int n, const Dtype p, int* r,
+                         const Philox4x32& stream);
+
+template <typename Dtype>
+void caffe_rng_bernoulli(const int n, const Dtype p, unsigned int* r,
+                         const Philox4x32& stream);
+
 template <typename Dtype>
 void caffe_exp(const int n, const Dtype* a, Dtype* y);
 
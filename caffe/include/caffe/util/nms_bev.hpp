@@ -0,0 +1,59 @@
+//
+// Non-maxima suppression of 3D bounding boxes in the bird's eye view, i.e. on their rectangles in the ground
+// plane. Unlike the 2D NMS in the image it does not merge distinct objects, which occlude each other.
+//
+
+#ifndef NMS_BEV_H
+#define NMS_BEV_H
+
+#include <vector>
+
+
+/**
+ * @brief Rectangle of a 3D bounding box in the ground plane (2D coordinates within the plane)
+ * The corners are ordered FBL FBR RBR RBL, the rectangle may be arbitrarily rotated
+ */
+struct GroundRect
+{
+    GroundRect () {}
+    GroundRect (const double *x, const double *y)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            this->x[i] = x[i];
+            this->y[i] = y[i];
+        }
+    }
+
+
+    double area () const;
+
+
+    double x[4];
+    double y[4];
+};
+
+
+/**
+ * @brief Exact intersection over union of two rotated ground plane rectangles
+ */
+double iouBEV (const GroundRect &r1, const GroundRect &r2);
+
+
+/**
+ * @brief Greedy non-maxima suppression of ground plane rectangles
+ *
+ * Rectangles are processed from the highest confidence, a rectangle is thrown away if it has intersection
+ * over union higher than iou_threshold with an already kept one. The rectangles are put into a spatial hash
+ * grid over the ground plane, so each rectangle is only compared with the ones in the neighboring cells.
+ *
+ * @param rects Ground plane rectangles
+ * @param conf Confidences of the rectangles
+ * @param iou_threshold Maximum intersection over union of two kept rectangles
+ * @return Indices of the kept rectangles sorted by confidence
+ */
+std::vector<int> nonMaximaSuppressionBEV (const std::vector<GroundRect> &rects, const std::vector<double> &conf,
+                                          double iou_threshold);
+
+
+#endif // NMS_BEV_H
@@ -12,6 +12,7 @@
 #include <map>
 #include "utils3d.hpp"
 #include "utils_bb.hpp"
+#include "nms_bev.hpp"
 
 
 /**
@@ -56,6 +57,22 @@ public:
      */
     cv::Mat reconstructAndFixBB3D (BB3D &bb3d) const;
 
+    /**
+     * @brief Reconstructs the detection in 3D, checks its validity and sets its 2D bounding box
+     * @param bb3d Detected 3D bounding box (7 parameters), fixed in place
+     * @param size_filter Whether to throw away boxes with an unreasonable size of the bottom rectangle
+     * @param rect Output, if not null, ground plane rectangle of the reconstructed box (see groundRect())
+     * @return False if the reconstructed box is not in front of the camera or has an unreasonable size
+     */
+    bool reconstructDetection (BB3D &bb3d, bool size_filter, GroundRect *rect=nullptr) const;
+
+    /**
+     * @brief Expresses the bottom rectangle of a 3D bounding box in 2D coordinates within the ground plane
+     * @param X_3x8 Corners of the 3D bounding box (output of reconstructAndFixBB3D())
+     * @return Ground plane rectangle (bird's eye view) of the bounding box
+     */
+    GroundRect groundRect (const cv::Mat &X_3x8) const;
+
 
     // -----------------------------------------  PUBLIC MEMBERS  ----------------------------------------- //
     // Image projection matrix P = KR[I|-C]
@@ -70,5 +87,15 @@ public:
 };
 
 
+/**
+ * @brief Reconstructs the raw detections in 3D (see PGP::reconstructDetection()), throws away invalid ones and
+ * computes their 2D bounding boxes
+ * @param candidates Raw detections of one image
+ * @param pgp PGP of the image, with nullptr the candidates are returned unchanged
+ * @param size_filter Whether to throw away boxes with an unreasonable size of the bottom rectangle
+ */
+std::vector<BB3D> reconstructDetections (const std::vector<BB3D> &candidates, const PGP *pgp, bool size_filter);
+
+
 #endif // PGP_H
 
@@ -0,0 +1,49 @@
+#ifndef CAFFE_UTIL_PHILOX_HPP_
+#define CAFFE_UTIL_PHILOX_HPP_
+
+#include <stdint.h>
+
+namespace caffe {
+
+/**
+ * @brief Philox4x32-10 counter based random number generator (Salmon et al.,
+ *        "Parallel Random Numbers: As Easy as 1, 2, 3", SC 2011).
+ *
+ * A stream is identified by a 64 bit seed and a 64 bit stream id. Its i-th
+ * block of four 32 bit words is a pure function of (seed, stream, i), so any
+ * range of a stream can be generated independently, by any thread and in any
+ * order. Streams keyed by e.g. (seed, layer, iteration) are therefore
+ * reproducible no matter how the work is split.
+ */
+class Philox4x32 {
+ public:
+  /// Number of 32 bit words produced by one counter value.
+  static const int kBlockWords = 4;
+
+  Philox4x32(uint64_t seed, uint64_t stream)
+      : key0_(static_cast<uint32_t>(seed)),
+        key1_(static_cast<uint32_t>(seed >> 32)),
+        stream0_(static_cast<uint32_t>(stream)),
+        stream1_(static_cast<uint32_t>(stream >> 32)) {}
+
+  /// Stream id for per layer and per iteration random numbers.
+  static uint64_t StreamId(uint32_t layer, uint32_t iteration) {
+    return (static_cast<uint64_t>(layer) << 32) | iteration;
+  }
+
+  /**
+   * @brief Writes the blocks [first_block, first_block + num_blocks) of the
+   *        stream to r, which must hold num_blocks * kBlockWords words.
+   */
+  void Generate(uint64_t first_block, int num_blocks, uint32_t* r) const;
+
+ private:
+  uint32_t key0_;
+  uint32_t key1_;
+  uint32_t stream0_;
+  uint32_t stream1_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_PHILOX_HPP_
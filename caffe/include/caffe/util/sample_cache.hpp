@@ -0,0 +1,91 @@
+//
+// Cache of ready-to-use samples (data + label) for data layers with deterministic output, e.g. BBTXT data
+// layers in the TEST phase, which produce exactly the same crops in every test pass
+//
+
+#ifndef CAFFE_UTIL_SAMPLE_CACHE_HPP_
+#define CAFFE_UTIL_SAMPLE_CACHE_HPP_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+
+namespace caffe {
+
+
+/**
+ * @brief Fixed size store of samples, each consisting of data_count data values and label_count label values
+ *
+ * The samples are materialized on the first pass through the dataset (store()) and later passes only copy
+ * them out (load()). The storage is either in RAM or in a memory mapped file, which lets the OS page the
+ * cache out when the dataset does not fit into memory. The file is only a backing store - a new unique file
+ * is created next to the given path for each cache and unlinked right after it is mapped.
+ *
+ * store() and load() may be called concurrently from multiple threads.
+ */
+template <typename Dtype>
+class SampleCache
+{
+public:
+
+    /**
+     * @param num_samples Number of samples in the dataset
+     * @param data_count Number of data values of one sample
+     * @param label_count Number of label values of one sample
+     * @param filename Prefix of the memory mapped backing file (a unique suffix is added), if empty the cache
+     *                 is kept in RAM
+     */
+    SampleCache (int num_samples, int data_count, int label_count, const std::string &filename="");
+    ~SampleCache ();
+
+
+    /**
+     * @brief Copies sample i out of the cache
+     * @return false if the sample has not been cached yet
+     */
+    bool load (int i, Dtype *data, Dtype *label) const;
+
+    /**
+     * @brief Stores sample i in the cache, only the first store of each sample is kept
+     */
+    void store (int i, const Dtype *data, const Dtype *label);
+
+    /**
+     * @brief Number of already cached samples
+     */
+    int numCached () const;
+
+    int numSamples () const;
+
+
+private:
+
+    Dtype* _sample (int i) const;
+
+
+    // ---------------------------------------  PRIVATE MEMBERS  --------------------------------------- //
+    int _num_samples;
+    int _data_count;
+    int _label_count;
+    // State of each sample: empty, being stored, cached
+    std::unique_ptr<std::atomic<int>[]> _state;
+    std::atomic<int> _num_cached;
+
+    // Storage of the samples, either _ram or a memory mapped file
+    Dtype *_data;
+    std::vector<Dtype> _ram;
+    size_t _mapped_size;
+
+
+    DISABLE_COPY_AND_ASSIGN(SampleCache);
+};
+
+
+}  // namespace caffe
+
+
+#endif  // CAFFE_UTIL_SAMPLE_CACHE_HPP_
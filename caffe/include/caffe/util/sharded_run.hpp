@@ -0,0 +1,148 @@
+//
+// Resumable processing of a long list of items (e.g. images to be detected) by several worker processes
+//
+
+#ifndef CAFFE_UTIL_SHARDED_RUN_HPP_
+#define CAFFE_UTIL_SHARDED_RUN_HPP_
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+
+namespace caffe {
+
+
+/**
+ * @brief Work queue of chunks of an item list, shared by processes through a directory
+ *
+ * The list of num_items items is split into chunks of chunk_size consecutive items. Worker processes claim
+ * the chunks atomically (the next chunk index is stored in a locked queue file) and write the outputs of
+ * each chunk with a ChunkWriter. Chunks, which were finished in a previous (crashed) run are skipped, an
+ * unfinished chunk is resumed from its last checkpoint. merge() concatenates the outputs of all chunks in
+ * the original order of the list.
+ *
+ * The directory contains a manifest with the number of items, the chunk size, the number of outputs and a
+ * hash of the item list. A run can only be resumed with the same list and settings, otherwise the chunk
+ * boundaries would not match the finished chunks.
+ */
+class ShardedRun
+{
+public:
+
+    /**
+     * @param path_dir Directory with the queue and the chunk outputs, created if it does not exist
+     * @param items List of the items (e.g. image paths), only its size and hash are stored
+     * @param chunk_size Number of items in one chunk
+     * @param num_outputs Number of output files produced by each chunk
+     */
+    ShardedRun (const std::string &path_dir, const std::vector<std::string> &items, int chunk_size,
+                int num_outputs);
+
+
+    /**
+     * @brief Starts the queue from the beginning, must be called before the workers are started
+     */
+    void resetQueue () const;
+
+    /**
+     * @brief Atomically claims the next unfinished chunk
+     * @param chunk Output, index of the claimed chunk
+     * @return false if there are no chunks left
+     */
+    bool claim (int &chunk) const;
+
+    /**
+     * @brief Checks if the given chunk was finished (in this or a previous run)
+     */
+    bool isFinished (int chunk) const;
+
+    /**
+     * @brief Concatenates the outputs of all chunks into paths_out (one file per output)
+     * @return false if some chunk is not finished yet
+     */
+    bool merge (const std::vector<std::string> &paths_out) const;
+
+    int numChunks () const;
+    int chunkBegin (int chunk) const;
+    int chunkEnd (int chunk) const;
+    int numOutputs () const;
+
+    /**
+     * @brief Path of a file of the given chunk, e.g. extension ".out0" for its first output
+     */
+    std::string chunkPath (int chunk, const std::string &extension) const;
+
+
+private:
+
+    /**
+     * @brief Writes the manifest of a new run or checks that it matches the manifest of the previous run
+     */
+    void _checkManifest (uint64_t items_hash) const;
+
+
+    // ---------------------------------------  PRIVATE MEMBERS  --------------------------------------- //
+    std::string _path_dir;
+    int _num_items;
+    int _chunk_size;
+    int _num_outputs;
+
+
+    DISABLE_COPY_AND_ASSIGN(ShardedRun);
+};
+
+
+/**
+ * @brief Writes the outputs of one claimed chunk with checkpoints after each item
+ *
+ * A checkpoint records the number of processed items and the sizes of the output files. When a chunk is
+ * opened again after a crash, the outputs are truncated to the last checkpoint and processing continues with
+ * the first unprocessed item.
+ */
+class ChunkWriter
+{
+public:
+
+    ChunkWriter (const ShardedRun &run, int chunk);
+
+
+    /**
+     * @brief Index of the first item (in the whole list), which has not been processed yet
+     */
+    int nextItem () const;
+
+    std::ofstream& output (int i);
+
+    /**
+     * @brief Marks the next item as processed, flushes the outputs and records the checkpoint
+     */
+    void checkpoint ();
+
+    /**
+     * @brief Marks the whole chunk as finished
+     */
+    void finish ();
+
+
+private:
+
+    // ---------------------------------------  PRIVATE MEMBERS  --------------------------------------- //
+    const ShardedRun &_run;
+    int _chunk;
+    int _next_item;
+    std::vector<std::unique_ptr<std::ofstream>> _outputs;
+
+
+    DISABLE_COPY_AND_ASSIGN(ChunkWriter);
+};
+
+
+}  // namespace caffe
+
+
+#endif  // CAFFE_UTIL_SHARDED_RUN_HPP_
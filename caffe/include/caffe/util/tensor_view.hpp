@@ -0,0 +1,175 @@
+//
+// Lightweight typed view of a contiguous tensor (e.g. the CPU data of a Blob) for the hot loops of custom
+// layers. Unlike Blob::offset() it does not check the indices in release builds and unlike calling
+// cpu_data() in a loop it does not touch the SyncedMemory state on each access.
+//
+
+#ifndef CAFFE_UTIL_TENSOR_VIEW_HPP_
+#define CAFFE_UTIL_TENSOR_VIEW_HPP_
+
+#include <cstddef>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+
+
+// Qualifier of raw pointers, which do not alias any other pointer in the loop
+#if defined(__GNUC__) || defined(__clang__)
+#define CAFFE_RESTRICT __restrict__
+#elif defined(_MSC_VER)
+#define CAFFE_RESTRICT __restrict
+#else
+#define CAFFE_RESTRICT
+#endif
+
+
+namespace caffe {
+
+
+/**
+ * @brief View of a row-major tensor with Rank axes
+ *
+ * The view does not own the data. The strides are computed once in the constructor, the indices are only
+ * checked in debug builds (DCHECK). A view of a Blob stays valid until the Blob is reshaped or its data are
+ * accessed on the GPU.
+ *
+ * Usage:
+ *     TensorView<const Dtype, 4> acc = cpuView<4>(*bottom[0]);
+ *     const Dtype *CAFFE_RESTRICT plane = acc.ptr(b, c);  // Raw pointer to the channel c of image b
+ *     Dtype v = acc(b, c, i, j);
+ */
+template <typename T, int Rank>
+class TensorView
+{
+    static_assert(Rank >= 1, "TensorView must have at least one axis");
+
+public:
+
+    TensorView ()
+        : _data(nullptr)
+    {
+        for (int a = 0; a < Rank; ++a)
+        {
+            this->_shape[a]   = 0;
+            this->_strides[a] = 0;
+        }
+    }
+
+    TensorView (T *data, const std::vector<int> &shape)
+        : _data(data)
+    {
+        CHECK_EQ(shape.size(), Rank) << "Shape does not match the rank of the view";
+
+        size_t stride = 1;
+        for (int a = Rank-1; a >= 0; --a)
+        {
+            CHECK_GE(shape[a], 0);
+            this->_shape[a]   = shape[a];
+            this->_strides[a] = stride;
+            stride *= shape[a];
+        }
+    }
+
+
+    /**
+     * @brief Element at the given indices, exactly Rank indices must be given
+     */
+    template <typename... Idx>
+    inline T& operator() (Idx... idx) const
+    {
+        static_assert(sizeof...(Idx) == Rank, "Number of indices must match the rank of the view");
+        return this->_data[_offset<0>(idx...)];
+    }
+
+    /**
+     * @brief Raw pointer to the subtensor given by the leading indices (e.g. ptr(b, c) is the channel c of the
+     * image b in an NCHW tensor)
+     */
+    template <typename... Idx>
+    inline T* ptr (Idx... idx) const
+    {
+        static_assert(sizeof...(Idx) <= Rank, "More indices than the rank of the view");
+        return this->_data + _offset<0>(idx...);
+    }
+
+    /**
+     * @brief View of the subtensor at index i of the first axis
+     */
+    inline TensorView<T, Rank-1> operator[] (int i) const
+    {
+        std::vector<int> shape(this->_shape+1, this->_shape+Rank);
+        return TensorView<T, Rank-1>(this->ptr(i), shape);
+    }
+
+    inline T* data () const { return this->_data; }
+    inline int shape (int axis) const { return this->_shape[axis]; }
+    inline size_t stride (int axis) const { return this->_strides[axis]; }
+    inline size_t count () const { return this->_strides[0] * this->_shape[0]; }
+
+
+private:
+
+    template <int Axis>
+    inline size_t _offset () const
+    {
+        return 0;
+    }
+
+    template <int Axis, typename... Idx>
+    inline size_t _offset (int i, Idx... rest) const
+    {
+        DCHECK_GE(i, 0) << "Index out of range on axis " << Axis;
+        DCHECK_LT(i, this->_shape[Axis]) << "Index out of range on axis " << Axis;
+        return size_t(i) * this->_strides[Axis] + _offset<Axis+1>(rest...);
+    }
+
+
+    // ---------------------------------------  PRIVATE MEMBERS  --------------------------------------- //
+    T *_data;
+    int _shape[Rank];
+    size_t _strides[Rank];
+};
+
+
+/**
+ * @brief Read only view of the CPU data of a blob, the blob must have exactly Rank axes
+ */
+template <int Rank, typename Dtype>
+TensorView<const Dtype, Rank> cpuView (const Blob<Dtype> &blob)
+{
+    return TensorView<const Dtype, Rank>(blob.cpu_data(), blob.shape());
+}
+
+/**
+ * @brief Writable view of the CPU data of a blob, the blob must have exactly Rank axes
+ */
+template <int Rank, typename Dtype>
+TensorView<Dtype, Rank> mutableCpuView (Blob<Dtype> &blob)
+{
+    return TensorView<Dtype, Rank>(blob.mutable_cpu_data(), blob.shape());
+}
+
+/**
+ * @brief Read only view of the CPU diff of a blob, the blob must have exactly Rank axes
+ */
+template <int Rank, typename Dtype>
+TensorView<const Dtype, Rank> cpuDiffView (const Blob<Dtype> &blob)
+{
+    return TensorView<const Dtype, Rank>(blob.cpu_diff(), blob.shape());
+}
+
+/**
+ * @brief Writable view of the CPU diff of a blob, the blob must have exactly Rank axes
+ */
+template <int Rank, typename Dtype>
+TensorView<Dtype, Rank> mutableCpuDiffView (Blob<Dtype> &blob)
+{
+    return TensorView<Dtype, Rank>(blob.mutable_cpu_diff(), blob.shape());
+}
+
+
+}  // namespace caffe
+
+
+#endif  // CAFFE_UTIL_TENSOR_VIEW_HPP_
@@ -19,7 +19,7 @@ namespace geometry {
      * @param P_3x4 Image projection matrix
      * @return 2x1 matrix of coordinates of the projected points in the image
      */
-    cv::Mat projectXtox (const cv::Mat &X_3xn, const cv::Mat P_3x4)
+    inline cv::Mat projectXtox (const cv::Mat &X_3xn, const cv::Mat P_3x4)
     {
         // Create a 4xn matrix from the points
         cv::Mat X_4xn = cv::Mat::ones(4, X_3xn.cols, CV_64FC1);
@@ -41,7 +41,7 @@ namespace geometry {
      * @param p_1x4 Coefficients in the ax+by+cz+d=0 plane equation
      * @return 3x1 coordinates of the point in the 3D world
      */
-    cv::Mat reconstructXInPlane (double u, double v, const cv::Mat &KR_3x3_inv, const cv::Mat &C_3x1, const cv::Mat &p_1x4)
+    inline cv::Mat reconstructXInPlane (double u, double v, const cv::Mat &KR_3x3_inv, const cv::Mat &C_3x1, const cv::Mat &p_1x4)
     {
         // Homogenous coordinates of the point in the image
         cv::Mat x_3x1 = cv::Mat::ones(3, 1, CV_64FC1);
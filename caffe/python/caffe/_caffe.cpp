@@ -10,6 +10,7 @@
 #include <numpy/arrayobject.h>
 
 // these need to be included after boost on OS X
+#include <algorithm>  // NOLINT(build/include_order)
 #include <string>  // NOLINT(build/include_order)
 #include <vector>  // NOLINT(build/include_order)
 #include <fstream>  // NOLINT
@@ -18,6 +19,7 @@
 #include "caffe/layers/memory_data_layer.hpp"
 #include "caffe/layers/python_layer.hpp"
 #include "caffe/sgd_solvers.hpp"
+#include "caffe/util/detection.hpp"
 
 // Temporary solution for numpy < 1.7 versions: old macro, no promises.
 // You're strongly advised to upgrade to >= 1.7.
@@ -66,6 +68,20 @@ void Log(const string& s) {
 
 void set_random_seed(unsigned int seed) { Caffe::set_random_seed(seed); }
 
+// Releases the GIL for its lifetime, so that other Python threads (e.g. other
+// nets) can run while Caffe computes. Calls back into Python (PythonLayer,
+// callbacks) take the GIL again with ScopedGILAcquire.
+class ScopedGILRelease {
+ public:
+  ScopedGILRelease() : state_(PyEval_SaveThread()) {}
+  ~ScopedGILRelease() { PyEval_RestoreThread(state_); }
+
+ private:
+  PyThreadState* state_;
+
+  DISABLE_COPY_AND_ASSIGN(ScopedGILRelease);
+};
+
 // For convenience, check that input files can be opened, and raise an
 // exception that boost will send to Python if not (caffe could still crash
 // later if the input files are disturbed before they are actually used, but
@@ -160,6 +176,104 @@ void Net_LoadHDF5(Net<Dtype>* net, string filename) {
   net->CopyTrainedLayersFromHDF5(filename.c_str());
 }
 
+Dtype Net_ForwardFromTo(Net<Dtype>* net, int start, int end) {
+  ScopedGILRelease gil;
+  return net->ForwardFromTo(start, end);
+}
+
+void Net_BackwardFromTo(Net<Dtype>* net, int start, int end) {
+  ScopedGILRelease gil;
+  net->BackwardFromTo(start, end);
+}
+
+// Binds a C contiguous float32 array as the data of an input blob without
+// copying. The blob takes the shape of the array, the caller has to keep the
+// array alive while it is bound (pycaffe keeps a reference in the Net).
+void Net_BindInput(Net<Dtype>* net, const string& name, bp::object arr_obj) {
+  if (!net->has_blob(name)) {
+    throw std::runtime_error("Net has no blob " + name);
+  }
+  const shared_ptr<Blob<Dtype> > blob = net->blob_by_name(name);
+  const vector<Blob<Dtype>*>& inputs = net->input_blobs();
+  if (std::find(inputs.begin(), inputs.end(), blob.get()) == inputs.end()) {
+    throw std::runtime_error("Only input blobs can be bound, " + name
+        + " is not an input");
+  }
+  if (!PyArray_Check(arr_obj.ptr())) {
+    throw std::runtime_error("Bound input must be a numpy array");
+  }
+  PyArrayObject* arr = reinterpret_cast<PyArrayObject*>(arr_obj.ptr());
+  if (!(PyArray_FLAGS(arr) & NPY_ARRAY_C_CONTIGUOUS)
+      || !(PyArray_FLAGS(arr) & NPY_ARRAY_ALIGNED)) {
+    throw std::runtime_error("Bound input must be C contiguous and aligned");
+  }
+  if (PyArray_TYPE(arr) != NPY_FLOAT32) {
+    throw std::runtime_error("Bound input must be float32");
+  }
+  if (PyArray_SIZE(arr) == 0) {
+    throw std::runtime_error("Bound input must not be empty");
+  }
+  vector<int> shape(PyArray_DIMS(arr), PyArray_DIMS(arr) + PyArray_NDIM(arr));
+  blob->Reshape(shape);
+  blob->set_cpu_data(static_cast<Dtype*>(PyArray_DATA(arr)));
+}
+
+// Converts detections to an N x 6 float32 array, each row is a BBTXT line
+// without the image path: label, confidence, xmin, ymin, xmax, ymax
+bp::object DetectionsToArray(const vector<Detection2D>& detections) {
+  npy_intp dims[2] = { static_cast<npy_intp>(detections.size()), 6 };
+  PyObject* arr_obj = PyArray_SimpleNew(2, dims, NPY_FLOAT32);
+  float* data = static_cast<float*>(
+      PyArray_DATA(reinterpret_cast<PyArrayObject*>(arr_obj)));
+  for (int i = 0; i < detections.size(); ++i) {
+    data[6*i + 0] = detections[i].label;
+    data[6*i + 1] = detections[i].conf;
+    data[6*i + 2] = detections[i].xmin;
+    data[6*i + 3] = detections[i].ymin;
+    data[6*i + 4] = detections[i].xmax;
+    data[6*i + 5] = detections[i].ymax;
+  }
+  return bp::object(bp::handle<>(arr_obj));
+}
+
+bp::object ExtractBBTXTDetections(const Blob<Dtype>& output, int b,
+    double scale, double min_conf, int label) {
+  vector<Detection2D> detections;
+  {
+    ScopedGILRelease gil;
+    detections = extractBBTXTDetections(output, b, scale, min_conf, label);
+  }
+  return DetectionsToArray(detections);
+}
+
+bp::object NonMaximaSuppression(bp::object detections_obj,
+    double iou_threshold) {
+  if (!PyArray_Check(detections_obj.ptr())) {
+    throw std::runtime_error("Detections must be a numpy array");
+  }
+  PyArrayObject* arr = reinterpret_cast<PyArrayObject*>(detections_obj.ptr());
+  if (PyArray_NDIM(arr) != 2 || PyArray_DIMS(arr)[1] != 6) {
+    throw std::runtime_error("Detections must be an N x 6 array");
+  }
+  if (!(PyArray_FLAGS(arr) & NPY_ARRAY_C_CONTIGUOUS)
+      || PyArray_TYPE(arr) != NPY_FLOAT32) {
+    throw std::runtime_error("Detections must be C contiguous float32");
+  }
+  const float* data = static_cast<const float*>(PyArray_DATA(arr));
+  vector<Detection2D> detections;
+  for (int i = 0; i < PyArray_DIMS(arr)[0]; ++i) {
+    detections.push_back(Detection2D(static_cast<int>(data[6*i + 0]),
+        data[6*i + 1], data[6*i + 2], data[6*i + 3], data[6*i + 4],
+        data[6*i + 5]));
+  }
+  vector<Detection2D> detections_out;
+  {
+    ScopedGILRelease gil;
+    detections_out = nonMaximaSuppression(detections, iou_threshold);
+  }
+  return DetectionsToArray(detections_out);
+}
+
 void Net_SetInputArrays(Net<Dtype>* net, bp::object data_obj,
     bp::object labels_obj) {
   // check that this network has an input MemoryDataLayer
@@ -192,6 +306,16 @@ void Net_SetInputArrays(Net<Dtype>* net, bp::object data_obj,
       PyArray_DIMS(data_arr)[0]);
 }
 
+void Solver_Solve(Solver<Dtype>* solver, const char* resume_file = NULL) {
+  ScopedGILRelease gil;
+  solver->Solve(resume_file);
+}
+
+void Solver_Step(Solver<Dtype>* solver, int iters) {
+  ScopedGILRelease gil;
+  solver->Step(iters);
+}
+
 Solver<Dtype>* GetSolverFromFile(const string& filename) {
   SolverParameter param;
   ReadSolverParamsFromTextFileOrDie(filename, &param);
@@ -275,9 +399,11 @@ class SolverCallback: public Solver<Dtype>::Callback {
   SolverCallback(bp::object on_start, bp::object on_gradients_ready)
     : on_start_(on_start), on_gradients_ready_(on_gradients_ready) { }
   virtual void on_gradients_ready() {
+    ScopedGILAcquire gil;
     on_gradients_ready_();
   }
   virtual void on_start() {
+    ScopedGILAcquire gil;
     on_start_();
   }
 };
@@ -305,6 +431,7 @@ class NetCallback: public Net<Dtype>::Callback {
 
  protected:
   virtual void run(int layer) {
+    ScopedGILAcquire gil;
     run_(layer);
   }
   bp::object run_;
@@ -339,7 +466,7 @@ class NCCL {
 };
 #endif
 
-BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(SolveOverloads, Solve, 0, 1);
+BOOST_PYTHON_FUNCTION_OVERLOADS(SolveOverloads, Solver_Solve, 1, 2);
 
 BOOST_PYTHON_MODULE(_caffe) {
   // below, we prepend an underscore to methods that will be replaced
@@ -347,6 +474,9 @@ BOOST_PYTHON_MODULE(_caffe) {
 
   bp::scope().attr("__version__") = AS_STRING(CAFFE_VERSION);
 
+  // The GIL is released during computation, make sure it exists (Python 2)
+  PyEval_InitThreads();
+
   // Caffe utility functions
   bp::def("init_log", &InitLog);
   bp::def("init_log", &InitLogInfo);
@@ -363,6 +493,13 @@ BOOST_PYTHON_MODULE(_caffe) {
 
   bp::def("layer_type_list", &LayerRegistry<Dtype>::LayerTypeList);
 
+  // BBTXT detection utilities
+  bp::def("extract_bbtxt_detections", &ExtractBBTXTDetections,
+      (bp::arg("output"), bp::arg("b")=0, bp::arg("scale")=1.0,
+       bp::arg("min_conf")=0.1, bp::arg("label")=1));
+  bp::def("non_maxima_suppression", &NonMaximaSuppression,
+      (bp::arg("detections"), bp::arg("iou_threshold")=0.5));
+
   bp::class_<Net<Dtype>, shared_ptr<Net<Dtype> >, boost::noncopyable >("Net",
     bp::no_init)
     // Constructor
@@ -372,8 +509,8 @@ BOOST_PYTHON_MODULE(_caffe) {
             bp::arg("weights")=bp::object())))
     // Legacy constructor
     .def("__init__", bp::make_constructor(&Net_Init_Load))
-    .def("_forward", &Net<Dtype>::ForwardFromTo)
-    .def("_backward", &Net<Dtype>::BackwardFromTo)
+    .def("_forward", &Net_ForwardFromTo)
+    .def("_backward", &Net_BackwardFromTo)
     .def("reshape", &Net<Dtype>::Reshape)
     .def("clear_param_diffs", &Net<Dtype>::ClearParamDiffs)
     // The cast is to select a particular overload.
@@ -401,6 +538,7 @@ BOOST_PYTHON_MODULE(_caffe) {
         bp::return_value_policy<bp::copy_const_reference>()))
     .def("_set_input_arrays", &Net_SetInputArrays,
         bp::with_custodian_and_ward<1, 2, bp::with_custodian_and_ward<1, 3> >())
+    .def("_bind_input", &Net_BindInput)
     .def("save", &Net_Save)
     .def("save_hdf5", &Net_SaveHDF5)
     .def("load_hdf5", &Net_LoadHDF5)
@@ -454,9 +592,8 @@ BOOST_PYTHON_MODULE(_caffe) {
     .add_property("iter", &Solver<Dtype>::iter)
     .def("add_callback", &Solver_add_callback<Dtype>)
     .def("add_callback", &Solver_add_nccl)
-    .def("solve", static_cast<void (Solver<Dtype>::*)(const char*)>(
-          &Solver<Dtype>::Solve), SolveOverloads())
-    .def("step", &Solver<Dtype>::Step)
+    .def("solve", &Solver_Solve, SolveOverloads())
+    .def("step", &Solver_Step)
     .def("restore", &Solver<Dtype>::Restore)
     .def("snapshot", &Solver<Dtype>::Snapshot)
     .add_property("param", bp::make_function(&Solver<Dtype>::param,
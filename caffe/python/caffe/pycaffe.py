@@ -114,10 +114,19 @@ def _Net_forward(self, blobs=None, start=None, end=None, **kwargs):
         # Set input according to defined shapes and make arrays single and
         # C-contiguous as Caffe expects.
         for in_, blob in six.iteritems(kwargs):
+            if in_ in self._bound_inputs:
+                # Bound inputs are not copied, the new array gets bound
+                self.bind_input(in_, blob)
+                continue
             if blob.shape[0] != self.blobs[in_].shape[0]:
                 raise Exception('Input is not batch sized')
             self.blobs[in_].data[...] = blob
 
+    # Bound arrays may have been modified in place since the last pass, mark
+    # them as the current input data
+    for in_, arr in six.iteritems(self._bound_inputs):
+        self._bind_input(in_, arr)
+
     self._forward(start_ind, end_ind)
 
     # Unpack blobs to extract
@@ -259,6 +268,35 @@ def _Net_set_input_arrays(self, data, labels):
     return self._set_input_arrays(data, labels)
 
 
+@property
+def _Net_bound_inputs(self):
+    """
+    A dict of input blob names -> arrays bound with bind_input().
+    """
+    if not hasattr(self, '_bound_inputs_dict'):
+        self._bound_inputs_dict = {}
+    return self._bound_inputs_dict
+
+
+def _Net_bind_input(self, blob_name, arr):
+    """
+    Bind a numpy array as the data of an input blob without copying it.
+
+    Parameters
+    ----------
+    blob_name : name of the input blob.
+    arr : C-contiguous float32 ndarray. The blob and the net are reshaped to
+          its shape, so a whole batch (N x C x H x W) can be bound at once.
+
+    The net keeps a reference to the array until another array is bound to
+    the same blob. The array may be refilled in place, forward() always uses
+    its current contents.
+    """
+    self._bind_input(blob_name, arr)
+    self._bound_inputs[blob_name] = arr
+    self.reshape()
+
+
 def _Net_batch(self, blobs):
     """
     Batch blob lists according to net's batch size.
@@ -327,6 +365,8 @@ Net.backward = _Net_backward
 Net.forward_all = _Net_forward_all
 Net.forward_backward_all = _Net_forward_backward_all
 Net.set_input_arrays = _Net_set_input_arrays
+Net._bound_inputs = _Net_bound_inputs
+Net.bind_input = _Net_bind_input
 Net._batch = _Net_batch
 Net.inputs = _Net_inputs
 Net.outputs = _Net_outputs
@@ -0,0 +1,45 @@
+import unittest
+import tempfile
+import os
+import numpy as np
+
+import caffe
+
+
+class TestDetection(unittest.TestCase):
+
+    TEST_NET = """
+layer {
+  name: "acc"
+  type: "Input"
+  top: "acc"
+  input_param { shape { dim: 1 dim: 5 dim: 4 dim: 6 } }
+}
+"""
+
+    def setUp(self):
+        f = tempfile.NamedTemporaryFile(mode='w+', delete=False)
+        f.write(self.TEST_NET)
+        f.close()
+        self.net = caffe.Net(f.name, caffe.TEST)
+        os.remove(f.name)
+
+    def test_extract_bbtxt_detections(self):
+        acc = self.net.blobs['acc']
+        acc.data[...] = 0
+        acc.data[0, :, 1, 1] = [0.9, 10, 20, 30, 40]
+        acc.data[0, :, 1, 2] = [0.5, 11, 21, 31, 41]
+        acc.data[0, :, 3, 5] = [0.6, 50, 60, 70, 80]
+        dets = caffe.extract_bbtxt_detections(acc, scale=2.0, min_conf=0.1)
+        self.assertEqual(dets.shape, (2, 6))
+        self.assertTrue(np.allclose(dets[0], [1, 0.9, 5, 10, 15, 20]))
+        self.assertTrue(np.allclose(dets[1], [1, 0.6, 25, 30, 35, 40]))
+
+    def test_non_maxima_suppression(self):
+        dets = np.array([[1, 0.5, 0, 0, 10, 10],
+                         [1, 0.9, 1, 1, 11, 11],
+                         [1, 0.7, 20, 20, 30, 30],
+                         [2, 0.6, 1, 1, 11, 11]], dtype=np.float32)
+        kept = caffe.non_maxima_suppression(dets, iou_threshold=0.5)
+        self.assertTrue(np.allclose(kept[:, 1], [0.9, 0.7, 0.6]))
+        self.assertEqual(len(caffe.non_maxima_suppression(dets, 0.9)), 4)
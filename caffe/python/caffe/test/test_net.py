@@ -343,3 +343,51 @@ layer {
         net = caffe.Net(self.f.name, caffe.TEST, stages=['deploy'])
         self.check_net(net, ['pred'])
 
+
+
+class TestBindInput(unittest.TestCase):
+
+    TEST_NET = """
+layer {
+  name: "data"
+  type: "Input"
+  top: "data"
+  input_param { shape { dim: 1 dim: 2 dim: 3 dim: 4 } }
+}
+layer {
+  name: "scale"
+  type: "Power"
+  bottom: "data"
+  top: "scaled"
+  power_param { scale: 2 }
+}
+"""
+
+    def setUp(self):
+        self.f = tempfile.NamedTemporaryFile(mode='w+', delete=False)
+        self.f.write(self.TEST_NET)
+        self.f.close()
+        self.net = caffe.Net(self.f.name, caffe.TEST)
+
+    def tearDown(self):
+        os.remove(self.f.name)
+
+    def test_bind_batch(self):
+        arr = np.random.rand(5, 2, 3, 4).astype(np.float32)
+        self.net.bind_input('data', arr)
+        self.assertEqual(list(self.net.blobs['scaled'].shape), [5, 2, 3, 4])
+        out = self.net.forward()['scaled']
+        self.assertTrue(np.allclose(out, 2 * arr))
+        # The blob uses the memory of the array, in place changes are seen
+        arr[...] = 1
+        out = self.net.forward()['scaled']
+        self.assertTrue(np.allclose(out, 2))
+
+    def test_bind_checks(self):
+        with self.assertRaises(RuntimeError):
+            self.net.bind_input('data', np.zeros((1, 2, 3, 4)))
+        with self.assertRaises(RuntimeError):
+            self.net.bind_input('data',
+                np.zeros((1, 2, 3, 8), dtype=np.float32)[..., ::2])
+        with self.assertRaises(RuntimeError):
+            self.net.bind_input('scaled', np.zeros((1, 2, 3, 4), np.float32))
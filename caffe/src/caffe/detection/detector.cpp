@@ -0,0 +1,395 @@
+#include "caffe/detection/detector.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "caffe/util/detection.hpp"
+#include "caffe/util/nms_bev.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+
+namespace caffe {
+
+// ------------------------------------------  ASYNC DETECTOR  ------------------------------------------- //
+
+template <typename BB>
+AsyncDetector<BB>::AsyncDetector (const std::string &path_prototxt, const std::string &path_caffemodel,
+                                  const DetectorSettings &settings, int num_channels)
+    : _settings(settings),
+      _num_channels(num_channels),
+      _stop(false)
+{
+    CHECK(!settings.scales.empty()) << "At least one scale of the pyramid is needed";
+    CHECK_GT(settings.num_workers, 0) << "At least one worker is needed";
+    CHECK_GT(settings.max_batch_size, 0) << "Maximum batch size must be positive";
+#ifdef CPU_ONLY
+    CHECK_LT(settings.gpu, 0) << "Caffe was built with CPU_ONLY, the detector cannot run on the GPU";
+#endif
+
+    NetParameter net_param;
+    ReadNetParamsFromTextFileOrDie(path_prototxt, &net_param);
+    net_param.mutable_state()->set_phase(TEST);
+    if (settings.sparse_head) enableSparseAccumulators(net_param, settings.min_conf);
+
+    // The first network loads the weights, the other ones share them
+    this->_nets.push_back(std::make_shared<Net<float>>(net_param));
+    this->_nets[0]->CopyTrainedLayersFrom(path_caffemodel);
+    for (int w = 1; w < settings.num_workers; ++w)
+    {
+        this->_nets.push_back(std::make_shared<Net<float>>(net_param));
+        this->_nets[w]->ShareTrainedLayersWith(this->_nets[0].get());
+    }
+
+    const Net<float> &net = *this->_nets[0];
+    CHECK_EQ(net.num_inputs(), 1) << "Network should have exactly one input.";
+    CHECK_EQ(net.input_blobs()[0]->shape(1), 3) << "Input layer must have 3 channels.";
+    // Joint 2D and 3D networks have outputs of both kinds, the other ones are ignored
+    const int num_outputs = std::count_if(net.output_blobs().begin(), net.output_blobs().end(),
+                                          [num_channels] (const Blob<float> *output) {
+                                              return output->shape(1) == num_channels;
+                                          });
+    CHECK_GT(num_outputs, 0) << "Unsupported network, no output with " << num_channels << " channels!";
+    LOG_IF(INFO, num_outputs < net.num_outputs()) << "Using " << num_outputs << " of " << net.num_outputs()
+                                                  << " outputs of the network (" << num_channels << " channels)";
+
+    for (int w = 0; w < settings.num_workers; ++w)
+    {
+        this->_workers.emplace_back(&AsyncDetector<BB>::_workerEntry, this, w);
+    }
+}
+
+
+template <typename BB>
+AsyncDetector<BB>::~AsyncDetector ()
+{
+    this->_stopWorkers();
+}
+
+
+template <typename BB>
+std::future<std::vector<BB>> AsyncDetector<BB>::_submit (const cv::Mat &image, const std::string &id,
+                                                         const std::shared_ptr<const PGP> &pgp)
+{
+    CHECK(!image.empty()) << "Empty frame submitted for detection";
+    CHECK_EQ(image.type(), CV_8UC3) << "Only BGR frames (CV_8UC3) are supported";
+
+    std::unique_ptr<Request> request(new Request());
+    request->size = image.size();
+    request->id   = id;
+    request->pgp  = pgp;
+
+    // Convert to zero mean and unit variance
+    cv::Mat imagef; image.convertTo(imagef, CV_32FC3, 1.0/128.0, -1.0);
+
+    for (double s: this->_settings.scales)
+    {
+        const cv::Size size(cvRound(image.cols*s), cvRound(image.rows*s));
+        if (size == imagef.size())
+        {
+            request->levels.push_back(imagef);
+        }
+        else
+        {
+            cv::Mat imagef_scaled;
+            cv::resize(imagef, imagef_scaled, size);
+            request->levels.push_back(imagef_scaled);
+        }
+    }
+
+    std::future<std::vector<BB>> result = request->promise.get_future();
+    {
+        std::lock_guard<std::mutex> lock(this->_mtx);
+        CHECK(!this->_stop) << "Frame submitted to a stopped detector";
+        this->_queue.push_back(std::move(request));
+    }
+    this->_cv.notify_one();
+
+    return result;
+}
+
+
+template <typename BB>
+void AsyncDetector<BB>::_stopWorkers ()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->_mtx);
+        this->_stop = true;
+    }
+    this->_cv.notify_all();
+
+    for (std::thread &worker: this->_workers)
+    {
+        if (worker.joinable()) worker.join();
+    }
+
+    // Fail the frames, which were not processed
+    std::lock_guard<std::mutex> lock(this->_mtx);
+    for (std::unique_ptr<Request> &request: this->_queue)
+    {
+        request->promise.set_exception(std::make_exception_ptr(std::runtime_error("Detector was stopped")));
+    }
+    this->_queue.clear();
+}
+
+
+// -------------------------------------  ASYNC DETECTOR WORKERS  ------------------------------------- //
+
+template <typename BB>
+void AsyncDetector<BB>::_workerEntry (int w)
+{
+    Net<float> &net = *this->_nets[w];
+
+    // Caffe mode is thread local. The weights are moved to the GPU under the lock, so that the workers do not
+    // race on the state of their shared memory
+    {
+        std::lock_guard<std::mutex> lock(this->_mtx);
+#ifndef CPU_ONLY
+        if (this->_settings.gpu >= 0)
+        {
+            Caffe::SetDevice(this->_settings.gpu);
+            Caffe::set_mode(Caffe::GPU);
+            for (Blob<float> *param: net.learnable_params()) param->gpu_data();
+        }
+        else
+#endif
+        {
+            Caffe::set_mode(Caffe::CPU);
+        }
+    }
+
+    std::vector<std::unique_ptr<Request>> batch;
+    while (this->_takeBatch(batch))
+    {
+        this->_processBatch(net, batch);
+    }
+}
+
+
+template <typename BB>
+bool AsyncDetector<BB>::_takeBatch (std::vector<std::unique_ptr<Request>> &batch)
+{
+    batch.clear();
+
+    std::unique_lock<std::mutex> lock(this->_mtx);
+    this->_cv.wait(lock, [this] () { return this->_stop || !this->_queue.empty(); });
+    if (this->_stop) return false;
+
+    batch.push_back(std::move(this->_queue.front()));
+    this->_queue.pop_front();
+
+    // Add the queued frames of the same size (their pyramid levels have the same sizes)
+    const cv::Size size = batch[0]->size;
+    auto it = this->_queue.begin();
+    while (it != this->_queue.end() && batch.size() < this->_settings.max_batch_size)
+    {
+        if ((*it)->size == size)
+        {
+            batch.push_back(std::move(*it));
+            it = this->_queue.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    return true;
+}
+
+
+template <typename BB>
+void AsyncDetector<BB>::_processBatch (Net<float> &net, std::vector<std::unique_ptr<Request>> &batch)
+{
+    Blob<float> *input = net.input_blobs()[0];
+    std::vector<std::vector<BB>> bbs(batch.size());
+
+    for (int l = 0; l < this->_settings.scales.size(); ++l)
+    {
+        const cv::Size size = batch[0]->levels[l].size();
+
+        // Reshape the network
+        input->Reshape(batch.size(), input->shape(1), size.height, size.width);
+        net.Reshape();
+
+        // Copy the images to the input layer of the network
+        float *input_data = input->mutable_cpu_data();
+        for (int b = 0; b < batch.size(); ++b)
+        {
+            std::vector<cv::Mat> input_channels;
+            for (int c = 0; c < input->shape(1); ++c)
+            {
+                input_channels.emplace_back(size, CV_32FC1, input_data + input->offset(b, c));
+            }
+            cv::split(batch[b]->levels[l], input_channels);
+        }
+
+        net.Forward();
+
+        for (const Blob<float> *output: net.output_blobs())
+        {
+            if (output->shape(1) != this->_num_channels) continue;
+
+            for (int b = 0; b < batch.size(); ++b)
+            {
+                std::vector<BB> new_bbs = this->_extract(*output, b, this->_settings.scales[l], batch[b]->id);
+                bbs[b].insert(bbs[b].end(), new_bbs.begin(), new_bbs.end());
+            }
+        }
+    }
+
+    for (int b = 0; b < batch.size(); ++b)
+    {
+        try {
+            batch[b]->promise.set_value(this->_finish(bbs[b], batch[b]->pgp.get()));
+        }
+        catch (...)
+        {
+            batch[b]->promise.set_exception(std::current_exception());
+        }
+    }
+}
+
+
+template class AsyncDetector<BB2D>;
+template class AsyncDetector<BB3D>;
+
+
+// --------------------------------------------  DETECTOR 2D  -------------------------------------------- //
+
+Detector2D::Detector2D (const std::string &path_prototxt, const std::string &path_caffemodel,
+                        const DetectorSettings &settings)
+    : AsyncDetector<BB2D>(path_prototxt, path_caffemodel, settings, 5)
+{
+}
+
+
+Detector2D::~Detector2D ()
+{
+    // The workers call the virtual methods of this class
+    this->_stopWorkers();
+}
+
+
+std::future<std::vector<BB2D>> Detector2D::detect (const cv::Mat &image, const std::string &id)
+{
+    return this->_submit(image, id, nullptr);
+}
+
+
+std::future<std::vector<BB2D>> Detector2D::detect (const unsigned char *data, int width, int height, int step,
+                                                   const std::string &id)
+{
+    CHECK_GE(step, 3*width) << "Row step is smaller than the width of the frame";
+    // The frame is converted in _submit(), the buffer is not referenced afterwards
+    const cv::Mat image(height, width, CV_8UC3, const_cast<unsigned char*>(data), step);
+    return this->detect(image, id);
+}
+
+
+std::vector<BB2D> Detector2D::_extract (const Blob<float> &output, int b, double scale,
+                                        const std::string &id) const
+{
+    std::vector<BB2D> bbs;
+    for (const Detection2D &d: extractBBTXTDetections(output, b, scale, this->_settings.min_conf))
+    {
+        bbs.emplace_back(id, d.label, d.conf, d.xmin, d.ymin, d.xmax, d.ymax);
+    }
+    return bbs;
+}
+
+
+std::vector<BB2D> Detector2D::_finish (std::vector<BB2D> &bbs, const PGP *pgp) const
+{
+    if (this->_settings.nms_iou <= 0.0) return bbs;
+    return greedyNonMaximaSuppression(bbs, this->_settings.nms_iou, ::iou2d<BB2D>);
+}
+
+
+// --------------------------------------------  DETECTOR 3D  -------------------------------------------- //
+
+Detector3D::Detector3D (const std::string &path_prototxt, const std::string &path_caffemodel,
+                        const DetectorSettings &settings)
+    : AsyncDetector<BB3D>(path_prototxt, path_caffemodel, settings, 8)
+{
+}
+
+
+Detector3D::~Detector3D ()
+{
+    // The workers call the virtual methods of this class
+    this->_stopWorkers();
+}
+
+
+std::future<std::vector<BB3D>> Detector3D::detect (const cv::Mat &image, const PGP &pgp, const std::string &id)
+{
+    return this->_submit(image, id, std::make_shared<const PGP>(pgp));
+}
+
+
+std::future<std::vector<BB3D>> Detector3D::detect (const cv::Mat &image, const std::string &id)
+{
+    return this->_submit(image, id, nullptr);
+}
+
+
+std::future<std::vector<BB3D>> Detector3D::detect (const unsigned char *data, int width, int height, int step,
+                                                   const PGP *pgp, const std::string &id)
+{
+    CHECK_GE(step, 3*width) << "Row step is smaller than the width of the frame";
+    // The frame is converted in _submit(), the buffer is not referenced afterwards
+    const cv::Mat image(height, width, CV_8UC3, const_cast<unsigned char*>(data), step);
+    return this->_submit(image, id, pgp ? std::make_shared<const PGP>(*pgp) : nullptr);
+}
+
+
+std::vector<BB3D> Detector3D::_extract (const Blob<float> &output, int b, double scale,
+                                        const std::string &id) const
+{
+    std::vector<BB3D> bbs;
+    for (const Detection3D &d: extractBB3TXTDetections(output, b, scale, this->_settings.min_conf))
+    {
+        bbs.emplace_back(id, d.label, d.conf, d.fblx, d.fbly, d.fbrx, d.fbry, d.rblx, d.rbly, d.ftly);
+    }
+    return bbs;
+}
+
+
+std::vector<BB3D> Detector3D::_finish (std::vector<BB3D> &bbs, const PGP *pgp) const
+{
+    // Without calibration only the raw detections can be returned
+    if (pgp == nullptr) return bbs;
+
+    // The ground rectangles for the NMS in the bird's eye view are kept from the reconstruction
+    std::vector<BB3D> reconstructed;
+    std::vector<GroundRect> rects;
+    std::vector<double> conf;
+    for (BB3D bb: bbs)
+    {
+        GroundRect rect;
+        if (pgp->reconstructDetection(bb, this->_settings.size_filter, &rect))
+        {
+            reconstructed.push_back(bb);
+            rects.push_back(rect);
+            conf.push_back(bb.conf);
+        }
+    }
+
+    if (this->_settings.nms_bev)
+    {
+        std::vector<BB3D> bbs_out;
+        for (int i: nonMaximaSuppressionBEV(rects, conf, this->_settings.nms_bev_iou))
+        {
+            bbs_out.push_back(reconstructed[i]);
+        }
+        return bbs_out;
+    }
+
+    if (this->_settings.nms_iou <= 0.0) return reconstructed;
+    return greedyNonMaximaSuppression(reconstructed, this->_settings.nms_iou, ::iou2d<BB3D>);
+}
+
+
+}  // namespace caffe
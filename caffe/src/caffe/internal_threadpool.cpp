@@ -7,7 +7,8 @@
 namespace caffe {
 
 
-InternalThreadpool::InternalThreadpool (int num_threads)
+InternalThreadpool::InternalThreadpool (int num_threads, CPUResources::Role role)
+    : _role(role)
 {
     for (int t = 0; t < num_threads; ++t) this->_threads.emplace_back();
 }
@@ -68,6 +69,7 @@ void InternalThreadpool::entry (int t, int device, Caffe::Brew mode, int rand_se
     Caffe::set_solver_count(solver_count);
     Caffe::set_solver_rank(solver_rank);
     Caffe::set_multiprocess(multiprocess);
+    CPUResources::Get().pinThread(this->_role, t);
 
     InternalThreadpoolEntry(t);
 }
@@ -1,4 +1,7 @@
+#include <boost/thread.hpp>
+
 #include <algorithm>
+#include <cstring>
 #include <vector>
 
 #include "caffe/filler.hpp"
@@ -8,6 +11,41 @@
 
 namespace caffe {
 
+namespace {
+
+// Layers of a net run one after another, so the batched GEMM buffers of all
+// convolution layers of a thread can share one workspace.
+template <typename Dtype>
+Blob<Dtype>* batched_gemm_workspace() {
+  static boost::thread_specific_ptr<Blob<Dtype> > workspace;
+  if (!workspace.get()) {
+    workspace.reset(new Blob<Dtype>());
+  }
+  return workspace.get();
+}
+
+// Copies the rows x cols matrix of image b into columns [b * cols,
+// (b + 1) * cols) of the rows x (num * cols) batch matrix and back.
+template <typename Dtype>
+void image_to_batch(const Dtype* image, int rows, int cols, int num, int b,
+    Dtype* batch) {
+  for (int r = 0; r < rows; ++r) {
+    std::memcpy(batch + (r * num + b) * cols, image + r * cols,
+        sizeof(Dtype) * cols);
+  }
+}
+
+template <typename Dtype>
+void batch_to_image(const Dtype* batch, int rows, int cols, int num, int b,
+    Dtype* image) {
+  for (int r = 0; r < rows; ++r) {
+    std::memcpy(image + r * cols, batch + (r * num + b) * cols,
+        sizeof(Dtype) * cols);
+  }
+}
+
+}  // namespace
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -251,6 +289,21 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     caffe_set(bias_multiplier_.count(), Dtype(1),
         bias_multiplier_.mutable_cpu_data());
   }
+  // Images per batched GEMM: as many as fit into the workspace, spread evenly
+  // over the chunks of the minibatch.
+  batched_gemm_images_ = 1;
+  const ConvolutionParameter& conv_param =
+      this->layer_param_.convolution_param();
+  if (conv_param.batched_gemm() && !reverse_dimensions() && num_ > 1) {
+    const size_t image_bytes = sizeof(Dtype) * conv_out_spatial_dim_
+        * (kernel_dim_ * group_ + conv_out_channels_);
+    const size_t workspace_bytes =
+        static_cast<size_t>(conv_param.batched_gemm_workspace()) << 20;
+    const int max_images = std::max<size_t>(1, std::min<size_t>(num_,
+        workspace_bytes / image_bytes));
+    const int num_chunks = (num_ + max_images - 1) / max_images;
+    batched_gemm_images_ = (num_ + num_chunks - 1) / num_chunks;
+  }
 }
 
 template <typename Dtype>
@@ -320,6 +373,110 @@ void BaseConvolutionLayer<Dtype>::backward_cpu_bias(Dtype* bias,
       input, bias_multiplier_.cpu_data(), 1., bias);
 }
 
+template <typename Dtype>
+Dtype* BaseConvolutionLayer<Dtype>::batched_col_buffer(int num) {
+  CHECK_LE(num, batched_gemm_images_);
+  const int col_count = kernel_dim_ * group_ * conv_out_spatial_dim_;
+  const int output_count = conv_out_channels_ * conv_out_spatial_dim_;
+  Blob<Dtype>* workspace = batched_gemm_workspace<Dtype>();
+  workspace->Reshape(vector<int>(1,
+      batched_gemm_images_ * (col_count + output_count)));
+  return workspace->mutable_cpu_data();
+}
+
+template <typename Dtype>
+Dtype* BaseConvolutionLayer<Dtype>::batched_output_buffer(int num) {
+  return batched_col_buffer(num)
+      + batched_gemm_images_ * kernel_dim_ * group_ * conv_out_spatial_dim_;
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::batched_im2col_cpu(const Dtype* data,
+    int num, Dtype* col_batch) {
+  for (int b = 0; b < num; ++b) {
+    const Dtype* col_buff = data + b * bottom_dim_;
+    if (!is_1x1_) {
+      conv_im2col_cpu(col_buff, col_buffer_.mutable_cpu_data());
+      col_buff = col_buffer_.cpu_data();
+    }
+    image_to_batch(col_buff, kernel_dim_ * group_, conv_out_spatial_dim_,
+        num, b, col_batch);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_gemm_batched(const Dtype* input,
+    const Dtype* weights, Dtype* output, int num) {
+  Dtype* col_batch = batched_col_buffer(num);
+  Dtype* output_batch = batched_output_buffer(num);
+  batched_im2col_cpu(input, num, col_batch);
+  const int columns = num * conv_out_spatial_dim_;
+  for (int g = 0; g < group_; ++g) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
+        group_, columns, kernel_dim_,
+        (Dtype)1., weights + weight_offset_ * g,
+        col_batch + col_offset_ * num * g,
+        (Dtype)0., output_batch + output_offset_ * num * g);
+  }
+  for (int b = 0; b < num; ++b) {
+    batch_to_image(output_batch, conv_out_channels_, conv_out_spatial_dim_,
+        num, b, output + b * top_dim_);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::backward_cpu_gemm_batched(
+    const Dtype* output, const Dtype* weights, Dtype* input, int num,
+    bool skip_gather) {
+  Dtype* col_batch = batched_col_buffer(num);
+  Dtype* output_batch = batched_output_buffer(num);
+  if (!skip_gather) {
+    for (int b = 0; b < num; ++b) {
+      image_to_batch(output + b * top_dim_, conv_out_channels_,
+          conv_out_spatial_dim_, num, b, output_batch);
+    }
+  }
+  const int columns = num * conv_out_spatial_dim_;
+  for (int g = 0; g < group_; ++g) {
+    caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, kernel_dim_,
+        columns, conv_out_channels_ / group_,
+        (Dtype)1., weights + weight_offset_ * g,
+        output_batch + output_offset_ * num * g,
+        (Dtype)0., col_batch + col_offset_ * num * g);
+  }
+  for (int b = 0; b < num; ++b) {
+    if (is_1x1_) {
+      batch_to_image(col_batch, kernel_dim_ * group_, conv_out_spatial_dim_,
+          num, b, input + b * bottom_dim_);
+    } else {
+      Dtype* col_buff = col_buffer_.mutable_cpu_data();
+      batch_to_image(col_batch, kernel_dim_ * group_, conv_out_spatial_dim_,
+          num, b, col_buff);
+      conv_col2im_cpu(col_buff, input + b * bottom_dim_);
+    }
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::weight_cpu_gemm_batched(const Dtype* input,
+    const Dtype* output, Dtype* weights, int num) {
+  Dtype* col_batch = batched_col_buffer(num);
+  Dtype* output_batch = batched_output_buffer(num);
+  batched_im2col_cpu(input, num, col_batch);
+  for (int b = 0; b < num; ++b) {
+    image_to_batch(output + b * top_dim_, conv_out_channels_,
+        conv_out_spatial_dim_, num, b, output_batch);
+  }
+  const int columns = num * conv_out_spatial_dim_;
+  for (int g = 0; g < group_; ++g) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, conv_out_channels_ / group_,
+        kernel_dim_, columns,
+        (Dtype)1., output_batch + output_offset_ * num * g,
+        col_batch + col_offset_ * num * g,
+        (Dtype)1., weights + weight_offset_ * g);
+  }
+}
+
 #ifndef CPU_ONLY
 
 template <typename Dtype>
@@ -54,8 +54,8 @@ namespace {
 template <typename Dtype>
 BB3TXTDataLayer<Dtype>::BB3TXTDataLayer (const LayerParameter &param)
     : BasePrefetchingDataLayer<Dtype>(param),
-      InternalThreadpool(std::min(int(std::max(int(boost::thread::hardware_concurrency()/2), 1)),
-                                  int(param.image_data_param().batch_size())))
+      InternalThreadpool(CPUResources::Get().numThreads(CPUResources::DATA, param.image_data_param().batch_size()),
+                         CPUResources::DATA)
 {
 }
 
@@ -88,7 +88,9 @@ void BB3TXTDataLayer<Dtype>::DataLayerSetUp (const vector<Blob<Dtype>*> &bottom,
 
     // Load the BBTXT file with 2D bounding box annotations
     this->_loadBB3TXTFile();
-    this->_i_global = 0;
+    this->_i_global   = 0;
+    this->_i_prefetch = 0;
+    this->_seq_epoch  = 0;
 
     CHECK(!this->_images.empty()) << "The given BBTXT file is empty!";
     LOG(INFO) << "There are " << this->_images.size() << " images in the dataset.";
@@ -105,6 +107,28 @@ void BB3TXTDataLayer<Dtype>::DataLayerSetUp (const vector<Blob<Dtype>*> &bottom,
     top[1]->Reshape(label_shape);
 
 
+    if (this->phase_ == TEST && this->layer_param_.bbtxt_param().test_cache())
+    {
+        // Test crops are always the same - materialize each of them only once
+        this->_test_cache.reset(new SampleCache<Dtype>(this->_indices.size(), this->transformed_data_.count(1),
+                                                       this->transformed_label_.count(1),
+                                                       this->layer_param_.bbtxt_param().test_cache_file()));
+    }
+
+
+    if (this->layer_param_.bbtxt_param().read_ahead() > 0)
+    {
+        // Read the upcoming images asynchronously, the data threads then only decode them from memory
+        this->_prefetcher.reset(new FilePrefetcher(this->layer_param_.bbtxt_param().read_ahead_threads(),
+                                                   this->layer_param_.bbtxt_param().read_ahead()));
+        LOG(INFO) << "Reading " << this->layer_param_.bbtxt_param().read_ahead() << " images ahead"
+                  << (this->_prefetcher->usesIOUring() ? " with io_uring" : "");
+
+        std::lock_guard<std::mutex> lock(this->_i_global_mtx);
+        this->_prefetchAhead();
+    }
+
+
     // Initialize prefetching
     // We also have to reshape the prefetching blobs to the correct batch size
     for (int i = 0; i < this->prefetch_.size(); ++i)
@@ -125,6 +149,9 @@ void BB3TXTDataLayer<Dtype>::load_batch (Batch<Dtype> *batch)
     CHECK(batch->data_.count());
     CHECK(this->transformed_data_.count());
 
+    CPUTimer batch_timer;
+    batch_timer.Start();
+
     const int batch_size = this->layer_param_.image_data_param().batch_size();
 
     Dtype* prefetch_data  = batch->data_.mutable_cpu_data();
@@ -136,6 +163,10 @@ void BB3TXTDataLayer<Dtype>::load_batch (Batch<Dtype> *batch)
     this->_num_processed.reset();
     for (int b = 0; b < batch_size; ++b) this->_b_queue.push(b);
     this->_num_processed.waitToCount(batch_size);
+
+    batch_timer.Stop();
+    DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
+    if (this->_prefetcher) DLOG(INFO) << "Image read-ahead " << this->_prefetcher->stats();
 }
 
 
@@ -154,13 +185,33 @@ void BB3TXTDataLayer<Dtype>::InternalThreadpoolEntry (int t)
             // Get index of image and bounding box we will crop
             SelectedBB<Dtype> selbb = this->_getImageAndBB();
 
-            cv::Mat cv_img = cv::imread(selbb.filename, CV_LOAD_IMAGE_COLOR);
+            Dtype *data_b  = this->transformed_data_.mutable_cpu_data() + this->transformed_data_.offset(b);
+            Dtype *label_b = this->transformed_label_.mutable_cpu_data() + this->transformed_label_.offset(b);
+
+            // The crop may already be cached from one of the previous test passes
+            if (this->_test_cache && this->_test_cache->load(selbb.index, data_b, label_b))
+            {
+                if (this->_prefetcher) this->_prefetcher->discard(selbb.seq);
+                this->_num_processed.increase();
+                continue;
+            }
+
+            // Decode the image from memory if its file was read ahead
+            cv::Mat cv_img;
+            std::vector<uchar> file;
+            if (this->_prefetcher && this->_prefetcher->take(selbb.seq, file))
+            {
+                cv_img = cv::imdecode(file, CV_LOAD_IMAGE_COLOR);
+            }
+            else
+            {
+                cv_img = cv::imread(selbb.filename, CV_LOAD_IMAGE_COLOR);
+            }
             CHECK(cv_img.data) << "Could not open " << selbb.filename;
 
             // Copy the annotation - we really have to copy it because it will be altered during image
             // transformations like cropping or scaling
-            caffe_copy(selbb.label->count(), selbb.label->cpu_data(),
-                       this->transformed_label_.mutable_cpu_data() + this->transformed_label_.offset(b));
+            caffe_copy(selbb.label->count(), selbb.label->cpu_data(), label_b);
 
             // We select a bounding box from the image and then make a crop such that the bounding box is
             // inside of it and it has the reference size (Training - we select a random bounding box to crop
@@ -168,6 +219,8 @@ void BB3TXTDataLayer<Dtype>::InternalThreadpoolEntry (int t)
             // the test set is always the same)
             this->_cropAndTransform(cv_img, b, selbb.bb_id);
 
+            if (this->_test_cache) this->_test_cache->store(selbb.index, data_b, label_b);
+
             // Raise the counter on processed images
             this->_num_processed.increase();
 
@@ -498,23 +551,51 @@ SelectedBB<Dtype> BB3TXTDataLayer<Dtype>::_getImageAndBB()
     std::lock_guard<std::mutex> lock(this->_i_global_mtx);
 
     // Get image and bounding box index
-    auto indices = this->_indices[this->_i_global++];
+    const int index = this->_i_global++;
+    auto indices = this->_indices[index];
+    const long seq = this->_seq_epoch + index;
 
     if (this->_i_global >= this->_indices.size())
     {
         this->_i_global = 0;  // Restart
         if (this->phase_ == TRAIN) this->_shuffleBoundingBoxes();
+
+        this->_seq_epoch += this->_indices.size();
+        this->_i_prefetch = 0;
+        if (this->_prefetcher) LOG(INFO) << "Epoch finished, image read-ahead " << this->_prefetcher->stats();
     }
 
+    // Keep the reads of the upcoming images in flight
+    if (this->_prefetcher) this->_prefetchAhead();
+
     SelectedBB<Dtype> sel;
     sel.filename = this->_images[indices.first].first;
     sel.label    = this->_images[indices.first].second;
     sel.bb_id    = indices.second;
+    sel.index    = index;
+    sel.seq      = seq;
 
     return sel;
 }
 
 
+template <typename Dtype>
+void BB3TXTDataLayer<Dtype>::_prefetchAhead ()
+{
+    // All test crops are cached - the images will not be needed anymore
+    if (this->_test_cache && this->_test_cache->numCached() == this->_test_cache->numSamples()) return;
+
+    // Only the order of the current epoch is known, the next one is shuffled when this one ends
+    const int end = std::min(int(this->_indices.size()),
+                             this->_i_global + int(this->layer_param_.bbtxt_param().read_ahead()));
+    for (; this->_i_prefetch < end; ++this->_i_prefetch)
+    {
+        const std::string &filename = this->_images[this->_indices[this->_i_prefetch].first].first;
+        this->_prefetcher->prefetch(this->_seq_epoch + this->_i_prefetch, filename);
+    }
+}
+
+
 // ----------------------------------------  LAYER INSTANTIATION  ---------------------------------------- //
 
 INSTANTIATE_CLASS(BB3TXTDataLayer);
@@ -6,10 +6,10 @@
 
 #include "caffe/layers/bb3txt_loss_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/tensor_view.hpp"
 #include "caffe/util/rng.hpp"
 #include "caffe/internal_threadpool.hpp"
-#include "caffe/util/blocking_queue.hpp"
-#include "caffe/util/blocking_counter.hpp"
+#include "caffe/util/lockfree_queue.hpp"
 #include "caffe/util/benchmark.hpp"
 
 
@@ -19,7 +19,8 @@ namespace caffe {
 template <typename Dtype>
 BB3TXTLossLayer<Dtype>::BB3TXTLossLayer (const LayerParameter &param)
     : LossLayer<Dtype>(param),
-      InternalThreadpool(4),
+      InternalThreadpool(CPUResources::Get().numThreads(CPUResources::LOSS), CPUResources::LOSS),
+      _teacher(nullptr),
       _b_queue()
 {
     CHECK(param.has_accumulator_loss_param()) << "AccumulatorLossParameter is mandatory!";
@@ -54,6 +55,24 @@ void BB3TXTLossLayer<Dtype>::LayerSetUp (const vector<Blob<Dtype>*> &bottom, con
     // Compute the bounds for bounding boxes, which should be included in this accumulator
     this->_computeSizeBounds();
 
+    // Knowledge distillation from the teacher accumulator
+    const AccumulatorLossParameter &alp = this->layer_param_.accumulator_loss_param();
+    if (bottom.size() > 2)
+    {
+        CHECK(alp.distill_weight_size() == 1 || alp.distill_weight_size() == 8)
+                << "Distillation needs one distill_weight or one for each of the 8 channels!";
+        for (int c = 0; c < 8; ++c)
+        {
+            const float w = alp.distill_weight((alp.distill_weight_size() == 1) ? 0 : c);
+            CHECK(w >= 0.0f && w <= 1.0f) << "Distillation weights must be in [0, 1]!";
+            this->_distill_weights.push_back(Dtype(w));
+        }
+    }
+    else
+    {
+        CHECK_EQ(alp.distill_weight_size(), 0) << "distill_weight requires the teacher accumulator (bottom[2])!";
+    }
+
     this->StartInternalThreadpool();
 }
 
@@ -67,6 +86,14 @@ void BB3TXTLossLayer<Dtype>::Reshape (const vector<Blob<Dtype>*> &bottom, const
 
     CHECK_EQ(bottom[1]->shape(1), 8) << "Accumulator must have 8 channels (prob, fblx, fbly, fbrx, fbry, "
                                      << "rblx, rbly, ftly)!";
+    CHECK_EQ(bottom[0]->num_axes(), 3) << "Labels must be 3 dimensional (batch x bounding boxes x values)!";
+    CHECK_EQ(bottom[0]->shape(2), 12) << "Labels must have 12 values, BB3TXTData layer has to be used!";
+
+    if (bottom.size() > 2)
+    {
+        CHECK(bottom[2]->shape() == bottom[1]->shape()) << "Teacher accumulator must have the same shape as "
+                                                        << "the trained one!";
+    }
 
     this->_accumulator->ReshapeLike(*bottom[1]);
     this->_diff->ReshapeLike(*bottom[1]);
@@ -89,6 +116,8 @@ void BB3TXTLossLayer<Dtype>::Forward_cpu (const vector<Blob<Dtype>*> &bottom, co
     // threads
     this->_labels = bottom[0]; this->_labels->cpu_data();
     this->_bottom = bottom[1]; this->_bottom->cpu_data();
+    this->_teacher = (bottom.size() > 2) ? bottom[2] : nullptr;
+    if (this->_teacher) this->_teacher->cpu_data();
 
     // -- COMPUTE THE LOSS -- //
     // Go through all images on the output and for each of them create accumulators and compute loss
@@ -154,9 +183,10 @@ void BB3TXTLossLayer<Dtype>::InternalThreadpoolEntry (int t)
             const int count_channel = this->_bottom->shape(2) * this->_bottom->shape(3);
 
             // Compute the difference of the target accumulator and the estimated one
-            caffe_sub(count, this->_bottom->cpu_data() + this->_bottom->offset(b, 0),
-                             this->_accumulator->cpu_data() + this->_accumulator->offset(b, 0),
-                             this->_diff->mutable_cpu_data() + this->_diff->offset(b, 0));
+            caffe_sub(count, cpuView<4>(*this->_bottom).ptr(b), cpuView<4>(*this->_accumulator).ptr(b),
+                      mutableCpuView<4>(*this->_diff).ptr(b));
+
+            if (this->_teacher) this->_blendTeacher(b);
 
             // We do not want to include errors on coordinates from samples (pixels), which are not supposed
             // to predict them - we need to remove the computed difference from the loss computation
@@ -166,7 +196,7 @@ void BB3TXTLossLayer<Dtype>::InternalThreadpoolEntry (int t)
             // Loss from the probability accumulator (channel 0)
             this->_computeProbabilityLoss(b);
             // Loss from the coordinates (channels 1-7)
-            const Dtype *data_coord = this->_diff->cpu_data() + this->_diff->offset(b, 1);
+            const Dtype *data_coord = cpuView<4>(*this->_diff).ptr(b, 1);
             Dtype loss_coord = caffe_cpu_dot(7*count_channel, data_coord, data_coord);
 
             // Loss per pixel
@@ -241,7 +271,8 @@ void BB3TXTLossLayer<Dtype>::_buildAccumulator (int b)
     const int height = this->_accumulator->shape(2);
     const int width  = this->_accumulator->shape(3);
 
-    Dtype *accumulator_data = this->_accumulator->mutable_cpu_data();
+    TensorView<Dtype, 4> accumulator  = mutableCpuView<4>(*this->_accumulator);
+    TensorView<const Dtype, 3> labels = cpuView<3>(*this->_labels);
 
     const double scaling_ratio = 1.0 / this->_scale;
 
@@ -251,14 +282,14 @@ void BB3TXTLossLayer<Dtype>::_buildAccumulator (int b)
     {
         // Create a cv::Mat wrapper for the accumulator - this way we can now use OpenCV drawing functions
         // to create circles in the accumulator
-        cv::Mat acc(height, width, CV_32FC1, accumulator_data + this->_accumulator->offset(b, c));
+        cv::Mat acc(height, width, CV_32FC1, accumulator.ptr(b, c));
         acc.setTo(cv::Scalar(0));
 
         // Draw circles in the center of the bounding boxes
-        for (int i = 0; i < this->_labels->shape(1); ++i)
+        for (int i = 0; i < labels.shape(1); ++i)
         {
             // Data are stored: [label, xmin, ymin, xmax, ymax, fblx, fbly, fbrx, fbry, rblx, rbly, ftly]
-            const Dtype *data = this->_labels->cpu_data() + this->_labels->offset(b, i);
+            const Dtype *data = labels.ptr(b, i);
 
             // If the label is -1, there are no more bounding boxes
             if (data[0] == Dtype(-1.0f)) break;
@@ -301,28 +332,28 @@ int BB3TXTLossLayer<Dtype>::_removeNegativeCoordinateDiff (int b)
 {
     int num_removed = 0;
 
+    TensorView<Dtype, 4> diff = mutableCpuView<4>(*this->_diff);
+    const Dtype *CAFFE_RESTRICT data_acc_prob = cpuView<4>(*this->_accumulator).ptr(b, 0);
+    const int count_channel = diff.shape(2) * diff.shape(3);
+
     // The channels of the accumulator go like this: probability, fblx, fbly, fbrx, fbry, rblx, rbly, ftly -
     // we want to nullify the diffs of the coordinates, thus indices 1 to 7
     for (int c = 1; c < 8; ++c)
     {
-        const Dtype *data_acc_prob = this->_accumulator->cpu_data() + this->_accumulator->offset(b, 0);
-        Dtype *data_diff_coord     = this->_diff->mutable_cpu_data() + this->_diff->offset(b, c);
+        Dtype *CAFFE_RESTRICT data_diff_coord = diff.ptr(b, c);
 
-        for (int i = 0; i < this->_accumulator->shape(2)*this->_accumulator->shape(3); ++i)
+        for (int i = 0; i < count_channel; ++i)
         {
             // This is a negative sample - nullify coordinate diff
-            if (*data_acc_prob == Dtype(0.0f))
+            if (data_acc_prob[i] == Dtype(0.0f))
             {
-                *data_diff_coord = Dtype(0.0f);
+                data_diff_coord[i] = Dtype(0.0f);
                 num_removed++;
             }
             else
             {
-                *data_diff_coord *= *data_acc_prob;
+                data_diff_coord[i] *= data_acc_prob[i];
             }
-
-            data_acc_prob++;
-            data_diff_coord++;
         }
     }
 
@@ -330,6 +361,29 @@ int BB3TXTLossLayer<Dtype>::_removeNegativeCoordinateDiff (int b)
 }
 
 
+template <typename Dtype>
+void BB3TXTLossLayer<Dtype>::_blendTeacher (int b)
+{
+    // The target (1-w)*rendered + w*teacher shifts the diff by w*(rendered-teacher). The positive and negative
+    // samples, and thus the removal of the coordinate diffs and the weighting, are still given by the rendered
+    // accumulator
+    const int count_channel = this->_diff->shape(2) * this->_diff->shape(3);
+
+    TensorView<Dtype, 4> diff              = mutableCpuView<4>(*this->_diff);
+    TensorView<const Dtype, 4> accumulator = cpuView<4>(*this->_accumulator);
+    TensorView<const Dtype, 4> teacher     = cpuView<4>(*this->_teacher);
+
+    for (int c = 0; c < this->_distill_weights.size(); ++c)
+    {
+        const Dtype w = this->_distill_weights[c];
+        if (w == Dtype(0.0f)) continue;
+
+        caffe_axpy(count_channel, w, accumulator.ptr(b, c), diff.ptr(b, c));
+        caffe_axpy(count_channel, -w, teacher.ptr(b, c), diff.ptr(b, c));
+    }
+}
+
+
 template <typename Dtype>
 void BB3TXTLossLayer<Dtype>::_computeProbabilityLoss (int b)
 {
@@ -339,24 +393,21 @@ void BB3TXTLossLayer<Dtype>::_computeProbabilityLoss (int b)
     Dtype loss_neg = Dtype(0.0f);
     Dtype loss_pos = Dtype(0.0f);
 
-    const Dtype *data_acc_prob  = this->_accumulator->cpu_data() + this->_accumulator->offset(b, 0);
-    const Dtype *data_diff_prob = this->_diff->cpu_data() + this->_diff->offset(b, 0);
+    const Dtype *CAFFE_RESTRICT data_acc_prob  = cpuView<4>(*this->_accumulator).ptr(b, 0);
+    const Dtype *CAFFE_RESTRICT data_diff_prob = cpuView<4>(*this->_diff).ptr(b, 0);
     for (int i = 0; i < count_channel; ++i)
     {
-        if (*data_acc_prob == Dtype(0.0f))
+        if (data_acc_prob[i] == Dtype(0.0f))
         {
             // Negative sample
-            loss_neg += (*data_diff_prob) * (*data_diff_prob);
+            loss_neg += data_diff_prob[i] * data_diff_prob[i];
         }
         else
         {
             // Positive sample
-            loss_pos += (*data_diff_prob) * (*data_diff_prob);
+            loss_pos += data_diff_prob[i] * data_diff_prob[i];
             num_pos++;
         }
-
-        data_acc_prob++;
-        data_diff_prob++;
     }
 
     this->_loss_prob = this->_loss_prob + (loss_pos+loss_neg) / count_channel;
@@ -376,12 +427,13 @@ void BB3TXTLossLayer<Dtype>::_applyDiffWeights (int b)
 //    const Dtype HN_THRESH   = 0.25f;
 
 
-    const Dtype* data_acc_prob  = this->_accumulator->cpu_data() + this->_accumulator->offset(b, 0);
+    const Dtype *CAFFE_RESTRICT data_acc_prob = cpuView<4>(*this->_accumulator).ptr(b, 0);
 //    const Dtype *data_diff_prob = this->_diff->cpu_data() + this->_diff->offset(b, 0);
+    TensorView<Dtype, 4> diff = mutableCpuView<4>(*this->_diff);
     std::vector<Dtype*> data_diff_m;
-    for (int c = 0; c < this->_diff->shape(1); ++c)
+    for (int c = 0; c < diff.shape(1); ++c)
     {
-        data_diff_m.push_back(this->_diff->mutable_cpu_data() + this->_diff->offset(b, c));
+        data_diff_m.push_back(diff.ptr(b, c));
     }
 
     // Number of positive pixels (samples) in this accumulator
@@ -420,7 +472,7 @@ void BB3TXTLossLayer<Dtype>::_applyDiffWeights (int b)
         }
         else
         {
-            if (*data_acc_prob > Dtype(0.0f))
+            if (data_acc_prob[i] > Dtype(0.0f))
             {
                 // Positive sample
                 for (int c = 0; c < data_diff_m.size(); ++c)
@@ -439,8 +491,6 @@ void BB3TXTLossLayer<Dtype>::_applyDiffWeights (int b)
 //                *data_diff_prob_m *= neg_diff_weight;
 //            }
         }
-
-        data_acc_prob++;
     }
 }
 
@@ -461,6 +511,8 @@ void BB3TXTLossLayer<Dtype>::_renderCoordinateCircle (cv::Mat &acc, int x, int y
     cv::circle(acc, cv::Point(x_acc, y_acc), radius-1, cv::Scalar(DUMMY), -1);
     cv::GaussianBlur(acc, acc, cv::Size(3, 3), 100);
 
+    TensorView<Dtype, 2> acc_view(acc.ptr<Dtype>(), {acc.rows, acc.cols});
+
     // Now go through the pixels in the circle's bounding box and if there is the DUMMY value compute
     // the real value
     for (int i = -radius; i <= radius; ++i)
@@ -470,10 +522,10 @@ void BB3TXTLossLayer<Dtype>::_renderCoordinateCircle (cv::Mat &acc, int x, int y
             int xp = x_acc + j;
             int yp = y_acc + i;
 
-            if (xp >= 0 && xp < acc.cols && yp >= 0 && yp < acc.rows)
+            if (xp >= 0 && xp < acc_view.shape(1) && yp >= 0 && yp < acc_view.shape(0))
             {
                 // Pixel is inside of the accumulator - check if it contains DUMMY
-                if (acc.at<Dtype>(yp, xp) > Dtype(DUMMY/100.0f))
+                if (acc_view(yp, xp) > Dtype(DUMMY/100.0f))
                 {
                     // Change its value to the actual value - coordinate relative to the pixel position
                     // The coordinates are converted to approximately [0,1], i.e. the ideal bounding box has
@@ -482,12 +534,12 @@ void BB3TXTLossLayer<Dtype>::_renderCoordinateCircle (cv::Mat &acc, int x, int y
                     if (channel == 1 || channel == 3 || channel == 5)
                     {
                         // fblx, fbrx, rblx
-                        acc.at<Dtype>(yp, xp) = Dtype(0.5f + (value-x - j*this->_scale) / this->_ideal_size);
+                        acc_view(yp, xp) = Dtype(0.5f + (value-x - j*this->_scale) / this->_ideal_size);
                     }
                     else if (channel == 2 || channel == 4 || channel == 6 || channel == 7)
                     {
                         // fbly, fbry, rbly, ftly
-                        acc.at<Dtype>(yp, xp) = Dtype(0.5f + (value-y - i*this->_scale) / this->_ideal_size);
+                        acc_view(yp, xp) = Dtype(0.5f + (value-y - i*this->_scale) / this->_ideal_size);
                     }
                 }
             }
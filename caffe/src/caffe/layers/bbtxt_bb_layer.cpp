@@ -2,6 +2,7 @@
 #include <vector>
 
 #include "caffe/layers/bbtxt_bb_layer.hpp"
+#include "caffe/util/tensor_view.hpp"
 
 namespace caffe {
 
@@ -22,18 +23,22 @@ void BBTXTBBLayer<Dtype>::Forward_cpu (const vector<Blob<Dtype>*> &bottom, const
     const Dtype ideal_size   = this->layer_param_.bbtxt_bb_param().ideal_size();
     const Dtype downsampling = this->layer_param_.bbtxt_bb_param().downsampling();
 
+    // The layer usually runs in place, therefore the views may alias each other
+    TensorView<const Dtype, 4> bottom_view = cpuView<4>(*bottom[0]);
+    TensorView<Dtype, 4> top_view          = mutableCpuView<4>(*top[0]);
+
     // For each image in the batch
-    for (int b = 0; b < bottom[0]->shape(0); ++b)
+    for (int b = 0; b < bottom_view.shape(0); ++b)
     {
         // For each channel
         for (int c = 1; c < 5; ++c)
         {
-            const Dtype* bottom_data = bottom[0]->cpu_data() + bottom[0]->offset(b, c);
-            Dtype* top_data          = top[0]->mutable_cpu_data() + top[0]->offset(b, c);
+            const Dtype* bottom_data = bottom_view.ptr(b, c);
+            Dtype* top_data          = top_view.ptr(b, c);
 
-            for (int i = 0; i < bottom[0]->shape(2); ++i)
+            for (int i = 0; i < bottom_view.shape(2); ++i)
             {
-                for (int j = 0; j < bottom[0]->shape(3); ++j)
+                for (int j = 0; j < bottom_view.shape(3); ++j)
                 {
                     // Convert the local normalized coordinate into a global unnormalized value in pixels
                     if (c == 1 || c == 3)
@@ -1,6 +1,7 @@
 #ifdef USE_OPENCV
 #include <opencv2/core/core.hpp>
 
+#include <cfloat>
 #include <fstream>  // NOLINT(readability/streams)
 #include <iostream>  // NOLINT(readability/streams)
 #include <string>
@@ -19,8 +20,7 @@
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
 #include "caffe/internal_threadpool.hpp"
-#include "caffe/util/blocking_queue.hpp"
-#include "caffe/util/blocking_counter.hpp"
+#include "caffe/util/lockfree_queue.hpp"
 
 // The maximum number of bounding boxes (annotations) in one image - we set the label blob shape according
 // to this number
@@ -57,8 +57,8 @@ namespace {
 template <typename Dtype>
 BBTXTDataLayer<Dtype>::BBTXTDataLayer (const LayerParameter &param)
     : BasePrefetchingDataLayer<Dtype>(param),
-      InternalThreadpool(std::min(int(std::max(int(boost::thread::hardware_concurrency()/2), 1)),
-                                  int(param.image_data_param().batch_size())))
+      InternalThreadpool(CPUResources::Get().numThreads(CPUResources::DATA, param.image_data_param().batch_size()),
+                         CPUResources::DATA)
 {
 }
 
@@ -91,7 +91,9 @@ void BBTXTDataLayer<Dtype>::DataLayerSetUp (const vector<Blob<Dtype>*> &bottom,
 
     // Load the BBTXT file with 2D bounding box annotations
     this->_loadBBTXTFile();
-    this->_i_global = 0;
+    this->_i_global   = 0;
+    this->_i_prefetch = 0;
+    this->_seq_epoch  = 0;
 
     CHECK(!this->_images.empty()) << "The given BBTXT file is empty!";
     LOG(INFO) << "There are " << this->_images.size() << " images in the dataset.";
@@ -114,6 +116,28 @@ void BBTXTDataLayer<Dtype>::DataLayerSetUp (const vector<Blob<Dtype>*> &bottom,
     top[1]->Reshape(label_shape);
 
 
+    if (this->phase_ == TEST && this->layer_param_.bbtxt_param().test_cache())
+    {
+        // Test crops are always the same - materialize each of them only once
+        this->_test_cache.reset(new SampleCache<Dtype>(this->_indices.size(), this->transformed_data_.count(1),
+                                                       this->transformed_label_.count(1),
+                                                       this->layer_param_.bbtxt_param().test_cache_file()));
+    }
+
+
+    if (this->layer_param_.bbtxt_param().read_ahead() > 0)
+    {
+        // Read the upcoming images asynchronously, the data threads then only decode them from memory
+        this->_prefetcher.reset(new FilePrefetcher(this->layer_param_.bbtxt_param().read_ahead_threads(),
+                                                   this->layer_param_.bbtxt_param().read_ahead()));
+        LOG(INFO) << "Reading " << this->layer_param_.bbtxt_param().read_ahead() << " images ahead"
+                  << (this->_prefetcher->usesIOUring() ? " with io_uring" : "");
+
+        std::lock_guard<std::mutex> lock(this->_i_global_mtx);
+        this->_prefetchAhead();
+    }
+
+
     // Initialize prefetching
     // We also have to reshape the prefetching blobs to the correct batch size
     for (int i = 0; i < this->prefetch_.size(); ++i)
@@ -134,6 +158,9 @@ void BBTXTDataLayer<Dtype>::load_batch (Batch<Dtype> *batch)
     CHECK(batch->data_.count());
     CHECK(this->transformed_data_.count());
 
+    CPUTimer batch_timer;
+    batch_timer.Start();
+
     const int batch_size = this->layer_param_.image_data_param().batch_size();
 
     Dtype* prefetch_data  = batch->data_.mutable_cpu_data();
@@ -145,6 +172,10 @@ void BBTXTDataLayer<Dtype>::load_batch (Batch<Dtype> *batch)
     this->_num_processed.reset();
     for (int b = 0; b < batch_size; ++b) this->_b_queue.push(b);
     this->_num_processed.waitToCount(batch_size);
+
+    batch_timer.Stop();
+    DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
+    if (this->_prefetcher) DLOG(INFO) << "Image read-ahead " << this->_prefetcher->stats();
 }
 
 
@@ -163,13 +194,33 @@ void BBTXTDataLayer<Dtype>::InternalThreadpoolEntry (int t)
             // Get index of image and bounding box we will crop
             SelectedBB<Dtype> selbb = this->_getImageAndBB();
 
-            cv::Mat cv_img = cv::imread(selbb.filename, CV_LOAD_IMAGE_COLOR);
+            Dtype *data_b  = this->transformed_data_.mutable_cpu_data() + this->transformed_data_.offset(b);
+            Dtype *label_b = this->transformed_label_.mutable_cpu_data() + this->transformed_label_.offset(b);
+
+            // The crop may already be cached from one of the previous test passes
+            if (this->_test_cache && this->_test_cache->load(selbb.index, data_b, label_b))
+            {
+                if (this->_prefetcher) this->_prefetcher->discard(selbb.seq);
+                this->_num_processed.increase();
+                continue;
+            }
+
+            // Decode the image from memory if its file was read ahead
+            cv::Mat cv_img;
+            std::vector<uchar> file;
+            if (this->_prefetcher && this->_prefetcher->take(selbb.seq, file))
+            {
+                cv_img = cv::imdecode(file, CV_LOAD_IMAGE_COLOR);
+            }
+            else
+            {
+                cv_img = cv::imread(selbb.filename, CV_LOAD_IMAGE_COLOR);
+            }
             CHECK(cv_img.data) << "Could not open " << selbb.filename;
 
             // Copy the annotation - we really have to copy it because it will be altered during image
             // transformations like cropping or scaling
-            caffe_copy(selbb.label->count(), selbb.label->cpu_data(),
-                       this->transformed_label_.mutable_cpu_data() + this->transformed_label_.offset(b));
+            caffe_copy(selbb.label->count(), selbb.label->cpu_data(), label_b);
 
             // We select a bounding box from the image and then make a crop such that the bounding box is
             // inside of it and it has the reference size (Training - we select a random bounding box to crop
@@ -177,6 +228,8 @@ void BBTXTDataLayer<Dtype>::InternalThreadpoolEntry (int t)
             // the test set is always the same)
             this->_cropAndTransform(cv_img, b, selbb.bb_id);
 
+            if (this->_test_cache) this->_test_cache->store(selbb.index, data_b, label_b);
+
             // Raise the counter on processed images
             this->_num_processed.increase();
 
@@ -274,14 +327,35 @@ void BBTXTDataLayer<Dtype>::_cropAndTransform (const cv::Mat &cv_img, int b, int
 {
     CHECK_EQ(cv_img.channels(), 3) << "Image must have 3 color channels";
 
-    // Crop this bounding box from the image
+    const int height = this->layer_param_.bbtxt_param().height();
+    const int width  = this->layer_param_.bbtxt_param().width();
+
+    // Compose all geometric transformations into one affine transformation from the image to the network
+    // input: crop (translation and scaling), then mirroring and rotation around the center of the crop. Keep
+    // the calls in this order, they draw from the random number generator
+    const cv::Mat T_crop     = this->_cropTransform(b, bb_id);
+    const cv::Mat T_flip     = this->_flipTransform();
+    const cv::Mat T_rotation = this->_rotationTransform();
+    cv::Mat T = T_rotation * T_flip * T_crop;
+
+    // The transformation works with continuous coordinates (pixel i spans [i, i+1)) like the annotations,
+    // warpAffine takes pixel centers, which are shifted by 0.5
+    cv::Mat C = cv::Mat::eye(3, 3, CV_64F);
+    C.at<double>(0, 2) = 0.5;
+    C.at<double>(1, 2) = 0.5;
+    cv::Mat C_inv = cv::Mat::eye(3, 3, CV_64F);
+    C_inv.at<double>(0, 2) = -0.5;
+    C_inv.at<double>(1, 2) = -0.5;
+    cv::Mat T_pixels = C_inv * T * C;
+
+    // Warp the image straight into the network input in one pass - the parts of the crop outside of the
+    // image stay black
     cv::Mat cv_img_cropped;
-    this->_cropBBFromImage(cv_img, cv_img_cropped, b, bb_id);
+    cv::warpAffine(cv_img, cv_img_cropped, T_pixels.rowRange(0, 2), cv::Size(width, height), cv::INTER_LINEAR,
+                   cv::BORDER_CONSTANT, cv::Scalar(0, 0, 0));
 
-    // Mirror
-    this->_flipImage(cv_img_cropped, b);
-
-    // Rotate
+    // Transform the annotations with the same transformation
+    this->_transformLabels(T, b);
 
     // Copy the cropped and transformed image to the input blob
     this->_applyPixelTransformationsAndCopyOut(cv_img_cropped, b);
@@ -289,8 +363,7 @@ void BBTXTDataLayer<Dtype>::_cropAndTransform (const cv::Mat &cv_img, int b, int
 
 
 template <typename Dtype>
-void BBTXTDataLayer<Dtype>::_cropBBFromImage (const cv::Mat &cv_img, cv::Mat &cv_img_cropped_out,
-                                              int b, int bb_id)
+cv::Mat BBTXTDataLayer<Dtype>::_cropTransform (int b, int bb_id)
 {
     // Input dimensions of the network
     const int height             = this->layer_param_.bbtxt_param().height();
@@ -353,75 +426,18 @@ void BBTXTDataLayer<Dtype>::_cropBBFromImage (const cv::Mat &cv_img, cv::Mat &cv
         crop_y = y + h/2 - crop_height/2;
     }
 
-    // Now if the crop spans outside the image we have to pad the image
-    int border_left   = (crop_x < 0) ? -crop_x : 0;
-    int border_top    = (crop_y < 0) ? -crop_y : 0;
-    int border_right  = (crop_x+crop_width  > cv_img.cols) ? (crop_x+crop_width  - cv_img.cols) : 0;
-    int border_bottom = (crop_y+crop_height > cv_img.rows) ? (crop_y+crop_height - cv_img.rows) : 0;
-
-
-    // -- CROP THE IMAGE -- //
-    // Because we want to save memory we will not use the copyMakeBorder function to create the border, but
-    // instead we will compute an intersection of the crop with the image, crop that intersection, scale it
-    // and then place it on black background to the position in which it would be cropped from
-
-    // Intersection of the crop with the image
-    int ints_width  = crop_width - border_left - border_right;
-    int ints_height = crop_height - border_top - border_bottom;
-    cv::Rect intersection(crop_x+border_left, crop_y+border_top, ints_width, ints_height);
-
-    // Scale the intersection according to the crip scaling ratio
-    int ints_width_scaled  = ints_width / size * reference_size;
-    int ints_height_scaled = ints_height / size * reference_size;
-    int border_left_scaled = border_left / size * reference_size;  // x coordinate of the crop
-    int border_top_scaled  = border_top / size * reference_size;   // y coordinate of the crop
-    // Corrections for imprecisions - we have to keep the crop inside of the network input image dimensions
-    if (ints_width_scaled > width) ints_width_scaled = width;
-    if (ints_height_scaled > height) ints_height_scaled = height;
-    if (border_left_scaled+ints_width_scaled > width) border_left_scaled = width - ints_width_scaled;
-    if (border_top_scaled+ints_height_scaled > height) border_top_scaled = height - ints_height_scaled;
-
-    CHECK_GT(ints_width_scaled, 0) << "Crop does not intersect the image";
-    CHECK_GT(ints_height_scaled, 0) << "Crop does not intersect the image";
-    CHECK_LE(ints_width_scaled, width) << "Crop larger than width: " << ints_width_scaled;
-    CHECK_LE(ints_height_scaled, height) << "Crop larger than height: " << ints_height_scaled;
-    CHECK_LE(border_left_scaled+ints_width_scaled, width) << "Moved crop does not fit in the image";
-    CHECK_LE(border_top_scaled+ints_height_scaled, height) << "Moved crop does not fit in the image";
-
-    // Crop and scale down the cropped intersection
-    cv::Mat cv_img_cropped_scaled;
-    cv::resize(cv_img(intersection), cv_img_cropped_scaled, cv::Size(ints_width_scaled, ints_height_scaled));
-
-    // Initialize the network input with black
-    cv_img_cropped_out = cv::Mat::zeros(height, width, CV_8UC3);
-
-    // Place the crop onto black canvas of the size of the network input image
-    cv::Mat cv_img_subcrop = cv_img_cropped_out(cv::Rect(border_left_scaled, border_top_scaled,
-                                                         ints_width_scaled, ints_height_scaled));
-    cv_img_cropped_scaled.copyTo(cv_img_subcrop);
-
-
-    // -- UPDATE THE COORDINATES OF THE BOUNDING BOXES -- //
-    // Update the bounding box coordinates - we need to update all annotations
-    Dtype x_scaling   = float(width) / crop_width;
-    Dtype y_scaling   = float(height) / crop_height;
-    for (int i = 0; i < MAX_NUM_BBS_PER_IMAGE; ++i)
-    {
-        // Data are stored like this [label, xmin, ymin, xmax, ymax]
-        Dtype *data = this->transformed_label_.mutable_cpu_data() + this->transformed_label_.offset(b, i);
+    // Move the crop to the origin and scale it to the network input. The crop may span outside of the
+    // image, warpAffine fills those parts with black
+    const double x_scaling = double(width) / crop_width;
+    const double y_scaling = double(height) / crop_height;
 
-        if (data[0] == Dtype(-1.0f)) break;
-
-        // Align with x, y of the crop and scale
-        data[1] = (data[1]-crop_x) * x_scaling;
-        data[2] = (data[2]-crop_y) * y_scaling;
-        data[3] = (data[3]-crop_x) * x_scaling;
-        data[4] = (data[4]-crop_y) * y_scaling;
+    cv::Mat T = cv::Mat::eye(3, 3, CV_64F);
+    T.at<double>(0, 0) = x_scaling;
+    T.at<double>(0, 2) = -crop_x * x_scaling;
+    T.at<double>(1, 1) = y_scaling;
+    T.at<double>(1, 2) = -crop_y * y_scaling;
 
-//        cv::rectangle(cv_img_cropped_out, cv::Rect(data[1], data[2], data[3]-data[1], data[4]-data[2]), cv::Scalar(0,0,255), 2);
-    }
-//    static int imi = 0;
-//    if(this->phase_ == TRAIN) cv::imwrite("cropped" + std::to_string(imi++) + ".png", cv_img_cropped_out);
+    return T;
 }
 
 
@@ -494,31 +510,99 @@ void BBTXTDataLayer<Dtype>::_applyPixelTransformationsAndCopyOut (const cv::Mat
 
 
 template <typename Dtype>
-void BBTXTDataLayer<Dtype>::_flipImage(cv::Mat &cv_img_cropped, int b)
+cv::Mat BBTXTDataLayer<Dtype>::_flipTransform ()
 {
-    if (this->phase_ == TEST) return;
+    cv::Mat T = cv::Mat::eye(3, 3, CV_64F);
+    if (this->phase_ == TEST) return T;
 
     caffe::rng_t* rng  = static_cast<caffe::rng_t*>(this->_rng->generator());
     boost::random::uniform_int_distribution<> dist(0, 1);
 
-    if (dist(*rng) == 1)
-    {
-        // Flip the image
-        cv::flip(cv_img_cropped, cv_img_cropped, 1);
+    if (dist(*rng) == 1) T = this->_flipMatrix();
+
+    return T;
+}
 
-        // Flip the annotations
-        const Dtype width = Dtype(cv_img_cropped.cols);
-        for (int i = 0; i < MAX_NUM_BBS_PER_IMAGE; ++i)
-        {
-            // Data are stored like this [label, xmin, ymin, xmax, ymax]
-            Dtype *data = this->transformed_label_.mutable_cpu_data() + this->transformed_label_.offset(b, i);
 
-            if (data[0] == Dtype(-1.0f)) break;
+template <typename Dtype>
+cv::Mat BBTXTDataLayer<Dtype>::_rotationTransform ()
+{
+    cv::Mat T = cv::Mat::eye(3, 3, CV_64F);
+    const double rotation_max = this->layer_param_.bbtxt_param().rotation_max();
+    if (this->phase_ == TEST || rotation_max <= 0.0) return T;
+
+    caffe::rng_t* rng  = static_cast<caffe::rng_t*>(this->_rng->generator());
+    boost::random::uniform_real_distribution<double> dist(-rotation_max, rotation_max);
 
-            Dtype temp = data[1];
-            data[1]  = width - data[3]; // xmax -> xmin
-            data[3]  = width - temp;    // xmin -> xmax
+    return this->_rotationMatrix(dist(*rng));
+}
+
+
+template <typename Dtype>
+cv::Mat BBTXTDataLayer<Dtype>::_flipMatrix () const
+{
+    // Mirror along the vertical axis of the network input: x -> width - x
+    cv::Mat T = cv::Mat::eye(3, 3, CV_64F);
+    T.at<double>(0, 0) = -1.0;
+    T.at<double>(0, 2) = this->layer_param_.bbtxt_param().width();
+
+    return T;
+}
+
+
+template <typename Dtype>
+cv::Mat BBTXTDataLayer<Dtype>::_rotationMatrix (double angle) const
+{
+    // Rotation around the center of the network input
+    const double cx = this->layer_param_.bbtxt_param().width() / 2.0;
+    const double cy = this->layer_param_.bbtxt_param().height() / 2.0;
+    const double alpha = std::cos(angle * CV_PI / 180.0);
+    const double beta  = std::sin(angle * CV_PI / 180.0);
+
+    cv::Mat T = cv::Mat::eye(3, 3, CV_64F);
+    T.at<double>(0, 0) = alpha;
+    T.at<double>(0, 1) = beta;
+    T.at<double>(0, 2) = (1.0-alpha)*cx - beta*cy;
+    T.at<double>(1, 0) = -beta;
+    T.at<double>(1, 1) = alpha;
+    T.at<double>(1, 2) = beta*cx + (1.0-alpha)*cy;
+
+    return T;
+}
+
+
+template <typename Dtype>
+void BBTXTDataLayer<Dtype>::_transformLabels (const cv::Mat &T, int b)
+{
+    const double a00 = T.at<double>(0, 0), a01 = T.at<double>(0, 1), a02 = T.at<double>(0, 2);
+    const double a10 = T.at<double>(1, 0), a11 = T.at<double>(1, 1), a12 = T.at<double>(1, 2);
+
+    for (int i = 0; i < MAX_NUM_BBS_PER_IMAGE; ++i)
+    {
+        // Data are stored like this [label, xmin, ymin, xmax, ymax]
+        Dtype *data = this->transformed_label_.mutable_cpu_data() + this->transformed_label_.offset(b, i);
+
+        if (data[0] == Dtype(-1.0f)) break;
+
+        // Transform all 4 corners - the new bounding box is the bounding box of the transformed corners (this
+        // also swaps xmin and xmax when mirroring)
+        double xmin = DBL_MAX, ymin = DBL_MAX, xmax = -DBL_MAX, ymax = -DBL_MAX;
+        for (int c = 0; c < 4; ++c)
+        {
+            const double x = (c & 1) ? data[3] : data[1];
+            const double y = (c & 2) ? data[4] : data[2];
+            const double xt = a00*x + a01*y + a02;
+            const double yt = a10*x + a11*y + a12;
+            xmin = std::min(xmin, xt);
+            ymin = std::min(ymin, yt);
+            xmax = std::max(xmax, xt);
+            ymax = std::max(ymax, yt);
         }
+
+        data[1] = xmin;
+        data[2] = ymin;
+        data[3] = xmax;
+        data[4] = ymax;
     }
 }
 
@@ -529,23 +613,51 @@ SelectedBB<Dtype> BBTXTDataLayer<Dtype>::_getImageAndBB ()
     std::lock_guard<std::mutex> lock(this->_i_global_mtx);
 
     // Get image and bounding box index
-    auto indices = this->_indices[this->_i_global++];
+    const int index = this->_i_global++;
+    auto indices = this->_indices[index];
+    const long seq = this->_seq_epoch + index;
 
     if (this->_i_global >= this->_indices.size())
     {
         this->_i_global = 0;  // Restart
         if (this->phase_ == TRAIN) this->_shuffleBoundingBoxes();
+
+        this->_seq_epoch += this->_indices.size();
+        this->_i_prefetch = 0;
+        if (this->_prefetcher) LOG(INFO) << "Epoch finished, image read-ahead " << this->_prefetcher->stats();
     }
 
+    // Keep the reads of the upcoming images in flight
+    if (this->_prefetcher) this->_prefetchAhead();
+
     SelectedBB<Dtype> sel;
     sel.filename = this->_images[indices.first].first;
     sel.label    = this->_images[indices.first].second;
     sel.bb_id    = indices.second;
+    sel.index    = index;
+    sel.seq      = seq;
 
     return sel;
 }
 
 
+template <typename Dtype>
+void BBTXTDataLayer<Dtype>::_prefetchAhead ()
+{
+    // All test crops are cached - the images will not be needed anymore
+    if (this->_test_cache && this->_test_cache->numCached() == this->_test_cache->numSamples()) return;
+
+    // Only the order of the current epoch is known, the next one is shuffled when this one ends
+    const int end = std::min(int(this->_indices.size()),
+                             this->_i_global + int(this->layer_param_.bbtxt_param().read_ahead()));
+    for (; this->_i_prefetch < end; ++this->_i_prefetch)
+    {
+        const std::string &filename = this->_images[this->_indices[this->_i_prefetch].first].first;
+        this->_prefetcher->prefetch(this->_seq_epoch + this->_i_prefetch, filename);
+    }
+}
+
+
 // ----------------------------------------  LAYER INSTANTIATION  ---------------------------------------- //
 
 INSTANTIATE_CLASS(BBTXTDataLayer);
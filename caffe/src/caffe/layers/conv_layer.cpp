@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/conv_layer.hpp"
@@ -25,15 +26,24 @@ template <typename Dtype>
 void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const Dtype* weight = this->blobs_[0]->cpu_data();
+  const int batch = this->batched_gemm_images();
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* top_data = top[i]->mutable_cpu_data();
-    for (int n = 0; n < this->num_; ++n) {
-      this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
-          top_data + n * this->top_dim_);
+    for (int n = 0; n < this->num_; n += batch) {
+      const int num = std::min(batch, this->num_ - n);
+      if (num > 1) {
+        this->forward_cpu_gemm_batched(bottom_data + n * this->bottom_dim_,
+            weight, top_data + n * this->top_dim_, num);
+      } else {
+        this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
+            top_data + n * this->top_dim_);
+      }
       if (this->bias_term_) {
         const Dtype* bias = this->blobs_[1]->cpu_data();
-        this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
+        for (int m = n; m < n + num; ++m) {
+          this->forward_cpu_bias(top_data + m * this->top_dim_, bias);
+        }
       }
     }
   }
@@ -44,6 +54,7 @@ void ConvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
   const Dtype* weight = this->blobs_[0]->cpu_data();
   Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
+  const int batch = this->batched_gemm_images();
   for (int i = 0; i < top.size(); ++i) {
     const Dtype* top_diff = top[i]->cpu_diff();
     const Dtype* bottom_data = bottom[i]->cpu_data();
@@ -56,7 +67,22 @@ void ConvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       }
     }
     if (this->param_propagate_down_[0] || propagate_down[i]) {
-      for (int n = 0; n < this->num_; ++n) {
+      for (int n = 0; n < this->num_; n += batch) {
+        const int num = std::min(batch, this->num_ - n);
+        if (num > 1) {
+          // The top diff gathered for the weight gradient is reused for the
+          // bottom gradient.
+          if (this->param_propagate_down_[0]) {
+            this->weight_cpu_gemm_batched(bottom_data + n * this->bottom_dim_,
+                top_diff + n * this->top_dim_, weight_diff, num);
+          }
+          if (propagate_down[i]) {
+            this->backward_cpu_gemm_batched(top_diff + n * this->top_dim_,
+                weight, bottom_diff + n * this->bottom_dim_, num,
+                this->param_propagate_down_[0]);
+          }
+          continue;
+        }
         // gradient w.r.t. weight. Note that we will accumulate diffs.
         if (this->param_propagate_down_[0]) {
           this->weight_cpu_gemm(bottom_data + n * this->bottom_dim_,
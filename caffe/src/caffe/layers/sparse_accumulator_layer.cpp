@@ -0,0 +1,147 @@
+#include <vector>
+
+#include "caffe/filler.hpp"
+#include "caffe/layers/sparse_accumulator_layer.hpp"
+#include "caffe/util/detection.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/tensor_view.hpp"
+
+namespace caffe {
+
+
+template <typename Dtype>
+SparseAccumulatorLayer<Dtype>::SparseAccumulatorLayer (const LayerParameter &param)
+    : Layer<Dtype>(param)
+{
+    CHECK(param.has_convolution_param()) << "ConvolutionParameter is mandatory!";
+    CHECK(isPointwiseConvolution(param.convolution_param())) << "SparseAccumulator layer '" << param.name()
+        << "' only supports 1x1 convolutions with stride 1 and no padding or groups!";
+}
+
+
+template <typename Dtype>
+void SparseAccumulatorLayer<Dtype>::LayerSetUp (const vector<Blob<Dtype>*> &bottom,
+                                                const vector<Blob<Dtype>*> &top)
+{
+    const ConvolutionParameter &conv_param = this->layer_param_.convolution_param();
+
+    CHECK_EQ(bottom[0]->num_axes(), 4) << "Input of the accumulator must be 4 dimensional";
+    this->_num_output = conv_param.num_output();
+    this->_channels   = bottom[0]->shape(1);
+    this->_bias_term  = conv_param.bias_term();
+    CHECK_GT(this->_num_output, 0) << "Accumulator must have at least the probability channel";
+
+    // The weight blobs have the same shapes as the blobs of a 1x1 convolution
+    const vector<int> weight_shape = { this->_num_output, this->_channels, 1, 1 };
+    const vector<int> bias_shape   = { this->_num_output };
+
+    if (this->blobs_.size() > 0)
+    {
+        CHECK_EQ(1 + this->_bias_term, this->blobs_.size()) << "Incorrect number of weight blobs.";
+        CHECK(weight_shape == this->blobs_[0]->shape()) << "Incorrect weight shape "
+                                                        << this->blobs_[0]->shape_string();
+        CHECK(!this->_bias_term || bias_shape == this->blobs_[1]->shape()) << "Incorrect bias shape "
+                                                                           << this->blobs_[1]->shape_string();
+        LOG(INFO) << "Skipping parameter initialization";
+    }
+    else
+    {
+        this->blobs_.resize(this->_bias_term ? 2 : 1);
+
+        this->blobs_[0].reset(new Blob<Dtype>(weight_shape));
+        shared_ptr<Filler<Dtype>> weight_filler(GetFiller<Dtype>(conv_param.weight_filler()));
+        weight_filler->Fill(this->blobs_[0].get());
+
+        if (this->_bias_term)
+        {
+            this->blobs_[1].reset(new Blob<Dtype>(bias_shape));
+            shared_ptr<Filler<Dtype>> bias_filler(GetFiller<Dtype>(conv_param.bias_filler()));
+            bias_filler->Fill(this->blobs_[1].get());
+        }
+    }
+
+    this->param_propagate_down_.resize(this->blobs_.size(), false);
+}
+
+
+template <typename Dtype>
+void SparseAccumulatorLayer<Dtype>::Reshape (const vector<Blob<Dtype>*> &bottom, const vector<Blob<Dtype>*> &top)
+{
+    CHECK_EQ(bottom[0]->num_axes(), 4) << "Input of the accumulator must be 4 dimensional";
+    CHECK_EQ(bottom[0]->shape(1), this->_channels) << "Number of input channels cannot change";
+
+    top[0]->Reshape(bottom[0]->shape(0), this->_num_output, bottom[0]->shape(2), bottom[0]->shape(3));
+}
+
+
+template <typename Dtype>
+void SparseAccumulatorLayer<Dtype>::Forward_cpu (const vector<Blob<Dtype>*> &bottom,
+                                                 const vector<Blob<Dtype>*> &top)
+{
+    const Dtype min_conf = this->layer_param_.sparse_accumulator_param().min_conf();
+
+    TensorView<const Dtype, 4> bottom_view = cpuView<4>(*bottom[0]);
+    TensorView<Dtype, 4> top_view          = mutableCpuView<4>(*top[0]);
+    // Weights are num_output x channels
+    const Dtype *CAFFE_RESTRICT weights    = this->blobs_[0]->cpu_data();
+    const Dtype *CAFFE_RESTRICT bias       = this->_bias_term ? this->blobs_[1]->cpu_data() : nullptr;
+
+    const int height  = bottom_view.shape(2);
+    const int width   = bottom_view.shape(3);
+    const int spatial = height * width;
+
+    // For each image in the batch
+    for (int b = 0; b < bottom_view.shape(0); ++b)
+    {
+        const Dtype *CAFFE_RESTRICT input = bottom_view.ptr(b);
+        Dtype *CAFFE_RESTRICT acc_prob    = top_view.ptr(b, 0);
+
+        // Probability channel - the input is a channels x spatial matrix, the probability is its product with
+        // the first filter
+        caffe_cpu_gemv<Dtype>(CblasTrans, this->_channels, spatial, Dtype(1), input, weights, Dtype(0),
+                              acc_prob);
+        if (this->_bias_term) caffe_add_scalar<Dtype>(spatial, bias[0], acc_prob);
+
+        if (this->_num_output == 1) continue;
+
+        // Coordinate channels - only in the local maxima, which are extracted as bounding boxes
+        caffe_set<Dtype>((this->_num_output-1) * spatial, Dtype(0), top_view.ptr(b, 1));
+
+        for (int i = 0; i < height; ++i)
+        {
+            for (int j = 0; j < width; ++j)
+            {
+                if (acc_prob[i*width + j] < min_conf || !isLocalMaximum(acc_prob, height, width, i, j)) continue;
+
+                const int idx = i*width + j;
+                for (int c = 1; c < this->_num_output; ++c)
+                {
+                    const Dtype *CAFFE_RESTRICT filter = weights + c*this->_channels;
+
+                    Dtype value = this->_bias_term ? bias[c] : Dtype(0);
+                    for (int k = 0; k < this->_channels; ++k) value += filter[k] * input[k*spatial + idx];
+
+                    top_view(b, c, i, j) = value;
+                }
+            }
+        }
+    }
+}
+
+
+template <typename Dtype>
+void SparseAccumulatorLayer<Dtype>::Backward_cpu (const vector<Blob<Dtype>*> &top,
+                                                  const vector<bool> &propagate_down,
+                                                  const vector<Blob<Dtype>*> &bottom)
+{
+    CHECK(false) << "SparseAccumulatorLayer implements only the forward pass!";
+}
+
+
+// ----------------------------------------  LAYER INSTANTIATION  ---------------------------------------- //
+
+INSTANTIATE_CLASS(SparseAccumulatorLayer);
+REGISTER_LAYER_CLASS(SparseAccumulator);
+
+
+}  // namespace caffe
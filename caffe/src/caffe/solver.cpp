@@ -1,12 +1,15 @@
+#include <boost/thread.hpp>
 #include <cstdio>
 
 #include <string>
 #include <vector>
 
 #include "caffe/solver.hpp"
+#include "caffe/util/cpu_resources.hpp"
 #include "caffe/util/format.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 namespace caffe {
@@ -39,6 +42,11 @@ Solver<Dtype>::Solver(const string& param_file)
   Init(param);
 }
 
+template <typename Dtype>
+Solver<Dtype>::~Solver() {
+  WaitForAsyncTest(true);
+}
+
 template <typename Dtype>
 void Solver<Dtype>::Init(const SolverParameter& param) {
   LOG_IF(INFO, Caffe::root_solver()) << "Initializing solver from parameters: "
@@ -292,6 +300,7 @@ void Solver<Dtype>::Solve(const char* resume_file) {
     Snapshot();
   }
   if (requested_early_exit_) {
+    WaitForAsyncTest(true);
     LOG(INFO) << "Optimization stopped early.";
     return;
   }
@@ -313,11 +322,16 @@ void Solver<Dtype>::Solve(const char* resume_file) {
   if (param_.test_interval() && iter_ % param_.test_interval() == 0) {
     TestAll();
   }
+  WaitForAsyncTest();
   LOG(INFO) << "Optimization Done.";
 }
 
 template <typename Dtype>
 void Solver<Dtype>::TestAll() {
+  if (param_.test_async()) {
+    TestAllAsync();
+    return;
+  }
   for (int test_net_id = 0;
        test_net_id < test_nets_.size() && !requested_early_exit_;
        ++test_net_id) {
@@ -332,24 +346,36 @@ void Solver<Dtype>::Test(const int test_net_id) {
             << ", Testing net (#" << test_net_id << ")";
   CHECK_NOTNULL(test_nets_[test_net_id].get())->
       ShareTrainedLayersWith(net_.get());
+  TestNet(test_net_id, iter_, false);
+}
+
+template <typename Dtype>
+void Solver<Dtype>::TestNet(const int test_net_id, const int iter,
+    const bool async) {
   vector<Dtype> test_score;
   vector<int> test_score_output_id;
   const shared_ptr<Net<Dtype> >& test_net = test_nets_[test_net_id];
   Dtype loss = 0;
   for (int i = 0; i < param_.test_iter(test_net_id); ++i) {
-    SolverAction::Enum request = GetRequestedAction();
-    // Check to see if stoppage of testing/training has been requested.
-    while (request != SolverAction::NONE) {
-        if (SolverAction::SNAPSHOT == request) {
-          Snapshot();
-        } else if (SolverAction::STOP == request) {
-          requested_early_exit_ = true;
-        }
-        request = GetRequestedAction();
-    }
-    if (requested_early_exit_) {
-      // break out of test loop.
-      break;
+    if (async) {
+      // The training thread handles the requested actions and interrupts
+      // this thread if it should stop
+      boost::this_thread::interruption_point();
+    } else {
+      SolverAction::Enum request = GetRequestedAction();
+      // Check to see if stoppage of testing/training has been requested.
+      while (request != SolverAction::NONE) {
+          if (SolverAction::SNAPSHOT == request) {
+            Snapshot();
+          } else if (SolverAction::STOP == request) {
+            requested_early_exit_ = true;
+          }
+          request = GetRequestedAction();
+      }
+      if (requested_early_exit_) {
+        // break out of test loop.
+        break;
+      }
     }
 
     Dtype iter_loss;
@@ -376,13 +402,20 @@ void Solver<Dtype>::Test(const int test_net_id) {
       }
     }
   }
-  if (requested_early_exit_) {
+  if (!async && requested_early_exit_) {
     LOG(INFO)     << "Test interrupted.";
     return;
   }
+  // Asynchronous results are interleaved with the training log, tag them with
+  // the iteration the weights were taken at
+  ostringstream iter_stream;
+  if (async) {
+    iter_stream << "Iteration " << iter << ", ";
+  }
+  const string iter_prefix = iter_stream.str();
   if (param_.test_compute_loss()) {
     loss /= param_.test_iter(test_net_id);
-    LOG(INFO) << "Test loss: " << loss;
+    LOG(INFO) << iter_prefix << "Test loss: " << loss;
   }
   for (int i = 0; i < test_score.size(); ++i) {
     const int output_blob_index =
@@ -395,9 +428,76 @@ void Solver<Dtype>::Test(const int test_net_id) {
       loss_msg_stream << " (* " << loss_weight
                       << " = " << loss_weight * mean_score << " loss)";
     }
-    LOG(INFO) << "    Test net output #" << i << ": " << output_name << " = "
-              << mean_score << loss_msg_stream.str();
+    LOG(INFO) << (async ? iter_prefix : "    ") << "Test net output #" << i
+              << ": " << output_name << " = " << mean_score
+              << loss_msg_stream.str();
+  }
+}
+
+template <typename Dtype>
+void Solver<Dtype>::TestAllAsync() {
+  CHECK(Caffe::root_solver());
+  if (test_thread_ &&
+      !test_thread_->timed_join(boost::posix_time::seconds(0))) {
+    LOG(WARNING) << "Iteration " << iter_ << ", waiting for the previous "
+                 << "asynchronous test to finish (increase test_interval)";
+  }
+  WaitForAsyncTest();
+  if (requested_early_exit_) return;
+  // The test nets keep their own copy of the weights, so the training can go
+  // on updating the train net while they are being evaluated
+  for (int test_net_id = 0; test_net_id < test_nets_.size(); ++test_net_id) {
+    CHECK_NOTNULL(test_nets_[test_net_id].get())->
+        CopyTrainedLayersFrom(net_.get());
+  }
+
+  int device = 0;
+#ifndef CPU_ONLY
+  CUDA_CHECK(cudaGetDevice(&device));
+#endif
+  try {
+    test_thread_.reset(new boost::thread(&Solver<Dtype>::TestAllAsyncEntry,
+          this, iter_, device, Caffe::mode(), caffe_rng_rand()));
+  } catch (std::exception& e) {
+    LOG(FATAL) << "Thread exception: " << e.what();
+  }
+}
+
+template <typename Dtype>
+void Solver<Dtype>::TestAllAsyncEntry(int iter, int device, Caffe::Brew mode,
+    int rand_seed) {
+#ifndef CPU_ONLY
+  CUDA_CHECK(cudaSetDevice(device));
+#endif
+  Caffe::set_mode(mode);
+  Caffe::set_random_seed(rand_seed);
+  CPUResources::Get().pinThreadToTail(CPUResources::COMPUTE,
+      param_.test_async_cores());
+
+  try {
+    for (int test_net_id = 0; test_net_id < test_nets_.size(); ++test_net_id) {
+      LOG(INFO) << "Iteration " << iter
+                << ", Testing net (#" << test_net_id << ") asynchronously";
+      TestNet(test_net_id, iter, true);
+    }
+  } catch (boost::thread_interrupted&) {
+    LOG(INFO) << "Iteration " << iter << ", Test interrupted.";
+  }
+}
+
+template <typename Dtype>
+void Solver<Dtype>::WaitForAsyncTest(bool interrupt) {
+  if (!test_thread_) return;
+  if (interrupt) {
+    test_thread_->interrupt();
+  }
+  try {
+    test_thread_->join();
+  } catch (boost::thread_interrupted&) {
+  } catch (std::exception& e) {
+    LOG(FATAL) << "Thread exception: " << e.what();
   }
+  test_thread_.reset();
 }
 
 template <typename Dtype>
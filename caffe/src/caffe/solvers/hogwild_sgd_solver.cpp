@@ -0,0 +1,231 @@
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <vector>
+
+#include "caffe/sgd_solvers.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/cpu_resources.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Bounds the staleness of the asynchronous updates. Each thread publishes the
+// iteration it is starting, a thread does not start an iteration more than
+// max_lag iterations ahead of the slowest running thread. A thread, which is
+// too far ahead, sleeps until the slowest one moves on - the root thread may be
+// testing or writing a snapshot for a long time.
+class HogwildLag {
+ public:
+  HogwildLag(int num_threads, int start_iter, int max_lag)
+      : iters_(num_threads, start_iter), max_lag_(max_lag), stop_(false) {}
+
+  void Start(int rank, int iter) {
+    boost::mutex::scoped_lock lock(mutex_);
+    iters_[rank] = iter;
+    changed_.notify_all();
+    if (max_lag_ < 0) return;
+    while (iter - Slowest() > max_lag_ && !stop_.load()) {
+      changed_.wait(lock);
+    }
+  }
+  // The thread finished its iterations and does not hold the others back
+  void Finish(int rank) {
+    boost::mutex::scoped_lock lock(mutex_);
+    iters_[rank] = INT_MAX;
+    changed_.notify_all();
+  }
+  // Requests all threads to stop (e.g. the root solver stopped early)
+  void Stop() {
+    boost::mutex::scoped_lock lock(mutex_);
+    stop_.store(true);
+    changed_.notify_all();
+  }
+  SolverAction::Enum RequestedAction() const {
+    return stop_.load() ? SolverAction::STOP : SolverAction::NONE;
+  }
+
+ private:
+  int Slowest() const {
+    return *std::min_element(iters_.begin(), iters_.end());
+  }
+
+  boost::mutex mutex_;
+  boost::condition_variable changed_;
+  vector<int> iters_;
+  const int max_lag_;
+  std::atomic<bool> stop_;
+};
+
+template <typename Dtype>
+class HogwildCallback : public Solver<Dtype>::Callback {
+ public:
+  HogwildCallback(const Solver<Dtype>* solver, int rank, HogwildLag* lag)
+      : solver_(solver), rank_(rank), lag_(lag) {}
+
+ protected:
+  void on_start() { lag_->Start(rank_, solver_->iter()); }
+  void on_gradients_ready() {}
+
+  const Solver<Dtype>* solver_;
+  const int rank_;
+  HogwildLag* lag_;
+};
+
+// Solver of the non-root threads - plain SGD on a replica of the train net
+template <typename Dtype>
+class HogwildWorker : public SGDSolver<Dtype> {
+ public:
+  explicit HogwildWorker(const SolverParameter& param)
+      : SGDSolver<Dtype>(param) {}
+
+  void Run(int start_iter, int current_step, int iters) {
+    this->iter_ = start_iter;
+    this->current_step_ = current_step;
+    SGDSolver<Dtype>::Step(iters);
+  }
+};
+
+// Net setup is serialized, not all data layers can be set up concurrently
+// (e.g. the HDF5 library is not thread safe)
+boost::mutex setup_mutex;
+
+template <typename Dtype>
+void HogwildWorkerEntry(const SolverParameter& param, int rank,
+    int num_threads, const Net<Dtype>* root_net, int start_iter,
+    int current_step, int iters, HogwildLag* lag, int* iters_done) {
+  Caffe::set_mode(Caffe::CPU);
+  Caffe::set_solver_count(num_threads);
+  Caffe::set_solver_rank(rank);
+  CPUResources::Get().pinThread(CPUResources::COMPUTE, rank);
+
+  shared_ptr<HogwildWorker<Dtype> > worker;
+  {
+    boost::mutex::scoped_lock lock(setup_mutex);
+    worker.reset(new HogwildWorker<Dtype>(param));
+    worker->net()->ShareTrainedLayersWith(root_net);
+  }
+  HogwildCallback<Dtype> callback(worker.get(), rank, lag);
+  worker->add_callback(&callback);
+  worker->SetActionFunction([lag] () { return lag->RequestedAction(); });
+
+  worker->Run(start_iter, current_step, iters);
+  lag->Finish(rank);
+  *iters_done = worker->iter() - start_iter;
+}
+
+int HogwildThreads(const SolverParameter& param) {
+  return (param.hogwild_threads() > 0) ? param.hogwild_threads()
+      : CPUResources::Get().numThreads(CPUResources::COMPUTE);
+}
+
+// Solver count of the constructing thread, restored after the root net is set
+// up
+thread_local int constructor_solver_count = 1;
+
+}  // namespace
+
+template <typename Dtype>
+const SolverParameter& HogwildSGDSolver<Dtype>::ShareRootData(
+    const SolverParameter& param) {
+  // The prefetching threads of the data layers copy the solver count when
+  // they start, the root net has to be set up as rank 0 of all the threads
+  constructor_solver_count = Caffe::solver_count();
+  if (HogwildThreads(param) > 1) {
+    CHECK(Caffe::root_solver());
+    Caffe::set_solver_count(HogwildThreads(param));
+  }
+  return param;
+}
+
+template <typename Dtype>
+SolverParameter HogwildSGDSolver<Dtype>::ShareRootData(
+    const string& param_file) {
+  SolverParameter param;
+  ReadSolverParamsFromTextFileOrDie(param_file, &param);
+  ShareRootData(param);
+  return param;
+}
+
+template <typename Dtype>
+void HogwildSGDSolver<Dtype>::HogwildPreSolve() {
+  Caffe::set_solver_count(constructor_solver_count);
+  num_threads_ = HogwildThreads(this->param_);
+}
+
+template <typename Dtype>
+void HogwildSGDSolver<Dtype>::Step(int iters) {
+  if (num_threads_ == 1) {
+    SGDSolver<Dtype>::Step(iters);
+    return;
+  }
+  CHECK(Caffe::root_solver());
+  CHECK_EQ(Caffe::mode(), Caffe::CPU)
+      << "The HogwildSGD solver only runs on the CPU";
+  LOG(INFO) << "Running " << num_threads_ << " Hogwild threads, max lag "
+      << this->param_.hogwild_max_lag();
+
+  // The workers are plain SGD solvers with the same train net
+  SolverParameter worker_param(this->param_);
+  worker_param.set_type("SGD");
+  worker_param.set_hogwild_threads(1);
+
+  // The parameters must be on the CPU before they are shared, so that the
+  // threads do not race on the synced memory state
+  const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
+  for (int i = 0; i < net_params.size(); ++i) {
+    net_params[i]->mutable_cpu_data();
+  }
+
+  // The data layers of the workers shard the data by their rank, the root net
+  // was set up as rank 0 of num_threads_ already
+  const int solver_count = Caffe::solver_count();
+  Caffe::set_solver_count(num_threads_);
+
+  const int start_iter = this->iter_;
+  HogwildLag lag(num_threads_, start_iter, this->param_.hogwild_max_lag());
+  HogwildCallback<Dtype> callback(this, 0, &lag);
+  this->add_callback(&callback);
+
+  vector<int> iters_done(num_threads_, 0);
+  vector<shared_ptr<boost::thread> > workers;
+  CPUTimer timer;
+  timer.Start();
+  for (int rank = 1; rank < num_threads_; ++rank) {
+    workers.push_back(shared_ptr<boost::thread>(new boost::thread(
+        &HogwildWorkerEntry<Dtype>, boost::cref(worker_param), rank,
+        num_threads_, this->net_.get(), start_iter, this->current_step_,
+        iters, &lag, &iters_done[rank])));
+  }
+
+  SGDSolver<Dtype>::Step(iters);
+  lag.Finish(0);
+  if (this->requested_early_exit_) {
+    lag.Stop();
+  }
+  for (int i = 0; i < workers.size(); ++i) {
+    workers[i]->join();
+  }
+  iters_done[0] = this->iter_ - start_iter;
+  const float seconds = timer.Seconds();
+
+  this->callbacks_.erase(std::find(this->callbacks_.begin(),
+      this->callbacks_.end(), &callback));
+  Caffe::set_solver_count(solver_count);
+
+  int total_iters = 0;
+  for (int i = 0; i < iters_done.size(); ++i) {
+    total_iters += iters_done[i];
+  }
+  LOG(INFO) << "Hogwild: " << num_threads_ << " threads applied "
+      << total_iters << " updates in " << seconds << " s ("
+      << total_iters / (seconds ? seconds : 1) << " updates/s)";
+}
+
+INSTANTIATE_CLASS(HogwildSGDSolver);
+REGISTER_SOLVER_CLASS(HogwildSGD);
+
+}  // namespace caffe
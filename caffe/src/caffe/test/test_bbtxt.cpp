@@ -0,0 +1,75 @@
+#ifdef USE_OPENCV
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/bbtxt.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class BBTXTFileTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    MakeTempFilename(&path_);
+  }
+
+  virtual void TearDown() {
+    std::remove(path_.c_str());
+  }
+
+  void WriteFile(const string& content) {
+    std::ofstream(path_.c_str()) << content;
+  }
+
+  string path_;
+};
+
+TEST_F(BBTXTFileTest, TestReadBB3TXT) {
+  // [filename label confidence xmin ymin xmax ymax fblx fbly fbrx fbry rblx
+  // rbly ftly]
+  WriteFile("a.png 1 0.9 10 20 110 80 12 78 90 79 105 70 25\n"
+            "b.png 2 0.5 1 2 3 4 5 6 7 8 9 10 11\n"
+            "a.png 1 0.25 0 0 50 40 2 39 30 38 48 35 3\n");
+  const std::map<string, vector<BB3D> > bbs = readBB3TXTFile(path_);
+  ASSERT_EQ(2, bbs.size());
+  ASSERT_EQ(2, bbs.at("a.png").size());
+  ASSERT_EQ(1, bbs.at("b.png").size());
+
+  const BB3D& bb = bbs.at("a.png")[0];
+  EXPECT_EQ("a.png", bb.path_image);
+  EXPECT_EQ(1, bb.label);
+  EXPECT_DOUBLE_EQ(0.9, bb.conf);
+  EXPECT_DOUBLE_EQ(10, bb.xmin);
+  EXPECT_DOUBLE_EQ(20, bb.ymin);
+  EXPECT_DOUBLE_EQ(110, bb.xmax);
+  EXPECT_DOUBLE_EQ(80, bb.ymax);
+  EXPECT_DOUBLE_EQ(12, bb.fblx);
+  EXPECT_DOUBLE_EQ(78, bb.fbly);
+  EXPECT_DOUBLE_EQ(90, bb.fbrx);
+  EXPECT_DOUBLE_EQ(79, bb.fbry);
+  EXPECT_DOUBLE_EQ(105, bb.rblx);
+  EXPECT_DOUBLE_EQ(70, bb.rbly);
+  EXPECT_DOUBLE_EQ(25, bb.ftly);
+
+  // The boxes of one image keep the order of the file
+  EXPECT_DOUBLE_EQ(0.25, bbs.at("a.png")[1].conf);
+  EXPECT_EQ(2, bbs.at("b.png")[0].label);
+  EXPECT_DOUBLE_EQ(11, bbs.at("b.png")[0].ftly);
+}
+
+TEST_F(BBTXTFileTest, TestReadBB3TXTCorrupted) {
+  // A BBTXT line is missing the 3D coordinates
+  WriteFile("a.png 1 0.9 10 20 110 80\n");
+  EXPECT_DEATH(readBB3TXTFile(path_), "corrupted");
+}
+
+}  // namespace caffe
+#endif  // USE_OPENCV
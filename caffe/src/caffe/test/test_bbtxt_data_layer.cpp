@@ -0,0 +1,158 @@
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/bbtxt_data_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+// Exposes the geometric transformations of the layer, the mirroring and the
+// rotation are given instead of random
+class TransformBBTXTDataLayer : public BBTXTDataLayer<float> {
+ public:
+  explicit TransformBBTXTDataLayer(const LayerParameter& param)
+      : BBTXTDataLayer<float>(param), flip_(false), angle_(0) {
+    _rng.reset(new Caffe::RNG(1701));
+    transformed_data_.Reshape(1, 3, 96, 96);
+    transformed_label_.Reshape(vector<int>{1, 20, 5});
+  }
+
+  // Sets the annotation of the image, 4 coordinates per bounding box
+  void SetLabels(const vector<float>& bbs) {
+    float* label = transformed_label_.mutable_cpu_data();
+    for (int i = 0; i < bbs.size() / 4; ++i) {
+      label[5 * i] = 1;
+      std::copy(bbs.begin() + 4 * i, bbs.begin() + 4 * i + 4,
+                label + 5 * i + 1);
+    }
+    label[bbs.size() / 4 * 5] = -1;
+  }
+
+  const float* Label(int i) const {
+    return transformed_label_.cpu_data() + transformed_label_.offset(0, i);
+  }
+
+  const float* Data(int c) const {
+    return transformed_data_.cpu_data() + transformed_data_.offset(0, c);
+  }
+
+  using BBTXTDataLayer<float>::_cropAndTransform;
+  using BBTXTDataLayer<float>::_cropTransform;
+  using BBTXTDataLayer<float>::_flipMatrix;
+  using BBTXTDataLayer<float>::_rotationMatrix;
+  using BBTXTDataLayer<float>::_transformLabels;
+
+  bool flip_;
+  double angle_;
+
+ protected:
+  virtual cv::Mat _flipTransform() {
+    return flip_ ? _flipMatrix() : cv::Mat(cv::Mat::eye(3, 3, CV_64F));
+  }
+
+  virtual cv::Mat _rotationTransform() {
+    return _rotationMatrix(angle_);
+  }
+};
+
+class BBTXTDataLayerTest : public ::testing::Test {
+ protected:
+  BBTXTDataLayerTest() {
+    layer_param_.set_phase(TEST);
+    layer_param_.mutable_image_data_param()->set_batch_size(1);
+    BBTXTParameter* bbtxt_param = layer_param_.mutable_bbtxt_param();
+    bbtxt_param->set_width(96);
+    bbtxt_param->set_height(96);
+    bbtxt_param->set_reference_size_min(20);
+    bbtxt_param->set_reference_size_max(40);
+  }
+
+  // The crop is centered on the first (80x60) box and scaled 0.5 to get it to
+  // the reference size 40: x -> 0.5x - 22, y -> 0.5y - 17
+  void SetLabels(TransformBBTXTDataLayer* layer) {
+    layer->SetLabels({100, 100, 180, 160, 60, 80, 100, 120});
+  }
+
+  void ExpectLabel(const TransformBBTXTDataLayer& layer, int i, float xmin,
+                   float ymin, float xmax, float ymax) {
+    EXPECT_NEAR(xmin, layer.Label(i)[1], 1e-4);
+    EXPECT_NEAR(ymin, layer.Label(i)[2], 1e-4);
+    EXPECT_NEAR(xmax, layer.Label(i)[3], 1e-4);
+    EXPECT_NEAR(ymax, layer.Label(i)[4], 1e-4);
+  }
+
+  LayerParameter layer_param_;
+};
+
+TEST_F(BBTXTDataLayerTest, TestCropTransform) {
+  TransformBBTXTDataLayer layer(layer_param_);
+  SetLabels(&layer);
+
+  const cv::Mat T = layer._cropTransform(0, 0);
+  EXPECT_NEAR(0.5, T.at<double>(0, 0), 1e-9);
+  EXPECT_NEAR(-22, T.at<double>(0, 2), 1e-9);
+  EXPECT_NEAR(0.5, T.at<double>(1, 1), 1e-9);
+  EXPECT_NEAR(-17, T.at<double>(1, 2), 1e-9);
+
+  layer._transformLabels(T, 0);
+  ExpectLabel(layer, 0, 28, 33, 68, 63);
+  ExpectLabel(layer, 1, 8, 23, 28, 43);
+  EXPECT_EQ(-1, layer.Label(2)[0]);
+}
+
+TEST_F(BBTXTDataLayerTest, TestFlipAndRotation) {
+  TransformBBTXTDataLayer layer(layer_param_);
+  SetLabels(&layer);
+
+  // Mirroring x -> 96 - x, rotation by 90 degrees around the center (48, 48)
+  // x -> y, y -> 96 - x
+  const cv::Mat R = layer._rotationMatrix(90);
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_NEAR(48, R.at<double>(i, 0) * 48 + R.at<double>(i, 1) * 48
+                    + R.at<double>(i, 2), 1e-9);
+  }
+
+  layer._transformLabels(R * layer._flipMatrix() * layer._cropTransform(0, 0),
+                         0);
+  ExpectLabel(layer, 0, 33, 28, 63, 68);
+  ExpectLabel(layer, 1, 23, 8, 43, 28);
+}
+
+TEST_F(BBTXTDataLayerTest, TestPixelsMatchLabels) {
+  TransformBBTXTDataLayer layer(layer_param_);
+  SetLabels(&layer);
+  layer.flip_ = true;
+  layer.angle_ = 90;
+
+  // Black image with the second box white
+  cv::Mat image(250, 300, CV_8UC3, cv::Scalar(0, 0, 0));
+  image(cv::Rect(60, 80, 40, 40)).setTo(cv::Scalar(255, 255, 255));
+
+  layer._cropAndTransform(image, 0, 0);
+  ExpectLabel(layer, 1, 23, 8, 43, 28);
+
+  // The warped pixels of the box are exactly inside of its transformed label
+  for (int c = 0; c < 3; ++c) {
+    const float* data = layer.Data(c);
+    for (int v = 0; v < 96; ++v) {
+      for (int u = 0; u < 96; ++u) {
+        const bool inside = u >= 23 && u < 43 && v >= 8 && v < 28;
+        if (inside) {
+          EXPECT_GT(data[v * 96 + u], 0.9) << "Pixel " << u << "," << v;
+        } else {
+          EXPECT_LT(data[v * 96 + u], -0.9) << "Pixel " << u << "," << v;
+        }
+      }
+    }
+  }
+}
+
+}  // namespace caffe
+#endif  // USE_OPENCV
@@ -0,0 +1,155 @@
+#ifdef USE_OPENCV
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/bb3txt_loss_layer.hpp"
+#include "caffe/layers/bbtxt_loss_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+// The 2D and 3D loss layers share the distillation, they only differ in the
+// number of the accumulator channels and in the label width
+struct BBTXTLoss {
+  typedef BBTXTLossLayer<float> Layer;
+  static const int kChannels = 5;
+  static const int kLabelWidth = 5;
+};
+
+struct BB3TXTLoss {
+  typedef BB3TXTLossLayer<float> Layer;
+  static const int kChannels = 8;
+  static const int kLabelWidth = 12;
+};
+
+template <typename TypeParam>
+class BBTXTLossLayerTest : public ::testing::Test {
+ protected:
+  static const int kChannels = TypeParam::kChannels;
+  static const int kLabelWidth = TypeParam::kLabelWidth;
+
+  BBTXTLossLayerTest()
+      : blob_label_(new Blob<float>(vector<int>{2, 3, kLabelWidth})),
+        blob_acc_(new Blob<float>(2, kChannels, 16, 16)),
+        blob_teacher_(new Blob<float>(2, kChannels, 16, 16)),
+        blob_top_loss_(new Blob<float>()) {
+    // One bounding box in the first image (it fits the bounds of the x2
+    // accumulator), none in the second one. The 3D box has its fblx, fbly,
+    // fbrx, fbry, rblx, rbly, ftly coordinates after the 2D one
+    float* label = blob_label_->mutable_cpu_data();
+    const float bb[] = {1, 4, 4, 34, 34, 6, 32, 28, 32, 10, 26, 8};
+    std::copy(bb, bb + kLabelWidth, label);
+    label[kLabelWidth] = -1;
+    label[3 * kLabelWidth] = -1;
+
+    FillerParameter filler_param;
+    UniformFiller<float> filler(filler_param);
+    filler.Fill(blob_acc_);
+    filler.Fill(blob_teacher_);
+    blob_top_vec_.push_back(blob_top_loss_);
+
+    AccumulatorLossParameter* loss_param =
+        layer_param_.mutable_accumulator_loss_param();
+    loss_param->set_radius(2);
+    loss_param->set_circle_ratio(0.3);
+    loss_param->set_downsampling(2);
+  }
+  virtual ~BBTXTLossLayerTest() {
+    delete blob_label_;
+    delete blob_acc_;
+    delete blob_teacher_;
+    delete blob_top_loss_;
+  }
+
+  // Runs the forward and backward pass, returns the loss
+  float Run(const LayerParameter& param, bool with_teacher) {
+    vector<Blob<float>*> bottom;
+    bottom.push_back(blob_label_);
+    bottom.push_back(blob_acc_);
+    if (with_teacher) bottom.push_back(blob_teacher_);
+
+    typename TypeParam::Layer layer(param);
+    layer.SetUp(bottom, blob_top_vec_);
+    const float loss = layer.Forward(bottom, blob_top_vec_);
+    vector<bool> propagate_down(bottom.size(), false);
+    propagate_down[1] = true;
+    layer.Backward(blob_top_vec_, propagate_down, bottom);
+    return loss;
+  }
+
+  Blob<float>* const blob_label_;
+  Blob<float>* const blob_acc_;
+  Blob<float>* const blob_teacher_;
+  Blob<float>* const blob_top_loss_;
+  vector<Blob<float>*> blob_top_vec_;
+  LayerParameter layer_param_;
+};
+
+typedef ::testing::Types<BBTXTLoss, BB3TXTLoss> BBTXTLossTypes;
+TYPED_TEST_CASE(BBTXTLossLayerTest, BBTXTLossTypes);
+
+TYPED_TEST(BBTXTLossLayerTest, TestDistillZeroWeight) {
+  const float loss = this->Run(this->layer_param_, false);
+  Blob<float> diff;
+  diff.CopyFrom(*this->blob_acc_, true, true);
+  EXPECT_GT(loss, 0);
+
+  // The teacher with zero weight does not change anything
+  LayerParameter param(this->layer_param_);
+  param.mutable_accumulator_loss_param()->add_distill_weight(0);
+  EXPECT_FLOAT_EQ(loss, this->Run(param, true));
+  for (int i = 0; i < diff.count(); ++i) {
+    EXPECT_FLOAT_EQ(diff.cpu_diff()[i], this->blob_acc_->cpu_diff()[i]);
+  }
+}
+
+TYPED_TEST(BBTXTLossLayerTest, TestDistillFromItself) {
+  // The target is the output itself - no loss, no gradient
+  this->blob_teacher_->CopyFrom(*this->blob_acc_);
+  LayerParameter param(this->layer_param_);
+  param.mutable_accumulator_loss_param()->add_distill_weight(1);
+  EXPECT_NEAR(0, this->Run(param, true), 1e-6);
+  for (int i = 0; i < this->blob_acc_->count(); ++i) {
+    EXPECT_NEAR(0, this->blob_acc_->cpu_diff()[i], 1e-6);
+  }
+}
+
+TYPED_TEST(BBTXTLossLayerTest, TestDistillPerChannel) {
+  // Only the probability is distilled, the coordinates keep the rendered
+  // target
+  const int channels = this->kChannels;
+  LayerParameter param(this->layer_param_);
+  param.mutable_accumulator_loss_param()->add_distill_weight(0.5);
+  for (int c = 1; c < channels; ++c) {
+    param.mutable_accumulator_loss_param()->add_distill_weight(0);
+  }
+  this->Run(param, true);
+  Blob<float> diff;
+  diff.CopyFrom(*this->blob_acc_, true, true);
+
+  this->Run(this->layer_param_, false);
+  const Blob<float>& acc = *this->blob_acc_;
+  bool prob_differs = false;
+  for (int b = 0; b < 2; ++b) {
+    for (int c = 0; c < channels; ++c) {
+      const float* distilled = diff.cpu_diff() + diff.offset(b, c);
+      const float* plain = acc.cpu_diff() + acc.offset(b, c);
+      for (int i = 0; i < 16 * 16; ++i) {
+        if (c == 0) {
+          prob_differs |= (plain[i] != distilled[i]);
+        } else {
+          EXPECT_FLOAT_EQ(plain[i], distilled[i]);
+        }
+      }
+    }
+  }
+  EXPECT_TRUE(prob_differs);
+}
+
+}  // namespace caffe
+#endif  // USE_OPENCV
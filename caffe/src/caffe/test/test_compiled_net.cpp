@@ -0,0 +1,173 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/bbtxt_bb_layer.hpp"
+#include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/pooling_layer.hpp"
+#include "caffe/layers/relu_layer.hpp"
+#include "caffe/util/compiled_net.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+// The compiled kernels must reproduce the CPU layers bit by bit.
+class CompiledNetTest : public CPUDeviceTest<float> {
+ protected:
+  CompiledNetTest()
+      : blob_bottom_(new Blob<float>(2, 3, 9, 13)),
+        blob_top_(new Blob<float>()) {}
+  virtual void SetUp() {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    filler_param.set_std(1);
+    GaussianFiller<float> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~CompiledNetTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  void ExpectEqual(const Blob<float>& expected, const float* actual) {
+    for (int i = 0; i < expected.count(); ++i) {
+      EXPECT_EQ(expected.cpu_data()[i], actual[i]) << "at index " << i;
+    }
+  }
+
+  Blob<float>* const blob_bottom_;
+  Blob<float>* const blob_top_;
+  vector<Blob<float>*> blob_bottom_vec_;
+  vector<Blob<float>*> blob_top_vec_;
+};
+
+TEST_F(CompiledNetTest, TestConvolutionDilatedStrided) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(3);
+  convolution_param->add_stride(2);
+  convolution_param->add_dilation(3);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  ConvolutionLayer<float> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+
+  typedef compiled::ConvGeometry<3, 9, 13, 3, 3, 3, 3, 2, 2, 3, 3> G;
+  ASSERT_EQ(this->blob_top_->height(), int(G::OUT_H));
+  ASSERT_EQ(this->blob_top_->width(), int(G::OUT_W));
+  vector<float> col_buffer(G::COL_SIZE);
+  vector<float> bias_multiplier(G::OUT_SPATIAL, 1.0f);
+  vector<float> output(this->blob_top_->count());
+  for (int n = 0; n < 2; ++n) {
+    compiled::convolution<3, 9, 13, 4, 3, 3, 3, 3, 2, 2, 3, 3, true>(
+        this->blob_bottom_->cpu_data() + this->blob_bottom_->offset(n),
+        layer.blobs()[0]->cpu_data(), layer.blobs()[1]->cpu_data(),
+        bias_multiplier.data(), col_buffer.data(),
+        output.data() + this->blob_top_->offset(n));
+  }
+  ExpectEqual(*this->blob_top_, output.data());
+}
+
+TEST_F(CompiledNetTest, TestConvolution1x1) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(1);
+  convolution_param->set_num_output(5);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  ConvolutionLayer<float> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+
+  EXPECT_TRUE((compiled::ConvGeometry<3, 9, 13, 1, 1, 0, 0, 1, 1, 1, 1>::IS_1X1));
+  vector<float> bias_multiplier(9 * 13, 1.0f);
+  vector<float> output(this->blob_top_->count());
+  for (int n = 0; n < 2; ++n) {
+    compiled::convolution<3, 9, 13, 5, 1, 1, 0, 0, 1, 1, 1, 1, true>(
+        this->blob_bottom_->cpu_data() + this->blob_bottom_->offset(n),
+        layer.blobs()[0]->cpu_data(), layer.blobs()[1]->cpu_data(),
+        bias_multiplier.data(), NULL,
+        output.data() + this->blob_top_->offset(n));
+  }
+  ExpectEqual(*this->blob_top_, output.data());
+}
+
+TEST_F(CompiledNetTest, TestReLU) {
+  LayerParameter layer_param;
+  layer_param.mutable_relu_param()->set_negative_slope(0.01);
+  ReLULayer<float> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+
+  vector<float> output(this->blob_top_->count());
+  compiled::relu<2 * 3 * 9 * 13>(this->blob_bottom_->cpu_data(),
+      output.data(), layer_param.relu_param().negative_slope());
+  ExpectEqual(*this->blob_top_, output.data());
+}
+
+TEST_F(CompiledNetTest, TestMaxPooling) {
+  LayerParameter layer_param;
+  PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+  pooling_param->set_kernel_size(3);
+  pooling_param->set_stride(2);
+  pooling_param->set_pad(1);
+  pooling_param->set_pool(PoolingParameter_PoolMethod_MAX);
+  PoolingLayer<float> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+
+  typedef compiled::PoolGeometry<9, 13, 3, 3, 1, 1, 2, 2> G;
+  ASSERT_EQ(this->blob_top_->height(), int(G::OUT_H));
+  ASSERT_EQ(this->blob_top_->width(), int(G::OUT_W));
+  vector<float> output(this->blob_top_->count());
+  for (int n = 0; n < 2; ++n) {
+    compiled::maxPooling<3, 9, 13, 3, 3, 1, 1, 2, 2>(
+        this->blob_bottom_->cpu_data() + this->blob_bottom_->offset(n),
+        output.data() + this->blob_top_->offset(n));
+  }
+  ExpectEqual(*this->blob_top_, output.data());
+}
+
+TEST_F(CompiledNetTest, TestBBTXTBB) {
+  this->blob_bottom_->Reshape(2, 5, 9, 13);
+  FillerParameter filler_param;
+  GaussianFiller<float> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  layer_param.mutable_bbtxt_bb_param()->set_ideal_size(66.67);
+  layer_param.mutable_bbtxt_bb_param()->set_downsampling(4);
+  BBTXTBBLayer<float> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+
+  vector<float> output(this->blob_top_->count());
+  for (int n = 0; n < 2; ++n) {
+    compiled::bbtxtBB<5, 9, 13>(
+        this->blob_bottom_->cpu_data() + this->blob_bottom_->offset(n),
+        output.data() + this->blob_top_->offset(n),
+        layer_param.bbtxt_bb_param().ideal_size(),
+        layer_param.bbtxt_bb_param().downsampling());
+  }
+  // The layer does not write the probability channel of a separate top
+  for (int n = 0; n < 2; ++n) {
+    for (int c = 1; c < 5; ++c) {
+      for (int i = 0; i < 9 * 13; ++i) {
+        const int index = this->blob_top_->offset(n, c) + i;
+        EXPECT_EQ(this->blob_top_->cpu_data()[index], output[index]);
+      }
+    }
+  }
+}
+
+}  // namespace caffe
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -706,6 +708,92 @@ TYPED_TEST(ConvolutionLayerTest, TestNDAgainst2D) {
   }
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestBatchedGEMMAgainstPerImage) {
+  typedef typename TypeParam::Dtype Dtype;
+  vector<int> bottom_shape(4);
+  bottom_shape[0] = 5;
+  bottom_shape[1] = 4;
+  bottom_shape[2] = 40;
+  bottom_shape[3] = 40;
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  this->blob_bottom_->Reshape(bottom_shape);
+  filler.Fill(this->blob_bottom_);
+  // 3x3 and 1x1 kernels, the 1 MB workspace splits the 3x3 minibatch into
+  // several chunks
+  for (int kernel_size = 3; kernel_size >= 1; kernel_size -= 2) {
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(kernel_size);
+    convolution_param->set_num_output(6);
+    convolution_param->set_group(2);
+    convolution_param->set_batched_gemm_workspace(1);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    ConvolutionLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    Blob<Dtype> top_diff;
+    top_diff.ReshapeLike(*this->blob_top_);
+    filler.Fill(&top_diff);
+    vector<bool> propagate_down(1, true);
+    vector<shared_ptr<Blob<Dtype> > > results;
+    for (int batched = 0; batched < 2; ++batched) {
+      convolution_param->set_batched_gemm(batched);
+      ConvolutionLayer<Dtype> layer_b(layer_param);
+      layer_b.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      for (int j = 0; j < layer.blobs().size(); ++j) {
+        layer_b.blobs()[j]->CopyFrom(*layer.blobs()[j]);
+        caffe_set(layer_b.blobs()[j]->count(), Dtype(0),
+                  layer_b.blobs()[j]->mutable_cpu_diff());
+      }
+      layer_b.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      caffe_copy(top_diff.count(), top_diff.cpu_data(),
+                 this->blob_top_->mutable_cpu_diff());
+      layer_b.Backward(this->blob_top_vec_, propagate_down,
+                       this->blob_bottom_vec_);
+      results.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+      results.back()->CopyFrom(*this->blob_top_, false, true);
+      results.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+      results.back()->CopyFrom(*this->blob_bottom_, true, true);
+      results.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+      results.back()->CopyFrom(*layer_b.blobs()[0], true, true);
+    }
+    const Dtype* top = results[0]->cpu_data();
+    const Dtype* top_batched = results[3]->cpu_data();
+    for (int i = 0; i < results[0]->count(); ++i) {
+      EXPECT_NEAR(top[i], top_batched[i], 1e-4);
+    }
+    for (int k = 1; k < 3; ++k) {
+      const Dtype* diff = results[k]->cpu_diff();
+      const Dtype* diff_batched = results[k + 3]->cpu_diff();
+      for (int i = 0; i < results[k]->count(); ++i) {
+        EXPECT_NEAR(diff[i], diff_batched[i],
+                    1e-4 * std::max(Dtype(1), std::fabs(diff[i])));
+      }
+    }
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestBatchedGEMMGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  this->blob_bottom_vec_.push_back(this->blob_bottom_2_);
+  this->blob_top_vec_.push_back(this->blob_top_2_);
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(2);
+  convolution_param->set_batched_gemm(true);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  ConvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
 TYPED_TEST(ConvolutionLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -0,0 +1,101 @@
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/cpu_resources.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class CPUResourcesTest : public ::testing::Test {
+ protected:
+  virtual void TearDown() {
+    CPUResources::Get().reset();
+  }
+};
+
+TEST_F(CPUResourcesTest, TestSplit) {
+  CPUResources& resources = CPUResources::Get();
+  resources.configure("2:1:1", "none");
+  const int num_cores = resources.numCores();
+  EXPECT_GE(num_cores, 1);
+
+  // Each role gets at least one core, the roles only share cores when there
+  // are fewer cores than roles
+  const int compute = resources.numThreads(CPUResources::COMPUTE);
+  const int data = resources.numThreads(CPUResources::DATA);
+  const int loss = resources.numThreads(CPUResources::LOSS);
+  EXPECT_GE(compute, 1);
+  EXPECT_GE(data, 1);
+  EXPECT_GE(loss, 1);
+  EXPECT_EQ(std::max(num_cores, 3), compute + data + loss);
+  if (num_cores >= 4) {
+    EXPECT_GE(compute, data);
+    EXPECT_GE(compute, loss);
+  }
+
+  EXPECT_EQ(1, resources.numThreads(CPUResources::DATA, 1));
+  EXPECT_FALSE(resources.layout().empty());
+}
+
+TEST_F(CPUResourcesTest, TestReset) {
+  // Only explicit shares limit the BLAS threads, reset returns to the defaults
+  CPUResources& resources = CPUResources::Get();
+  resources.configure("1:1:1", "");
+  EXPECT_EQ(string::npos, resources.layout().find("default shares"));
+  resources.reset();
+  EXPECT_NE(string::npos, resources.layout().find("default shares"));
+}
+
+#ifdef __linux__
+TEST_F(CPUResourcesTest, TestPinCore) {
+  CPUResources& resources = CPUResources::Get();
+  resources.configure("", "core");
+
+  // A pinned thread runs on exactly one core
+  int num_cpus = 0;
+  std::thread thread([&resources, &num_cpus]() {
+    resources.pinThread(CPUResources::DATA, 1);
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+      num_cpus = CPU_COUNT(&set);
+    }
+  });
+  thread.join();
+  EXPECT_EQ(1, num_cpus);
+}
+
+TEST_F(CPUResourcesTest, TestPinTail) {
+  CPUResources& resources = CPUResources::Get();
+  resources.configure("", "none");
+
+  // The tail of the compute cores, at most all of them
+  const int compute = resources.numThreads(CPUResources::COMPUTE);
+  vector<int> num_cpus(2, 0);
+  std::thread thread([&resources, &num_cpus, compute]() {
+    for (int i = 0; i < 2; ++i) {
+      resources.pinThreadToTail(CPUResources::COMPUTE, (i == 0) ? 1
+                                                               : compute + 5);
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        num_cpus[i] = CPU_COUNT(&set);
+      }
+    }
+  });
+  thread.join();
+  EXPECT_EQ(1, num_cpus[0]);
+  EXPECT_EQ(compute, num_cpus[1]);
+}
+#endif
+
+}  // namespace caffe
@@ -0,0 +1,108 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/util/detection.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class DetectionTest : public ::testing::Test {
+ protected:
+  DetectionTest() : output_(2, 5, 4, 6) {
+    caffe_set(output_.count(), Dtype(0), output_.mutable_cpu_data());
+  }
+
+  void SetDetection(int b, int i, int j, Dtype conf, Dtype xmin, Dtype ymin,
+      Dtype xmax, Dtype ymax) {
+    Dtype* data = output_.mutable_cpu_data();
+    data[output_.offset(b, 0, i, j)] = conf;
+    data[output_.offset(b, 1, i, j)] = xmin;
+    data[output_.offset(b, 2, i, j)] = ymin;
+    data[output_.offset(b, 3, i, j)] = xmax;
+    data[output_.offset(b, 4, i, j)] = ymax;
+  }
+
+  Blob<Dtype> output_;
+};
+
+TYPED_TEST_CASE(DetectionTest, TestDtypes);
+
+TYPED_TEST(DetectionTest, TestExtractLocalMaxima) {
+  this->SetDetection(1, 1, 1, 0.9, 10, 20, 30, 40);
+  // Neighbor of the first maximum - not extracted
+  this->SetDetection(1, 1, 2, 0.5, 11, 21, 31, 41);
+  this->SetDetection(1, 3, 5, 0.6, 50, 60, 70, 80);
+  // Below the confidence threshold
+  this->SetDetection(1, 0, 4, 0.05, 0, 0, 1, 1);
+
+  vector<Detection2D> detections =
+      extractBBTXTDetections(this->output_, 1, 2.0, 0.1, 3);
+  ASSERT_EQ(2, detections.size());
+  EXPECT_EQ(3, detections[0].label);
+  EXPECT_FLOAT_EQ(0.9, detections[0].conf);
+  EXPECT_FLOAT_EQ(5, detections[0].xmin);
+  EXPECT_FLOAT_EQ(10, detections[0].ymin);
+  EXPECT_FLOAT_EQ(15, detections[0].xmax);
+  EXPECT_FLOAT_EQ(20, detections[0].ymax);
+  EXPECT_FLOAT_EQ(0.6, detections[1].conf);
+  EXPECT_FLOAT_EQ(25, detections[1].xmin);
+
+  // The other image of the batch is empty
+  EXPECT_EQ(0, extractBBTXTDetections(this->output_, 0, 1.0, 0.1).size());
+}
+
+TYPED_TEST(DetectionTest, TestExtract3D) {
+  // Output of a BB3TXT network - prob and 7 coordinates
+  Blob<TypeParam> output(1, 8, 4, 6);
+  TypeParam* data = output.mutable_cpu_data();
+  caffe_set(output.count(), TypeParam(0), data);
+  data[output.offset(0, 0, 2, 3)] = 0.8;
+  for (int c = 1; c < 8; ++c) {
+    data[output.offset(0, c, 2, 3)] = 10 * c;
+  }
+  // Below the confidence threshold
+  data[output.offset(0, 0, 0, 0)] = 0.05;
+
+  vector<Detection3D> detections =
+      extractBB3TXTDetections(output, 0, 2.0, 0.1);
+  ASSERT_EQ(1, detections.size());
+  EXPECT_EQ(1, detections[0].label);
+  EXPECT_FLOAT_EQ(0.8, detections[0].conf);
+  EXPECT_FLOAT_EQ(5, detections[0].fblx);
+  EXPECT_FLOAT_EQ(10, detections[0].fbly);
+  EXPECT_FLOAT_EQ(15, detections[0].fbrx);
+  EXPECT_FLOAT_EQ(20, detections[0].fbry);
+  EXPECT_FLOAT_EQ(25, detections[0].rblx);
+  EXPECT_FLOAT_EQ(30, detections[0].rbly);
+  EXPECT_FLOAT_EQ(35, detections[0].ftly);
+}
+
+TEST(DetectionNMSTest, TestNonMaximaSuppression) {
+  vector<Detection2D> detections;
+  detections.push_back(Detection2D(1, 0.5, 0, 0, 10, 10));
+  detections.push_back(Detection2D(1, 0.9, 1, 1, 11, 11));
+  detections.push_back(Detection2D(1, 0.7, 20, 20, 30, 30));
+  // Same box, different category
+  detections.push_back(Detection2D(2, 0.6, 1, 1, 11, 11));
+
+  EXPECT_FLOAT_EQ(81.0 / 119.0, iou2d(detections[0], detections[1]));
+  EXPECT_FLOAT_EQ(0.0, iou2d(detections[0], detections[2]));
+
+  vector<Detection2D> kept = nonMaximaSuppression(detections, 0.5);
+  ASSERT_EQ(3, kept.size());
+  EXPECT_FLOAT_EQ(0.9, kept[0].conf);
+  EXPECT_FLOAT_EQ(0.7, kept[1].conf);
+  EXPECT_FLOAT_EQ(0.6, kept[2].conf);
+  EXPECT_EQ(2, kept[2].label);
+
+  // With a high threshold nothing is suppressed
+  EXPECT_EQ(4, nonMaximaSuppression(detections, 0.9).size());
+}
+
+}  // namespace caffe
@@ -0,0 +1,86 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/detection_cache.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class DetectionCacheTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    MakeTempDir(&dir_);
+    prototxt_ = dir_ + "/net.prototxt";
+    caffemodel_ = dir_ + "/net.caffemodel";
+    WriteFile(prototxt_, "layer {}");
+    WriteFile(caffemodel_, "weights");
+  }
+
+  virtual void TearDown() {
+    boost::filesystem::remove_all(dir_);
+  }
+
+  void WriteFile(const string& path, const string& content) {
+    std::ofstream(path.c_str()) << content;
+  }
+
+  string dir_;
+  string prototxt_;
+  string caffemodel_;
+};
+
+TEST_F(DetectionCacheTest, TestStoreLoad) {
+  DetectionCache cache(dir_ + "/cache", prototxt_, caffemodel_);
+  const string key = cache.key(42, 1.0);
+
+  vector<float> records;
+  EXPECT_FALSE(cache.load(key, 3, records));
+
+  const float values[] = {0.9f, 1.f, 2.f, 0.5f, 3.f, 4.f};
+  cache.store(key, 3, vector<float>(values, values + 6));
+  ASSERT_TRUE(cache.load(key, 3, records));
+  EXPECT_EQ(vector<float>(values, values + 6), records);
+
+  // Entries without any candidates are valid as well
+  cache.store(cache.key(43, 1.0), 3, vector<float>());
+  ASSERT_TRUE(cache.load(cache.key(43, 1.0), 3, records));
+  EXPECT_TRUE(records.empty());
+
+  // Another instance of the same network sees the entries
+  DetectionCache cache2(dir_ + "/cache", prototxt_, caffemodel_);
+  EXPECT_TRUE(cache2.load(key, 3, records));
+}
+
+TEST_F(DetectionCacheTest, TestKeys) {
+  DetectionCache cache(dir_ + "/cache", prototxt_, caffemodel_);
+  EXPECT_EQ(cache.key(42, 0.5), cache.key(42, 0.5));
+  EXPECT_NE(cache.key(42, 0.5), cache.key(42, 0.66));
+  EXPECT_NE(cache.key(42, 0.5), cache.key(41, 0.5));
+
+  // The image hash depends on the content, not on the path
+  const string image1 = dir_ + "/a.png";
+  const string image2 = dir_ + "/b.png";
+  WriteFile(image1, "pixels");
+  WriteFile(image2, "pixels");
+  EXPECT_EQ(DetectionCache::hashFile(image1), DetectionCache::hashFile(image2));
+  WriteFile(image2, "pixelz");
+  EXPECT_NE(DetectionCache::hashFile(image1), DetectionCache::hashFile(image2));
+
+  // Changed weights invalidate all entries
+  const string key = cache.key(42, 1.0);
+  cache.store(key, 1, vector<float>(1, 0.5f));
+  WriteFile(caffemodel_, "retrained weights");
+  DetectionCache cache2(dir_ + "/cache", prototxt_, caffemodel_);
+  vector<float> records;
+  EXPECT_FALSE(cache2.load(cache2.key(42, 1.0), 1, records));
+}
+
+}  // namespace caffe
@@ -0,0 +1,151 @@
+#ifdef USE_OPENCV
+#include <future>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/detection/detector.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/detection.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class DetectorTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    const string proto =
+        "layer { name: 'data' type: 'Input' top: 'data' "
+        "  input_param { shape { dim: 1 dim: 3 dim: 12 dim: 16 } } } "
+        "layer { name: 'acc' type: 'Convolution' bottom: 'data' top: 'acc' "
+        "  convolution_param { num_output: 5 kernel_size: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "    bias_filler { type: 'constant' value: 0.2 } } } "
+        "layer { name: 'bb' type: 'BBTXTBB' bottom: 'acc' top: 'acc' "
+        "  bbtxt_bb_param { ideal_size: 10 downsampling: 1 } } ";
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    param.mutable_state()->set_phase(TEST);
+
+    // Save the network with random weights
+    MakeTempFilename(&path_prototxt_);
+    MakeTempFilename(&path_caffemodel_);
+    WriteProtoToTextFile(param, path_prototxt_);
+    net_.reset(new Net<float>(param));
+    NetParameter weights;
+    net_->ToProto(&weights, false);
+    WriteProtoToBinaryFile(weights, path_caffemodel_);
+  }
+
+  cv::Mat RandomImage(int height, int width) {
+    cv::Mat image(height, width, CV_8UC3);
+    cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(255));
+    return image;
+  }
+
+  // Synchronous detection without NMS with the same network
+  vector<Detection2D> Reference(const cv::Mat& image) {
+    Blob<float>* input = net_->input_blobs()[0];
+    input->Reshape(1, 3, image.rows, image.cols);
+    net_->Reshape();
+    cv::Mat imagef;
+    image.convertTo(imagef, CV_32FC3, 1.0 / 128.0, -1.0);
+    vector<cv::Mat> channels;
+    for (int c = 0; c < 3; ++c) {
+      channels.push_back(cv::Mat(image.rows, image.cols, CV_32FC1,
+          input->mutable_cpu_data() + input->offset(0, c)));
+    }
+    cv::split(imagef, channels);
+    net_->Forward();
+    return extractBBTXTDetections(*net_->output_blobs()[0], 0, 1.0, 0.1);
+  }
+
+  void ExpectSame(const vector<Detection2D>& expected,
+      const vector<BB2D>& actual, const string& id) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (int i = 0; i < expected.size(); ++i) {
+      EXPECT_EQ(id, actual[i].path_image);
+      EXPECT_NEAR(expected[i].conf, actual[i].conf, 1e-5);
+      EXPECT_NEAR(expected[i].xmin, actual[i].xmin, 1e-4);
+      EXPECT_NEAR(expected[i].ymin, actual[i].ymin, 1e-4);
+      EXPECT_NEAR(expected[i].xmax, actual[i].xmax, 1e-4);
+      EXPECT_NEAR(expected[i].ymax, actual[i].ymax, 1e-4);
+    }
+  }
+
+  string path_prototxt_;
+  string path_caffemodel_;
+  shared_ptr<Net<float> > net_;
+};
+
+TEST_F(DetectorTest, TestConcurrentFrames) {
+  DetectorSettings settings;
+  settings.nms_iou = 0.0;
+  settings.num_workers = 2;
+  settings.max_batch_size = 3;
+  Detector2D detector(path_prototxt_, path_caffemodel_, settings);
+
+  // Frames of two different sizes are queued at once, only the frames of the
+  // same size can be batched together
+  vector<cv::Mat> images;
+  vector<std::future<vector<BB2D> > > results;
+  for (int i = 0; i < 8; ++i) {
+    images.push_back(i % 3 ? RandomImage(12, 16) : RandomImage(9, 7));
+    results.push_back(detector.detect(images[i], format_int(i)));
+  }
+
+  int num_detections = 0;
+  for (int i = 0; i < images.size(); ++i) {
+    vector<BB2D> bbs = results[i].get();
+    ExpectSame(Reference(images[i]), bbs, format_int(i));
+    num_detections += bbs.size();
+  }
+  EXPECT_GT(num_detections, 0);
+}
+
+TEST_F(DetectorTest, TestRawBuffer) {
+  Detector2D detector(path_prototxt_, path_caffemodel_);
+
+  // Frame stored in a buffer with padded rows
+  cv::Mat buffer = RandomImage(12, 20);
+  cv::Mat image = buffer(cv::Rect(0, 0, 16, 12));
+  vector<BB2D> bbs = detector.detect(buffer.data, 16, 12, buffer.step,
+      "raw").get();
+
+  // The detections are the same as of the cv::Mat frame after NMS
+  vector<Detection2D> expected = Reference(image);
+  expected = nonMaximaSuppression(expected, 0.5);
+  ExpectSame(expected, bbs, "raw");
+}
+
+TEST_F(DetectorTest, TestJointNetwork) {
+  // The 2D detector ignores the 3D accumulators of a joint network
+  NetParameter param;
+  ReadNetParamsFromTextFileOrDie(path_prototxt_, &param);
+  const string proto =
+      "layer { name: 'acc3d' type: 'Convolution' bottom: 'data' top: 'acc3d' "
+      "  convolution_param { num_output: 8 kernel_size: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.5 } } } ";
+  CHECK(google::protobuf::TextFormat::MergeFromString(proto, &param));
+  string path_joint;
+  MakeTempFilename(&path_joint);
+  WriteProtoToTextFile(param, path_joint);
+
+  DetectorSettings settings;
+  settings.nms_iou = 0.0;
+  Detector2D detector(path_joint, path_caffemodel_, settings);
+
+  cv::Mat image = RandomImage(12, 16);
+  ExpectSame(Reference(image), detector.detect(image, "joint").get(), "joint");
+}
+
+}  // namespace caffe
+#endif  // USE_OPENCV
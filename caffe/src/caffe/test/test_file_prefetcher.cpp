@@ -0,0 +1,96 @@
+#include <cstdio>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/file_prefetcher.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class FilePrefetcherTest : public ::testing::TestWithParam<bool> {
+ protected:
+  virtual void SetUp() {
+    // Files of different sizes, including an empty one
+    for (int i = 0; i < 5; ++i) {
+      string filename;
+      MakeTempFilename(&filename);
+      vector<unsigned char> content(i * 70001);
+      for (int j = 0; j < content.size(); ++j) content[j] = (j * 7 + i) % 251;
+      std::ofstream file(filename.c_str(), std::ios::binary);
+      file.write(reinterpret_cast<const char*>(content.data()), content.size());
+      filenames_.push_back(filename);
+      contents_.push_back(content);
+    }
+  }
+
+  virtual void TearDown() {
+    for (int i = 0; i < filenames_.size(); ++i) {
+      std::remove(filenames_[i].c_str());
+    }
+  }
+
+  vector<string> filenames_;
+  vector<vector<unsigned char> > contents_;
+};
+
+TEST_P(FilePrefetcherTest, TestTake) {
+  FilePrefetcher prefetcher(3, 4, GetParam());
+  // More files than the queue depth and the number of threads
+  for (int i = 0; i < 2 * filenames_.size(); ++i) {
+    prefetcher.prefetch(i, filenames_[i % filenames_.size()]);
+  }
+  for (int i = 2 * filenames_.size() - 1; i >= 0; --i) {
+    vector<unsigned char> buffer;
+    ASSERT_TRUE(prefetcher.take(i, buffer));
+    EXPECT_TRUE(buffer == contents_[i % filenames_.size()]);
+  }
+
+  FilePrefetcher::Stats stats = prefetcher.stats();
+  EXPECT_EQ(2 * filenames_.size(), stats.hits + stats.waits);
+  EXPECT_EQ(0, stats.misses);
+}
+
+TEST_P(FilePrefetcherTest, TestMisses) {
+  FilePrefetcher prefetcher(2, 4, GetParam());
+  prefetcher.prefetch(0, filenames_[1]);
+  prefetcher.prefetch(1, filenames_[2]);
+  prefetcher.prefetch(2, filenames_[3] + ".missing");
+
+  vector<unsigned char> buffer;
+  // Not prefetched, discarded and failed reads are all misses
+  EXPECT_FALSE(prefetcher.take(5, buffer));
+  prefetcher.discard(0);
+  EXPECT_FALSE(prefetcher.take(0, buffer));
+  EXPECT_FALSE(prefetcher.take(2, buffer));
+  EXPECT_TRUE(buffer.empty());
+
+  // Taken reads can not be taken again
+  EXPECT_TRUE(prefetcher.take(1, buffer));
+  EXPECT_TRUE(buffer == contents_[2]);
+  EXPECT_FALSE(prefetcher.take(1, buffer));
+
+  FilePrefetcher::Stats stats = prefetcher.stats();
+  EXPECT_EQ(1, stats.hits + stats.waits);
+  EXPECT_EQ(4, stats.misses);
+}
+
+TEST_P(FilePrefetcherTest, TestDestroyPending) {
+  // Reads, which were never taken, are cleaned up
+  FilePrefetcher prefetcher(1, 1, GetParam());
+  for (int i = 0; i < filenames_.size(); ++i) {
+    prefetcher.prefetch(i, filenames_[i]);
+  }
+}
+
+// With and without io_uring (the blocking reader is used when it is not
+// available)
+INSTANTIATE_TEST_CASE_P(FilePrefetcherTest, FilePrefetcherTest,
+    ::testing::Bool());
+
+}  // namespace caffe
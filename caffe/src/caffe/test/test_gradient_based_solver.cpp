@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 #include <string>
 #include <utility>
 #include <vector>
@@ -8,10 +9,13 @@
 #include "gtest/gtest.h"
 
 #include "caffe/common.hpp"
+#include "caffe/layer_factory.hpp"
+#include "caffe/layers/base_data_layer.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/sgd_solvers.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -301,7 +305,8 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
       const Dtype history_value = (i == D) ?
             history[1]->cpu_data()[0] : history[0]->cpu_data()[i];
       const Dtype temp = momentum * history_value;
-      if (solver_->type() == string("SGD")) {
+      if (solver_->type() == string("SGD") ||
+          solver_->type() == string("HogwildSGD")) {
         update_value += temp;
       } else if (solver_->type() == string("Nesterov")) {
         update_value += temp;
@@ -715,6 +720,137 @@ TYPED_TEST(SGDSolverTest, TestSnapshotShare) {
 }
 
 
+template <typename Dtype>
+class HogwildSGDSolverTest : public GradientBasedSolverTest<CPUDevice<Dtype> > {
+ protected:
+  HogwildSGDSolverTest() : threads_(1) {}
+
+  virtual void InitSolver(const SolverParameter& param) {
+    SolverParameter hogwild_param(param);
+    hogwild_param.set_hogwild_threads(threads_);
+    this->solver_.reset(new HogwildSGDSolver<Dtype>(hogwild_param));
+  }
+
+  int threads_;
+};
+
+TYPED_TEST_CASE(HogwildSGDSolverTest, TestDtypes);
+
+// With a single thread the updates are exactly those of SGD
+TYPED_TEST(HogwildSGDSolverTest, TestLeastSquaresUpdateWithEverything) {
+  const TypeParam kLearningRate = 0.01;
+  const TypeParam kWeightDecay = 0.5;
+  const TypeParam kMomentum = 0.5;
+  const int kNumIters = 4;
+  for (int i = 0; i <= kNumIters; ++i) {
+    this->TestLeastSquaresUpdate(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
+TYPED_TEST(HogwildSGDSolverTest, TestMultiThreaded) {
+  const int kNumIters = 10;
+  this->threads_ = 4;
+  // The loss of the initial weights (the same seed gives the same weights)
+  TypeParam initial_loss;
+  this->RunLeastSquaresSolver(0.01, 0.5, 0.5, 0);
+  this->solver_->net()->Forward(&initial_loss);
+
+  this->RunLeastSquaresSolver(0.01, 0.5, 0.5, kNumIters);
+  EXPECT_EQ(kNumIters, this->solver_->iter());
+  TypeParam loss;
+  this->solver_->net()->Forward(&loss);
+  EXPECT_LT(loss, initial_loss);
+  // The racing updates must still leave valid parameters
+  const vector<Blob<TypeParam>*>& params =
+      this->solver_->net()->learnable_params();
+  for (int i = 0; i < params.size(); ++i) {
+    for (int j = 0; j < params[i]->count(); ++j) {
+      EXPECT_TRUE(std::isfinite(params[i]->cpu_data()[j]))
+          << "param " << i << " is not finite at dim " << j;
+    }
+  }
+}
+
+// Prefetching data layer, which outputs the solver rank (data) and count
+// (label) its prefetching thread runs with
+template <typename Dtype>
+class SolverRankDataLayer : public BasePrefetchingDataLayer<Dtype> {
+ public:
+  explicit SolverRankDataLayer(const LayerParameter& param)
+      : BasePrefetchingDataLayer<Dtype>(param) {}
+  virtual inline const char* type() const { return "SolverRankData"; }
+
+  virtual void DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+    top[0]->Reshape(2, 3, 1, 1);
+    top[1]->Reshape(2, 1, 1, 1);
+    for (int i = 0; i < this->prefetch_.size(); ++i) {
+      this->prefetch_[i]->data_.ReshapeLike(*top[0]);
+      this->prefetch_[i]->label_.ReshapeLike(*top[1]);
+    }
+  }
+
+ protected:
+  virtual void load_batch(Batch<Dtype>* batch) {
+    caffe_set(batch->data_.count(), Dtype(Caffe::solver_rank()),
+        batch->data_.mutable_cpu_data());
+    caffe_set(batch->label_.count(), Dtype(Caffe::solver_count()),
+        batch->label_.mutable_cpu_data());
+  }
+};
+
+REGISTER_LAYER_CLASS(SolverRankData);
+
+TYPED_TEST(HogwildSGDSolverTest, TestStepWithPrefetching) {
+  SolverParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      "base_lr: 0.01 "
+      "lr_policy: 'fixed' "
+      "hogwild_threads: 3 "
+      "net_param { "
+      "  name: 'TestNetwork' "
+      "  layer { "
+      "    name: 'data' "
+      "    type: 'SolverRankData' "
+      "    top: 'data' "
+      "    top: 'label' "
+      "  } "
+      "  layer { "
+      "    name: 'innerprod' "
+      "    type: 'InnerProduct' "
+      "    inner_product_param { num_output: 1 } "
+      "    bottom: 'data' "
+      "    top: 'innerprod' "
+      "  } "
+      "  layer { "
+      "    name: 'loss' "
+      "    type: 'EuclideanLoss' "
+      "    bottom: 'innerprod' "
+      "    bottom: 'label' "
+      "  } "
+      "} ", &param));
+  HogwildSGDSolver<TypeParam> solver(param);
+  // Only the root net is set up as one of the Hogwild threads
+  EXPECT_EQ(1, Caffe::solver_count());
+
+  // Repeated steps keep the prefetched batches of the root net going, the
+  // root reads as rank 0 of all the threads
+  for (int i = 1; i <= 3; ++i) {
+    solver.Step(2);
+    EXPECT_EQ(2 * i, solver.iter());
+    const Blob<TypeParam>& data = *solver.net()->blob_by_name("data");
+    const Blob<TypeParam>& label = *solver.net()->blob_by_name("label");
+    for (int j = 0; j < data.count(); ++j) {
+      EXPECT_EQ(0, data.cpu_data()[j]);
+    }
+    for (int j = 0; j < label.count(); ++j) {
+      EXPECT_EQ(3, label.cpu_data()[j]);
+    }
+  }
+  EXPECT_EQ(1, Caffe::solver_count());
+}
+
+
 template <typename TypeParam>
 class AdaGradSolverTest : public GradientBasedSolverTest<TypeParam> {
   typedef typename TypeParam::Dtype Dtype;
@@ -220,6 +220,35 @@ TEST_F(IOTest, TestReadImageToCVMatGray) {
   EXPECT_EQ(cv_img.cols, 480);
 }
 
+TEST_F(IOTest, TestReducedDecodeFactor) {
+  EXPECT_EQ(1, ReducedDecodeFactor(1.5));
+  EXPECT_EQ(1, ReducedDecodeFactor(1.0));
+  EXPECT_EQ(1, ReducedDecodeFactor(0.66));
+  EXPECT_EQ(2, ReducedDecodeFactor(0.5));
+  EXPECT_EQ(2, ReducedDecodeFactor(0.44));
+  EXPECT_EQ(4, ReducedDecodeFactor(0.19));
+  EXPECT_EQ(8, ReducedDecodeFactor(0.1));
+  EXPECT_EQ(8, ReducedDecodeFactor(0.01));
+}
+
+TEST_F(IOTest, TestReadImageToCVMatReduced) {
+  string filename = EXAMPLES_SOURCE_DIR "images/cat.jpg";
+  for (int factor = 1; factor <= 8; factor *= 2) {
+    int height, width;
+    cv::Mat cv_img = ReadImageToCVMatReduced(filename, factor, true, &height,
+                                             &width);
+    EXPECT_EQ(cv_img.channels(), 3);
+    EXPECT_EQ(height, 360);
+    EXPECT_EQ(width, 480);
+    EXPECT_EQ(cv_img.rows, (360 + factor - 1) / factor);
+    EXPECT_EQ(cv_img.cols, (480 + factor - 1) / factor);
+  }
+  cv::Mat cv_img = ReadImageToCVMatReduced(filename, 2, false, NULL, NULL);
+  EXPECT_EQ(cv_img.channels(), 1);
+  EXPECT_EQ(cv_img.rows, 180);
+  EXPECT_EQ(cv_img.cols, 240);
+}
+
 TEST_F(IOTest, TestReadImageToCVMatResizedGray) {
   string filename = EXAMPLES_SOURCE_DIR "images/cat.jpg";
   const bool is_color = false;
@@ -0,0 +1,113 @@
+#include <boost/thread.hpp>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/lockfree_queue.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class LockFreeQueueTest : public ::testing::Test {};
+
+TEST_F(LockFreeQueueTest, TestCapacity) {
+  LockFreeQueue<int> queue(5);
+  EXPECT_EQ(8, queue.capacity());
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_TRUE(queue.try_push(i));
+  }
+  EXPECT_FALSE(queue.try_push(8));
+  EXPECT_EQ(8, queue.size());
+  int t;
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_TRUE(queue.try_pop(&t));
+    EXPECT_EQ(i, t);
+  }
+  EXPECT_FALSE(queue.try_pop(&t));
+  EXPECT_EQ(0, queue.size());
+}
+
+namespace {
+
+void Produce(LockFreeQueue<int>* queue, int first, int count) {
+  for (int i = first; i < first + count; ++i) {
+    queue->push(i);
+  }
+}
+
+void Consume(LockFreeQueue<int>* queue, int count, vector<int>* seen,
+    LockFreeCounter* counter) {
+  for (int i = 0; i < count; ++i) {
+    (*seen)[queue->pop()]++;
+    counter->increase();
+  }
+}
+
+void PopForever(LockFreeQueue<int>* queue, bool* interrupted) {
+  try {
+    while (true) {
+      queue->pop();
+    }
+  } catch (boost::thread_interrupted&) {
+    *interrupted = true;
+  }
+}
+
+}  // namespace
+
+TEST_F(LockFreeQueueTest, TestMultipleProducersConsumers) {
+  const int kThreads = 4;
+  const int kCount = 20000;
+  // Small capacity, so the producers have to wait for the consumers
+  LockFreeQueue<int> queue(16);
+  LockFreeCounter counter;
+  vector<vector<int> > seen(kThreads, vector<int>(kThreads * kCount, 0));
+  boost::thread_group threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.create_thread(boost::bind(&Consume, &queue, kCount, &seen[i],
+        &counter));
+  }
+  for (int i = 0; i < kThreads; ++i) {
+    threads.create_thread(boost::bind(&Produce, &queue, i * kCount, kCount));
+  }
+  counter.waitToCount(kThreads * kCount);
+  threads.join_all();
+  EXPECT_EQ(kThreads * kCount, counter.getCount());
+  // Each element was received exactly once
+  for (int e = 0; e < kThreads * kCount; ++e) {
+    int received = 0;
+    for (int i = 0; i < kThreads; ++i) {
+      received += seen[i][e];
+    }
+    EXPECT_EQ(1, received);
+  }
+}
+
+TEST_F(LockFreeQueueTest, TestInterruptParkedThread) {
+  LockFreeQueue<int> queue;
+  bool interrupted = false;
+  boost::thread thread(&PopForever, &queue, &interrupted);
+  // Give the thread time to park on the empty queue
+  boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+  queue.push(1);
+  boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+  EXPECT_EQ(0, queue.size());
+  thread.interrupt();
+  thread.join();
+  EXPECT_TRUE(interrupted);
+}
+
+TEST_F(LockFreeQueueTest, TestCounterReset) {
+  LockFreeCounter counter;
+  counter.increase();
+  counter.increase();
+  counter.decrease();
+  EXPECT_EQ(1, counter.getCount());
+  counter.reset();
+  EXPECT_EQ(0, counter.getCount());
+  counter.waitToCount(0);
+}
+
+}  // namespace caffe
@@ -2446,6 +2446,77 @@ TYPED_TEST(NetTest, TestReshape) {
   EXPECT_FALSE(same_spatial_shape);
 }
 
+TYPED_TEST(NetTest, TestInferenceOnly) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Inference only net has to produce the same outputs as the full net while
+  // its input shape changes, without touching any diff
+  Caffe::set_random_seed(this->seed_);
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype> blob1(2, 3, 12, 10);
+  Blob<Dtype> blob2(4, 3, 9, 11);
+  filler.Fill(&blob1);
+  filler.Fill(&blob2);
+
+  this->InitReshapableNet();
+  shared_ptr<Net<Dtype> > full_net = this->net_;
+  NetParameter param;
+  full_net->ToProto(&param);
+  param.set_inference_only(true);
+  Net<Dtype> net(param);
+  EXPECT_TRUE(net.inference_only());
+  for (int i = 0; i < net.layers().size(); ++i) {
+    EXPECT_FALSE(net.layer_need_backward()[i]);
+    for (int j = 0; j < net.layers()[i]->blobs().size(); ++j) {
+      EXPECT_FALSE(net.layers()[i]->param_propagate_down(j));
+    }
+  }
+
+  const Blob<Dtype>* blobs[] = { &blob1, &blob2, &blob2, &blob1 };
+  for (int b = 0; b < 4; ++b) {
+    Net<Dtype>* nets[] = { full_net.get(), &net };
+    for (int n = 0; n < 2; ++n) {
+      Blob<Dtype>* input_blob = nets[n]->input_blobs()[0];
+      input_blob->ReshapeLike(*blobs[b]);
+      caffe_copy(blobs[b]->count(), blobs[b]->cpu_data(),
+          input_blob->mutable_cpu_data());
+      nets[n]->Forward();
+    }
+    const Blob<Dtype>* full_output = full_net->output_blobs()[0];
+    const Blob<Dtype>* output = net.output_blobs()[0];
+    ASSERT_TRUE(full_output->shape() == output->shape());
+    for (int i = 0; i < output->count(); ++i) {
+      EXPECT_FLOAT_EQ(full_output->cpu_data()[i], output->cpu_data()[i]);
+    }
+  }
+
+  for (int i = 0; i < net.blobs().size(); ++i) {
+    EXPECT_EQ(SyncedMemory::UNINITIALIZED, net.blobs()[i]->diff()->head());
+  }
+  for (int i = 0; i < net.params().size(); ++i) {
+    EXPECT_EQ(SyncedMemory::UNINITIALIZED, net.params()[i]->diff()->head());
+  }
+}
+
+TYPED_TEST(NetTest, TestInferenceOnlyLoss) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Loss layers are evaluated, but do not contribute to the returned loss
+  this->InitTinyNet();
+  NetParameter param;
+  this->net_->ToProto(&param);
+  param.mutable_state()->set_phase(TEST);
+  param.set_inference_only(true);
+  Net<Dtype> net(param);
+  Dtype loss;
+  net.Forward(&loss);
+  EXPECT_EQ(0, loss);
+  EXPECT_GT(net.blob_by_name("top_loss")->cpu_data()[0], 0);
+  for (int i = 0; i < net.blobs().size(); ++i) {
+    EXPECT_EQ(SyncedMemory::UNINITIALIZED, net.blobs()[i]->diff()->head());
+  }
+}
+
 TYPED_TEST(NetTest, TestSkipPropagateDown) {
   // check bottom_need_backward if propagate_down is true
   this->InitSkipPropNet(false);
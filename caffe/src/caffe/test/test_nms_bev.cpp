@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/util/nms_bev.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+// Rectangle of size w x l centered at (cx, cy) and rotated by angle
+static GroundRect MakeRect(double cx, double cy, double w, double l,
+                           double angle) {
+  const double dx[4] = {-w / 2, w / 2, w / 2, -w / 2};
+  const double dy[4] = {-l / 2, -l / 2, l / 2, l / 2};
+  double x[4], y[4];
+  for (int i = 0; i < 4; ++i) {
+    x[i] = cx + std::cos(angle) * dx[i] - std::sin(angle) * dy[i];
+    y[i] = cy + std::sin(angle) * dx[i] + std::cos(angle) * dy[i];
+  }
+  return GroundRect(x, y);
+}
+
+TEST(NMSBEVTest, TestIoU) {
+  const GroundRect a = MakeRect(0, 0, 2, 2, 0);
+  EXPECT_NEAR(4.0, a.area(), 1e-9);
+  EXPECT_NEAR(1.0, iouBEV(a, a), 1e-9);
+
+  // Half overlap: intersection 2, union 6
+  EXPECT_NEAR(1.0 / 3, iouBEV(a, MakeRect(1, 0, 2, 2, 0)), 1e-9);
+  EXPECT_NEAR(0.0, iouBEV(a, MakeRect(5, 0, 2, 2, 0)), 1e-9);
+
+  // Square rotated by 45 degrees - the intersection is an octagon
+  const double intersection = 8 * std::sqrt(2.0) - 8;
+  EXPECT_NEAR(intersection / (8 - intersection),
+              iouBEV(a, MakeRect(0, 0, 2, 2, M_PI / 4)), 1e-9);
+
+  // Independent of the corner order
+  const GroundRect b = MakeRect(0.5, 0.3, 1.5, 4, 0.3);
+  const double x[4] = {b.x[3], b.x[2], b.x[1], b.x[0]};
+  const double y[4] = {b.y[3], b.y[2], b.y[1], b.y[0]};
+  EXPECT_NEAR(iouBEV(a, b), iouBEV(a, GroundRect(x, y)), 1e-9);
+  EXPECT_NEAR(iouBEV(a, b), iouBEV(b, a), 1e-9);
+}
+
+TEST(NMSBEVTest, TestSuppression) {
+  std::vector<GroundRect> rects;
+  std::vector<double> conf;
+  rects.push_back(MakeRect(0, 10, 1.8, 4, 0.1));   conf.push_back(0.5);
+  rects.push_back(MakeRect(0.2, 10.3, 1.8, 4, 0));  conf.push_back(0.9);
+  // Behind the first two in the same direction - not suppressed
+  rects.push_back(MakeRect(0, 16, 1.8, 4, 0));     conf.push_back(0.7);
+  rects.push_back(MakeRect(-30, 40, 1.8, 4, 1.2)); conf.push_back(0.1);
+
+  const std::vector<int> kept = nonMaximaSuppressionBEV(rects, conf, 0.3);
+  ASSERT_EQ(3, kept.size());
+  EXPECT_EQ(1, kept[0]);
+  EXPECT_EQ(2, kept[1]);
+  EXPECT_EQ(3, kept[2]);
+}
+
+TEST(NMSBEVTest, TestAgainstBruteForce) {
+  std::vector<GroundRect> rects;
+  std::vector<double> conf;
+  for (int i = 0; i < 200; ++i) {
+    rects.push_back(MakeRect((i * 37 % 101) * 0.3 - 15, (i * 53 % 97) * 0.4,
+                             1.5 + (i % 3) * 0.2, 3.5 + (i % 5) * 0.3,
+                             i * 0.7));
+    conf.push_back((i * 71 % 199) / 199.0);
+  }
+
+  // Greedy NMS comparing all pairs
+  std::vector<int> order;
+  for (int i = 0; i < rects.size(); ++i) order.push_back(i);
+  std::stable_sort(order.begin(), order.end(),
+                   [&conf](int a, int b) { return conf[a] > conf[b]; });
+  std::vector<int> expected;
+  for (int i : order) {
+    bool keep = true;
+    for (int j : expected) {
+      if (iouBEV(rects[i], rects[j]) > 0.2) keep = false;
+    }
+    if (keep) expected.push_back(i);
+  }
+
+  EXPECT_EQ(expected, nonMaximaSuppressionBEV(rects, conf, 0.2));
+}
+
+}  // namespace caffe
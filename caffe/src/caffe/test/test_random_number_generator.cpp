@@ -1,4 +1,5 @@
 #include <cmath>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -395,6 +396,56 @@ TYPED_TEST(RandomNumberGeneratorTest, TestRngBernoulliTimesBernoulli) {
   EXPECT_NEAR(true_mean, sample_p, bound);
 }
 
+TYPED_TEST(RandomNumberGeneratorTest, TestRngSeedReproducible) {
+  TypeParam* data_a = static_cast<TypeParam*>(this->data_->mutable_cpu_data());
+  TypeParam* data_b =
+      static_cast<TypeParam*>(this->data_2_->mutable_cpu_data());
+  this->RngGaussianFill(0, 1, data_a);
+  Caffe::set_random_seed(this->seed_);
+  this->RngGaussianFill(0, 1, data_b);
+  for (int i = 0; i < this->sample_size_; ++i) {
+    EXPECT_EQ(data_a[i], data_b[i]);
+  }
+  // The next call continues with a different stream
+  this->RngGaussianFill(0, 1, data_b);
+  EXPECT_NE(data_a[0], data_b[0]);
+}
+
+TYPED_TEST(RandomNumberGeneratorTest, TestRngPhiloxStream) {
+  // Large enough to be filled in parallel
+  const int n = (1 << 20) + 3;
+  vector<TypeParam> full(n);
+  const Philox4x32 stream(this->seed_, Philox4x32::StreamId(3, 1000));
+  caffe_rng_gaussian(n, TypeParam(0), TypeParam(1), full.data(), stream);
+  // A shorter fill of the same stream is a prefix of the long one
+  vector<TypeParam> prefix(this->sample_size_ + 1);
+  caffe_rng_gaussian<TypeParam>(prefix.size(), 0, 1, prefix.data(), stream);
+  for (int i = 0; i < prefix.size(); ++i) {
+    EXPECT_EQ(full[i], prefix[i]);
+  }
+  this->RngGaussianChecks(0, 1, full.data());
+  // Other iterations of the same layer give different numbers
+  const Philox4x32 next(this->seed_, Philox4x32::StreamId(3, 1001));
+  caffe_rng_gaussian<TypeParam>(prefix.size(), 0, 1, prefix.data(), next);
+  EXPECT_NE(full[0], prefix[0]);
+}
+
+TEST(PhiloxTest, TestKnownAnswer) {
+  // Test vectors of the Random123 reference implementation
+  uint32_t r[Philox4x32::kBlockWords];
+  Philox4x32(0, 0).Generate(0, 1, r);
+  EXPECT_EQ(0x6627e8d5u, r[0]);
+  EXPECT_EQ(0xe169c58du, r[1]);
+  EXPECT_EQ(0xbc57ac4cu, r[2]);
+  EXPECT_EQ(0x9b00dbd8u, r[3]);
+  Philox4x32(0x299f31d0a4093822ull, 0x0370734413198a2eull)
+      .Generate(0x85a308d3243f6a88ull, 1, r);
+  EXPECT_EQ(0xd16cfe09u, r[0]);
+  EXPECT_EQ(0x94fdccebu, r[1]);
+  EXPECT_EQ(0x5001e420u, r[2]);
+  EXPECT_EQ(0x24126ea1u, r[3]);
+}
+
 #ifndef CPU_ONLY
 
 TYPED_TEST(RandomNumberGeneratorTest, TestRngGaussianGPU) {
@@ -0,0 +1,82 @@
+#include <string>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/sample_cache.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class SampleCacheTest : public ::testing::Test {
+ protected:
+  // Stores samples 0 and 2 and checks that only those can be loaded
+  void TestStoreLoad(const string& filename) {
+    SampleCache<Dtype> cache(3, 4, 2, filename);
+    EXPECT_EQ(3, cache.numSamples());
+    EXPECT_EQ(0, cache.numCached());
+
+    vector<Dtype> data(4), label(2);
+    EXPECT_FALSE(cache.load(0, data.data(), label.data()));
+
+    for (int i = 0; i < 3; i += 2) {
+      for (int j = 0; j < 4; ++j) data[j] = 10 * i + j;
+      for (int j = 0; j < 2; ++j) label[j] = -10 * i - j;
+      cache.store(i, data.data(), label.data());
+    }
+    EXPECT_EQ(2, cache.numCached());
+
+    // Only the first store of a sample is kept
+    data[0] = 1000;
+    cache.store(2, data.data(), label.data());
+    EXPECT_EQ(2, cache.numCached());
+
+    EXPECT_FALSE(cache.load(1, data.data(), label.data()));
+    for (int i = 0; i < 3; i += 2) {
+      ASSERT_TRUE(cache.load(i, data.data(), label.data()));
+      for (int j = 0; j < 4; ++j) EXPECT_EQ(10 * i + j, data[j]);
+      for (int j = 0; j < 2; ++j) EXPECT_EQ(-10 * i - j, label[j]);
+    }
+  }
+};
+
+TYPED_TEST_CASE(SampleCacheTest, TestDtypes);
+
+TYPED_TEST(SampleCacheTest, TestRAM) {
+  this->TestStoreLoad("");
+}
+
+TYPED_TEST(SampleCacheTest, TestMappedFile) {
+  string dir;
+  MakeTempDir(&dir);
+  this->TestStoreLoad(dir + "/cache");
+  // The backing file is unlinked right after mapping
+  EXPECT_TRUE(boost::filesystem::is_empty(dir));
+  boost::filesystem::remove_all(dir);
+}
+
+TYPED_TEST(SampleCacheTest, TestSharedPath) {
+  string dir;
+  MakeTempDir(&dir);
+  // Two caches configured with the same path do not overwrite each other
+  SampleCache<TypeParam> cache1(1, 2, 1, dir + "/cache");
+  SampleCache<TypeParam> cache2(1, 2, 1, dir + "/cache");
+  vector<TypeParam> data(2, 1), label(1, 1);
+  cache1.store(0, data.data(), label.data());
+  data.assign(2, 2);
+  label.assign(1, 2);
+  cache2.store(0, data.data(), label.data());
+
+  ASSERT_TRUE(cache1.load(0, data.data(), label.data()));
+  EXPECT_EQ(1, data[0]);
+  EXPECT_EQ(1, data[1]);
+  EXPECT_EQ(1, label[0]);
+  boost::filesystem::remove_all(dir);
+}
+
+}  // namespace caffe
@@ -0,0 +1,139 @@
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/sharded_run.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ShardedRunTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    MakeTempDir(&dir_);
+    for (int i = 0; i < 10; ++i) {
+      items_.push_back("image_" + std::to_string(i) + ".png");
+    }
+  }
+
+  virtual void TearDown() {
+    boost::filesystem::remove_all(dir_);
+  }
+
+  string ReadFile(const string& path) {
+    std::ifstream infile(path.c_str());
+    return string(std::istreambuf_iterator<char>(infile),
+                  std::istreambuf_iterator<char>());
+  }
+
+  // Processes the chunk, item i writes "i" to output 0 and "-i" to output 1
+  void ProcessChunk(const ShardedRun& run, int chunk, int stop_after = -1) {
+    ChunkWriter writer(run, chunk);
+    for (int i = writer.nextItem(); i < run.chunkEnd(chunk); ++i) {
+      if (i == stop_after) {
+        // Simulates a crash after a partially written item
+        writer.output(0) << "garbage\n";
+        return;
+      }
+      writer.output(0) << i << "\n";
+      writer.output(1) << -i << "\n";
+      writer.checkpoint();
+    }
+    writer.finish();
+  }
+
+  string Expected(int num_items, int sign) {
+    string expected;
+    for (int i = 0; i < num_items; ++i) {
+      expected += std::to_string(sign * i) + "\n";
+    }
+    return expected;
+  }
+
+  string dir_;
+  vector<string> items_;
+};
+
+TEST_F(ShardedRunTest, TestClaims) {
+  ShardedRun run(dir_ + "/shards", items_, 4, 2);
+  EXPECT_EQ(3, run.numChunks());
+  EXPECT_EQ(8, run.chunkBegin(2));
+  EXPECT_EQ(10, run.chunkEnd(2));
+
+  run.resetQueue();
+  int chunk;
+  for (int c = 0; c < 3; ++c) {
+    ASSERT_TRUE(run.claim(chunk));
+    EXPECT_EQ(c, chunk);
+  }
+  EXPECT_FALSE(run.claim(chunk));
+}
+
+TEST_F(ShardedRunTest, TestResumeAndMerge) {
+  const vector<string> paths = {dir_ + "/out.bbtxt", dir_ + "/out_nms.bbtxt"};
+  {
+    ShardedRun run(dir_ + "/shards", items_, 4, 2);
+    run.resetQueue();
+    int chunk;
+    // Chunks are processed out of order and chunk 1 crashes in the middle
+    ASSERT_TRUE(run.claim(chunk));
+    ASSERT_TRUE(run.claim(chunk));
+    ProcessChunk(run, 1, 6);
+    ASSERT_TRUE(run.claim(chunk));
+    ProcessChunk(run, 2);
+    EXPECT_FALSE(run.merge(paths));
+  }
+
+  // Second run only gets the unfinished chunks, chunk 1 continues with item 6
+  ShardedRun run(dir_ + "/shards", items_, 4, 2);
+  run.resetQueue();
+  int chunk;
+  ASSERT_TRUE(run.claim(chunk));
+  EXPECT_EQ(0, chunk);
+  ASSERT_TRUE(run.claim(chunk));
+  EXPECT_EQ(1, chunk);
+  {
+    ChunkWriter writer(run, 1);
+    EXPECT_EQ(6, writer.nextItem());
+  }
+  ProcessChunk(run, 1);
+  ProcessChunk(run, 0);
+  EXPECT_FALSE(run.claim(chunk));
+
+  ASSERT_TRUE(run.merge(paths));
+  EXPECT_EQ(Expected(10, 1), ReadFile(paths[0]));
+  EXPECT_EQ(Expected(10, -1), ReadFile(paths[1]));
+}
+
+TEST_F(ShardedRunTest, TestManifest) {
+  {
+    ShardedRun run(dir_ + "/shards", items_, 4, 2);
+    run.resetQueue();
+    int chunk;
+    ASSERT_TRUE(run.claim(chunk));
+    ProcessChunk(run, chunk);
+  }
+  // The same list and settings resume the run
+  {
+    ShardedRun run(dir_ + "/shards", items_, 4, 2);
+    EXPECT_TRUE(run.isFinished(0));
+  }
+
+  // A changed list or chunk size would not match the finished chunks
+  vector<string> changed(items_);
+  changed[3] = "other.png";
+  EXPECT_DEATH(ShardedRun(dir_ + "/shards", changed, 4, 2), "different item list");
+  EXPECT_DEATH(ShardedRun(dir_ + "/shards", items_, 5, 2), "different item list");
+  changed = items_;
+  changed.push_back("image_10.png");
+  EXPECT_DEATH(ShardedRun(dir_ + "/shards", changed, 4, 2), "different item list");
+}
+
+}  // namespace caffe
@@ -106,4 +106,70 @@ TYPED_TEST(SolverTest, TestInitTrainTestNets) {
   EXPECT_TRUE(this->solver_->test_nets()[1]->has_layer("accuracy"));
 }
 
+TYPED_TEST(SolverTest, TestAsyncTestNetsCopyWeights) {
+  const string& proto =
+     "base_lr: 0.1 "
+     "lr_policy: 'fixed' "
+     "max_iter: 10 "
+     "snapshot_after_train: false "
+     "test_interval: 5 "
+     "test_iter: 3 "
+     "test_async: true "
+     "net_param { "
+     "  name: 'TestNetwork' "
+     "  layer { "
+     "    name: 'data' "
+     "    type: 'DummyData' "
+     "    dummy_data_param { "
+     "      shape { "
+     "        dim: 5 "
+     "        dim: 2 "
+     "        dim: 3 "
+     "        dim: 4 "
+     "      } "
+     "      shape { "
+     "        dim: 5 "
+     "      } "
+     "      data_filler { type: 'gaussian' } "
+     "      data_filler { type: 'constant' value: 1 } "
+     "    } "
+     "    top: 'data' "
+     "    top: 'label' "
+     "  } "
+     "  layer { "
+     "    name: 'innerprod' "
+     "    type: 'InnerProduct' "
+     "    inner_product_param { "
+     "      num_output: 10 "
+     "      weight_filler { type: 'gaussian' } "
+     "    } "
+     "    bottom: 'data' "
+     "    top: 'innerprod' "
+     "  } "
+     "  layer { "
+     "    name: 'loss' "
+     "    type: 'SoftmaxWithLoss' "
+     "    bottom: 'innerprod' "
+     "    bottom: 'label' "
+     "    top: 'loss' "
+     "  } "
+     "} ";
+  typedef typename TypeParam::Dtype Dtype;
+  this->InitSolverFromProtoString(proto);
+  this->solver_->Solve();
+  EXPECT_EQ(10, this->solver_->iter());
+  ASSERT_EQ(1, this->solver_->test_nets().size());
+  // The final test ran on a copy of the trained weights
+  const Blob<Dtype>* train_weights =
+      this->solver_->net()->layer_by_name("innerprod")->blobs()[0].get();
+  const Blob<Dtype>* test_weights =
+      this->solver_->test_nets()[0]->layer_by_name("innerprod")
+      ->blobs()[0].get();
+  EXPECT_NE(train_weights->data().get(), test_weights->data().get());
+  ASSERT_EQ(train_weights->count(), test_weights->count());
+  for (int i = 0; i < train_weights->count(); ++i) {
+    EXPECT_EQ(train_weights->cpu_data()[i], test_weights->cpu_data()[i]);
+  }
+}
+
 }  // namespace caffe
@@ -0,0 +1,146 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/sparse_accumulator_layer.hpp"
+#include "caffe/util/detection.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class SparseAccumulatorLayerTest : public ::testing::Test {
+ protected:
+  SparseAccumulatorLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 6, 5, 7)),
+        blob_top_sparse_(new Blob<Dtype>()),
+        blob_top_dense_(new Blob<Dtype>()) {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_sparse_vec_.push_back(blob_top_sparse_);
+    blob_top_dense_vec_.push_back(blob_top_dense_);
+
+    ConvolutionParameter* conv_param =
+        layer_param_.mutable_convolution_param();
+    conv_param->set_num_output(5);
+    conv_param->add_kernel_size(1);
+    conv_param->mutable_weight_filler()->set_type("gaussian");
+    conv_param->mutable_bias_filler()->set_type("gaussian");
+  }
+  virtual ~SparseAccumulatorLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_sparse_;
+    delete blob_top_dense_;
+  }
+
+  // Runs the sparse layer and a convolution with the same weights
+  void Forward() {
+    SparseAccumulatorLayer<Dtype> sparse_layer(layer_param_);
+    sparse_layer.SetUp(blob_bottom_vec_, blob_top_sparse_vec_);
+    ConvolutionLayer<Dtype> dense_layer(layer_param_);
+    dense_layer.SetUp(blob_bottom_vec_, blob_top_dense_vec_);
+    for (int i = 0; i < sparse_layer.blobs().size(); ++i) {
+      dense_layer.blobs()[i]->CopyFrom(*sparse_layer.blobs()[i]);
+    }
+    sparse_layer.Forward(blob_bottom_vec_, blob_top_sparse_vec_);
+    dense_layer.Forward(blob_bottom_vec_, blob_top_dense_vec_);
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_sparse_;
+  Blob<Dtype>* const blob_top_dense_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_sparse_vec_;
+  vector<Blob<Dtype>*> blob_top_dense_vec_;
+  LayerParameter layer_param_;
+};
+
+TYPED_TEST_CASE(SparseAccumulatorLayerTest, TestDtypes);
+
+TYPED_TEST(SparseAccumulatorLayerTest, TestForwardAtLocalMaxima) {
+  // Compute the coordinates in all local maxima
+  this->layer_param_.mutable_sparse_accumulator_param()->set_min_conf(-1e9);
+  this->Forward();
+  ASSERT_TRUE(this->blob_top_sparse_->shape() ==
+      this->blob_top_dense_->shape());
+
+  const Blob<TypeParam>& sparse = *this->blob_top_sparse_;
+  const Blob<TypeParam>& dense = *this->blob_top_dense_;
+  const int height = dense.shape(2);
+  const int width = dense.shape(3);
+  int num_maxima = 0;
+  for (int b = 0; b < dense.shape(0); ++b) {
+    const TypeParam* prob = dense.cpu_data() + dense.offset(b, 0);
+    for (int i = 0; i < height; ++i) {
+      for (int j = 0; j < width; ++j) {
+        EXPECT_NEAR(dense.data_at(b, 0, i, j), sparse.data_at(b, 0, i, j),
+            1e-4);
+        const bool local_max = isLocalMaximum(prob, height, width, i, j);
+        num_maxima += local_max;
+        for (int c = 1; c < dense.shape(1); ++c) {
+          if (local_max) {
+            EXPECT_NEAR(dense.data_at(b, c, i, j), sparse.data_at(b, c, i, j),
+                1e-4);
+          } else {
+            EXPECT_EQ(0, sparse.data_at(b, c, i, j));
+          }
+        }
+      }
+    }
+  }
+  EXPECT_GT(num_maxima, 0);
+}
+
+TYPED_TEST(SparseAccumulatorLayerTest, TestExtractedDetections) {
+  this->Forward();
+  for (int b = 0; b < this->blob_top_dense_->shape(0); ++b) {
+    vector<Detection2D> sparse =
+        extractBBTXTDetections(*this->blob_top_sparse_, b, 1.0, 0.1);
+    vector<Detection2D> dense =
+        extractBBTXTDetections(*this->blob_top_dense_, b, 1.0, 0.1);
+    ASSERT_EQ(dense.size(), sparse.size());
+    for (int i = 0; i < dense.size(); ++i) {
+      EXPECT_NEAR(dense[i].conf, sparse[i].conf, 1e-4);
+      EXPECT_NEAR(dense[i].xmin, sparse[i].xmin, 1e-4);
+      EXPECT_NEAR(dense[i].ymin, sparse[i].ymin, 1e-4);
+      EXPECT_NEAR(dense[i].xmax, sparse[i].xmax, 1e-4);
+      EXPECT_NEAR(dense[i].ymax, sparse[i].ymax, 1e-4);
+    }
+  }
+}
+
+TEST(SparseAccumulatorTest, TestEnableSparseAccumulators) {
+  const string proto =
+      "layer { name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape { dim: 1 dim: 3 dim: 8 dim: 8 } } } "
+      "layer { name: 'conv' type: 'Convolution' bottom: 'data' top: 'conv' "
+      "  convolution_param { num_output: 4 kernel_size: 3 } } "
+      "layer { name: 'acc_x2' type: 'Convolution' bottom: 'conv' "
+      "  top: 'acc_x2' convolution_param { num_output: 5 kernel_size: 1 } } "
+      "layer { name: 'acc_x4' type: 'Convolution' bottom: 'conv' "
+      "  top: 'acc_x4' convolution_param { num_output: 8 kernel_size: 3 } } "
+      "layer { name: 'bb_x2' type: 'BBTXTBB' bottom: 'acc_x2' top: 'acc_x2' "
+      "  bbtxt_bb_param { ideal_size: 10 downsampling: 2 } } "
+      "layer { name: 'bb_x4' type: 'BB3TXTBB' bottom: 'acc_x4' top: 'acc_x4' "
+      "  bbtxt_bb_param { ideal_size: 20 downsampling: 4 } } ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+
+  // Only the 1x1 accumulator is replaced
+  EXPECT_EQ(1, enableSparseAccumulators(param, 0.2));
+  EXPECT_EQ("Convolution", param.layer(1).type());
+  EXPECT_EQ("SparseAccumulator", param.layer(2).type());
+  EXPECT_FLOAT_EQ(0.2, param.layer(2).sparse_accumulator_param().min_conf());
+  EXPECT_EQ("Convolution", param.layer(3).type());
+}
+
+}  // namespace caffe
@@ -0,0 +1,79 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/util/tensor_view.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class TensorViewTest : public ::testing::Test {
+ protected:
+  TensorViewTest() : blob_(2, 3, 4, 5) {
+    Dtype* data = blob_.mutable_cpu_data();
+    for (int i = 0; i < blob_.count(); ++i) {
+      data[i] = i;
+    }
+  }
+
+  Blob<Dtype> blob_;
+};
+
+TYPED_TEST_CASE(TensorViewTest, TestDtypes);
+
+TYPED_TEST(TensorViewTest, TestShape) {
+  TensorView<const TypeParam, 4> view = cpuView<4>(this->blob_);
+  EXPECT_EQ(this->blob_.cpu_data(), view.data());
+  EXPECT_EQ(this->blob_.count(), view.count());
+  for (int a = 0; a < 4; ++a) {
+    EXPECT_EQ(this->blob_.shape(a), view.shape(a));
+  }
+  EXPECT_EQ(60, view.stride(0));
+  EXPECT_EQ(20, view.stride(1));
+  EXPECT_EQ(5, view.stride(2));
+  EXPECT_EQ(1, view.stride(3));
+}
+
+TYPED_TEST(TensorViewTest, TestIndexing) {
+  TensorView<const TypeParam, 4> view = cpuView<4>(this->blob_);
+  for (int n = 0; n < 2; ++n) {
+    for (int c = 0; c < 3; ++c) {
+      EXPECT_EQ(this->blob_.cpu_data() + this->blob_.offset(n, c),
+                view.ptr(n, c));
+      for (int h = 0; h < 4; ++h) {
+        for (int w = 0; w < 5; ++w) {
+          EXPECT_EQ(this->blob_.data_at(n, c, h, w), view(n, c, h, w));
+        }
+      }
+    }
+  }
+  EXPECT_EQ(view.data(), view.ptr());
+}
+
+TYPED_TEST(TensorViewTest, TestSlice) {
+  TensorView<const TypeParam, 4> view = cpuView<4>(this->blob_);
+  TensorView<const TypeParam, 3> image = view[1];
+  TensorView<const TypeParam, 2> channel = image[2];
+  EXPECT_EQ(3, image.shape(0));
+  EXPECT_EQ(4, channel.shape(0));
+  EXPECT_EQ(5, channel.shape(1));
+  EXPECT_EQ(view.ptr(1, 2), channel.data());
+  EXPECT_EQ(this->blob_.data_at(1, 2, 3, 4), channel(3, 4));
+}
+
+TYPED_TEST(TensorViewTest, TestMutable) {
+  TensorView<TypeParam, 4> data = mutableCpuView<4>(this->blob_);
+  data(1, 2, 3, 4) = -1;
+  EXPECT_EQ(-1, this->blob_.data_at(1, 2, 3, 4));
+
+  TensorView<TypeParam, 4> diff = mutableCpuDiffView<4>(this->blob_);
+  diff(0, 1, 2, 3) = 7;
+  EXPECT_EQ(7, this->blob_.diff_at(0, 1, 2, 3));
+  EXPECT_EQ(7, cpuDiffView<4>(this->blob_)(0, 1, 2, 3));
+}
+
+}  // namespace caffe
@@ -31,3 +31,36 @@ std::map<std::string, std::vector<BB2D>> readBBTXTFile (const std::string &path_
 
     return bbs_out;
 }
+
+
+std::map<std::string, std::vector<BB3D>> readBB3TXTFile (const std::string &path_bb3txt)
+{
+    std::ifstream infile(path_bb3txt.c_str(), std::ios::in);
+    CHECK(infile.is_open()) << "BB3TXT file '" << path_bb3txt << "' could not be opened!";
+
+    std::string line;
+    std::vector<std::string> data;
+
+    std::map<std::string, std::vector<BB3D>> bbs_out;
+
+    while (std::getline(infile, line))
+    {
+        // Split the line - entries separated by space
+        // [filename label confidence xmin ymin xmax ymax fblx fbly fbrx fbry rblx rbly ftly]
+        boost::split(data, line, boost::is_any_of(" "));
+        CHECK_EQ(data.size(), 14) << "Line '" << line << "' corrupted!";
+
+        std::vector<BB3D> &bbs = bbs_out[data[0]];
+        bbs.emplace_back(data[0], std::stod(data[1]), std::stod(data[2]), std::stod(data[7]), std::stod(data[8]),
+                         std::stod(data[9]), std::stod(data[10]), std::stod(data[11]), std::stod(data[12]),
+                         std::stod(data[13]));
+        bbs.back().xmin = std::stod(data[3]);
+        bbs.back().ymin = std::stod(data[4]);
+        bbs.back().xmax = std::stod(data[5]);
+        bbs.back().ymax = std::stod(data[6]);
+    }
+
+    infile.close();
+
+    return bbs_out;
+}
@@ -0,0 +1,63 @@
+#include <map>
+
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/compiled_net.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+
+namespace caffe {
+namespace compiled {
+
+
+namespace {
+
+    /**
+     * @brief Copies the content of a blob from the caffemodel into a static buffer of the compiled net
+     */
+    void copyBlob (const BlobProto &blob, float *data, int count, const std::string &layer_name)
+    {
+        if (blob.data_size() > 0)
+        {
+            CHECK_EQ(blob.data_size(), count) << "Blob size mismatch in layer '" << layer_name << "'!";
+            std::copy(blob.data().begin(), blob.data().end(), data);
+        }
+        else
+        {
+            CHECK_EQ(blob.double_data_size(), count) << "Blob size mismatch in layer '" << layer_name << "'!";
+            std::copy(blob.double_data().begin(), blob.double_data().end(), data);
+        }
+    }
+
+}
+
+
+void loadParams (const std::string &path_caffemodel, const ParamEntry *params, int num_params)
+{
+    NetParameter net_param;
+    ReadNetParamsFromBinaryFileOrDie(path_caffemodel, &net_param);
+
+    std::map<std::string, const LayerParameter*> layers;
+    for (int i = 0; i < net_param.layer_size(); ++i)
+    {
+        layers[net_param.layer(i).name()] = &net_param.layer(i);
+    }
+
+    for (int i = 0; i < num_params; ++i)
+    {
+        const ParamEntry &p = params[i];
+
+        auto it = layers.find(p.layer_name);
+        CHECK(it != layers.end()) << "Layer '" << p.layer_name << "' is missing in '" << path_caffemodel << "'!";
+
+        const LayerParameter &layer = *it->second;
+        CHECK_EQ(layer.blobs_size(), (p.bias != NULL) ? 2 : 1) << "Wrong number of blobs in layer '"
+                                                                 << p.layer_name << "'!";
+
+        copyBlob(layer.blobs(0), p.weights, p.weights_count, p.layer_name);
+        if (p.bias != NULL) copyBlob(layer.blobs(1), p.bias, p.bias_count, p.layer_name);
+    }
+}
+
+
+}  // namespace compiled
+}  // namespace caffe
@@ -0,0 +1,443 @@
+#include "caffe/util/cpu_resources.hpp"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>  // NOLINT(readability/streams)
+#include <map>
+#include <numeric>
+#include <set>
+#include <sstream>
+#include <utility>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+
+#ifdef USE_MKL
+#include <mkl.h>
+#else
+// OpenBLAS is found at link time - the functions are null with the other BLAS libraries
+extern "C" void openblas_set_num_threads (int num_threads) __attribute__((weak));
+extern "C" int openblas_get_num_threads () __attribute__((weak));
+#endif
+
+
+namespace caffe {
+
+
+namespace {
+
+    const char* const ROLE_NAMES[] = { "compute", "data", "loss" };
+    const char* const PINNING_NAMES[] = { "none", "core", "numa" };
+
+
+    std::string readLine (const std::string &path)
+    {
+        std::ifstream file(path.c_str());
+        std::string line;
+        std::getline(file, line);
+        return line;
+    }
+
+
+    /**
+     * @brief Parses a list of CPUs in the format of the kernel, e.g. "0-3,8,10-11"
+     */
+    std::vector<int> parseCPUList (const std::string &list)
+    {
+        std::vector<std::string> ranges;
+        boost::split(ranges, list, boost::is_any_of(","));
+
+        std::vector<int> cpus;
+        for (std::string &range: ranges)
+        {
+            boost::trim(range);
+            if (range.empty()) continue;
+
+            const size_t dash = range.find('-');
+            const int first   = std::stoi(range.substr(0, dash));
+            const int last    = (dash == std::string::npos) ? first : std::stoi(range.substr(dash+1));
+            for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+        }
+
+        return cpus;
+    }
+
+
+    /**
+     * @brief CPUs in the affinity mask of the process
+     */
+    std::vector<int> affinityCPUs ()
+    {
+        std::vector<int> cpus;
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0)
+        {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            {
+                if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+            }
+        }
+#endif
+        if (cpus.empty())
+        {
+            const int num_cpus = std::max(1, int(boost::thread::hardware_concurrency()));
+            for (int cpu = 0; cpu < num_cpus; ++cpu) cpus.push_back(cpu);
+        }
+
+        return cpus;
+    }
+
+
+    /**
+     * @brief Number of CPUs given by the CFS quota of the cgroup of the process, 0 if there is no quota
+     */
+    double cgroupQuota ()
+    {
+        // cgroup v2 - "<quota> <period>" or "max <period>". Look into the cgroup of the process and into the
+        // root of the cgroup namespace (containers usually see only their own cgroup)
+        std::vector<std::string> v2_files;
+        std::ifstream cgroup("/proc/self/cgroup");
+        std::string line;
+        while (std::getline(cgroup, line))
+        {
+            if (line.compare(0, 3, "0::") == 0 && line.size() > 4)
+            {
+                v2_files.push_back("/sys/fs/cgroup" + line.substr(3) + "/cpu.max");
+            }
+        }
+        v2_files.push_back("/sys/fs/cgroup/cpu.max");
+
+        for (const std::string &path: v2_files)
+        {
+            std::istringstream iss(readLine(path));
+            std::string quota;
+            double period;
+            if (iss >> quota >> period)
+            {
+                if (quota == "max" || period <= 0.0) return 0.0;
+                return std::stod(quota) / period;
+            }
+        }
+
+        // cgroup v1 - quota of -1 means no quota
+        const std::vector<std::string> v1_dirs = { "/sys/fs/cgroup/cpu,cpuacct/", "/sys/fs/cgroup/cpu/" };
+        for (const std::string &dir: v1_dirs)
+        {
+            const std::string quota  = readLine(dir + "cpu.cfs_quota_us");
+            const std::string period = readLine(dir + "cpu.cfs_period_us");
+            if (quota.empty() || period.empty()) continue;
+
+            const double q = std::stod(quota);
+            const double p = std::stod(period);
+            return (q > 0.0 && p > 0.0) ? q / p : 0.0;
+        }
+
+        return 0.0;
+    }
+
+
+    /**
+     * @brief NUMA node of each CPU, CPUs missing in the map (no NUMA information) are on node 0
+     */
+    std::map<int, int> numaNodes ()
+    {
+        std::map<int, int> nodes;
+
+        boost::system::error_code ec;
+        boost::filesystem::directory_iterator it("/sys/devices/system/node", ec);
+        for (; !ec && it != boost::filesystem::directory_iterator(); it.increment(ec))
+        {
+            const std::string name = it->path().filename().string();
+            if (name.size() <= 4 || name.compare(0, 4, "node") != 0 || !std::isdigit(name[4])) continue;
+
+            const int node = std::stoi(name.substr(4));
+            for (int cpu: parseCPUList(readLine((it->path() / "cpulist").string()))) nodes[cpu] = node;
+        }
+
+        return nodes;
+    }
+
+
+#ifdef __linux__
+    /**
+     * @brief Sets the affinity of the calling thread to the given cores (indices to cpus)
+     */
+    void setAffinity (const std::vector<int> &cpus, const std::vector<int> &cores, const char *role)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int core: cores) CPU_SET(cpus[core], &set);
+
+        const int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        LOG_IF(WARNING, ret != 0) << "Unable to pin a thread to the " << role << " cores";
+    }
+#endif
+
+}
+
+
+CPUResources& CPUResources::Get ()
+{
+    static CPUResources instance;
+    return instance;
+}
+
+
+CPUResources::CPUResources ()
+    : _quota(cgroupQuota()),
+      _shares({ 2.0, 2.0, 1.0 }),
+      _explicit_shares(false),
+      _blas_threads(0),
+      _pinning(PIN_NONE),
+      _role_cpus(3)
+{
+    // The own thread count of BLAS, restored when the shares return to the defaults
+#ifdef USE_MKL
+    this->_blas_threads = mkl_get_max_threads();
+#else
+    if (openblas_get_num_threads) this->_blas_threads = openblas_get_num_threads();
+#endif
+
+    // Sort the CPUs by NUMA nodes, the consecutive cores given to one role are then close to each other
+    const std::map<int, int> nodes = numaNodes();
+    std::vector<std::pair<int, int>> cpus;
+    for (int cpu: affinityCPUs())
+    {
+        auto it = nodes.find(cpu);
+        cpus.emplace_back((it != nodes.end()) ? it->second : 0, cpu);
+    }
+    std::sort(cpus.begin(), cpus.end());
+
+    for (const std::pair<int, int> &cpu: cpus)
+    {
+        this->_nodes.push_back(cpu.first);
+        this->_cpus.push_back(cpu.second);
+    }
+
+    // A fractional quota is rounded down - the threads on the last core would be throttled
+    this->_num_cores = this->_cpus.size();
+    if (this->_quota > 0.0) this->_num_cores = std::max(1, std::min(this->_num_cores, int(this->_quota)));
+
+    const char *shares  = std::getenv("CAFFE_CPU_SHARES");
+    const char *pinning = std::getenv("CAFFE_CPU_PINNING");
+    if (shares)
+    {
+        this->_shares = CPUResources::_parseShares(shares);
+        this->_explicit_shares = true;
+    }
+    if (pinning) this->_pinning = CPUResources::_parsePinning(pinning);
+
+    std::lock_guard<std::mutex> lock(this->_mtx);
+    this->_split();
+}
+
+
+void CPUResources::configure (const std::string &shares, const std::string &pinning)
+{
+    std::lock_guard<std::mutex> lock(this->_mtx);
+
+    if (!shares.empty())
+    {
+        this->_shares = CPUResources::_parseShares(shares);
+        this->_explicit_shares = true;
+    }
+    if (!pinning.empty()) this->_pinning = CPUResources::_parsePinning(pinning);
+
+    this->_split();
+}
+
+
+void CPUResources::reset ()
+{
+    std::lock_guard<std::mutex> lock(this->_mtx);
+
+    this->_shares          = { 2.0, 2.0, 1.0 };
+    this->_explicit_shares = false;
+    this->_pinning         = PIN_NONE;
+
+    this->_split();
+}
+
+
+int CPUResources::numCores () const
+{
+    std::lock_guard<std::mutex> lock(this->_mtx);
+    return this->_num_cores;
+}
+
+
+int CPUResources::numThreads (Role role, int max_threads) const
+{
+    std::lock_guard<std::mutex> lock(this->_mtx);
+
+    const int num_threads = this->_role_cpus[role].size();
+    return (max_threads > 0) ? std::min(num_threads, max_threads) : num_threads;
+}
+
+
+void CPUResources::pinThread (Role role, int t) const
+{
+    std::lock_guard<std::mutex> lock(this->_mtx);
+    if (this->_pinning == PIN_NONE) return;
+
+#ifdef __linux__
+    const std::vector<int> &cores = this->_role_cpus[role];
+    // Core of the thread in the list of the cores of the role
+    const int core = (t >= 0) ? cores[t % cores.size()] : -1;
+
+    std::vector<int> thread_cores;
+    for (int i: cores)
+    {
+        if (core < 0 || i == core || (this->_pinning == PIN_NUMA && this->_nodes[i] == this->_nodes[core]))
+        {
+            thread_cores.push_back(i);
+        }
+    }
+
+    setAffinity(this->_cpus, thread_cores, ROLE_NAMES[role]);
+#else
+    LOG(WARNING) << "Pinning of threads is only supported on Linux, ignoring";
+#endif
+}
+
+
+void CPUResources::pinThreadToTail (Role role, int num_cores) const
+{
+    if (num_cores <= 0) return;
+
+    std::lock_guard<std::mutex> lock(this->_mtx);
+
+#ifdef __linux__
+    const std::vector<int> &cores = this->_role_cpus[role];
+    LOG_IF(WARNING, num_cores > cores.size()) << "Only " << cores.size() << " " << ROLE_NAMES[role]
+                                              << " cores, a thread can not be pinned to " << num_cores;
+
+    const int first = std::max(0, int(cores.size()) - num_cores);
+    setAffinity(this->_cpus, std::vector<int>(cores.begin() + first, cores.end()), ROLE_NAMES[role]);
+#else
+    LOG(WARNING) << "Pinning of threads is only supported on Linux, ignoring";
+#endif
+}
+
+
+std::string CPUResources::layout () const
+{
+    std::lock_guard<std::mutex> lock(this->_mtx);
+    return this->_describe();
+}
+
+
+// -----------------------------------------  PRIVATE METHODS  ----------------------------------------- //
+
+void CPUResources::_split ()
+{
+    // Numbers of cores proportional to the shares, each role gets at least one core
+    const double total = std::accumulate(this->_shares.begin(), this->_shares.end(), 0.0);
+    std::vector<int> counts(3);
+    for (int r = 0; r < 3; ++r)
+    {
+        counts[r] = std::max(1, int(std::round(this->_num_cores * this->_shares[r] / total)));
+    }
+
+    // Rounding may hand out more or less cores than there are - take them from the largest roles or give the
+    // rest to the compute threads
+    int sum = std::accumulate(counts.begin(), counts.end(), 0);
+    while (sum > this->_num_cores)
+    {
+        auto largest = std::max_element(counts.begin(), counts.end());
+        if (*largest == 1) break;
+        (*largest)--;
+        sum--;
+    }
+    if (sum < this->_num_cores) counts[COMPUTE] += this->_num_cores - sum;
+
+    // Consecutive ranges of cores, when there are fewer cores than roles, the roles share them
+    int next = 0;
+    for (int r = 0; r < 3; ++r)
+    {
+        this->_role_cpus[r].clear();
+        for (int i = 0; i < counts[r]; ++i) this->_role_cpus[r].push_back(next++ % this->_num_cores);
+    }
+
+    // BLAS threads run on the compute cores. With the default shares BLAS keeps its own thread count, the tools
+    // without data and loss pools would otherwise lose the data and loss cores
+    const int blas_threads = this->_explicit_shares ? counts[COMPUTE] : this->_blas_threads;
+    if (blas_threads > 0)
+    {
+#ifdef USE_MKL
+        mkl_set_num_threads(blas_threads);
+#else
+        if (openblas_set_num_threads) openblas_set_num_threads(blas_threads);
+#endif
+    }
+
+    LOG(INFO) << "CPU layout: " << this->_describe();
+}
+
+
+std::vector<double> CPUResources::_parseShares (const std::string &shares)
+{
+    std::vector<std::string> values;
+    boost::split(values, shares, boost::is_any_of(":"));
+    CHECK_EQ(values.size(), 3) << "CPU shares must have the format compute:data:loss, got '" << shares << "'";
+
+    std::vector<double> result;
+    for (const std::string &value: values)
+    {
+        result.push_back(std::stod(value));
+        CHECK_GT(result.back(), 0.0) << "CPU shares must be positive, got '" << shares << "'";
+    }
+
+    return result;
+}
+
+
+CPUResources::Pinning CPUResources::_parsePinning (const std::string &pinning)
+{
+    for (int p = 0; p < 3; ++p)
+    {
+        if (pinning == PINNING_NAMES[p]) return Pinning(p);
+    }
+
+    LOG(FATAL) << "Unknown CPU pinning '" << pinning << "', use none, core or numa";
+    return PIN_NONE;
+}
+
+
+std::string CPUResources::_describe () const
+{
+    const std::set<int> nodes(this->_nodes.begin(), this->_nodes.begin() + this->_num_cores);
+
+    std::ostringstream oss;
+    oss << this->_num_cores << " cores of " << this->_cpus.size() << " CPUs in the affinity mask";
+    if (this->_quota > 0.0) oss << " (cgroup quota " << this->_quota << " CPUs)";
+    oss << ", " << nodes.size() << " NUMA node(s), pinning: " << PINNING_NAMES[this->_pinning];
+    if (!this->_explicit_shares) oss << ", default shares (BLAS threads not limited)";
+
+    for (int r = 0; r < 3; ++r)
+    {
+        oss << "\n    " << ROLE_NAMES[r] << ": " << this->_role_cpus[r].size() << " cores [";
+        for (int i = 0; i < this->_role_cpus[r].size(); ++i)
+        {
+            const int core = this->_role_cpus[r][i];
+            oss << ((i > 0) ? ", " : "") << this->_cpus[core];
+            if (nodes.size() > 1) oss << " (node " << this->_nodes[core] << ")";
+        }
+        oss << "]";
+    }
+
+    return oss.str();
+}
+
+
+}  // namespace caffe
@@ -0,0 +1,206 @@
+#include "caffe/util/detection.hpp"
+
+#include <algorithm>
+
+#ifdef USE_OPENCV
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "caffe/util/io.hpp"
+#endif
+
+
+namespace caffe {
+
+
+float iou2d (const Detection2D &a, const Detection2D &b)
+{
+    const float iw = std::min(a.xmax, b.xmax) - std::max(a.xmin, b.xmin);
+    const float ih = std::min(a.ymax, b.ymax) - std::max(a.ymin, b.ymin);
+    if (iw <= 0.0f || ih <= 0.0f) return 0.0f;
+
+    const float intersection = iw * ih;
+    return intersection / (a.area() + b.area() - intersection);
+}
+
+
+template <typename Dtype>
+std::vector<Detection2D> extractBBTXTDetections (const Blob<Dtype> &output, int b, double scale,
+                                                 double min_conf, int label)
+{
+    CHECK_EQ(output.num_axes(), 4) << "Output of a BBTXT network must be 4 dimensional";
+    CHECK_GE(output.shape(1), 5) << "Output of a BBTXT network must have at least 5 channels";
+    CHECK_LT(b, output.shape(0)) << "Image index out of the batch";
+
+    std::vector<Detection2D> detections;
+
+    const int height = output.shape(2);
+    const int width  = output.shape(3);
+
+    const Dtype *acc_prob = output.cpu_data() + output.offset(b, 0);
+    const Dtype *acc_xmin = output.cpu_data() + output.offset(b, 1);
+    const Dtype *acc_ymin = output.cpu_data() + output.offset(b, 2);
+    const Dtype *acc_xmax = output.cpu_data() + output.offset(b, 3);
+    const Dtype *acc_ymax = output.cpu_data() + output.offset(b, 4);
+
+    // Extract detected boxes - only extract local maxima from 3x3 neighborhood
+    for (int i = 0; i < height; ++i)
+    {
+        for (int j = 0; j < width; ++j)
+        {
+            const Dtype conf = acc_prob[i*width + j];
+            if (conf < min_conf || !isLocalMaximum(acc_prob, height, width, i, j)) continue;
+
+            const int idx = i*width + j;
+            detections.emplace_back(label, conf, acc_xmin[idx] / scale, acc_ymin[idx] / scale,
+                                    acc_xmax[idx] / scale, acc_ymax[idx] / scale);
+        }
+    }
+
+    return detections;
+}
+
+template std::vector<Detection2D> extractBBTXTDetections (const Blob<float> &output, int b, double scale,
+                                                          double min_conf, int label);
+template std::vector<Detection2D> extractBBTXTDetections (const Blob<double> &output, int b, double scale,
+                                                          double min_conf, int label);
+
+
+template <typename Dtype>
+std::vector<Detection3D> extractBB3TXTDetections (const Blob<Dtype> &output, int b, double scale,
+                                                  double min_conf, int label)
+{
+    CHECK_EQ(output.num_axes(), 4) << "Output of a BB3TXT network must be 4 dimensional";
+    CHECK_GE(output.shape(1), 8) << "Output of a BB3TXT network must have at least 8 channels";
+    CHECK_LT(b, output.shape(0)) << "Image index out of the batch";
+
+    std::vector<Detection3D> detections;
+
+    const int height = output.shape(2);
+    const int width  = output.shape(3);
+    const int channel_size = height * width;
+
+    const Dtype *acc_prob = output.cpu_data() + output.offset(b, 0);
+
+    // Extract detected boxes - only extract local maxima from 3x3 neighborhood
+    for (int i = 0; i < height; ++i)
+    {
+        for (int j = 0; j < width; ++j)
+        {
+            const Dtype conf = acc_prob[i*width + j];
+            if (conf < min_conf || !isLocalMaximum(acc_prob, height, width, i, j)) continue;
+
+            // Channels: prob, fblx, fbly, fbrx, fbry, rblx, rbly, ftly
+            const Dtype *coords = acc_prob + i*width + j;
+            detections.emplace_back(label, conf, coords[1*channel_size] / scale, coords[2*channel_size] / scale,
+                                    coords[3*channel_size] / scale, coords[4*channel_size] / scale,
+                                    coords[5*channel_size] / scale, coords[6*channel_size] / scale,
+                                    coords[7*channel_size] / scale);
+        }
+    }
+
+    return detections;
+}
+
+template std::vector<Detection3D> extractBB3TXTDetections (const Blob<float> &output, int b, double scale,
+                                                           double min_conf, int label);
+template std::vector<Detection3D> extractBB3TXTDetections (const Blob<double> &output, int b, double scale,
+                                                           double min_conf, int label);
+
+
+std::vector<Detection2D> nonMaximaSuppression (std::vector<Detection2D> &detections, double iou_threshold)
+{
+    return greedyNonMaximaSuppression(detections, iou_threshold, iou2d);
+}
+
+
+bool isPointwiseConvolution (const ConvolutionParameter &param)
+{
+    if (param.has_kernel_h() || param.has_kernel_w())
+    {
+        if (param.kernel_h() != 1 || param.kernel_w() != 1) return false;
+    }
+    else
+    {
+        if (param.kernel_size_size() == 0) return false;
+        for (int i = 0; i < param.kernel_size_size(); ++i) if (param.kernel_size(i) != 1) return false;
+    }
+
+    for (int i = 0; i < param.stride_size(); ++i) if (param.stride(i) != 1) return false;
+    for (int i = 0; i < param.pad_size(); ++i) if (param.pad(i) != 0) return false;
+    for (int i = 0; i < param.dilation_size(); ++i) if (param.dilation(i) != 1) return false;
+    if (param.has_stride_h() && param.stride_h() != 1) return false;
+    if (param.has_stride_w() && param.stride_w() != 1) return false;
+    if (param.pad_h() != 0 || param.pad_w() != 0) return false;
+
+    return param.group() == 1 && param.axis() == 1;
+}
+
+
+int enableSparseAccumulators (NetParameter &param, float min_conf)
+{
+    int replaced = 0;
+
+    for (int l = 0; l < param.layer_size(); ++l)
+    {
+        const LayerParameter &bb_layer = param.layer(l);
+        if (bb_layer.type() != "BBTXTBB" && bb_layer.type() != "BB3TXTBB") continue;
+        CHECK_GE(bb_layer.bottom_size(), 1);
+
+        // Find the last layer before the bb layer, which produces its input
+        for (int k = l-1; k >= 0; --k)
+        {
+            const LayerParameter &acc_layer = param.layer(k);
+            if (std::find(acc_layer.top().begin(), acc_layer.top().end(), bb_layer.bottom(0))
+                    == acc_layer.top().end()) continue;
+
+            if (acc_layer.type() == "Convolution" && isPointwiseConvolution(acc_layer.convolution_param()))
+            {
+                LayerParameter *sparse_layer = param.mutable_layer(k);
+                sparse_layer->set_type("SparseAccumulator");
+                sparse_layer->mutable_sparse_accumulator_param()->set_min_conf(min_conf);
+                replaced++;
+            }
+            else if (acc_layer.type() != "SparseAccumulator")
+            {
+                LOG(WARNING) << "Accumulator '" << acc_layer.name() << "' is not a 1x1 convolution, it will "
+                             << "be evaluated densely";
+            }
+            break;
+        }
+    }
+
+    return replaced;
+}
+
+
+#ifdef USE_OPENCV
+cv::Mat pyramidLevel (const std::string &path_image, double scale, std::map<int, cv::Mat> &decoded,
+                      cv::Size &original_size)
+{
+    const int factor = ReducedDecodeFactor(scale);
+
+    auto it = decoded.find(factor);
+    if (it == decoded.end())
+    {
+        cv::Mat image = ReadImageToCVMatReduced(path_image, factor, true, &original_size.height,
+                                                &original_size.width);
+        // Convert to zero mean and unit variance
+        cv::Mat imagef; image.convertTo(imagef, CV_32FC3);
+        imagef -= cv::Scalar(128.0f, 128.0f, 128.0f);
+        imagef *= 1.0f/128.0f;
+
+        it = decoded.insert(std::make_pair(factor, imagef)).first;
+    }
+
+    // The size is computed from the original image, so it does not depend on the reduction factor
+    const cv::Size size(cvRound(original_size.width*scale), cvRound(original_size.height*scale));
+    if (it->second.size() == size) return it->second;
+
+    cv::Mat imagef_scaled;
+    cv::resize(it->second, imagef_scaled, size);
+    return imagef_scaled;
+}
+#endif
+
+
+}  // namespace caffe
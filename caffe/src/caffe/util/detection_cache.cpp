@@ -0,0 +1,131 @@
+#include "caffe/util/detection_cache.hpp"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+
+#include "caffe/util/fnv1a.hpp"
+
+
+namespace caffe {
+
+
+namespace {
+
+    const uint32_t DETECTION_CACHE_MAGIC = 0x43544544;  // "DETC"
+
+    std::string hex (uint64_t value)
+    {
+        char buffer[17];
+        std::snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long)value);
+        return std::string(buffer);
+    }
+
+}
+
+
+DetectionCache::DetectionCache (const std::string &path_dir, const std::string &path_prototxt,
+                                const std::string &path_caffemodel)
+    : _path_dir(path_dir)
+{
+    boost::filesystem::create_directories(path_dir);
+    CHECK(boost::filesystem::is_directory(path_dir)) << "Cache directory '" << path_dir << "' is not a directory";
+
+    const uint64_t hashes[2] = { hashFile(path_prototxt), hashFile(path_caffemodel) };
+    this->_net_hash = fnv1a(FNV1A_OFFSET, reinterpret_cast<const char*>(hashes), sizeof(hashes));
+
+    LOG(INFO) << "Detection cache '" << path_dir << "', network " << hex(this->_net_hash);
+}
+
+
+uint64_t DetectionCache::hashFile (const std::string &path)
+{
+    std::ifstream infile(path.c_str(), std::ios::binary);
+    CHECK(infile) << "Unable to open file '" << path << "' for hashing";
+
+    uint64_t hash = FNV1A_OFFSET;
+    std::vector<char> buffer(1 << 20);
+    while (infile)
+    {
+        infile.read(buffer.data(), buffer.size());
+        hash = fnv1a(hash, buffer.data(), infile.gcount());
+    }
+
+    return hash;
+}
+
+
+std::string DetectionCache::key (uint64_t image_hash, double scale) const
+{
+    // The scale is part of the key bit-exactly
+    uint64_t scale_bits;
+    std::memcpy(&scale_bits, &scale, sizeof(scale));
+
+    return hex(image_hash) + "_" + hex(this->_net_hash) + "_" + hex(scale_bits);
+}
+
+
+bool DetectionCache::load (const std::string &key, int record_size, std::vector<float> &candidates) const
+{
+    std::ifstream infile(this->_path(key).c_str(), std::ios::binary);
+    if (!infile) return false;
+
+    uint32_t header[3];
+    infile.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!infile || header[0] != DETECTION_CACHE_MAGIC)
+    {
+        LOG(WARNING) << "Corrupted detection cache entry '" << this->_path(key) << "'";
+        return false;
+    }
+    CHECK_EQ(int(header[1]), record_size) << "Detection cache entry '" << this->_path(key)
+                                          << "' has a different record size";
+
+    candidates.resize(size_t(header[1]) * header[2]);
+    infile.read(reinterpret_cast<char*>(candidates.data()), candidates.size() * sizeof(float));
+    if (!infile)
+    {
+        LOG(WARNING) << "Truncated detection cache entry '" << this->_path(key) << "'";
+        return false;
+    }
+
+    return true;
+}
+
+
+void DetectionCache::store (const std::string &key, int record_size, const std::vector<float> &candidates) const
+{
+    CHECK_GT(record_size, 0);
+    CHECK_EQ(candidates.size() % record_size, 0) << "Candidates must consist of whole records";
+
+    // Write to a temporary file first and then rename it, so no one can read a half written entry
+    const std::string path = this->_path(key);
+    const std::string path_tmp = path + ".tmp" + std::to_string(getpid());
+
+    {
+        std::ofstream outfile(path_tmp.c_str(), std::ios::binary);
+        CHECK(outfile) << "Unable to create detection cache entry '" << path_tmp << "'";
+
+        const uint32_t header[3] = { DETECTION_CACHE_MAGIC, uint32_t(record_size),
+                                     uint32_t(candidates.size() / record_size) };
+        outfile.write(reinterpret_cast<const char*>(header), sizeof(header));
+        outfile.write(reinterpret_cast<const char*>(candidates.data()), candidates.size() * sizeof(float));
+        CHECK(outfile) << "Unable to write detection cache entry '" << path_tmp << "'";
+    }
+
+    CHECK_EQ(std::rename(path_tmp.c_str(), path.c_str()), 0) << "Unable to rename '" << path_tmp << "'";
+}
+
+
+// -----------------------------------------  PRIVATE METHODS  ----------------------------------------- //
+
+std::string DetectionCache::_path (const std::string &key) const
+{
+    return (boost::filesystem::path(this->_path_dir) / (key + ".det")).string();
+}
+
+
+}  // namespace caffe
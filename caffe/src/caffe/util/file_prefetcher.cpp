@@ -0,0 +1,399 @@
+#include "caffe/util/file_prefetcher.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+
+#ifdef USE_LIBURING
+#include <liburing.h>
+#endif
+
+
+namespace caffe {
+
+
+namespace {
+
+    const int READ_QUEUED  = 0;
+    const int READ_RUNNING = 1;
+    const int READ_DONE    = 2;
+    const int READ_FAILED  = 3;
+
+    // Stages of an io_uring read
+    const int STAGE_OPEN = 0;
+    const int STAGE_STAT = 1;
+    const int STAGE_READ = 2;
+
+}
+
+
+struct FilePrefetcher::Read
+{
+    Read (const std::string &filename)
+        : filename(filename),
+          state(READ_QUEUED),
+          discarded(false),
+          stage(STAGE_OPEN),
+          fd(-1),
+          offset(0)
+    {
+    }
+
+
+    std::string filename;
+    std::vector<unsigned char> buffer;
+    // One of READ_*, guarded by the mutex of the prefetcher
+    int state;
+    // The read was discarded, nobody will take it
+    bool discarded;
+
+    // State of the io_uring request - only touched by the ring thread
+    int stage;
+    int fd;
+    size_t offset;
+#ifdef USE_LIBURING
+    struct statx stx;
+#endif
+};
+
+
+#ifdef USE_LIBURING
+struct FilePrefetcher::Ring
+{
+    Ring () : initialized(false) {}
+    ~Ring () { if (this->initialized) io_uring_queue_exit(&this->ring); }
+
+    /**
+     * @brief Creates the ring and checks that the kernel supports all operations of the reads
+     */
+    bool init (int queue_depth)
+    {
+        if (io_uring_queue_init(queue_depth, &this->ring, 0) != 0) return false;
+        this->initialized = true;
+
+        struct io_uring_probe *probe = io_uring_get_probe_ring(&this->ring);
+        if (!probe) return false;
+        const bool supported = io_uring_opcode_supported(probe, IORING_OP_OPENAT)
+                && io_uring_opcode_supported(probe, IORING_OP_STATX)
+                && io_uring_opcode_supported(probe, IORING_OP_READ);
+        io_uring_free_probe(probe);
+
+        return supported;
+    }
+
+
+    struct io_uring ring;
+    bool initialized;
+};
+#else
+struct FilePrefetcher::Ring {};
+#endif
+
+
+FilePrefetcher::FilePrefetcher (int num_threads, int queue_depth, bool use_io_uring)
+    : _stop(false),
+      _queue_depth(queue_depth)
+{
+    CHECK_GT(num_threads, 0);
+    CHECK_GT(queue_depth, 0);
+
+#ifdef USE_LIBURING
+    if (use_io_uring)
+    {
+        this->_ring.reset(new Ring());
+        if (!this->_ring->init(queue_depth))
+        {
+            LOG(WARNING) << "io_uring is not available, files will be read by " << num_threads << " threads";
+            this->_ring.reset();
+        }
+    }
+#else
+    if (use_io_uring) DLOG(INFO) << "Built without io_uring, files will be read by " << num_threads << " threads";
+#endif
+
+    if (this->_ring)
+    {
+        // One thread submits all reads to the ring
+        this->_threads.emplace_back(&FilePrefetcher::_ringEntry, this);
+    }
+    else
+    {
+        for (int i = 0; i < num_threads; ++i) this->_threads.emplace_back(&FilePrefetcher::_threadEntry, this);
+    }
+}
+
+
+FilePrefetcher::~FilePrefetcher ()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->_mtx);
+        this->_stop = true;
+    }
+    this->_cv_queue.notify_all();
+    for (std::thread &thread: this->_threads) thread.join();
+
+    // Fail the reads, which were never started
+    for (const std::shared_ptr<Read> &read: this->_queue) this->_finish(read, false);
+}
+
+
+void FilePrefetcher::prefetch (long key, const std::string &filename)
+{
+    std::shared_ptr<Read> read = std::make_shared<Read>(filename);
+
+    {
+        std::lock_guard<std::mutex> lock(this->_mtx);
+        CHECK(this->_reads.emplace(key, read).second) << "File with key " << key << " is already prefetched";
+        this->_queue.push_back(read);
+    }
+    this->_cv_queue.notify_one();
+}
+
+
+bool FilePrefetcher::take (long key, std::vector<unsigned char> &buffer)
+{
+    std::unique_lock<std::mutex> lock(this->_mtx);
+
+    auto it = this->_reads.find(key);
+    if (it == this->_reads.end())
+    {
+        this->_stats.misses++;
+        return false;
+    }
+
+    std::shared_ptr<Read> read = it->second;
+    this->_reads.erase(it);
+
+    const bool waited = (read->state == READ_QUEUED || read->state == READ_RUNNING);
+    this->_cv_done.wait(lock, [&read]() { return read->state == READ_DONE || read->state == READ_FAILED; });
+
+    if (read->state == READ_FAILED)
+    {
+        this->_stats.misses++;
+        return false;
+    }
+
+    if (waited) this->_stats.waits++;
+    else        this->_stats.hits++;
+
+    buffer.swap(read->buffer);
+    return true;
+}
+
+
+void FilePrefetcher::discard (long key)
+{
+    std::lock_guard<std::mutex> lock(this->_mtx);
+
+    auto it = this->_reads.find(key);
+    if (it == this->_reads.end()) return;
+
+    // Reads, which were not started yet, will be skipped, the running ones are let finish
+    it->second->discarded = true;
+    this->_reads.erase(it);
+}
+
+
+bool FilePrefetcher::usesIOUring () const
+{
+    return bool(this->_ring);
+}
+
+
+FilePrefetcher::Stats FilePrefetcher::stats () const
+{
+    std::lock_guard<std::mutex> lock(this->_mtx);
+    return this->_stats;
+}
+
+
+// -----------------------------------------  PRIVATE METHODS  ----------------------------------------- //
+
+void FilePrefetcher::_threadEntry ()
+{
+    while (true)
+    {
+        std::shared_ptr<Read> read;
+        {
+            std::unique_lock<std::mutex> lock(this->_mtx);
+            this->_cv_queue.wait(lock, [this]() { return this->_stop || !this->_queue.empty(); });
+            if (this->_stop) return;
+
+            read = this->_queue.front();
+            this->_queue.pop_front();
+            if (read->discarded) continue;
+            read->state = READ_RUNNING;
+        }
+
+        const bool ok = FilePrefetcher::_readFile(read->filename, read->buffer);
+        this->_finish(read, ok);
+    }
+}
+
+
+void FilePrefetcher::_ringEntry ()
+{
+#ifdef USE_LIBURING
+    struct io_uring *ring = &this->_ring->ring;
+
+    // Reads with a request in the ring, each read has at most one request in the ring at a time
+    std::unordered_map<Read*, std::shared_ptr<Read>> in_flight;
+
+    // Closes the file of the read and finishes it
+    auto close_read = [this, &in_flight] (Read *read, bool ok) {
+        if (read->fd >= 0) close(read->fd);
+        read->fd = -1;
+        this->_finish(in_flight[read], ok);
+        in_flight.erase(read);
+    };
+
+    auto get_sqe = [ring] (Read *read) {
+        struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+        CHECK(sqe) << "The submission queue is full";
+        io_uring_sqe_set_data(sqe, read);
+        return sqe;
+    };
+
+    auto prep_read = [&get_sqe] (Read *read) {
+        io_uring_prep_read(get_sqe(read), read->fd, read->buffer.data() + read->offset,
+                           read->buffer.size() - read->offset, read->offset);
+    };
+
+    while (true)
+    {
+        // Start new reads while there is space in the ring
+        std::vector<std::shared_ptr<Read>> started;
+        {
+            std::unique_lock<std::mutex> lock(this->_mtx);
+            if (in_flight.empty())
+            {
+                this->_cv_queue.wait(lock, [this]() { return this->_stop || !this->_queue.empty(); });
+                if (this->_stop) return;
+            }
+
+            while (!this->_stop && !this->_queue.empty()
+                   && int(in_flight.size() + started.size()) < this->_queue_depth)
+            {
+                std::shared_ptr<Read> read = this->_queue.front();
+                this->_queue.pop_front();
+                if (read->discarded) continue;
+                read->state = READ_RUNNING;
+                started.push_back(read);
+            }
+        }
+
+        for (const std::shared_ptr<Read> &read: started)
+        {
+            in_flight[read.get()] = read;
+            io_uring_prep_openat(get_sqe(read.get()), AT_FDCWD, read->filename.c_str(), O_RDONLY, 0);
+        }
+        if (!started.empty()) io_uring_submit(ring);
+
+        // Wait for the completions, but come back regularly to start the newly queued reads
+        struct io_uring_cqe *cqe;
+        struct __kernel_timespec timeout;
+        timeout.tv_sec  = 0;
+        timeout.tv_nsec = 1000000;
+        const int ret = io_uring_wait_cqe_timeout(ring, &cqe, &timeout);
+        if (ret == -ETIME || ret == -EINTR) continue;
+        CHECK_EQ(ret, 0) << "Waiting for io_uring completions failed";
+
+        // Advance each completed read to its next stage
+        unsigned head;
+        unsigned num_completed = 0;
+        io_uring_for_each_cqe(ring, head, cqe)
+        {
+            num_completed++;
+
+            // On kernels without IORING_FEAT_EXT_ARG liburing waits with an internal timeout request, its
+            // completion is not one of the reads
+            if (cqe->user_data == LIBURING_UDATA_TIMEOUT) continue;
+
+            Read *read    = static_cast<Read*>(io_uring_cqe_get_data(cqe));
+            const int res = cqe->res;
+
+            if (res < 0)
+            {
+                close_read(read, false);
+                continue;
+            }
+
+            switch (read->stage)
+            {
+            case STAGE_OPEN:
+                read->fd    = res;
+                read->stage = STAGE_STAT;
+                io_uring_prep_statx(get_sqe(read), read->fd, "", AT_EMPTY_PATH, STATX_SIZE, &read->stx);
+                break;
+            case STAGE_STAT:
+                read->buffer.resize(read->stx.stx_size);
+                read->stage = STAGE_READ;
+                if (read->buffer.empty()) close_read(read, true);
+                else                      prep_read(read);
+                break;
+            case STAGE_READ:
+                // Reads may be short, continue where this one ended
+                read->offset += res;
+                if (res == 0)                                  close_read(read, false);  // File was truncated
+                else if (read->offset < read->buffer.size())   prep_read(read);
+                else                                           close_read(read, true);
+                break;
+            }
+        }
+        io_uring_cq_advance(ring, num_completed);
+        io_uring_submit(ring);
+    }
+#endif
+}
+
+
+void FilePrefetcher::_finish (const std::shared_ptr<Read> &read, bool ok)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->_mtx);
+        read->state = ok ? READ_DONE : READ_FAILED;
+        if (!ok || read->discarded) std::vector<unsigned char>().swap(read->buffer);
+    }
+    this->_cv_done.notify_all();
+}
+
+
+bool FilePrefetcher::_readFile (const std::string &filename, std::vector<unsigned char> &buffer)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    buffer.resize(st.st_size);
+    size_t offset = 0;
+    while (offset < buffer.size())
+    {
+        const ssize_t res = read(fd, buffer.data() + offset, buffer.size() - offset);
+        if (res < 0 && errno == EINTR) continue;
+        if (res <= 0) break;
+        offset += res;
+    }
+    close(fd);
+
+    return offset == buffer.size();
+}
+
+
+std::ostream& operator<< (std::ostream &os, const FilePrefetcher::Stats &stats)
+{
+    os << "coverage " << 100.0*stats.coverage() << "% (" << stats.hits << " hits, " << stats.waits << " waits, "
+       << stats.misses << " misses)";
+    return os;
+}
+
+
+}  // namespace caffe
@@ -8,6 +8,10 @@
 #include <opencv2/highgui/highgui_c.h>
 #include <opencv2/imgproc/imgproc.hpp>
 #endif  // USE_OPENCV
+#ifdef USE_LIBJPEG
+#include <jpeglib.h>
+#include <setjmp.h>
+#endif  // USE_LIBJPEG
 #include <stdint.h>
 
 #include <algorithm>
@@ -102,6 +106,105 @@ cv::Mat ReadImageToCVMat(const string& filename) {
   return ReadImageToCVMat(filename, 0, 0, true);
 }
 
+#ifdef USE_LIBJPEG
+struct JPEGErrorManager {
+  jpeg_error_mgr pub;
+  jmp_buf jump;
+};
+
+static void JPEGErrorExit(j_common_ptr cinfo) {
+  longjmp(reinterpret_cast<JPEGErrorManager*>(cinfo->err)->jump, 1);
+}
+
+// Decodes a JPEG file scaled by 1/factor in the DCT domain. Returns false if
+// libjpeg cannot decode the file, the caller then falls back to OpenCV. No
+// objects with destructors may live in this function because of longjmp.
+static bool DecodeJPEGReduced(FILE* file, const int factor,
+    const bool is_color, cv::Mat* image, cv::Size* original_size) {
+  jpeg_decompress_struct cinfo;
+  JPEGErrorManager jerr;
+  cinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit = JPEGErrorExit;
+  if (setjmp(jerr.jump)) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+
+  jpeg_create_decompress(&cinfo);
+  jpeg_stdio_src(&cinfo, file);
+  jpeg_read_header(&cinfo, TRUE);
+  // Leave CMYK images to OpenCV
+  if (cinfo.jpeg_color_space == JCS_CMYK ||
+      cinfo.jpeg_color_space == JCS_YCCK) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+
+  *original_size = cv::Size(cinfo.image_width, cinfo.image_height);
+  cinfo.out_color_space = is_color ? JCS_RGB : JCS_GRAYSCALE;
+  cinfo.scale_num = 1;
+  cinfo.scale_denom = factor;
+  jpeg_start_decompress(&cinfo);
+
+  image->create(cinfo.output_height, cinfo.output_width,
+      is_color ? CV_8UC3 : CV_8UC1);
+  while (cinfo.output_scanline < cinfo.output_height) {
+    JSAMPROW row = image->ptr<uchar>(cinfo.output_scanline);
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+  return true;
+}
+#endif  // USE_LIBJPEG
+
+int ReducedDecodeFactor(const double scale) {
+  int factor = 1;
+  while (factor < 8 && scale <= 1.0 / (2 * factor)) factor *= 2;
+  return factor;
+}
+
+cv::Mat ReadImageToCVMatReduced(const string& filename, const int factor,
+    const bool is_color, int* original_height, int* original_width) {
+  CHECK(factor == 1 || factor == 2 || factor == 4 || factor == 8)
+      << "Unsupported reduction factor " << factor;
+  cv::Size size;
+
+#ifdef USE_LIBJPEG
+  FILE* file = fopen(filename.c_str(), "rb");
+  if (file) {
+    // Only files starting with the JPEG SOI marker are given to libjpeg
+    unsigned char magic[3] = {0};
+    const bool is_jpeg = fread(magic, 1, 3, file) == 3 && magic[0] == 0xFF &&
+        magic[1] == 0xD8 && magic[2] == 0xFF;
+    cv::Mat cv_img;
+    bool decoded = false;
+    if (is_jpeg) {
+      rewind(file);
+      decoded = DecodeJPEGReduced(file, factor, is_color, &cv_img, &size);
+    }
+    fclose(file);
+    if (decoded) {
+      if (is_color) cv::cvtColor(cv_img, cv_img, CV_RGB2BGR);
+      if (original_height) *original_height = size.height;
+      if (original_width) *original_width = size.width;
+      return cv_img;
+    }
+  }
+#endif  // USE_LIBJPEG
+
+  cv::Mat cv_img = ReadImageToCVMat(filename, is_color);
+  size = cv_img.size();
+  if (original_height) *original_height = size.height;
+  if (original_width) *original_width = size.width;
+  if (cv_img.data && factor > 1) {
+    cv::resize(cv_img, cv_img, cv::Size((size.width + factor - 1) / factor,
+        (size.height + factor - 1) / factor), 0, 0, cv::INTER_AREA);
+  }
+  return cv_img;
+}
+
 // Do the file extension and encoding match?
 static bool matchExt(const std::string & fn,
                      std::string en) {
@@ -0,0 +1,342 @@
+#include <atomic>
+#include <boost/thread.hpp>
+#include <string>
+
+#include "caffe/layers/base_data_layer.hpp"
+#include "caffe/util/lockfree_queue.hpp"
+
+namespace caffe {
+
+
+namespace {
+
+    // Number of busy-wait iterations before the thread starts yielding and number of yields before it parks
+    const int SPIN_ITERATIONS  = 256;
+    const int YIELD_ITERATIONS = 16;
+
+
+    inline void cpuRelax ()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+
+    /**
+     * @brief Waits until the predicate is satisfied. Spins first, then parks on the condition variable
+     * @param attempt Predicate, which tries to complete the operation (e.g. try_pop) - called repeatedly
+     * @param mtx Mutex protecting the condition variable
+     * @param cond Condition variable the thread parks on
+     * @param num_parked Number of threads parked on the condition variable
+     * @param log_on_wait Message logged when the thread parks
+     */
+    template <typename Attempt>
+    void spinThenPark (Attempt attempt, boost::mutex &mtx, boost::condition_variable &cond,
+                       std::atomic<int> &num_parked, const std::string &log_on_wait = "")
+    {
+        for (int i = 0; i < SPIN_ITERATIONS; ++i)
+        {
+            if (attempt()) return;
+            cpuRelax();
+        }
+        for (int i = 0; i < YIELD_ITERATIONS; ++i)
+        {
+            boost::this_thread::interruption_point();
+            if (attempt()) return;
+            boost::this_thread::yield();
+        }
+
+        boost::mutex::scoped_lock lock(mtx);
+        // Announce the parked thread before the last attempt - the other side checks num_parked after it
+        // completes its operation, which guarantees that the wakeup cannot be lost
+        num_parked.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        try {
+            while (!attempt())
+            {
+                if (!log_on_wait.empty())
+                {
+                    LOG_EVERY_N(INFO, 1000) << log_on_wait;
+                }
+                // This is an interruption point - throws boost::thread_interrupted
+                cond.wait(lock);
+            }
+        } catch (...) {
+            num_parked.fetch_sub(1);
+            throw;
+        }
+
+        num_parked.fetch_sub(1);
+    }
+
+
+    /**
+     * @brief Wakes up parked threads if there are any
+     */
+    inline void unpark (boost::mutex &mtx, boost::condition_variable &cond, std::atomic<int> &num_parked,
+                        bool all)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (num_parked.load() > 0)
+        {
+            boost::mutex::scoped_lock lock(mtx);
+            if (all) cond.notify_all();
+            else     cond.notify_one();
+        }
+    }
+
+}
+
+
+// ---------------------------------------------  LOCKFREEQUEUE  ----------------------------------------- //
+
+template <typename T>
+class LockFreeQueue<T>::state
+{
+public:
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+
+    explicit state (size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity) size *= 2;
+
+        this->cells.reset(new Cell[size]);
+        this->mask = size - 1;
+        for (size_t i = 0; i < size; ++i) this->cells[i].sequence.store(i, std::memory_order_relaxed);
+
+        this->enqueue_pos.store(0, std::memory_order_relaxed);
+        this->dequeue_pos.store(0, std::memory_order_relaxed);
+        this->num_parked_pop.store(0);
+        this->num_parked_push.store(0);
+    }
+
+
+    bool tryPush (const T &t)
+    {
+        Cell *cell;
+        size_t pos = this->enqueue_pos.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            cell = &this->cells[pos & this->mask];
+            const size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = intptr_t(seq) - intptr_t(pos);
+
+            if (diff == 0)
+            {
+                // The cell is free - claim the position
+                if (this->enqueue_pos.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed)) break;
+            }
+            else if (diff < 0)
+            {
+                // The cell still holds an element from the previous lap - the queue is full
+                return false;
+            }
+            else
+            {
+                // Another producer claimed the position
+                pos = this->enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->data = t;
+        cell->sequence.store(pos+1, std::memory_order_release);
+        return true;
+    }
+
+
+    bool tryPop (T *t)
+    {
+        Cell *cell;
+        size_t pos = this->dequeue_pos.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            cell = &this->cells[pos & this->mask];
+            const size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = intptr_t(seq) - intptr_t(pos+1);
+
+            if (diff == 0)
+            {
+                // The cell contains an element - claim the position
+                if (this->dequeue_pos.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed)) break;
+            }
+            else if (diff < 0)
+            {
+                // The queue is empty
+                return false;
+            }
+            else
+            {
+                // Another consumer claimed the position
+                pos = this->dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        *t = cell->data;
+        // Release the cell for the producers of the next lap
+        cell->sequence.store(pos + this->mask + 1, std::memory_order_release);
+        return true;
+    }
+
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+
+    // Producer and consumer positions on separate cache lines
+    char pad0[64];
+    std::atomic<size_t> enqueue_pos;
+    char pad1[64];
+    std::atomic<size_t> dequeue_pos;
+    char pad2[64];
+
+    // Slow path - parking of the waiting threads
+    boost::mutex mtx;
+    boost::condition_variable cond_not_empty;
+    boost::condition_variable cond_not_full;
+    std::atomic<int> num_parked_pop;
+    std::atomic<int> num_parked_push;
+};
+
+
+template <typename T>
+LockFreeQueue<T>::LockFreeQueue (size_t capacity)
+    : _state(new state(capacity))
+{
+}
+
+
+template <typename T>
+void LockFreeQueue<T>::push (const T &t)
+{
+    state &s = *this->_state;
+    spinThenPark([&s, &t] () { return s.tryPush(t); }, s.mtx, s.cond_not_full, s.num_parked_push);
+    unpark(s.mtx, s.cond_not_empty, s.num_parked_pop, false);
+}
+
+
+template <typename T>
+bool LockFreeQueue<T>::try_push (const T &t)
+{
+    state &s = *this->_state;
+    if (!s.tryPush(t)) return false;
+    unpark(s.mtx, s.cond_not_empty, s.num_parked_pop, false);
+    return true;
+}
+
+
+template <typename T>
+bool LockFreeQueue<T>::try_pop (T *t)
+{
+    state &s = *this->_state;
+    if (!s.tryPop(t)) return false;
+    unpark(s.mtx, s.cond_not_full, s.num_parked_push, false);
+    return true;
+}
+
+
+template <typename T>
+T LockFreeQueue<T>::pop (const std::string &log_on_wait)
+{
+    state &s = *this->_state;
+    T t;
+    spinThenPark([&s, &t] () { return s.tryPop(&t); }, s.mtx, s.cond_not_empty, s.num_parked_pop, log_on_wait);
+    unpark(s.mtx, s.cond_not_full, s.num_parked_push, false);
+    return t;
+}
+
+
+template <typename T>
+size_t LockFreeQueue<T>::size () const
+{
+    const size_t enqueued = this->_state->enqueue_pos.load(std::memory_order_relaxed);
+    const size_t dequeued = this->_state->dequeue_pos.load(std::memory_order_relaxed);
+    return (enqueued > dequeued) ? enqueued - dequeued : 0;
+}
+
+
+template <typename T>
+size_t LockFreeQueue<T>::capacity () const
+{
+    return this->_state->mask + 1;
+}
+
+
+template class LockFreeQueue<Batch<float>*>;
+template class LockFreeQueue<Batch<double>*>;
+template class LockFreeQueue<int>;
+
+
+
+// --------------------------------------------  LOCKFREECOUNTER  ---------------------------------------- //
+
+class LockFreeCounter::state
+{
+public:
+
+    state ()
+        : counter(0),
+          num_parked(0)
+    {
+    }
+
+
+    std::atomic<int> counter;
+    char pad[64];
+
+    boost::mutex mtx;
+    boost::condition_variable cond;
+    std::atomic<int> num_parked;
+};
+
+
+LockFreeCounter::LockFreeCounter ()
+    : _state(new state())
+{
+}
+
+
+void LockFreeCounter::reset ()
+{
+    this->_state->counter.store(0);
+}
+
+
+void LockFreeCounter::increase ()
+{
+    this->_state->counter.fetch_add(1);
+    // Waiters may wait for different counts - wake all of them
+    unpark(this->_state->mtx, this->_state->cond, this->_state->num_parked, true);
+}
+
+
+void LockFreeCounter::decrease ()
+{
+    this->_state->counter.fetch_sub(1);
+}
+
+
+int LockFreeCounter::getCount ()
+{
+    return this->_state->counter.load();
+}
+
+
+void LockFreeCounter::waitToCount (int count)
+{
+    state &s = *this->_state;
+    spinThenPark([&s, count] () { return s.counter.load(std::memory_order_acquire) >= count; }, s.mtx, s.cond,
+                 s.num_parked);
+}
+
+
+}  // namespace caffe
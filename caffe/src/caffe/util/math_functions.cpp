@@ -1,9 +1,12 @@
 #include <boost/math/special_functions/next.hpp>
-#include <boost/random.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
 
+#include <algorithm>
 #include <limits>
 
 #include "caffe/common.hpp"
+#include "caffe/util/cpu_resources.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
 
@@ -242,17 +245,115 @@ float caffe_nextafter(const float b);
 template
 double caffe_nextafter(const double b);
 
+namespace {
+
+// Values produced per call of Philox4x32::Generate. Even, so that the
+// Box-Muller pairs never straddle two batches.
+const int kRngBatch = 1024;
+// Fills at least this large are split over the hardware threads.
+const int kRngParallelMin = 1 << 20;
+
+// Uniform numbers in [0, 1) built from the 24 (float) or 53 (double) high
+// bits of one or two words of the stream.
 template <typename Dtype>
-void caffe_rng_uniform(const int n, const Dtype a, const Dtype b, Dtype* r) {
+inline int rng_words_per_value() { return sizeof(Dtype) / sizeof(uint32_t); }
+
+inline float rng_unit(const uint32_t* w, float) {
+  return (w[0] >> 8) * (1.0f / 16777216.0f);
+}
+
+inline double rng_unit(const uint32_t* w, double) {
+  return ((w[0] >> 5) * 67108864.0 + (w[1] >> 6))
+      * (1.0 / 9007199254740992.0);
+}
+
+// Turns the values [begin, end) of the stream into uniform numbers batch by
+// batch and hands each batch to transform(u, offset, count). begin must be a
+// multiple of kRngBatch, then value i always comes from the same words of the
+// stream no matter how the range is split.
+template <typename Dtype, typename Transform>
+void rng_fill_range(const Philox4x32& stream, const int begin, const int end,
+    Transform transform) {
+  const int words = rng_words_per_value<Dtype>();
+  uint32_t bits[2 * kRngBatch];
+  Dtype u[kRngBatch];
+  for (int offset = begin; offset < end; offset += kRngBatch) {
+    const int count = std::min(kRngBatch, end - offset);
+    const int count_even = (count + 1) & ~1;
+    stream.Generate(static_cast<uint64_t>(offset) * words
+                    / Philox4x32::kBlockWords,
+                    (count_even * words + Philox4x32::kBlockWords - 1)
+                    / Philox4x32::kBlockWords, bits);
+    for (int i = 0; i < count_even; ++i) {
+      u[i] = rng_unit(bits + i * words, Dtype());
+    }
+    transform(u, offset, count);
+  }
+}
+
+template <typename Dtype, typename Transform>
+void rng_fill(const Philox4x32& stream, const int n, Transform transform) {
+  const int num_batches = (n + kRngBatch - 1) / kRngBatch;
+  const int num_threads = (n < kRngParallelMin) ? 1 : std::min<int>(
+      num_batches, CPUResources::Get().numThreads(CPUResources::COMPUTE));
+  if (num_threads <= 1) {
+    rng_fill_range<Dtype>(stream, 0, n, transform);
+    return;
+  }
+  const int64_t per_thread =
+      static_cast<int64_t>((num_batches + num_threads - 1) / num_threads)
+      * kRngBatch;
+  boost::thread_group threads;
+  for (int t = 0; t < num_threads; ++t) {
+    const int begin = std::min<int64_t>(n, t * per_thread);
+    const int end = std::min<int64_t>(n, begin + per_thread);
+    if (begin >= end) break;
+    threads.create_thread(boost::bind(&rng_fill_range<Dtype, Transform>,
+        boost::cref(stream), begin, end, transform));
+  }
+  threads.join_all();
+}
+
+// Key of a fresh stream drawn from the thread's caffe_rng().
+Philox4x32 caffe_rng_stream() {
+  const uint64_t seed = (static_cast<uint64_t>(caffe_rng_rand()) << 32)
+      | caffe_rng_rand();
+  return Philox4x32(seed, 0);
+}
+
+template <typename Dtype, typename Itype>
+void caffe_rng_bernoulli_impl(const int n, const Dtype p, Itype* r,
+    const Philox4x32& stream) {
+  CHECK_GE(n, 0);
+  CHECK(r);
+  CHECK_GE(p, 0);
+  CHECK_LE(p, 1);
+  rng_fill<Dtype>(stream, n, [=](const Dtype* u, int offset, int count) {
+    for (int i = 0; i < count; ++i) {
+      r[offset + i] = static_cast<Itype>(u[i] < p);
+    }
+  });
+}
+
+}  // namespace
+
+template <typename Dtype>
+void caffe_rng_uniform(const int n, const Dtype a, const Dtype b, Dtype* r,
+    const Philox4x32& stream) {
   CHECK_GE(n, 0);
   CHECK(r);
   CHECK_LE(a, b);
-  boost::uniform_real<Dtype> random_distribution(a, caffe_nextafter<Dtype>(b));
-  boost::variate_generator<caffe::rng_t*, boost::uniform_real<Dtype> >
-      variate_generator(caffe_rng(), random_distribution);
-  for (int i = 0; i < n; ++i) {
-    r[i] = variate_generator();
-  }
+  const Dtype range = b - a;
+  rng_fill<Dtype>(stream, n, [=](const Dtype* u, int offset, int count) {
+    for (int i = 0; i < count; ++i) {
+      r[offset + i] = std::min(b, a + range * u[i]);
+    }
+  });
+}
+
+template <typename Dtype>
+void caffe_rng_uniform(const int n, const Dtype a, const Dtype b, Dtype* r) {
+  caffe_rng_uniform(n, a, b, r, caffe_rng_stream());
 }
 
 template
@@ -263,18 +364,36 @@ template
 void caffe_rng_uniform<double>(const int n, const double a, const double b,
                                double* r);
 
+template
+void caffe_rng_uniform<float>(const int n, const float a, const float b,
+                              float* r, const Philox4x32& stream);
+
+template
+void caffe_rng_uniform<double>(const int n, const double a, const double b,
+                               double* r, const Philox4x32& stream);
+
 template <typename Dtype>
-void caffe_rng_gaussian(const int n, const Dtype a,
-                        const Dtype sigma, Dtype* r) {
+void caffe_rng_gaussian(const int n, const Dtype mu, const Dtype sigma,
+                        Dtype* r, const Philox4x32& stream) {
   CHECK_GE(n, 0);
   CHECK(r);
   CHECK_GT(sigma, 0);
-  boost::normal_distribution<Dtype> random_distribution(a, sigma);
-  boost::variate_generator<caffe::rng_t*, boost::normal_distribution<Dtype> >
-      variate_generator(caffe_rng(), random_distribution);
-  for (int i = 0; i < n; ++i) {
-    r[i] = variate_generator();
-  }
+  // Box-Muller, every pair of uniform numbers gives a pair of normal ones
+  rng_fill<Dtype>(stream, n, [=](const Dtype* u, int offset, int count) {
+    for (int i = 0; i < count; i += 2) {
+      const Dtype radius =
+          sigma * std::sqrt(Dtype(-2) * std::log(Dtype(1) - u[i]));
+      const Dtype theta = Dtype(2 * M_PI) * u[i + 1];
+      r[offset + i] = mu + radius * std::cos(theta);
+      if (i + 1 < count) r[offset + i + 1] = mu + radius * std::sin(theta);
+    }
+  });
+}
+
+template <typename Dtype>
+void caffe_rng_gaussian(const int n, const Dtype mu,
+                        const Dtype sigma, Dtype* r) {
+  caffe_rng_gaussian(n, mu, sigma, r, caffe_rng_stream());
 }
 
 template
@@ -285,18 +404,25 @@ template
 void caffe_rng_gaussian<double>(const int n, const double mu,
                                 const double sigma, double* r);
 
+template
+void caffe_rng_gaussian<float>(const int n, const float mu,
+                               const float sigma, float* r,
+                               const Philox4x32& stream);
+
+template
+void caffe_rng_gaussian<double>(const int n, const double mu,
+                                const double sigma, double* r,
+                                const Philox4x32& stream);
+
+template <typename Dtype>
+void caffe_rng_bernoulli(const int n, const Dtype p, int* r,
+                         const Philox4x32& stream) {
+  caffe_rng_bernoulli_impl(n, p, r, stream);
+}
+
 template <typename Dtype>
 void caffe_rng_bernoulli(const int n, const Dtype p, int* r) {
-  CHECK_GE(n, 0);
-  CHECK(r);
-  CHECK_GE(p, 0);
-  CHECK_LE(p, 1);
-  boost::bernoulli_distribution<Dtype> random_distribution(p);
-  boost::variate_generator<caffe::rng_t*, boost::bernoulli_distribution<Dtype> >
-      variate_generator(caffe_rng(), random_distribution);
-  for (int i = 0; i < n; ++i) {
-    r[i] = variate_generator();
-  }
+  caffe_rng_bernoulli_impl(n, p, r, caffe_rng_stream());
 }
 
 template
@@ -305,18 +431,23 @@ void caffe_rng_bernoulli<double>(const int n, const double p, int* r);
 template
 void caffe_rng_bernoulli<float>(const int n, const float p, int* r);
 
+template
+void caffe_rng_bernoulli<double>(const int n, const double p, int* r,
+                                 const Philox4x32& stream);
+
+template
+void caffe_rng_bernoulli<float>(const int n, const float p, int* r,
+                                const Philox4x32& stream);
+
+template <typename Dtype>
+void caffe_rng_bernoulli(const int n, const Dtype p, unsigned int* r,
+                         const Philox4x32& stream) {
+  caffe_rng_bernoulli_impl(n, p, r, stream);
+}
+
 template <typename Dtype>
 void caffe_rng_bernoulli(const int n, const Dtype p, unsigned int* r) {
-  CHECK_GE(n, 0);
-  CHECK(r);
-  CHECK_GE(p, 0);
-  CHECK_LE(p, 1);
-  boost::bernoulli_distribution<Dtype> random_distribution(p);
-  boost::variate_generator<caffe::rng_t*, boost::bernoulli_distribution<Dtype> >
-      variate_generator(caffe_rng(), random_distribution);
-  for (int i = 0; i < n; ++i) {
-    r[i] = static_cast<unsigned int>(variate_generator());
-  }
+  caffe_rng_bernoulli_impl(n, p, r, caffe_rng_stream());
 }
 
 template
@@ -325,6 +456,14 @@ void caffe_rng_bernoulli<double>(const int n, const double p, unsigned int* r);
 template
 void caffe_rng_bernoulli<float>(const int n, const float p, unsigned int* r);
 
+template
+void caffe_rng_bernoulli<double>(const int n, const double p, unsigned int* r,
+                                 const Philox4x32& stream);
+
+template
+void caffe_rng_bernoulli<float>(const int n, const float p, unsigned int* r,
+                                const Philox4x32& stream);
+
 template <>
 float caffe_cpu_strided_dot<float>(const int n, const float* x, const int incx,
     const float* y, const int incy) {
@@ -0,0 +1,188 @@
+#include "caffe/util/nms_bev.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+
+#include <glog/logging.h>
+
+
+namespace {
+
+    struct Point
+    {
+        double x;
+        double y;
+    };
+
+
+    /**
+     * @brief Signed area of a polygon (positive for counter-clockwise order)
+     */
+    double signedArea (const std::vector<Point> &polygon)
+    {
+        double area = 0.0;
+        for (int i = 0; i < polygon.size(); ++i)
+        {
+            const Point &p = polygon[i];
+            const Point &q = polygon[(i+1) % polygon.size()];
+            area += p.x*q.y - q.x*p.y;
+        }
+        return area / 2.0;
+    }
+
+
+    /**
+     * @brief Corners of the rectangle in the counter-clockwise order
+     */
+    std::vector<Point> polygon (const GroundRect &r)
+    {
+        std::vector<Point> p(4);
+        for (int i = 0; i < 4; ++i) p[i] = {r.x[i], r.y[i]};
+        if (signedArea(p) < 0.0) std::reverse(p.begin(), p.end());
+        return p;
+    }
+
+
+    /**
+     * @brief Cross product of (b-a) and (p-a), positive if p lies left of the a->b edge
+     */
+    inline double side (const Point &a, const Point &b, const Point &p)
+    {
+        return (b.x-a.x)*(p.y-a.y) - (b.y-a.y)*(p.x-a.x);
+    }
+
+
+    /**
+     * @brief Area of the intersection of two convex counter-clockwise polygons (Sutherland-Hodgman clipping)
+     */
+    double intersectionArea (const std::vector<Point> &subject, const std::vector<Point> &clip)
+    {
+        std::vector<Point> output = subject;
+
+        for (int i = 0; i < clip.size() && !output.empty(); ++i)
+        {
+            const Point &a = clip[i];
+            const Point &b = clip[(i+1) % clip.size()];
+
+            std::vector<Point> input;
+            input.swap(output);
+
+            for (int j = 0; j < input.size(); ++j)
+            {
+                const Point &p = input[j];
+                const Point &q = input[(j+1) % input.size()];
+                const double sp = side(a, b, p);
+                const double sq = side(a, b, q);
+
+                if (sp >= 0.0) output.push_back(p);
+                if ((sp >= 0.0) != (sq >= 0.0))
+                {
+                    // The edge crosses the clipping line
+                    const double t = sp / (sp - sq);
+                    output.push_back({p.x + t*(q.x-p.x), p.y + t*(q.y-p.y)});
+                }
+            }
+        }
+
+        if (output.size() < 3) return 0.0;
+        return std::abs(signedArea(output));
+    }
+
+
+    inline int64_t cellKey (int cx, int cy)
+    {
+        return (int64_t(cx) << 32) ^ uint32_t(cy);
+    }
+
+}
+
+
+double GroundRect::area () const
+{
+    return std::abs(signedArea(polygon(*this)));
+}
+
+
+double iouBEV (const GroundRect &r1, const GroundRect &r2)
+{
+    const std::vector<Point> p1 = polygon(r1);
+    const std::vector<Point> p2 = polygon(r2);
+
+    const double intersection = intersectionArea(p1, p2);
+    const double uni = std::abs(signedArea(p1)) + std::abs(signedArea(p2)) - intersection;
+
+    return (uni > 0.0) ? intersection / uni : 0.0;
+}
+
+
+std::vector<int> nonMaximaSuppressionBEV (const std::vector<GroundRect> &rects, const std::vector<double> &conf,
+                                          double iou_threshold)
+{
+    CHECK_EQ(rects.size(), conf.size()) << "Each rectangle must have a confidence";
+
+    std::vector<int> kept;
+    if (rects.empty()) return kept;
+
+    // Centers of the rectangles and the size of the grid cell - two rectangles can only intersect if their
+    // centers are closer than the sum of their circumradii, which is at most the cell size. Therefore it
+    // is enough to look into the 3x3 neighborhood of the cell
+    std::vector<double> cx(rects.size()), cy(rects.size());
+    double cell_size = 0.0;
+    for (int i = 0; i < rects.size(); ++i)
+    {
+        cx[i] = (rects[i].x[0] + rects[i].x[1] + rects[i].x[2] + rects[i].x[3]) / 4.0;
+        cy[i] = (rects[i].y[0] + rects[i].y[1] + rects[i].y[2] + rects[i].y[3]) / 4.0;
+        for (int c = 0; c < 4; ++c)
+        {
+            cell_size = std::max(cell_size, 2.0 * std::hypot(rects[i].x[c]-cx[i], rects[i].y[c]-cy[i]));
+        }
+    }
+    if (cell_size <= 0.0) cell_size = 1.0;
+
+    // Spatial hash of the rectangles
+    std::unordered_map<int64_t, std::vector<int>> grid;
+    std::vector<int> cell_x(rects.size()), cell_y(rects.size());
+    for (int i = 0; i < rects.size(); ++i)
+    {
+        cell_x[i] = int(std::floor(cx[i] / cell_size));
+        cell_y[i] = int(std::floor(cy[i] / cell_size));
+        grid[cellKey(cell_x[i], cell_y[i])].push_back(i);
+    }
+
+    // Sort by confidence in the descending order
+    std::vector<int> order(rects.size());
+    for (int i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&conf] (int a, int b) { return conf[a] > conf[b]; });
+    std::vector<int> rank(rects.size());
+    for (int r = 0; r < order.size(); ++r) rank[order[r]] = r;
+
+    std::vector<bool> active(rects.size(), true);
+    for (int i: order)
+    {
+        if (!active[i]) continue;
+
+        kept.push_back(i);
+
+        // Suppress all overlapping rectangles with lower confidence in the neighboring cells
+        for (int dx = -1; dx <= 1; ++dx)
+        {
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                auto cell = grid.find(cellKey(cell_x[i]+dx, cell_y[i]+dy));
+                if (cell == grid.end()) continue;
+
+                for (int j: cell->second)
+                {
+                    if (active[j] && rank[j] > rank[i] && iouBEV(rects[i], rects[j]) > iou_threshold)
+                    {
+                        active[j] = false;
+                    }
+                }
+            }
+        }
+    }
+
+    return kept;
+}
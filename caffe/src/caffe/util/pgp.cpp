@@ -1,8 +1,66 @@
 #include <caffe/caffe.hpp>
 
+#include <cfloat>
+
 #include "caffe/util/pgp.hpp"
 
 
+namespace {
+
+    /**
+     * @brief Checks if the Z coordinate of all points in X_3x8 is in front of C_3x1
+     * @param X_3x8
+     * @param C_3x1
+     * @return True if z of all points in larger than z of C
+     */
+    bool checkZ (const cv::Mat &X_3x8, const cv::Mat &C_3x1)
+    {
+        for (int p = 0; p < 8; ++p)
+        {
+            if (X_3x8.at<double>(2, p) < C_3x1.at<double>(2,0))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+
+    /**
+     * @brief Check if the bottom trapezoid has some reasonable size (area)
+     * @param X_3x8 Coordinates of 3D bounding box corners ordered FBL FBR RBR RBL FTL FTR RTR RTL
+     * @return True if it has good size
+     */
+    bool checkBBSize (const cv::Mat &X_3x8)
+    {
+        // We will compute the area of the bottom trapezoid of the bounding box - we need to find the
+        // "height" h of the trapezoid in order to use the A = (a+b)*h / 2 equation for computing its area
+
+        // Get the plane defined by the RBL-FBL normal vector and FBL and intersect it with the RBR-FBR line
+        // The coordinates are ordered FBL FBR RBR RBL FTL FTR RTR RTL
+        cv::Mat n_3x1 = X_3x8(cv::Rect(0, 0, 1, 3)) - X_3x8(cv::Rect(3, 0, 1, 3));  // RBL - FBL
+        double d = -n_3x1.dot(X_3x8(cv::Rect(3, 0, 1, 3)));  // d from ax+by+cz+d=0
+
+        // Intersect the plane with RBR-FBR line (it has the same direction as RBL-FBL)
+        double lambda = -(n_3x1.dot(X_3x8(cv::Rect(1, 0, 1, 3))) + d) / n_3x1.dot(n_3x1);
+        cv::Mat ip_3x1 = X_3x8(cv::Rect(1, 0, 1, 3)) + lambda*n_3x1;  // Intersection point
+
+        // Now compute the distance of the intersected point and FBL to get the h
+        cv::Mat temp = X_3x8(cv::Rect(3, 0, 1, 3)) - ip_3x1;
+        double h = std::sqrt(temp.dot(temp));
+        // Distance of FBL and RBL - another side of the trapezoid
+        double a = std::sqrt(n_3x1.dot(n_3x1));
+
+        // Check the area - if it is too small or too big throw it away
+        double area = (a*a*h) / 2.0;
+        if (area < 1.5 || area > 7500) return false;
+        return true;
+    }
+
+}
+
+
 PGP::PGP (const cv::Mat &P_3x4, const cv::Mat &gp_1x4)
     : P_3x4(P_3x4.clone()),
       gp_1x4(gp_1x4.clone())
@@ -154,3 +212,86 @@ cv::Mat PGP::reconstructAndFixBB3D (BB3D &bb3d) const
 
     return X_3x8;
 }
+
+
+bool PGP::reconstructDetection (BB3D &bb3d, bool size_filter, GroundRect *rect) const
+{
+    cv::Mat X_3x8 = this->reconstructAndFixBB3D(bb3d);
+
+    // Now since the Z axis points forward, we can check if the reconstructed points are in
+    // front of the camera, if not then we can throw away this bounding box
+    if (!checkZ(X_3x8, this->C_3x1)) return false;
+
+    // Check if the bounding box is large enough - its bottom trapezoid should be of
+    // reasonable size
+    if (size_filter && !checkBBSize(X_3x8)) return false;
+
+    // Extract the 2D bounding box - project back the 3D one and find extremes
+    cv::Mat x_2x8 = this->projectXtox(X_3x8);
+    double xmin = DBL_MAX; double ymin = DBL_MAX; double xmax = DBL_MIN; double ymax = DBL_MIN;
+    for (int p = 0; p < 8; ++p)
+    {
+        const double u = x_2x8.at<double>(0, p);
+        const double v = x_2x8.at<double>(1, p);
+        if (u < xmin) xmin = u;
+        if (u > xmax) xmax = u;
+        if (v < ymin) ymin = v;
+        if (v > ymax) ymax = v;
+    }
+    // Set the 2D bounding box
+    bb3d.xmin = xmin;
+    bb3d.ymin = ymin;
+    bb3d.xmax = xmax;
+    bb3d.ymax = ymax;
+
+    if (rect != nullptr) *rect = this->groundRect(X_3x8);
+
+    return true;
+}
+
+
+GroundRect PGP::groundRect (const cv::Mat &X_3x8) const
+{
+    // Orthonormal basis (u,v) of the ground plane - u is perpendicular to the optical axis (or to the x axis
+    // if the camera looks straight at the ground). The IoU does not depend on the choice of the basis
+    double n[3] = {this->gp_1x4.at<double>(0,0), this->gp_1x4.at<double>(0,1), this->gp_1x4.at<double>(0,2)};
+    const double n_norm = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+    for (int i = 0; i < 3; ++i) n[i] /= n_norm;
+
+    double u[3] = {n[1], -n[0], 0.0};  // (0,0,1) x n
+    if (std::abs(n[2]) > 0.99) { u[0] = 0.0; u[1] = -n[2]; u[2] = n[1]; }  // (1,0,0) x n
+    const double u_norm = std::sqrt(u[0]*u[0] + u[1]*u[1] + u[2]*u[2]);
+    for (int i = 0; i < 3; ++i) u[i] /= u_norm;
+
+    const double v[3] = {n[1]*u[2] - n[2]*u[1], n[2]*u[0] - n[0]*u[2], n[0]*u[1] - n[1]*u[0]};  // n x u
+
+    // The bottom rectangle is given by the first 4 corners FBL FBR RBR RBL
+    GroundRect rect;
+    for (int c = 0; c < 4; ++c)
+    {
+        rect.x[c] = 0.0;
+        rect.y[c] = 0.0;
+        for (int i = 0; i < 3; ++i)
+        {
+            rect.x[c] += u[i] * X_3x8.at<double>(i,c);
+            rect.y[c] += v[i] * X_3x8.at<double>(i,c);
+        }
+    }
+
+    return rect;
+}
+
+
+std::vector<BB3D> reconstructDetections (const std::vector<BB3D> &candidates, const PGP *pgp, bool size_filter)
+{
+    // We do not have image projection matrices and ground planes - just output the detections
+    if (pgp == nullptr) return candidates;
+
+    std::vector<BB3D> bbs;
+    for (BB3D bb3d: candidates)
+    {
+        if (pgp->reconstructDetection(bb3d, size_filter)) bbs.push_back(bb3d);
+    }
+
+    return bbs;
+}
@@ -0,0 +1,44 @@
+#include "caffe/util/philox.hpp"
+
+namespace caffe {
+
+namespace {
+
+const uint32_t kPhiloxM0 = 0xD2511F53;
+const uint32_t kPhiloxM1 = 0xCD9E8D57;
+const uint32_t kPhiloxW0 = 0x9E3779B9;
+const uint32_t kPhiloxW1 = 0xBB67AE85;
+const int kPhiloxRounds = 10;
+
+}  // namespace
+
+void Philox4x32::Generate(uint64_t first_block, int num_blocks,
+    uint32_t* r) const {
+  // The blocks are independent and the loop body is branch free, so the
+  // compiler vectorizes it over consecutive counters.
+  for (int b = 0; b < num_blocks; ++b) {
+    const uint64_t counter = first_block + b;
+    uint32_t c0 = static_cast<uint32_t>(counter);
+    uint32_t c1 = static_cast<uint32_t>(counter >> 32);
+    uint32_t c2 = stream0_;
+    uint32_t c3 = stream1_;
+    uint32_t k0 = key0_;
+    uint32_t k1 = key1_;
+    for (int round = 0; round < kPhiloxRounds; ++round) {
+      const uint64_t p0 = static_cast<uint64_t>(kPhiloxM0) * c0;
+      const uint64_t p1 = static_cast<uint64_t>(kPhiloxM1) * c2;
+      c0 = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k0;
+      c1 = static_cast<uint32_t>(p1);
+      c2 = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k1;
+      c3 = static_cast<uint32_t>(p0);
+      k0 += kPhiloxW0;
+      k1 += kPhiloxW1;
+    }
+    r[kBlockWords * b] = c0;
+    r[kBlockWords * b + 1] = c1;
+    r[kBlockWords * b + 2] = c2;
+    r[kBlockWords * b + 3] = c3;
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,149 @@
+#include "caffe/util/sample_cache.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+
+
+namespace caffe {
+
+
+namespace {
+
+    const int SAMPLE_EMPTY   = 0;
+    const int SAMPLE_STORING = 1;
+    const int SAMPLE_CACHED  = 2;
+
+}
+
+
+template <typename Dtype>
+SampleCache<Dtype>::SampleCache (int num_samples, int data_count, int label_count, const std::string &filename)
+    : _num_samples(num_samples),
+      _data_count(data_count),
+      _label_count(label_count),
+      _state(new std::atomic<int>[num_samples]),
+      _num_cached(0),
+      _data(nullptr),
+      _mapped_size(0)
+{
+    CHECK_GT(num_samples, 0);
+    CHECK_GT(data_count, 0);
+    CHECK_GE(label_count, 0);
+
+    for (int i = 0; i < num_samples; ++i) this->_state[i] = SAMPLE_EMPTY;
+
+    const size_t size = size_t(num_samples) * (data_count + label_count);
+
+    if (filename.empty())
+    {
+        this->_ram.resize(size);
+        this->_data = this->_ram.data();
+        LOG(INFO) << "Caching " << num_samples << " samples in RAM (" << (size * sizeof(Dtype) >> 20) << " MB)";
+    }
+    else
+    {
+        this->_mapped_size = size * sizeof(Dtype);
+
+        // Each cache gets its own file next to the given path, so several nets or processes configured with
+        // the same path do not overwrite each other. The file is unlinked right after mapping - it disappears
+        // with the mapping, even after a crash
+        std::vector<char> path(filename.begin(), filename.end());
+        const std::string suffix = ".XXXXXX";
+        path.insert(path.end(), suffix.begin(), suffix.end());
+        path.push_back('\0');
+
+        int fd = mkstemp(path.data());
+        CHECK_GE(fd, 0) << "Could not create the cache file '" << path.data() << "'";
+        CHECK_EQ(ftruncate(fd, this->_mapped_size), 0) << "Could not resize the cache file '" << path.data() << "'";
+
+        void *mapped = mmap(nullptr, this->_mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        unlink(path.data());
+        CHECK(mapped != MAP_FAILED) << "Could not map the cache file '" << path.data() << "'";
+
+        this->_data = static_cast<Dtype*>(mapped);
+        LOG(INFO) << "Caching " << num_samples << " samples in the unlinked file '" << path.data() << "' ("
+                  << (this->_mapped_size >> 20) << " MB)";
+    }
+}
+
+
+template <typename Dtype>
+SampleCache<Dtype>::~SampleCache ()
+{
+    if (this->_mapped_size > 0) munmap(this->_data, this->_mapped_size);
+}
+
+
+template <typename Dtype>
+bool SampleCache<Dtype>::load (int i, Dtype *data, Dtype *label) const
+{
+    CHECK_GE(i, 0);
+    CHECK_LT(i, this->_num_samples);
+
+    if (this->_state[i].load(std::memory_order_acquire) != SAMPLE_CACHED) return false;
+
+    const Dtype *sample = this->_sample(i);
+    std::memcpy(data, sample, sizeof(Dtype) * this->_data_count);
+    std::memcpy(label, sample + this->_data_count, sizeof(Dtype) * this->_label_count);
+
+    return true;
+}
+
+
+template <typename Dtype>
+void SampleCache<Dtype>::store (int i, const Dtype *data, const Dtype *label)
+{
+    CHECK_GE(i, 0);
+    CHECK_LT(i, this->_num_samples);
+
+    // Claim the sample - if another thread is already storing it, we are done
+    int expected = SAMPLE_EMPTY;
+    if (!this->_state[i].compare_exchange_strong(expected, SAMPLE_STORING)) return;
+
+    Dtype *sample = this->_sample(i);
+    std::memcpy(sample, data, sizeof(Dtype) * this->_data_count);
+    std::memcpy(sample + this->_data_count, label, sizeof(Dtype) * this->_label_count);
+
+    this->_state[i].store(SAMPLE_CACHED, std::memory_order_release);
+    if (++this->_num_cached == this->_num_samples)
+    {
+        LOG(INFO) << "All " << this->_num_samples << " samples are cached";
+    }
+}
+
+
+template <typename Dtype>
+int SampleCache<Dtype>::numCached () const
+{
+    return this->_num_cached;
+}
+
+
+template <typename Dtype>
+int SampleCache<Dtype>::numSamples () const
+{
+    return this->_num_samples;
+}
+
+
+// -----------------------------------------  PRIVATE METHODS  ----------------------------------------- //
+
+template <typename Dtype>
+Dtype* SampleCache<Dtype>::_sample (int i) const
+{
+    return this->_data + size_t(i) * (this->_data_count + this->_label_count);
+}
+
+
+// ----------------------------------------  TEMPLATE INSTANTIATION  ---------------------------------------- //
+
+template class SampleCache<float>;
+template class SampleCache<double>;
+
+
+}  // namespace caffe
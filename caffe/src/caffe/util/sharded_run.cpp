@@ -0,0 +1,278 @@
+#include "caffe/util/sharded_run.hpp"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+
+#include <boost/filesystem.hpp>
+
+#include "caffe/util/fnv1a.hpp"
+
+
+namespace caffe {
+
+
+namespace {
+
+    /**
+     * @brief 64-bit FNV-1a hash of the item list, the items are separated by newlines
+     */
+    uint64_t hashItems (const std::vector<std::string> &items)
+    {
+        uint64_t hash = FNV1A_OFFSET;
+        for (const std::string &item: items)
+        {
+            hash = fnv1a(hash, item.data(), item.size());
+            hash = fnv1a(hash, "\n", 1);
+        }
+        return hash;
+    }
+
+
+    /**
+     * @brief Writes the content to a temporary file and renames it, so the file is replaced atomically
+     */
+    void writeAtomically (const std::string &path, const std::string &content)
+    {
+        const std::string path_tmp = path + ".tmp";
+        {
+            std::ofstream outfile(path_tmp.c_str());
+            outfile << content;
+            outfile.flush();
+            CHECK(outfile) << "Unable to write '" << path_tmp << "'";
+        }
+        CHECK_EQ(std::rename(path_tmp.c_str(), path.c_str()), 0) << "Unable to rename '" << path_tmp << "'";
+    }
+
+}
+
+
+ShardedRun::ShardedRun (const std::string &path_dir, const std::vector<std::string> &items, int chunk_size,
+                        int num_outputs)
+    : _path_dir(path_dir),
+      _num_items(items.size()),
+      _chunk_size(chunk_size),
+      _num_outputs(num_outputs)
+{
+    CHECK_GT(chunk_size, 0);
+    CHECK_GT(num_outputs, 0);
+
+    boost::filesystem::create_directories(path_dir);
+    CHECK(boost::filesystem::is_directory(path_dir)) << "'" << path_dir << "' is not a directory";
+
+    this->_checkManifest(hashItems(items));
+}
+
+
+void ShardedRun::resetQueue () const
+{
+    writeAtomically((boost::filesystem::path(this->_path_dir) / "queue").string(), "0");
+}
+
+
+bool ShardedRun::claim (int &chunk) const
+{
+    const std::string path_queue = (boost::filesystem::path(this->_path_dir) / "queue").string();
+
+    int fd = open(path_queue.c_str(), O_RDWR);
+    CHECK_GE(fd, 0) << "Unable to open the queue '" << path_queue << "', was resetQueue() called?";
+    CHECK_EQ(flock(fd, LOCK_EX), 0) << "Unable to lock the queue '" << path_queue << "'";
+
+    char buffer[32] = {0};
+    CHECK_GE(pread(fd, buffer, sizeof(buffer)-1, 0), 0) << "Unable to read the queue '" << path_queue << "'";
+    int next = std::atoi(buffer);
+
+    // Chunks finished in a previous run are skipped
+    while (next < this->numChunks() && this->isFinished(next)) ++next;
+    chunk = next;
+
+    if (next < this->numChunks())
+    {
+        const std::string content = std::to_string(next+1);
+        CHECK_EQ(ftruncate(fd, 0), 0);
+        CHECK_EQ(pwrite(fd, content.c_str(), content.size(), 0), ssize_t(content.size()))
+                << "Unable to write the queue '" << path_queue << "'";
+    }
+
+    flock(fd, LOCK_UN);
+    close(fd);
+
+    return chunk < this->numChunks();
+}
+
+
+bool ShardedRun::isFinished (int chunk) const
+{
+    return boost::filesystem::exists(this->chunkPath(chunk, ".done"));
+}
+
+
+bool ShardedRun::merge (const std::vector<std::string> &paths_out) const
+{
+    CHECK_EQ(paths_out.size(), this->_num_outputs);
+
+    for (int c = 0; c < this->numChunks(); ++c)
+    {
+        if (!this->isFinished(c))
+        {
+            LOG(WARNING) << "Chunk " << c << " (items " << this->chunkBegin(c) << "-" << this->chunkEnd(c)
+                         << ") is not finished";
+            return false;
+        }
+    }
+
+    for (int o = 0; o < this->_num_outputs; ++o)
+    {
+        std::ofstream outfile(paths_out[o].c_str(), std::ios::binary);
+        CHECK(outfile) << "Output file '" << paths_out[o] << "' could not have been created!";
+
+        for (int c = 0; c < this->numChunks(); ++c)
+        {
+            const std::string path = this->chunkPath(c, ".out" + std::to_string(o));
+            std::ifstream infile(path.c_str(), std::ios::binary);
+            CHECK(infile) << "Unable to open '" << path << "'";
+            // Empty chunk outputs would set failbit of the output stream
+            if (infile.peek() != std::ifstream::traits_type::eof()) outfile << infile.rdbuf();
+        }
+
+        CHECK(outfile) << "Unable to write '" << paths_out[o] << "'";
+    }
+
+    return true;
+}
+
+
+int ShardedRun::numChunks () const
+{
+    return (this->_num_items + this->_chunk_size - 1) / this->_chunk_size;
+}
+
+
+int ShardedRun::chunkBegin (int chunk) const
+{
+    return chunk * this->_chunk_size;
+}
+
+
+int ShardedRun::chunkEnd (int chunk) const
+{
+    return std::min(this->_num_items, (chunk+1) * this->_chunk_size);
+}
+
+
+int ShardedRun::numOutputs () const
+{
+    return this->_num_outputs;
+}
+
+
+std::string ShardedRun::chunkPath (int chunk, const std::string &extension) const
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "chunk_%06d", chunk);
+    return (boost::filesystem::path(this->_path_dir) / (buffer + extension)).string();
+}
+
+
+// -----------------------------------------  PRIVATE METHODS  ----------------------------------------- //
+
+void ShardedRun::_checkManifest (uint64_t items_hash) const
+{
+    const std::string path_manifest = (boost::filesystem::path(this->_path_dir) / "manifest").string();
+    const std::string manifest = std::to_string(this->_num_items) + " " + std::to_string(this->_chunk_size)
+            + " " + std::to_string(this->_num_outputs) + " " + std::to_string(items_hash);
+
+    std::ifstream infile(path_manifest.c_str());
+    if (!infile)
+    {
+        writeAtomically(path_manifest, manifest);
+        return;
+    }
+
+    std::string previous;
+    std::getline(infile, previous);
+    CHECK_EQ(previous, manifest) << "'" << this->_path_dir << "' belongs to a run with a different item list "
+                                 << "or settings (items, chunk size, outputs, list hash), remove it to start over";
+}
+
+
+// -------------------------------------------  CHUNK WRITER  ------------------------------------------- //
+
+ChunkWriter::ChunkWriter (const ShardedRun &run, int chunk)
+    : _run(run),
+      _chunk(chunk),
+      _next_item(run.chunkBegin(chunk))
+{
+    CHECK(!run.isFinished(chunk)) << "Chunk " << chunk << " is already finished";
+
+    // Sizes of the outputs at the last checkpoint
+    std::vector<uint64_t> sizes(run.numOutputs(), 0);
+
+    std::ifstream ckpt(run.chunkPath(chunk, ".ckpt").c_str());
+    if (ckpt)
+    {
+        ckpt >> this->_next_item;
+        for (uint64_t &size: sizes) ckpt >> size;
+        CHECK(ckpt) << "Corrupted checkpoint '" << run.chunkPath(chunk, ".ckpt") << "'";
+        LOG(INFO) << "Resuming chunk " << chunk << " from item " << this->_next_item;
+    }
+
+    for (int o = 0; o < run.numOutputs(); ++o)
+    {
+        // Throw away everything written after the checkpoint
+        const std::string path = run.chunkPath(chunk, ".out" + std::to_string(o));
+        std::ofstream(path.c_str(), std::ios::app);
+        CHECK_EQ(truncate(path.c_str(), sizes[o]), 0) << "Unable to truncate '" << path << "'";
+
+        this->_outputs.emplace_back(new std::ofstream(path.c_str(), std::ios::app));
+        CHECK(*this->_outputs.back()) << "Unable to open '" << path << "'";
+    }
+}
+
+
+int ChunkWriter::nextItem () const
+{
+    return this->_next_item;
+}
+
+
+std::ofstream& ChunkWriter::output (int i)
+{
+    return *this->_outputs[i];
+}
+
+
+void ChunkWriter::checkpoint ()
+{
+    CHECK_LT(this->_next_item, this->_run.chunkEnd(this->_chunk));
+    ++this->_next_item;
+
+    std::string content = std::to_string(this->_next_item);
+    for (int o = 0; o < this->_outputs.size(); ++o)
+    {
+        const std::string path = this->_run.chunkPath(this->_chunk, ".out" + std::to_string(o));
+        this->_outputs[o]->flush();
+        CHECK(*this->_outputs[o]) << "Unable to write '" << path << "'";
+        content += " " + std::to_string(boost::filesystem::file_size(path));
+    }
+
+    writeAtomically(this->_run.chunkPath(this->_chunk, ".ckpt"), content);
+}
+
+
+void ChunkWriter::finish ()
+{
+    CHECK_EQ(this->_next_item, this->_run.chunkEnd(this->_chunk)) << "Not all items of the chunk were processed";
+
+    for (auto &output: this->_outputs) output->close();
+
+    writeAtomically(this->_run.chunkPath(this->_chunk, ".done"), "");
+    std::remove(this->_run.chunkPath(this->_chunk, ".ckpt").c_str());
+}
+
+
+}  // namespace caffe
@@ -13,6 +13,7 @@ namespace bp = boost::python;
 
 #include "boost/algorithm/string.hpp"
 #include "caffe/caffe.hpp"
+#include "caffe/util/cpu_resources.hpp"
 #include "caffe/util/signal_handler.h"
 
 using caffe::Blob;
@@ -54,6 +55,14 @@ DEFINE_string(sigint_effect, "stop",
 DEFINE_string(sighup_effect, "snapshot",
              "Optional; action to take when a SIGHUP signal is received: "
              "snapshot, stop or none.");
+DEFINE_string(cpu_shares, "",
+    "Optional; shares of the CPU cores of the compute (BLAS, solver), data "
+    "layer and loss layer threads as compute:data:loss. Defaults to "
+    "$CAFFE_CPU_SHARES or 2:2:1. The BLAS threads are only limited to the "
+    "compute cores with explicitly given shares.");
+DEFINE_string(cpu_pinning, "",
+    "Optional; pinning of the threads to their cores: none, core or numa. "
+    "Defaults to $CAFFE_CPU_PINNING or none.");
 
 // A simple registry for caffe commands.
 typedef int (*BrewFunction)();
@@ -441,6 +450,11 @@ int main(int argc, char** argv) {
       "  time            benchmark model execution time");
   // Run tool or show usage.
   caffe::GlobalInit(&argc, &argv);
+  // Split the cores between the thread pools (the layout is reported)
+  if (!FLAGS_cpu_shares.empty() || !FLAGS_cpu_pinning.empty()) {
+    caffe::CPUResources::Get().configure(FLAGS_cpu_shares, FLAGS_cpu_pinning);
+  }
+  caffe::CPUResources::Get().pinThread(caffe::CPUResources::COMPUTE);
   if (argc == 2) {
 #ifdef WITH_PYTHON_LAYER
     try {
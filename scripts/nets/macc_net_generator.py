@@ -13,8 +13,20 @@ conv k3      o256
 conv k3  d2  o256
 macc x4
 
+With the "joint" type each macc line creates two accumulators on the same features - a 2D one (5
+channels, BBTXTLoss) and a 3D one (8 channels, BB3TXTLoss). Both losses are trained from the labels
+of the BB3TXTData layer, which start with the 2D bounding box, so one network replaces a pair of
+bbtxt and bb3txt networks.
+
+With --teacher_config the train_val network distills a trained teacher network (e.g. a wider one).
+The teacher layers keep their names, so that the teacher caffemodel can be loaded by name (caffe
+train --weights teacher.caffemodel), they are frozen and run in the TEST phase. The accumulators of
+the teacher are the third bottoms of the loss layers, the student layers get the "student_" prefix.
+The teacher must have accumulators of the same scales and types as the student.
+
 ----------------------------------------------------------------------------------------------------
-python macc_net_generator.py path/to/config.txt path/to/output/folder
+python macc_net_generator.py path/to/config.txt path/to/output/folder bbtxt|bb3txt|joint
+                              [--teacher_config path/to/teacher_config.txt --distill_weight 0.5]
 ----------------------------------------------------------------------------------------------------
 """
 
@@ -70,14 +82,24 @@ def get_value_int(data, id, required=False):
 ####################################################################################################
 
 class MACCNetGenerator(object):
-	def __init__(self, path_config, bb_type):
+	def __init__(self, path_config, bb_type, path_teacher_config=None, distill_weight=0.5,
+				 frozen=False):
 		"""
 		Input:
-			path_config: Path to a configuration file with net structure
-			bb_type:     Type of data and loss layers ('bbtxt', 'bb3txt')
+			path_config:         Path to a configuration file with net structure
+			bb_type:             Type of data and loss layers ('bbtxt', 'bb3txt', 'joint')
+			path_teacher_config: Path to a configuration file of the teacher network (distillation)
+			distill_weight:      Weight of the teacher accumulators in the targets of the loss
+			frozen:              True for the teacher - no learning, TEST phase
 		"""
-		self.path_config = path_config
-		self.bb_type     = bb_type
+		self.path_config         = path_config
+		self.bb_type             = bb_type
+		self.path_teacher_config = path_teacher_config
+		self.distill_weight      = distill_weight
+		self.frozen              = frozen
+		# The student layers must not have the same names as the teacher ones
+		self.prefix              = 'student_' if path_teacher_config is not None else ''
+		self.teacher_accs        = {}
 
 		self.reset()
 
@@ -94,6 +116,7 @@ class MACCNetGenerator(object):
 		self.accs = []
 		self.acc_scales = []
 		self.acc_bbs_ideal = []
+		self.acc_types = []
 
 
 	def generate_prototxt_files(self, path_out):
@@ -102,23 +125,8 @@ class MACCNetGenerator(object):
 		if not os.path.exists(path_out):
 			os.makedirs(path_out)
 
-		lines = []
-
 		# Parse the configuration file and create the train_val.prototxt and deploy.protoxt files
-		with open(self.path_config, 'r') as infile:
-			# First line contains the name of the network
-			self.name = infile.readline().rstrip('\n')
-
-			# Second line contains the radius of the circle in the accumulator and the circle
-			# ratio - the size of the circle in the accumulator with respect to max(w,h) of
-			# a bounding box
-			data = infile.readline().rstrip('\n').split()
-			self.radius       = get_value_int(data, 'r', required=True)
-			self.circle_ratio = get_value_float(data, 'c', required=True)
-			
-			for line in infile:
-				lines.append(line.rstrip('\n'))
-				print(line.rstrip('\n'))
+		lines = self._read_config()
 
 
 		# Create the train_val.prototxt file
@@ -129,6 +137,9 @@ class MACCNetGenerator(object):
 			outfile.write('name: "' + self.name + '"\n\n')
 			outfile.write(self._layer_data('TRAIN'))
 			outfile.write(self._layer_data('TEST'))
+
+			if self.path_teacher_config is not None:
+				self._add_teacher(outfile)
 			
 			outfile.write('\n# ' + '-'*38 + ' NETWORK STRUCTURE ' + '-'*39 + ' #\n')
 			outfile.write(self._downsampling())
@@ -160,6 +171,56 @@ class MACCNetGenerator(object):
 	#                                          PRIVATE                                             #
 	################################################################################################
 
+	def _read_config(self):
+		"""
+		Reads the configuration file - sets the name of the network, the radius and the circle ratio
+		and returns the lines with the layers.
+		"""
+		lines = []
+
+		with open(self.path_config, 'r') as infile:
+			# First line contains the name of the network
+			self.name = infile.readline().rstrip('\n')
+
+			# Second line contains the radius of the circle in the accumulator and the circle
+			# ratio - the size of the circle in the accumulator with respect to max(w,h) of
+			# a bounding box
+			data = infile.readline().rstrip('\n').split()
+			self.radius       = get_value_int(data, 'r', required=True)
+			self.circle_ratio = get_value_float(data, 'c', required=True)
+			
+			for line in infile:
+				lines.append(line.rstrip('\n'))
+				print(line.rstrip('\n'))
+
+		return lines
+
+
+	def _add_teacher(self, outfile):
+		"""
+		Adds the frozen teacher network to the PROTOTXT file, its accumulators are remembered for the
+		loss layers.
+
+		Input:
+			outfile: File handle into which we will write the layers
+		"""
+		print('\n-- TEACHER')
+		teacher = MACCNetGenerator(self.path_teacher_config, self.bb_type, frozen=True)
+		lines = teacher._read_config()
+		teacher.reset()
+
+		outfile.write('\n# ' + '-'*39 + ' TEACHER (FROZEN) ' + '-'*39 + ' #\n')
+		outfile.write(teacher._downsampling())
+
+		for line in lines:
+			teacher._add_layer(line, outfile, False)
+
+		for name, scale, acc_type in zip(teacher.accs, teacher.acc_scales, teacher.acc_types):
+			self.teacher_accs[(acc_type, scale)] = name
+
+		print('\n-- STUDENT')
+
+
 	def _add_layer(self, line, outfile, deploy):
 		"""
 		Adds one layer to the PROTOTXT file specified by the line.
@@ -190,7 +251,8 @@ class MACCNetGenerator(object):
 		"""
 		return ('layer {\n' \
 				'  name: "relu_' + self.previous_layer + '"\n' \
-				'  type: "ReLU"\n' \
+				'  type: "ReLU"\n' + \
+				self._phase() + \
 				'  bottom: "' + self.previous_layer + '"\n' \
 				'  top: "' + self.previous_layer + '"\n' \
 				'}\n')
@@ -204,7 +266,7 @@ class MACCNetGenerator(object):
 			specs: string (one line from the config file) with the layer description
 			deploy: True/False - includes or does not include weight filling
 		"""
-		name = 'conv_x%d_%d'%(self.downsampling, self.new_conv_id)
+		name = self.prefix + 'conv_x%d_%d'%(self.downsampling, self.new_conv_id)
 		self.new_conv_id += 1
 
 		# Parse specs
@@ -233,19 +295,13 @@ class MACCNetGenerator(object):
 		out  = ('layer {\n' \
 				'  # ' + '-'*23 + '  FOV %d x %d  (%d+%d=%d)\n'%(fov, fov, self.fov_base * self.downsampling, self.fov_prev_downsampling-ceil(self.downsampling/2.0), fov) + \
 				'  name: "' + name + '"\n' \
-				'  type: "Convolution"\n' \
+				'  type: "Convolution"\n' + \
+				self._phase() + \
 				'  bottom: "' + self.previous_layer + '"\n' \
 				'  top: "' + name + '"\n')
 
 		if not deploy:
-			out += ('  param {\n' \
-					'    lr_mult: 1\n' \
-					'    decay_mult: 1\n' \
-					'  }\n' \
-					'  param {\n' \
-					'    lr_mult: 2\n' \
-					'    decay_mult: 0\n' \
-					'  }\n')
+			out += self._params()
 
 		out += ('  convolution_param {\n' \
 				'    num_output: %d\n'%(num_output) + \
@@ -255,7 +311,7 @@ class MACCNetGenerator(object):
 		if dilation is not None:
 			out += '    dilation: %d\n'%(dilation+1)
 
-		if not deploy:
+		if not deploy and not self.frozen:
 			out += ('    weight_filler {\n' \
 					'      type: "xavier"\n' \
 					'    }\n' \
@@ -286,14 +342,15 @@ class MACCNetGenerator(object):
 		self.fov_base = 1
 		self.fov_prev_downsampling = self.fov_previous
 
-		name = 'pool_x%d'%(self.downsampling)
+		name = self.prefix + 'pool_x%d'%(self.downsampling)
 
 		print('-- Pool')
 
 		out  = self._downsampling()
 		out += ('layer {\n' \
 				'  name: "' + name + '"\n' \
-				'  type: "Pooling"\n' \
+				'  type: "Pooling"\n' + \
+				self._phase() + \
 				'  bottom: "' + self.previous_layer + '"\n' \
 				'  top: "' + name + '"\n' \
 				'  pooling_param {\n' \
@@ -310,7 +367,8 @@ class MACCNetGenerator(object):
 
 	def _layer_macc(self, specs, deploy=False):
 		"""
-		Creates a description of an accumulator layer from the specs.
+		Creates a description of an accumulator layer from the specs. The joint network gets a 2D and
+		a 3D accumulator on the same features.
 
 		Input:
 			specs: string (line from the config file) with the layer description
@@ -322,52 +380,83 @@ class MACCNetGenerator(object):
 			print('ERROR: Accumulator of this scale cannot be created "' + specs + '"!')
 			exit()
 
-		name = 'acc_x%d'%(scale)
 		bb_ideal = (2*self.radius+1) * scale * 1/self.circle_ratio
 
-		print('-- ' + name + ' \t SCALE 1/%d  (FOV %d x %d, BB %dx%d px)'%(scale, self.last_in_scale_fov[scale], self.last_in_scale_fov[scale], bb_ideal, bb_ideal))
+		out = ''
+		for acc_type in (['bbtxt', 'bb3txt'] if self.bb_type == 'joint' else [self.bb_type]):
+			# The 3D accumulators of the joint network need different names
+			name = self.prefix + 'acc%s_x%d'%('3d' if self.bb_type == 'joint' and acc_type == 'bb3txt' else '', scale)
 
-		out  = ('layer {\n' \
-				'  # -----------------------  ACCUMULATOR\n' \
-				'  # -----------------------  SCALE 1/%d  (FOV %d x %d)\n'%(scale, self.last_in_scale_fov[scale], self.last_in_scale_fov[scale]) + \
-				'  # -----------------------  Ideal bounding box size: %dx%d px\n'%(bb_ideal, bb_ideal) + \
-				'  name: "' + name + '"\n' \
-				'  type: "Convolution"\n' \
-				'  bottom: "' + self.last_in_scale[scale] + '"\n' \
-				'  top: "' + name + '"\n')
+			print('-- ' + name + ' \t SCALE 1/%d  (FOV %d x %d, BB %dx%d px)'%(scale, self.last_in_scale_fov[scale], self.last_in_scale_fov[scale], bb_ideal, bb_ideal))
 
-		if not deploy:
-			out += ('  param {\n' \
-					'    lr_mult: 1\n' \
-					'    decay_mult: 1\n' \
+			out += ('layer {\n' \
+					'  # -----------------------  ACCUMULATOR\n' \
+					'  # -----------------------  SCALE 1/%d  (FOV %d x %d)\n'%(scale, self.last_in_scale_fov[scale], self.last_in_scale_fov[scale]) + \
+					'  # -----------------------  Ideal bounding box size: %dx%d px\n'%(bb_ideal, bb_ideal) + \
+					'  name: "' + name + '"\n' \
+					'  type: "Convolution"\n' + \
+					self._phase() + \
+					'  bottom: "' + self.last_in_scale[scale] + '"\n' \
+					'  top: "' + name + '"\n')
+
+			if not deploy:
+				out += self._params()
+
+			out += ('  convolution_param {\n' \
+					'    num_output: ' + ('8' if acc_type == 'bb3txt' else '5') + '\n' \
+					'    kernel_size: 1\n')
+
+			if not deploy and not self.frozen:
+				out += ('    weight_filler {\n' \
+						'      type: "xavier"\n' \
+						'    }\n' \
+						'    bias_filler {\n' \
+						'      type: "constant"\n' \
+						'      value: 0\n' \
+						'    }\n')
+
+			out += ('  }\n' \
+					'}\n')
+
+			# List of accumulators - for the loss layer
+			self.accs.append(name)
+			self.acc_scales.append(scale)
+			self.acc_bbs_ideal.append(bb_ideal)
+			self.acc_types.append(acc_type)
+
+		return out
+
+
+	def _params(self):
+		"""
+		Learning rate multipliers of the weights and biases of a convolutional layer, the frozen
+		teacher does not learn.
+		"""
+		if self.frozen:
+			return ('  param {\n' \
+					'    lr_mult: 0\n' \
+					'    decay_mult: 0\n' \
 					'  }\n' \
 					'  param {\n' \
-					'    lr_mult: 2\n' \
+					'    lr_mult: 0\n' \
 					'    decay_mult: 0\n' \
 					'  }\n')
 
-		out += ('  convolution_param {\n' \
-				'    num_output: ' + ('8' if self.bb_type == 'bb3txt' else '5') + '\n' \
-				'    kernel_size: 1\n')
-
-		if not deploy:
-			out += ('    weight_filler {\n' \
-					'      type: "xavier"\n' \
-					'    }\n' \
-					'    bias_filler {\n' \
-					'      type: "constant"\n' \
-					'      value: 0\n' \
-					'    }\n')
-
-		out += ('  }\n' \
-				'}\n')
+		return ('  param {\n' \
+				'    lr_mult: 1\n' \
+				'    decay_mult: 1\n' \
+				'  }\n' \
+				'  param {\n' \
+				'    lr_mult: 2\n' \
+				'    decay_mult: 0\n' \
+				'  }\n')
 
-		# List of accumulators - for the loss layer
-		self.accs.append(name)
-		self.acc_scales.append(scale)
-		self.acc_bbs_ideal.append(bb_ideal)
 
-		return out
+	def _phase(self):
+		"""
+		The frozen teacher is computed in the TEST phase.
+		"""
+		return '  phase: TEST\n' if self.frozen else ''
 
 
 	def _downsampling(self):
@@ -384,20 +473,29 @@ class MACCNetGenerator(object):
 		out = '\n# ' + '-'*45 + ' LOSS ' + '-'*45 + ' #\n'
 
 		for i in range(len(self.accs)):
+			teacher_acc = None
+			if self.path_teacher_config is not None:
+				teacher_acc = self.teacher_accs.get((self.acc_types[i], self.acc_scales[i]))
+				if teacher_acc is None:
+					print('ERROR: The teacher does not have the accumulator of "' + self.accs[i] + '"!')
+					exit()
+
 			out += ('layer {\n' \
 					'  # -----------------------  SCALE 1/%d  (FOV %d x %d)\n'%(self.acc_scales[i], self.last_in_scale_fov[self.acc_scales[i]], self.last_in_scale_fov[self.acc_scales[i]]) + \
 					'  # -----------------------  Ideal bounding box size: %dx%d px\n'%(self.acc_bbs_ideal[i], self.acc_bbs_ideal[i]) + \
-					'  name: "loss_x%d"\n'%(self.acc_scales[i]) + \
-					'  type: "BB' + ('3' if self.bb_type == 'bb3txt' else '') + 'TXTLoss"\n' \
+					'  name: "' + self.accs[i].replace('acc', 'loss', 1) + '"\n' + \
+					'  type: "BB' + ('3' if self.acc_types[i] == 'bb3txt' else '') + 'TXTLoss"\n' \
 					'  bottom: "label"\n'
-					'  bottom: "' + self.accs[i] + '"\n'
-					'  top: "loss_x%d"\n'%(self.acc_scales[i]) + \
+					'  bottom: "' + self.accs[i] + '"\n' + \
+					('  bottom: "' + teacher_acc + '"\n' if teacher_acc is not None else '') + \
+					'  top: "' + self.accs[i].replace('acc', 'loss', 1) + '"\n' + \
 					'  accumulator_loss_param {\n' \
 					'    radius: %d\n'%(self.radius) + \
 					'    downsampling: %d\n'%(self.acc_scales[i]) + \
 					'    negative_ratio: 30\n' \
 					'    circle_ratio: %f\n'%(self.circle_ratio) + \
-					'    bounds_overlap: 0.33\n' + 
+					'    bounds_overlap: 0.33\n' + \
+					('    distill_weight: %f\n'%(self.distill_weight) if teacher_acc is not None else '') + \
 					'  }\n' \
 					'}\n')
 
@@ -414,8 +512,8 @@ class MACCNetGenerator(object):
 			out += ('layer {\n' \
 					'  # -----------------------  SCALE 1/%d  (FOV %d x %d)\n'%(self.acc_scales[i], self.last_in_scale_fov[self.acc_scales[i]], self.last_in_scale_fov[self.acc_scales[i]]) + \
 					'  # -----------------------  Ideal bounding box size: %dx%d px\n'%(self.acc_bbs_ideal[i], self.acc_bbs_ideal[i]) + \
-					'  name: "bb_x%d"\n'%(self.acc_scales[i]) + \
-					'  type: "BB' + ('3' if self.bb_type == 'bb3txt' else '') + 'TXTBB"\n' \
+					'  name: "' + self.accs[i].replace('acc', 'bb', 1) + '"\n' + \
+					'  type: "BB' + ('3' if self.acc_types[i] == 'bb3txt' else '') + 'TXTBB"\n' \
 					'  bottom: "' + self.accs[i] + '"\n'
 					'  top: "' + self.accs[i] + '"\n' \
 					'  bbtxt_bb_param {\n' \
@@ -448,7 +546,7 @@ class MACCNetGenerator(object):
 		"""
 		out  = ('layer {\n' \
 				'  name: "data"\n' \
-				'  type: "BB' + ('3' if self.bb_type == 'bb3txt' else '') + 'TXTData"\n' \
+				'  type: "BB' + ('' if self.bb_type == 'bbtxt' else '3') + 'TXTData"\n' \
 				'  top: "data"\n' \
 				'  top: "label"\n' \
 				'  include {\n' \
@@ -503,14 +601,25 @@ def parse_arguments():
 	parser.add_argument('path_out', metavar='path_out', type=str,
 	                    help='Path to the output folder')
 	parser.add_argument('bb_type', metavar='bb_type', type=str,
-	                    help='Type of data and loss layers. One of ["bbtxt", "bb3txt"]')
+	                    help='Type of data and loss layers. One of ["bbtxt", "bb3txt", "joint"]')
+	parser.add_argument('--teacher_config', type=str, default=None,
+	                    help='A configuration TXT file of the teacher network for distillation')
+	parser.add_argument('--distill_weight', type=float, default=0.5,
+	                    help='Weight of the teacher accumulators in the targets (0 to 1)')
 
 	args = parser.parse_args()
 
 	if not check_path(args.path_config):
 		parser.print_help()
 		exit(1)
-	if args.bb_type not in ['bbtxt', 'bb3txt']:
+	if args.teacher_config is not None and not check_path(args.teacher_config):
+		parser.print_help()
+		exit(1)
+	if args.distill_weight < 0.0 or args.distill_weight > 1.0:
+		print('ERROR: Distillation weight must be in [0, 1]!')
+		parser.print_help()
+		exit(1)
+	if args.bb_type not in ['bbtxt', 'bb3txt', 'joint']:
 		print('ERROR: Incorrect data and loss type!')
 		parser.print_help()
 		exit(1)
@@ -521,7 +630,7 @@ def parse_arguments():
 def main():
 	args = parse_arguments()
 	
-	ng = MACCNetGenerator(args.path_config, args.bb_type)
+	ng = MACCNetGenerator(args.path_config, args.bb_type, args.teacher_config, args.distill_weight)
 	ng.generate_prototxt_files(args.path_out)
 
 